@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "symbols.h"
 
@@ -72,7 +73,69 @@ void error_invalid_byIndex_argument()
         LogError("A call to byIndex() has an invalid argument type."
                  "Valid types are:\n"
                  "\t- Constants. ie: byIndex(5)\n"
-                 "\t- Ranges. ie: byIndex([1..6])");
+                 "\t- Ranges. ie: byIndex([1..6])\n"
+                 "\t- Lists of line numbers. ie: byIndex([2, 5, 7])");
+}
+
+void error_invalid_columns_argument()
+{
+        LogError("A call to columns() has an invalid argument type."
+                 "Valid types are:\n"
+                 "\t- Constants. ie: columns(3)\n"
+                 "\t- Ranges. ie: columns([1..4])\n"
+                 "\t- Lists of column numbers. ie: columns([2, 5])");
+}
+
+void error_invalid_sort_argument()
+{
+        LogError("A call to sort() has an invalid argument."
+                 "Valid arguments are:\n"
+                 "\t- A column number. ie: sort(3)\n"
+                 "\t- numeric or lexical (default). ie: sort(3, numeric)\n"
+                 "\t- asc (default) or desc. ie: sort(3, numeric, desc)");
+}
+
+void error_invalid_group_argument()
+{
+        LogError("A call to group() has an invalid argument."
+                 "Valid arguments are:\n"
+                 "\t- The column number of the key. ie: group(2)\n"
+                 "\t- count. ie: group(2, count)\n"
+                 "\t- sum, min, max or avg and the column number of their "
+                 "values. ie: group(2, count, sum, 4)");
+}
+
+void error_invalid_distinct_argument(const char *name)
+{
+        LogError("A call to %s() has an invalid argument."
+                 "Valid arguments are:\n"
+                 "\t- None, to compare whole lines. ie: %s()\n"
+                 "\t- The column number of the key. ie: %s(2)",
+                 name, name, name);
+}
+
+void error_invalid_join_argument()
+{
+        LogError("A call to join() has an invalid argument."
+                 "Valid arguments are:\n"
+                 "\t- The input file to join, then the column number of "
+                 "the key in each file. ie: join(inputUsers, 2, 1)\n"
+                 "\t- inner or left, inner by default. "
+                 "ie: join(inputUsers, 2, 1, left)");
+}
+
+void error_invalid_top_argument(const char *name)
+{
+        if (strcmp(name, "longest") == 0)
+                LogError("A call to longest() has an invalid argument."
+                         "Valid arguments are:\n"
+                         "\t- None, for the longest line. ie: longest()\n"
+                         "\t- How many lines. ie: longest(10)");
+        else
+                LogError("A call to top() has an invalid argument."
+                         "Valid arguments are:\n"
+                         "\t- How many lines, then the column number of "
+                         "their values. ie: top(100, 5)");
 }
 
 void error_invalid_multiplication_type()
@@ -88,3 +151,8 @@ void error_loop_iterable_of_invalid_type()
         "\t- Functions. ie: for variable_name in lines() do"
         "\t- Ranges. ie: for variable_name in [1..6] do");
 }
+
+void error_not_supported_by_vm(const char *what)
+{
+        LogError("%s is not supported by the texler VM.", what);
+}
@@ -14,7 +14,14 @@ void error_in_function(const char *name);
 void error_invalid_file_variable_name(const char *name);
 void error_invalid_node_file_handler(const char *function);
 void error_invalid_byIndex_argument();
+void error_invalid_columns_argument();
+void error_invalid_sort_argument();
+void error_invalid_group_argument();
+void error_invalid_distinct_argument(const char *name);
+void error_invalid_join_argument();
+void error_invalid_top_argument(const char *name);
 void error_invalid_multiplication_type();
 void error_loop_iterable_of_invalid_type();
+void error_not_supported_by_vm(const char *what);
 
 #endif
@@ -7,20 +7,53 @@
 #include "../error.h"
 
 #include "free_function_call.h"
-#include "standard_functions.h"
-#include "internal_functions.h"
 
 #include "code-generator.h"
 
 //utils with functions to deal with code generation for each specific node type
 
+/*
+ * Depth of the loop braces where each buffer of a file loop was declared,
+ * 0 if it was not. They are freed right before that brace is closed.
+ */
+typedef struct {
+        size_t line; // lines(), named after the loop variable
+        size_t line_line; // Raw line split by columns()
+        size_t columns; // Column of columns()
+        size_t byIndex; // Rows of byIndex([...]), read by lines_by_numbers()
+        size_t sort; // Records of lines().sort()
+        size_t group; // Groups of lines().group(), of every file
+        size_t distinct; // Keys seen by lines().distinct() or uniq()
+        size_t join; // Records of the other file of lines().join()
+        size_t top; // Records of lines().top() or longest(), of every file
+} loop_buffers;
+
+/* Aggregates group() takes, by name, and their runtime constant */
+static const struct {
+        const char *name;
+        const char *type;
+        bool has_column;
+} group_aggregates[] = {
+        { "count", "TEXLER_AGGREGATE_COUNT", false },
+        { "sum", "TEXLER_AGGREGATE_SUM", true },
+        { "min", "TEXLER_AGGREGATE_MIN", true },
+        { "max", "TEXLER_AGGREGATE_MAX", true },
+        { "avg", "TEXLER_AGGREGATE_AVG", true },
+};
+
+typedef struct {
+        size_t aggregate; // In group_aggregates
+        unsigned long column;
+} group_argument;
+
 static FILE *open_output_file(const char *filename);
 static bool generate_c_main(FILE *const output, node_function *main_function);
+static void generate_loop_closing_braces(FILE *const output, node_loop *loop,
+                                         size_t closing_braces,
+                                         const loop_buffers *buffers,
+                                         const char *working_filename);
 
 static void generate_header(FILE *const output);
-static void generate_header_types_TexlerObject(FILE *const output);
-static void generate_header_types(FILE *const output);
-static void generate_header_macros_and_constants(FILE *const output);
 
 static bool generate_function(FILE *const output, node_function *function);
 static bool generate_args(FILE *const output, node_list *args);
@@ -70,6 +103,57 @@ static bool generate_conditional(FILE *const output,
                                  node_conditional *conditional,
                                  const char *working_filename);
 
+static bool generate_byIndex_row_set(FILE *const output, node_list *rows,
+                                     const char *working_filename);
+static int compare_rows(const void *a, const void *b);
+static bool generate_column_set(FILE *const output,
+                                node_function_call *columns,
+                                const char *working_filename);
+static bool chain_has_function(node_function_call *fn_calls, const char *name);
+static node_function_call *find_next_function(node_function_call *fn_calls,
+                                              const char *name);
+static bool sort_arguments(node_function_call *sort, unsigned long *column,
+                           bool *numeric, bool *descending);
+static bool join_arguments(node_function_call *join, const char **other,
+                           unsigned long *column, unsigned long *other_column,
+                           bool *left);
+static group_argument *group_arguments(node_function_call *group,
+                                       unsigned long *column,
+                                       size_t *n_aggregates);
+static bool generate_group(FILE *const output, node_loop *loop,
+                           node_function_call *group,
+                           const char *working_filename);
+static node_function_call *find_top(node_function_call *fn_calls);
+static bool generate_top(FILE *const output, node_loop *loop,
+                         node_function_call *top,
+                         const char *working_filename);
+static node_function_call *find_distinct(node_function_call *fn_calls);
+static bool generate_distinct(FILE *const output,
+                              node_function_call *fn_calls,
+                              const char *working_filename);
+static void generate_line_predicates(FILE *const output,
+                                     node_function_call *fn_calls,
+                                     const char *line_name);
+static void generate_cell_filter_pushdown(FILE *const output, node_loop *loop,
+                                          const char *line_name);
+
+/* Loop variable of the columns().lines() loop being generated, if any */
+static variable *columns_loop_variable = NULL;
+/* and the file it splits, whose cells may be parsed already (cache.c) */
+static const char *columns_loop_file = NULL;
+
+/* Shared object with texler_run() instead of an executable (texler -l) */
+static bool generate_library = false;
+
+/* Returned to the caller, so it is not freed when the function ends */
+static const variable *return_variable = NULL;
+
+/* Statement that leaves the function being generated because of an error */
+static const char *error_return(void)
+{
+        return return_variable == NULL ? "return 1;" : "return NULL;";
+}
+
 static const char *
 generate_number_arithmetic_add(FILE *const output, node_expression *left,
                                node_expression *right,
@@ -98,7 +182,7 @@ static bool generate_variable_assignment_from_function_call_from_id(
         FILE *const output, variable *dest,
         node_function_call *id_plus_function, const char *working_file);
 
-bool generate_code(program_t *ast, const char *filename)
+bool generate_code(program_t *ast, const char *filename, bool library)
 {
         if (filename == NULL) {
                 LogError("Please provide a filename for the C code.");
@@ -110,9 +194,8 @@ bool generate_code(program_t *ast, const char *filename)
         if (out_file == NULL)
                 return false;
 
+        generate_library = library;
         generate_header(out_file);
-        generate_internal_functions(out_file);
-        generate_standard_functions(out_file);
 
         if (!generate_function(out_file, ast->main_function)) {
                 fclose(out_file);
@@ -161,203 +244,107 @@ static bool generate_c_main(FILE *const output, node_function *main_function)
         if (main_function == NULL)
                 return false;
 
-        fputs("int main(const int argc, const char **argv)", output);
+        // Executables parse --file and --batch in texler_main(), which
+        // calls texler_run() once per run
+        if (generate_library)
+                fputs("TEXLER_EXPORT ", output);
+        else
+                fputs("static ", output);
+        fputs("int texler_run(texler_stream *streams, size_t n_streams, "
+              "const int argc, const char **argv)",
+              output);
         fputc('{', output);
+        fputs("texler_context _context = { streams, n_streams };", output);
 
-        if (main_function->args == NULL || main_function->args->len == 0) {
-                fprintf(output, "return %s();", main_function->name);
-        } else {
-                //
+        free_function_call_array *frees_stack =
+                (free_function_call_array *)calloc(
+                        1, sizeof(free_function_call_array));
+        if (frees_stack == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
 
-                free_function_call_array *frees_stack =
-                        (free_function_call_array *)calloc(
-                                1, sizeof(free_function_call_array));
-                if (frees_stack == NULL) {
-                        perror("Aborting due to");
-                        exit(1);
-                }
+        const long n_args =
+                main_function->args == NULL ? 0 : main_function->args->len;
 
-                for (long n_args = 0; n_args < main_function->args->len;
-                     n_args++) {
-                        fprintf(output,
-                                "TexlerObject * %s = "
-                                "(TexlerObject *)"
-                                "calloc(1, sizeof(TexlerObject));",
-                                main_function->args->exprs[n_args]->var->name);
-
-                        generate_allocation_error_msg(
-                                output,
-                                main_function->args->exprs[n_args]->var->name);
-
-                        push_free_function_call(
-                                frees_stack,
-                                main_function->args->exprs[n_args]->var->name,
-                                "free_texlerobject");
-
-                        // Caso base: argv[0] es un número
-                        // HI: argv[n] es un número
-                        // TI: argv[n+1] es un número
-
-                        fprintf(output, "%s->type = TYPE_T_REAL;",
-                                main_function->args->exprs[n_args]->var->name);
-                        fprintf(output, "%s->value.real = atof(argv[%ld]);",
-                                main_function->args->exprs[n_args]->var->name,
-                                n_args + 1);
-
-                        // La prueba resulta ser errónea, pero lo revisaremos
-                        // en la versión 2 de este paper.
-                }
+        for (long arg = 0; arg < n_args; arg++) {
+                const char *name = main_function->args->exprs[arg]->var->name;
 
-                fprintf(output, "%s(", main_function->name);
-                for (long n_args = 0; n_args < main_function->args->len - 1;
-                     n_args++) {
-                        fprintf(output, "%s",
-                                main_function->args->exprs[n_args]->var->name);
-                }
-                fprintf(output, "%s",
-                        main_function->args
-                                ->exprs[main_function->args->len - 1]
-                                ->var->name);
-                fputs(");", output);
+                fprintf(output,
+                        "TexlerObject * %s = "
+                        "(TexlerObject *)"
+                        "calloc(1, sizeof(TexlerObject));",
+                        name);
 
-                while (frees_stack->size > 0) {
-                        free_function_call *ffc =
-                                pop_free_function_call(&frees_stack);
+                generate_allocation_error_msg(output, (char *)name);
 
-                        if (ffc != NULL)
-                                fprintf(output, "%s(%s);", ffc->fun,
-                                        ffc->name);
+                push_free_function_call(frees_stack, name,
+                                        "free_texlerobject");
 
-                        free_struct_free_function_call(&ffc);
-                }
-                fputs("return 0;", output);
+                // Caso base: argv[0] es un número
+                // HI: argv[n] es un número
+                // TI: argv[n+1] es un número
+
+                fprintf(output, "%s->type = TYPE_T_REAL;", name);
+                fprintf(output,
+                        "%s->value.real = "
+                        "argc > %ld ? atof(argv[%ld]) : 0;",
+                        name, arg + 1, arg + 1);
+
+                // La prueba resulta ser errónea, pero lo revisaremos
+                // en la versión 2 de este paper.
         }
+
+        // Functions that return an object give NULL on errors
+        if (main_function->return_variable == NULL)
+                fputs("int _exit_code = ", output);
+        else
+                fputs("TexlerObject *_result = ", output);
+
+        fprintf(output, "%s(&_context", main_function->name);
+        for (long arg = 0; arg < n_args; arg++)
+                fprintf(output, ",%s",
+                        main_function->args->exprs[arg]->var->name);
+        fputs(");", output);
+
+        // The result is freed here, so embedding hosts can call texler_run()
+        // over and over. It may be one of the arguments, freed below.
+        if (main_function->return_variable != NULL) {
+                fputs("int _exit_code = _result == NULL;", output);
+                fputs("if (_result != NULL", output);
+                for (long arg = 0; arg < n_args; arg++)
+                        fprintf(output, "&& _result != %s",
+                                main_function->args->exprs[arg]->var->name);
+                fputs("){free_texlerobject(_result);}", output);
+        }
+
+        while (frees_stack->size > 0) {
+                free_function_call *ffc = pop_free_function_call(&frees_stack);
+
+                if (ffc != NULL)
+                        fprintf(output, "%s(%s);", ffc->fun, ffc->name);
+
+                free_struct_free_function_call(&ffc);
+        }
+        free_struct_free_function_call_array(&frees_stack);
+
+        fputs("return _exit_code;", output);
         fputc('}', output);
 
+        if (!generate_library)
+                fputs("int main(const int argc, const char **argv)"
+                      "{"
+                      "return texler_main(texler_run, argc, argv);"
+                      "}",
+                      output);
+
         return true;
 }
 /* HEADER */
 static void generate_header(FILE *const output)
 {
-        fprintf(output, "#include <ctype.h>\n"
-                        "#include <dirent.h>\n"
-                        "#include <float.h>\n"
-                        "#include <math.h>\n"
-                        "#include <stdio.h>\n"
-                        "#include <stdlib.h>\n"
-                        "#include <stdbool.h>\n"
-                        "#include <string.h>\n");
-        generate_header_macros_and_constants(output);
-        generate_header_types(output);
-        generate_internal_functions_headers(output);
-        generate_standard_functions_headers(output);
-}
-
-static void generate_header_macros_and_constants(FILE *const output)
-{
-        fprintf(output, "#define BUFFER_SIZE 256\n");
-        fprintf(output, "const char *DEFAULT_SEPARATORS = \" ,\";\n");
-}
-
-static void generate_header_types(FILE *const output)
-{
-        fprintf(output, "typedef enum {"
-                        "TYPE_T_NONE = 0,"
-                        "TYPE_T_BOOLEAN,"
-                        "TYPE_T_STRING,"
-                        "TYPE_T_REAL,"
-                        "TYPE_T_INTEGER,"
-                        "TYPE_T_FILEPTR,"
-                        "TYPE_T_FILE_LIST,"
-                        "N_TYPE_T"
-                        "} type_t;\n");
-
-        generate_header_types_TexlerObject(output);
-}
-
-static void generate_header_types_TexlerObject(FILE *const output)
-{
-        fprintf(output, "typedef struct TexlerObject TexlerObject;\n");
-        fprintf(output, "struct TexlerObject {"
-                        "union {"
-                        "bool boolean;"
-                        "struct {"
-                        "char *string;"
-                        "size_t length;"
-                        "};"
-                        "double real;"
-                        "long integer;"
-                        "struct {"
-                        "FILE *stream;"
-                        "fpos_t pos;"
-                        "char *separators;"
-                        "char **path_list;"
-                        "size_t n_line;"
-                        "size_t n_files;"
-                        "unsigned next_open_file;"
-                        "} file;"
-                        "} value;"
-                        "type_t type;"
-                        "};");
-
-        fprintf(output, "void free_texlerobject(TexlerObject *tex_obj)"
-                        "{"
-                        "if (tex_obj == NULL) { return; }"
-                        ""
-                        "switch (tex_obj->type) {"
-                        "case TYPE_T_FILEPTR:"
-                        "if (tex_obj->value.file.stream != NULL &&"
-                        "tex_obj->value.file.stream != stdout &&"
-                        "tex_obj->value.file.stream != stderr &&"
-                        "tex_obj->value.file.stream != stdin)"
-                        "{"
-                        "fclose(tex_obj->value.file.stream);"
-                        "}"
-                        "break;"
-                        "case TYPE_T_FILE_LIST:"
-                        "if (tex_obj->value.file.path_list != NULL)"
-                        "{"
-                        "while (tex_obj->value.file.n_files > 0) {"
-                        "if ("
-                        "tex_obj->value.file.path_list"
-                        "[tex_obj->value.file.n_files - 1]"
-                        "!= NULL"
-                        ")"
-                        "{"
-                        "free("
-                        "tex_obj->value.file.path_list"
-                        "[tex_obj->value.file.n_files -1]"
-                        ");"
-                        "}"
-                        ""
-                        "tex_obj->value.file.n_files--;"
-                        "}"
-                        "free(tex_obj->value.file.path_list);"
-                        "}"
-                        "if ("
-                        "tex_obj->value.file.separators != NULL"
-                        "&&"
-                        "tex_obj->value.file.separators != DEFAULT_SEPARATORS"
-                        ")"
-                        "{"
-                        "free(tex_obj->value.file.separators);"
-                        "}"
-                        "break;"
-                        "case TYPE_T_STRING:"
-                        "if (tex_obj->value.string != NULL)"
-                        "{"
-                        "free(tex_obj->value.string);"
-                        "}"
-                        "break;"
-                        "case TYPE_T_BOOLEAN: /* Fallsthrough */"
-                        "case TYPE_T_REAL:"
-                        "case TYPE_T_INTEGER:"
-                        "break;"
-                        "default:"
-                        "break;"
-                        "}"
-                        "free(tex_obj);"
-                        "}");
+        /* Types and runtime functions come from libtexlerrt */
+        fprintf(output, "#include \"texler_runtime.h\"\n");
 }
 
 /* Function generation */
@@ -366,13 +353,19 @@ static bool generate_function(FILE *const output, node_function *function)
         if (function == NULL)
                 return false;
 
+        /* Only texler_run() is exported from shared objects */
+        if (generate_library)
+                fprintf(output, "static");
+
         if (function->return_variable == NULL) {
                 fprintf(output, " int ");
         } else {
                 fprintf(output, " TexlerObject * ");
         }
 
-        fprintf(output, " %s (", function->name);
+        fprintf(output, " %s (const texler_context *_context", function->name);
+        if (function->args != NULL && function->args->len > 0)
+                fputc(',', output);
         if (!generate_args(output, function->args)) {
                 error_in_function(function->name);
                 return false;
@@ -381,6 +374,7 @@ static bool generate_function(FILE *const output, node_function *function)
 
         fprintf(output, " { ");
         // generate_expression_list(function->expressions);
+        return_variable = function->return_variable;
         if (!generate_expressions_list(output, function->expressions, NULL)) {
                 error_in_function(function->name);
                 return false;
@@ -445,14 +439,21 @@ static bool generate_expressions_list(FILE *const output,
                 expressions = expressions->next;
         }
 
-        /* while (frees_stack->size > 0) {
+        /*
+         * Variables of the function are released when it ends, closing its
+         * files: programs in shared objects run many times in one process.
+         * Those declared inside 'with' may be used after it.
+         */
+        while (working_filename == NULL && frees_stack->size > 0) {
                 free_function_call *ffc = pop_free_function_call(&frees_stack);
 
-                if (ffc != NULL)
+                if (ffc != NULL &&
+                    (return_variable == NULL ||
+                     strcmp(ffc->name, return_variable->name) != 0))
                         fprintf(output, "%s(%s);", ffc->fun, ffc->name);
 
                 free_struct_free_function_call(&ffc);
-        } */
+        }
 
         free_struct_free_function_call_array(&frees_stack);
         return gen_expression_return;
@@ -631,23 +632,28 @@ static bool generate_variable_file(FILE *const output, variable *var,
                                 "%s->value.file.next_open_file = 0;"
                                 "%s->value.file.n_files = "
                                 "get_list_of_files_in_dir("
-                                "&%s->value.file.path_list, %s);"
+                                "&%s->value.file.path_list, "
+                                "variable_path(_context, \"%s\", %s));"
                                 "%s->value.file.separators = strdup("
                                 "%s);",
                                 var->name, var->name, var->name, var->name,
-                                var->value.string, var->name, str_separators);
+                                var->name, var->value.string, var->name,
+                                strcmp(str_separators, "NULL") == 0 ?
+                                        "TEXLER_DEFAULT_SEPARATORS" :
+                                        str_separators);
 
                 } else {
                         fprintf(output,
-                                "if (open_file(%s, \"r\", %s, %s) == false)"
+                                "if (open_variable_file(_context, \"%s\", %s, "
+                                "\"r\", %s, %s) == false)"
                                 "{",
-                                var->value.string, var->name, str_separators);
+                                var->name, var->value.string, var->name,
+                                str_separators);
 
                         if (frees_string != NULL)
                                 fprintf(output, "%s", frees_string);
 
-                        fprintf(output, "return 1;"
-                                        "}");
+                        fprintf(output, "%s}", error_return());
                         fprintf(output, "%s->value.file.n_files = 1;",
                                 var->name);
                 }
@@ -679,17 +685,23 @@ static bool generate_variable_file(FILE *const output, variable *var,
                                 free(stream_str);
 
                 } else if (strcmp(var->value.string, "STDOUT") == 0) {
-                        fprintf(output, "%s->type = TYPE_T_FILEPTR;",
-                                var->name);
-                        fprintf(output, "%s->value.file.next_open_file = 0;",
-                                var->name);
-                        fprintf(output, "%s->value.file.stream = stdout;",
-                                var->name);
+                        fprintf(output,
+                                "if (open_variable_stdout(_context, \"%s\", "
+                                "%s) == false)"
+                                "{",
+                                var->name, var->name);
+
+                        if (frees_string != NULL)
+                                fprintf(output, "%s", frees_string);
+
+                        fprintf(output, "%s}", error_return());
                 } else {
                         fprintf(output,
-                                "if (open_file(%s, \"w+\", %s, %s) == false)"
+                                "if (open_variable_file(_context, \"%s\", %s, "
+                                "\"w+\", %s, %s) == false)"
                                 "{",
-                                var->value.string, var->name, str_separators);
+                                var->name, var->value.string, var->name,
+                                str_separators);
                         // if (strcmp(str_separators, "NULL") != 0) {
                         //         change_separators_from_input(str_separators, );
                         // }
@@ -697,8 +709,7 @@ static bool generate_variable_file(FILE *const output, variable *var,
                         if (frees_string != NULL)
                                 fprintf(output, "%s", frees_string);
 
-                        fprintf(output, "return 1;"
-                                        "}");
+                        fprintf(output, "%s}", error_return());
                 }
         } else {
                 error_invalid_file_variable_name(var->name);
@@ -1047,7 +1058,17 @@ static bool generate_variable_assignment_from_function_call_from_id(
         }
 
         while (concat_functions > 0) {
-                if (strcmp(fn_calls->id->name, "filter") == 0) {
+                if (strcmp(fn_calls->id->name, "filter") == 0 &&
+                    working_id == columns_loop_variable) {
+                        // Inside columns().lines(): filter the current cell
+                        fprintf(output,
+                                "if (!is_in_string(%s, %s))"
+                                "{"
+                                "continue;"
+                                "}",
+                                fn_calls->args->exprs[0]->var->value.string,
+                                working_id->name);
+                } else if (strcmp(fn_calls->id->name, "filter") == 0) {
                         fprintf(output, "rewind(%s_file->value.file.stream);",
                                 working_file);
                         fprintf(output, "while( _line_len_implementation "
@@ -1066,8 +1087,14 @@ static bool generate_variable_assignment_from_function_call_from_id(
                 } else if (strcmp(fn_calls->id->name, "toString") == 0) {
                         if (dest->type == FILE_PATH_TYPE) {
                                 fprintf(output,
-                                        "copy_buffer_content(toString(%s), "
-                                        "%s->value.file.stream);",
+                                        "{"
+                                        "char *_to_string_implementation ="
+                                        "toString(%s);"
+                                        "copy_buffer_content("
+                                        "_to_string_implementation,"
+                                        "%s->value.file.stream);"
+                                        "free(_to_string_implementation);"
+                                        "}",
                                         working_id->name, dest->name);
                         } else if (dest->type == CONSTANT_TYPE) {
                                 fprintf(output,
@@ -1083,11 +1110,12 @@ static bool generate_variable_assignment_from_function_call_from_id(
                                 "at(%s->value.string, %ld);"
                                 "if (_at_implementation_ret < 0)"
                                 "{"
-                                "return 1;"
+                                "%s"
                                 "}",
                                 working_id->name,
                                 (long)fn_calls->args->exprs[0]
-                                        ->var->value.number);
+                                        ->var->value.number,
+                                error_return());
                         if (dest->type == FILE_PATH_TYPE) {
                                 fprintf(output,
                                         "fputc(_at_implementation_ret,"
@@ -1096,8 +1124,14 @@ static bool generate_variable_assignment_from_function_call_from_id(
                         } else if (dest->type == CONSTANT_TYPE) {
                                 fprintf(output,
                                         "%s->value.string ="
+                                        "(char *)calloc(2, sizeof(char));"
+                                        "if (%s->value.string == NULL) {"
+                                        "perror(\"Aborting due to\");"
+                                        "exit(1);"
+                                        "}"
+                                        "%s->value.string[0] ="
                                         "_at_implementation_ret;",
-                                        dest->name);
+                                        dest->name, dest->name, dest->name);
                         } else {
                                 // TODO error msg
                         }
@@ -1174,9 +1208,12 @@ static bool generate_variable_assignment_to_variable(FILE *const output,
                                 source->name, dest->name);
                         break;
                 default:
+                        // Each object owns its string, they are all freed
                         fprintf(output,
-                                "memcpy(%s, %s, sizeof(TexlerObject));",
-                                dest->name, source->name);
+                                "memcpy(%s, %s, sizeof(TexlerObject));"
+                                "%s->value.string = strdup(%s->value.string);",
+                                dest->name, source->name, dest->name,
+                                source->name);
                         break;
                 }
         } else {
@@ -1332,6 +1369,7 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
 
         size_t closing_braces = 0;
         size_t concat_functions = 1;
+        loop_buffers buffers = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
         node_function_call *fn_calls = loop->iterable->fun_call; // Alias
 
         while (fn_calls != NULL && fn_calls->next != NULL) {
@@ -1342,9 +1380,13 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
         fprintf(output,
                 "for (int i = 0; i < %s->value.file.n_files; i++) {"
                 "TexlerObject* %s_file = get_next_file(%s, "
-                "%s->value.file.separators);",
+                "%s->value.file.separators);"
+                "if (%s_file == NULL)"
+                "{"
+                "continue;"
+                "}",
                 working_filename, working_filename, working_filename,
-                working_filename);
+                working_filename, working_filename);
         closing_braces++;
 
         while (concat_functions > 0) {
@@ -1352,6 +1394,7 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                         fprintf(output, "long _line_len_implementation"
                                         "="
                                         "BUFFER_SIZE;");
+                        buffers.line = closing_braces;
                         fprintf(output,
                                 "char * %s = "
                                 "(char * )"
@@ -1389,11 +1432,12 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                                                 "\"Line number %%d not found.\\n\","
                                                 "%s + 1"
                                                 ");"
-                                                "return 1;"
+                                                "%s"
                                                 "}",
                                                 loop->var->name,
                                                 fn_calls->next->args->exprs[0]
-                                                        ->var->name);
+                                                        ->var->name,
+                                                error_return());
                                         break;
                                 case EXPRESSION_GRAMMAR_CONSTANT_TYPE:
                                         fprintf(output,
@@ -1420,12 +1464,13 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                                                 "\"Line number %%d not found.\\n\","
                                                 "%ld"
                                                 ");"
-                                                "return 1;"
+                                                "%s"
                                                 "}",
                                                 loop->var->name,
                                                 (long)fn_calls->next->args
                                                         ->exprs[0]
-                                                        ->var->value.number);
+                                                        ->var->value.number,
+                                                error_return());
                                         break;
                                 case EXPRESSION_LIST:
                                         if (fn_calls->next->args->exprs[0]
@@ -1444,11 +1489,48 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                                                         ")"
                                                         "{"
                                                         "fprintf(stderr,"
-                                                        "\"Line number %%d not found.\\n\","
+                                                        "\"Line number %%ld not found.\\n\","
                                                         "_byIndex_implementation + 1"
                                                         ");"
+                                                        "free(%s);"
                                                         "break;"
                                                         "}",
+                                                        loop->var->name,
+                                                        loop->var->name);
+                                        } else {
+                                                // Rows already read by
+                                                // lines_by_numbers()
+                                                fprintf(output,
+                                                        "char *_byIndex_slot_implementation ="
+                                                        "_byIndex_slots_implementation["
+                                                        "_byIndex_order_implementation["
+                                                        "_byIndex_implementation]];"
+                                                        "if ("
+                                                        "_byIndex_slot_implementation == NULL"
+                                                        ")"
+                                                        "{"
+                                                        "fprintf(stderr,"
+                                                        "\"Line number %%lu not found.\\n\","
+                                                        "_byIndex_rows_implementation["
+                                                        "_byIndex_order_implementation["
+                                                        "_byIndex_implementation]]"
+                                                        ");"
+                                                        "free(%s);"
+                                                        "continue;"
+                                                        "}"
+                                                        "free(%s);"
+                                                        "%s = strdup("
+                                                        "_byIndex_slot_implementation"
+                                                        ");",
+                                                        loop->var->name,
+                                                        loop->var->name,
+                                                        loop->var->name);
+                                                generate_allocation_error_msg(
+                                                        output,
+                                                        loop->var->name);
+                                                fprintf(output,
+                                                        "_line_len_implementation ="
+                                                        "1 + strlen(%s);",
                                                         loop->var->name);
                                         }
                                         break;
@@ -1457,31 +1539,179 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                                         return false;
                                 }
 
-                        } else if (fn_calls->next != NULL &&
-                                   fn_calls->next->args != NULL &&
-                                   strcmp(fn_calls->next->id->name,
-                                          "filter") == 0) {
+                        } else if (find_next_function(fn_calls->next,
+                                                      "group") != NULL) {
+                                buffers.group = closing_braces;
+                                if (!generate_group(
+                                            output, loop,
+                                            find_next_function(fn_calls->next,
+                                                               "group"),
+                                            working_filename))
+                                        return false;
+
+                                closing_braces++;
+                        } else if (find_top(fn_calls->next) != NULL) {
+                                buffers.top = closing_braces;
+                                if (!generate_top(output, loop,
+                                                  find_top(fn_calls->next),
+                                                  working_filename))
+                                        return false;
+
+                                closing_braces++;
+                        } else if (find_next_function(fn_calls->next,
+                                                      "join") != NULL) {
+                                const char *other = NULL;
+                                unsigned long column = 0;
+                                unsigned long other_column = 0;
+                                bool left = false;
+                                if (!join_arguments(
+                                            find_next_function(fn_calls->next,
+                                                               "join"),
+                                            &other, &column, &other_column,
+                                            &left))
+                                        return false;
+
+                                buffers.join = closing_braces;
+                                fprintf(output,
+                                        "texler_join *_join_implementation ="
+                                        "join_records(%s_file, %s, %lu, %lu,"
+                                        "%s);"
+                                        "if (_join_implementation == NULL)"
+                                        "{"
+                                        "%s"
+                                        "}",
+                                        working_filename, other, column,
+                                        other_column, left ? "true" : "false",
+                                        error_return());
+                                if (find_distinct(fn_calls->next) != NULL) {
+                                        buffers.distinct = closing_braces;
+                                        if (!generate_distinct(
+                                                    output, fn_calls->next,
+                                                    working_filename))
+                                                return false;
+                                }
+                                fprintf(output,
+                                        "while (_line_len_implementation > 0)"
+                                        "{"
+                                        "_line_len_implementation = "
+                                        "joined_records("
+                                        "_join_implementation, &%s);"
+                                        "if ("
+                                        "_line_len_implementation <= 0"
+                                        "||"
+                                        "%s == NULL"
+                                        ")"
+                                        "{"
+                                        "break;"
+                                        "}",
+                                        loop->var->name, loop->var->name);
+
+                                closing_braces++;
+
+                                // Filters and distinct() after join() test
+                                // the joined lines
+                                generate_line_predicates(output,
+                                                         fn_calls->next,
+                                                         loop->var->name);
+                        } else if (find_next_function(fn_calls->next,
+                                                      "sort") != NULL) {
+                                unsigned long column = 0;
+                                bool numeric = false;
+                                bool descending = false;
+                                if (!sort_arguments(
+                                            find_next_function(fn_calls->next,
+                                                               "sort"),
+                                            &column, &numeric, &descending))
+                                        return false;
+
+                                buffers.sort = closing_braces;
                                 fprintf(output,
                                         "rewind(%s_file->"
                                         "value.file.stream);"
-                                        "while (_line_len_implementation > 0)"
-                                        "{",
-                                        working_filename);
+                                        "texler_sort *_sort_implementation ="
+                                        "sort_records(%s_file, %lu, %s, %s);"
+                                        "if (_sort_implementation == NULL)"
+                                        "{"
+                                        "%s"
+                                        "}",
+                                        working_filename, working_filename,
+                                        column, numeric ? "true" : "false",
+                                        descending ? "true" : "false",
+                                        error_return());
+                                if (find_distinct(fn_calls->next) != NULL) {
+                                        buffers.distinct = closing_braces;
+                                        if (!generate_distinct(
+                                                    output, fn_calls->next,
+                                                    working_filename))
+                                                return false;
+                                }
+                                fputs("while (_line_len_implementation > 0)"
+                                      "{",
+                                      output);
                                 fprintf(output,
                                         "_line_len_implementation = "
-                                        "lines(%s_file, &%s);",
-                                        working_filename, loop->var->name);
+                                        "sorted_records("
+                                        "_sort_implementation, &%s);"
+                                        "if ("
+                                        "_line_len_implementation <= 0"
+                                        "||"
+                                        "%s == NULL"
+                                        ")"
+                                        "{"
+                                        "break;"
+                                        "}",
+                                        loop->var->name, loop->var->name);
 
                                 closing_braces++;
 
-                                fprintf(output, "if (is_in_string(%s, %s)) {",
-                                        fn_calls->next->args->exprs[0]
-                                                ->var->value
-                                                .string, // "palabra"
-                                        loop->var->name
+                                // Filters and distinct() of the chain test the
+                                // sorted lines
+                                generate_line_predicates(output,
+                                                         fn_calls->next,
+                                                         loop->var->name);
+                        } else if (fn_calls->next != NULL &&
+                                   ((fn_calls->next->args != NULL &&
+                                     strcmp(fn_calls->next->id->name,
+                                            "filter") == 0) ||
+                                    find_distinct(fn_calls->next) != NULL) &&
+                                   (fn_calls->prev == NULL ||
+                                    strcmp(fn_calls->prev->id->name,
+                                           "columns") != 0)) {
+                                // columns().lines().filter() is handled by
+                                // the columns branch, before splitting
+                                fprintf(output,
+                                        "rewind(%s_file->"
+                                        "value.file.stream);",
+                                        working_filename);
+                                if (find_distinct(fn_calls->next) != NULL) {
+                                        buffers.distinct = closing_braces;
+                                        if (!generate_distinct(
+                                                    output, fn_calls->next,
+                                                    working_filename))
+                                                return false;
+                                }
+                                fputs("while (_line_len_implementation > 0)"
+                                      "{",
+                                      output);
+                                fprintf(output,
+                                        "_line_len_implementation = "
+                                        "lines(%s_file, &%s);"
+                                        "if ("
+                                        "_line_len_implementation <= 0"
+                                        "||"
+                                        "%s == NULL"
+                                        ")"
+                                        "{"
+                                        "break;"
+                                        "}",
+                                        working_filename, loop->var->name,
+                                        loop->var->name);
 
-                                );
                                 closing_braces++;
+
+                                generate_line_predicates(output,
+                                                         fn_calls->next,
+                                                         loop->var->name);
                         }
                 } else if (strcmp(fn_calls->id->name, "columns") == 0) {
                         if (fn_calls->next == NULL) {
@@ -1491,6 +1721,10 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                         } else if (fn_calls->next != NULL &&
                                    strcmp(fn_calls->next->id->name, "lines") ==
                                            0) {
+                                if (!generate_column_set(output, fn_calls,
+                                                         working_filename))
+                                        return false;
+
                                 char *original_loop_var_name =
                                         strdup(loop->var->name);
 
@@ -1548,12 +1782,13 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                                                 ");");
                                         generate_allocation_error_msg(
                                                 output, "_line_line");
+                                        buffers.line_line = closing_braces;
 
                                         fprintf(output,
                                                 "while (_line_len_implementation"
                                                 " > 0) {"
                                                 "_line_len_implementation = "
-                                                "lines(%s_file, &_line_line);"
+                                                "records(%s_file, &_line_line);"
                                                 "if("
                                                 "_line_len_implementation <= 0"
                                                 " || "
@@ -1566,6 +1801,15 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
 
                                         // aca tiene que venir la parte del line_len > 0 del r311
 
+                                        // Predicate pushdown: discard lines
+                                        // on the raw buffer, so that only
+                                        // surviving lines are split
+                                        generate_line_predicates(
+                                                output, fn_calls->next,
+                                                "_line_line");
+                                        generate_cell_filter_pushdown(
+                                                output, loop, "_line_line");
+
                                         fprintf(output,
                                                 "char "
                                                 "*_columns_remaining_implementation"
@@ -1582,6 +1826,7 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                                         loop->var->name);
                                 generate_allocation_error_msg(output,
                                                               loop->var->name);
+                                buffers.columns = closing_braces;
 
                                 fprintf(output,
                                         "while ("
@@ -1598,12 +1843,9 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                                         "= 0;");
                                 fprintf(output,
                                         "_columns_len_implementation ="
-                                        "columns("
+                                        "file_columns(%s_file,"
                                         "&_columns_remaining_implementation"
-                                        ",");
-
-                                fprintf(output,
-                                        "%s_file->value.file.separators,",
+                                        ",",
                                         working_filename);
 
                                 fprintf(output,
@@ -1623,8 +1865,12 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                                         loop->var->name);
                                 closing_braces++;
 
+                                columns_loop_variable = loop->var;
+                                columns_loop_file = working_filename;
                                 generate_loop_action(output, loop, frees_stack,
                                                      working_filename);
+                                columns_loop_variable = NULL;
+                                columns_loop_file = NULL;
                                 loop_action_generated = true;
 
                                 fprintf(output,
@@ -1656,10 +1902,10 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
 
                                 free(original_loop_var_name);
 
-                                while (closing_braces > 0) {
-                                        fputs("}", output);
-                                        closing_braces--;
-                                }
+                                generate_loop_closing_braces(
+                                        output, loop, closing_braces, &buffers,
+                                        working_filename);
+                                closing_braces = 0;
                         }
                 } else if (strcmp(fn_calls->id->name, "byIndex") == 0) {
                         switch (fn_calls->args->exprs[0]->type) {
@@ -1685,6 +1931,16 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                         case EXPRESSION_LIST:
                                 if (fn_calls->args->exprs[0]->list_expr->type ==
                                     LIST_RANGE_TYPE) {
+                                        // Skip straight to the first row;
+                                        // the loop stops reading right
+                                        // after the last one, its bound.
+                                        // The file is not closed there:
+                                        // another loop may read it later
+                                        fprintf(output,
+                                                "seek_line(%s_file, %ld);",
+                                                working_filename,
+                                                fn_calls->args->exprs[0]
+                                                        ->list_expr->from);
                                         fprintf(output,
                                                 "for (long %s = %ld - 1;"
                                                 "%s < %ld;"
@@ -1699,12 +1955,85 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                                                 "_byIndex_implementation");
 
                                         closing_braces++;
+                                } else if (!generate_byIndex_row_set(
+                                                   output,
+                                                   fn_calls->args->exprs[0]
+                                                           ->list_expr,
+                                                   working_filename)) {
+                                        return false;
+                                } else {
+                                        buffers.byIndex = closing_braces;
+                                        closing_braces++;
                                 }
                                 break;
                         default:
                                 error_invalid_byIndex_argument();
                                 return false;
                         }
+                } else if (strcmp(fn_calls->id->name, "filter") == 0 &&
+                           chain_has_function(fn_calls->prev, "lines")) {
+                        // Already applied to the raw line by lines()
+                } else if (strcmp(fn_calls->id->name, "sort") == 0 &&
+                           chain_has_function(fn_calls->prev, "lines") &&
+                           !chain_has_function(fn_calls->prev, "columns") &&
+                           !chain_has_function(fn_calls->prev, "byIndex") &&
+                           !chain_has_function(fn_calls->prev, "group") &&
+                           !chain_has_function(fn_calls->prev, "join") &&
+                           !chain_has_function(fn_calls->prev, "top") &&
+                           !chain_has_function(fn_calls->prev, "longest") &&
+                           !chain_has_function(fn_calls->prev, "distinct") &&
+                           !chain_has_function(fn_calls->prev, "uniq")) {
+                        // Records already sorted by lines()
+                } else if (strcmp(fn_calls->id->name, "sort") == 0) {
+                        LogError("sort() not implemented there. "
+                                 "Use it on lines: lines().sort(...)");
+                        return false;
+                } else if (strcmp(fn_calls->id->name, "group") == 0 &&
+                           fn_calls->prev != NULL &&
+                           strcmp(fn_calls->prev->id->name, "lines") == 0 &&
+                           fn_calls->prev->prev == NULL) {
+                        // Records already grouped by lines()
+                } else if (strcmp(fn_calls->id->name, "group") == 0) {
+                        LogError("group() not implemented there. "
+                                 "Use it right after lines: "
+                                 "lines().group(...)");
+                        return false;
+                } else if (find_top(fn_calls) == fn_calls &&
+                           fn_calls->prev != NULL &&
+                           strcmp(fn_calls->prev->id->name, "lines") == 0 &&
+                           fn_calls->prev->prev == NULL) {
+                        // Records already ranked by lines()
+                } else if (find_top(fn_calls) == fn_calls) {
+                        LogError("%s() not implemented there. "
+                                 "Use it right after lines: "
+                                 "lines().%s(...)",
+                                 fn_calls->id->name, fn_calls->id->name);
+                        return false;
+                } else if (strcmp(fn_calls->id->name, "join") == 0 &&
+                           fn_calls->prev != NULL &&
+                           strcmp(fn_calls->prev->id->name, "lines") == 0 &&
+                           fn_calls->prev->prev == NULL) {
+                        // Records already joined by lines()
+                } else if (strcmp(fn_calls->id->name, "join") == 0) {
+                        LogError("join() not implemented there. "
+                                 "Use it right after lines: "
+                                 "lines().join(...)");
+                        return false;
+                } else if ((strcmp(fn_calls->id->name, "distinct") == 0 ||
+                            strcmp(fn_calls->id->name, "uniq") == 0) &&
+                           chain_has_function(fn_calls->prev, "lines") &&
+                           !chain_has_function(fn_calls->prev, "columns") &&
+                           !chain_has_function(fn_calls->prev, "byIndex") &&
+                           !chain_has_function(fn_calls->prev, "group") &&
+                           !chain_has_function(fn_calls->prev, "top") &&
+                           !chain_has_function(fn_calls->prev, "longest")) {
+                        // Lines already tested by lines()
+                } else if (strcmp(fn_calls->id->name, "distinct") == 0 ||
+                           strcmp(fn_calls->id->name, "uniq") == 0) {
+                        LogError("%s() not implemented there. "
+                                 "Use it on lines: lines().%s(...)",
+                                 fn_calls->id->name, fn_calls->id->name);
+                        return false;
                 } else if (strcmp(fn_calls->id->name, "filter") == 0) {
                         fprintf(output,
                                 "rewind(%s_file->"
@@ -1748,12 +2077,68 @@ generate_loop_function_calls_expression(FILE *const output, node_loop *loop,
                 generate_loop_action(output, loop, frees_stack,
                                      working_filename);
 
+        generate_loop_closing_braces(output, loop, closing_braces, &buffers,
+                                     working_filename);
+
+        return true;
+}
+
+/*
+ * Closes the braces of a file loop, freeing its buffers on the way out. The
+ * outermost one loops over the files of a 'with', so the file read in this
+ * iteration is released there (files of a folder are opened one at a time)
+ */
+static void generate_loop_closing_braces(FILE *const output, node_loop *loop,
+                                         size_t closing_braces,
+                                         const loop_buffers *buffers,
+                                         const char *working_filename)
+{
         while (closing_braces > 0) {
-                fprintf(output, "}");
+                if (closing_braces == buffers->sort)
+                        fputs("free_sort(_sort_implementation);", output);
+                if (closing_braces == buffers->group)
+                        fputs("free_group(_group_implementation);", output);
+                if (closing_braces == buffers->distinct)
+                        fputs("free_distinct(_distinct_implementation);",
+                              output);
+                if (closing_braces == buffers->join)
+                        fputs("free_join(_join_implementation);", output);
+                if (closing_braces == buffers->top)
+                        fputs("free_top(_top_implementation);", output);
+                if (closing_braces == buffers->byIndex)
+                        fputs("for (char **_byIndex_slot_implementation ="
+                              "_byIndex_slots_implementation;"
+                              "*_byIndex_slot_implementation != NULL;"
+                              "_byIndex_slot_implementation++)"
+                              "{"
+                              "free(*_byIndex_slot_implementation);"
+                              "}"
+                              "free(_byIndex_slots_implementation);",
+                              output);
+                if (closing_braces == buffers->columns)
+                        fprintf(output, "free(_%s_columns_implementation);",
+                                loop->var->name);
+                if (closing_braces == buffers->line_line)
+                        fputs("free(_line_line);", output);
+                if (closing_braces == buffers->line)
+                        fprintf(output, "free(%s);", loop->var->name);
+
+                if (closing_braces == 1)
+                        fprintf(output,
+                                "if (%s_file != %s)"
+                                "{"
+                                "free_texlerobject(%s_file);"
+                                "}",
+                                working_filename, working_filename,
+                                working_filename);
+                // group() or top() already read every file of the folder
+                if (closing_braces == 1 &&
+                    (buffers->group != 0 || buffers->top != 0))
+                        fputs("break;", output);
+
+                fputs("}", output);
                 closing_braces--;
         }
-
-        return true;
 }
 
 static bool generate_loop_action(FILE *const output, node_loop *loop,
@@ -1766,6 +2151,628 @@ static bool generate_loop_action(FILE *const output, node_loop *loop,
         return true;
 }
 
+static int compare_rows(const void *a, const void *b)
+{
+        unsigned long left = *(const unsigned long *)a;
+        unsigned long right = *(const unsigned long *)b;
+
+        return (left > right) - (left < right);
+}
+
+/*
+ * byIndex([7, 2, 5, 2]) is compiled into a sorted, deduplicated row set
+ * (2, 5, 7) that lines_by_numbers() reads in a single forward pass, plus the
+ * order in which the user asked for them (2, 0, 1, 0).
+ * Opens the loop over the requested rows.
+ */
+static bool generate_byIndex_row_set(FILE *const output, node_list *rows,
+                                     const char *working_filename)
+{
+        if (rows == NULL || rows->type != LIST_EXPRESSION_TYPE ||
+            rows->len == 0) {
+                error_invalid_byIndex_argument();
+                return false;
+        }
+
+        unsigned long *requested =
+                (unsigned long *)calloc(rows->len, sizeof(unsigned long));
+        unsigned long *sorted =
+                (unsigned long *)calloc(rows->len, sizeof(unsigned long));
+        if (requested == NULL || sorted == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+
+        for (size_t i = 0; i < rows->len; i++) {
+                node_expression *row = rows->exprs[i];
+                if (row == NULL ||
+                    row->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+                    row->var->type != NUMBER_TYPE ||
+                    row->var->value.number < 1) {
+                        error_invalid_byIndex_argument();
+                        free(requested);
+                        free(sorted);
+                        return false;
+                }
+
+                requested[i] = (unsigned long)row->var->value.number;
+                sorted[i] = requested[i];
+        }
+
+        qsort(sorted, rows->len, sizeof(unsigned long), compare_rows);
+
+        size_t n_unique = 0;
+        for (size_t i = 0; i < rows->len; i++) {
+                if (n_unique == 0 || sorted[n_unique - 1] != sorted[i])
+                        sorted[n_unique++] = sorted[i];
+        }
+
+        fputs("static const unsigned long _byIndex_rows_implementation[] = {",
+              output);
+        for (size_t i = 0; i < n_unique; i++)
+                fprintf(output, "%lu,", sorted[i]);
+        fputs("};", output);
+
+        fputs("static const size_t _byIndex_order_implementation[] = {",
+              output);
+        for (size_t i = 0; i < rows->len; i++) {
+                unsigned long *slot =
+                        (unsigned long *)bsearch(&requested[i], sorted,
+                                                 n_unique,
+                                                 sizeof(unsigned long),
+                                                 compare_rows);
+                fprintf(output, "%ld,", (long)(slot - sorted));
+        }
+        fputs("};", output);
+
+        // NULL-terminated, so that it can be freed as the VM does
+        fprintf(output,
+                "char **_byIndex_slots_implementation ="
+                "(char **)calloc(%zu, sizeof(char *));",
+                n_unique + 1);
+        generate_allocation_error_msg(output, "_byIndex_slots_implementation");
+
+        fprintf(output,
+                "lines_by_numbers(%s_file,"
+                "_byIndex_rows_implementation, %zu,"
+                "_byIndex_slots_implementation);",
+                working_filename, n_unique);
+
+        fprintf(output,
+                "for (long _byIndex_implementation = 0;"
+                "_byIndex_implementation < %zu;"
+                "_byIndex_implementation++)"
+                "{",
+                rows->len);
+
+        free(requested);
+        free(sorted);
+
+        return true;
+}
+
+/*
+ * columns(2, [7, 5], [1..3]) reads columns 1, 2, 3, 5 and 7 of each line
+ * only: the set is sorted and deduplicated at compile time and handed to
+ * project_columns(), so the runtime stops splitting a line after column 7
+ * and skips column 4 and 6 without copying them. columns() reads them all.
+ */
+static bool generate_column_set(FILE *const output,
+                                node_function_call *columns,
+                                const char *working_filename)
+{
+        size_t n_columns = 0;
+        unsigned long *set = NULL;
+
+        for (size_t i = 0; columns->args != NULL && i < columns->args->len;
+             i++) {
+                node_expression *arg = columns->args->exprs[i];
+                node_list *list = NULL;
+                size_t n_new = 1;
+
+                if (arg != NULL && arg->type == EXPRESSION_LIST &&
+                    arg->list_expr != NULL &&
+                    (arg->list_expr->type != LIST_RANGE_TYPE ||
+                     arg->list_expr->from >= 1)) {
+                        list = arg->list_expr;
+                        n_new = list->type == LIST_RANGE_TYPE ?
+                                        (size_t)(list->to - list->from + 1) :
+                                        list->len;
+                } else if (arg == NULL ||
+                           arg->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE) {
+                        error_invalid_columns_argument();
+                        free(set);
+                        return false;
+                }
+
+                unsigned long *expanded = (unsigned long *)realloc(
+                        set, (n_columns + n_new) * sizeof(unsigned long));
+                if (expanded == NULL) {
+                        error_no_memory();
+                        exit(1);
+                }
+                set = expanded;
+
+                for (size_t j = 0; j < n_new; j++) {
+                        if (list != NULL && list->type == LIST_RANGE_TYPE) {
+                                set[n_columns++] = list->from + j;
+                                continue;
+                        }
+
+                        node_expression *column =
+                                list == NULL ? arg : list->exprs[j];
+                        if (column == NULL ||
+                            column->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+                            column->var->type != NUMBER_TYPE ||
+                            column->var->value.number < 1) {
+                                error_invalid_columns_argument();
+                                free(set);
+                                return false;
+                        }
+                        set[n_columns++] =
+                                (unsigned long)column->var->value.number;
+                }
+        }
+
+        if (n_columns == 0) {
+                fprintf(output, "project_columns(%s_file, NULL, 0);",
+                        working_filename);
+                return true;
+        }
+
+        qsort(set, n_columns, sizeof(unsigned long), compare_rows);
+
+        size_t n_unique = 0;
+        for (size_t i = 0; i < n_columns; i++) {
+                if (n_unique == 0 || set[n_unique - 1] != set[i])
+                        set[n_unique++] = set[i];
+        }
+
+        fputs("static const unsigned long _columns_set_implementation[] = {",
+              output);
+        for (size_t i = 0; i < n_unique; i++)
+                fprintf(output, "%lu,", set[i]);
+        fputs("};", output);
+        fprintf(output,
+                "project_columns(%s_file, _columns_set_implementation, %zu);",
+                working_filename, n_unique);
+
+        free(set);
+
+        return true;
+}
+
+static bool chain_has_function(node_function_call *fn_calls, const char *name)
+{
+        for (; fn_calls != NULL; fn_calls = fn_calls->prev) {
+                if (strcmp(fn_calls->id->name, name) == 0)
+                        return true;
+        }
+
+        return false;
+}
+
+static node_function_call *find_next_function(node_function_call *fn_calls,
+                                              const char *name)
+{
+        for (; fn_calls != NULL; fn_calls = fn_calls->next) {
+                if (strcmp(fn_calls->id->name, name) == 0)
+                        return fn_calls;
+        }
+
+        return NULL;
+}
+
+/*
+ * sort(column, numeric|lexical, asc|desc). The column is a constant, the
+ * options are names and may be left out: lexical and asc by default.
+ */
+static bool sort_arguments(node_function_call *sort, unsigned long *column,
+                           bool *numeric, bool *descending)
+{
+        node_list *args = sort->args;
+
+        if (args == NULL || args->len == 0 || args->len > 3 ||
+            args->exprs[0]->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+            args->exprs[0]->var->type != NUMBER_TYPE ||
+            args->exprs[0]->var->value.number < 1) {
+                error_invalid_sort_argument();
+                return false;
+        }
+        *column = (unsigned long)args->exprs[0]->var->value.number;
+
+        for (size_t i = 1; i < args->len; i++) {
+                node_expression *arg = args->exprs[i];
+                const char *option =
+                        arg->type == EXPRESSION_VARIABLE ? arg->var->name : "";
+
+                if (i == 1 && strcmp(option, "numeric") == 0) {
+                        *numeric = true;
+                } else if (i == 1 && strcmp(option, "lexical") == 0) {
+                        *numeric = false;
+                } else if (strcmp(option, "desc") == 0) {
+                        *descending = true;
+                } else if (strcmp(option, "asc") == 0) {
+                        *descending = false;
+                } else {
+                        error_invalid_sort_argument();
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/*
+ * join(other, column, other_column, inner|left): an input file, the columns
+ * of the keys in the lines and in the records of other, constants, and the
+ * kind of join, a name that may be left out: inner by default.
+ */
+static bool join_arguments(node_function_call *join, const char **other,
+                           unsigned long *column, unsigned long *other_column,
+                           bool *left)
+{
+        node_list *args = join->args;
+
+        if (args == NULL || args->len < 3 || args->len > 4 ||
+            args->exprs[0]->type != EXPRESSION_VARIABLE ||
+            args->exprs[0]->var->type != FILE_PATH_TYPE ||
+            strstr(args->exprs[0]->var->name, "input") !=
+                    args->exprs[0]->var->name) {
+                error_invalid_join_argument();
+                return false;
+        }
+        *other = args->exprs[0]->var->name;
+
+        for (size_t i = 1; i < 3; i++) {
+                node_expression *arg = args->exprs[i];
+                if (arg->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+                    arg->var->type != NUMBER_TYPE ||
+                    arg->var->value.number < 1) {
+                        error_invalid_join_argument();
+                        return false;
+                }
+        }
+        *column = (unsigned long)args->exprs[1]->var->value.number;
+        *other_column = (unsigned long)args->exprs[2]->var->value.number;
+
+        *left = false;
+        if (args->len == 4) {
+                node_expression *arg = args->exprs[3];
+                const char *option =
+                        arg->type == EXPRESSION_VARIABLE ? arg->var->name : "";
+
+                if (strcmp(option, "left") == 0) {
+                        *left = true;
+                } else if (strcmp(option, "inner") != 0) {
+                        error_invalid_join_argument();
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/*
+ * group(column, aggregates...): the column of the key, a constant, then
+ * count or sum|min|max|avg followed by the column of their values.
+ * Returns the aggregates (free() them), NULL if an argument is invalid.
+ */
+static group_argument *group_arguments(node_function_call *group,
+                                       unsigned long *column,
+                                       size_t *n_aggregates)
+{
+        node_list *args = group->args;
+        size_t n_names = sizeof(group_aggregates) / sizeof(*group_aggregates);
+
+        if (args == NULL || args->len == 0 ||
+            args->exprs[0]->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+            args->exprs[0]->var->type != NUMBER_TYPE ||
+            args->exprs[0]->var->value.number < 1) {
+                error_invalid_group_argument();
+                return NULL;
+        }
+        *column = (unsigned long)args->exprs[0]->var->value.number;
+
+        group_argument *aggregates =
+                (group_argument *)calloc(args->len, sizeof(group_argument));
+        if (aggregates == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+
+        *n_aggregates = 0;
+        for (size_t i = 1; i < args->len; i++) {
+                node_expression *arg = args->exprs[i];
+                const char *name =
+                        arg->type == EXPRESSION_VARIABLE ? arg->var->name : "";
+                group_argument *aggregate = &aggregates[(*n_aggregates)++];
+
+                aggregate->aggregate = n_names;
+                for (size_t j = 0; j < n_names; j++) {
+                        if (strcmp(name, group_aggregates[j].name) == 0)
+                                aggregate->aggregate = j;
+                }
+                if (aggregate->aggregate == n_names) {
+                        error_invalid_group_argument();
+                        free(aggregates);
+                        return NULL;
+                }
+                if (!group_aggregates[aggregate->aggregate].has_column)
+                        continue;
+
+                node_expression *value = ++i < args->len ? args->exprs[i] :
+                                                            NULL;
+                if (value == NULL ||
+                    value->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+                    value->var->type != NUMBER_TYPE ||
+                    value->var->value.number < 1) {
+                        error_invalid_group_argument();
+                        free(aggregates);
+                        return NULL;
+                }
+                aggregate->column = (unsigned long)value->var->value.number;
+        }
+
+        return aggregates;
+}
+
+/*
+ * lines().group(...) groups every file of the 'with' at once, so its loop
+ * runs in the first iteration of the loop over the files, which is left
+ * right after it. Filters after group() test the groups.
+ */
+static bool generate_group(FILE *const output, node_loop *loop,
+                           node_function_call *group,
+                           const char *working_filename)
+{
+        unsigned long column = 0;
+        size_t n_aggregates = 0;
+        group_argument *aggregates =
+                group_arguments(group, &column, &n_aggregates);
+        if (aggregates == NULL)
+                return false;
+
+        fprintf(output,
+                "texler_group *_group_implementation ="
+                "group_records(%s, %lu, (const texler_aggregate[]){",
+                working_filename, column);
+        for (size_t i = 0; i < n_aggregates; i++)
+                fprintf(output, "{%s, %lu},",
+                        group_aggregates[aggregates[i].aggregate].type,
+                        aggregates[i].column);
+        fprintf(output,
+                "{0}}, %zu);"
+                "if (_group_implementation == NULL)"
+                "{"
+                "%s"
+                "}"
+                "while (_line_len_implementation > 0)"
+                "{",
+                n_aggregates, error_return());
+        fprintf(output,
+                "_line_len_implementation = "
+                "grouped_records("
+                "_group_implementation, &%s);"
+                "if ("
+                "_line_len_implementation <= 0"
+                "||"
+                "%s == NULL"
+                ")"
+                "{"
+                "break;"
+                "}",
+                loop->var->name, loop->var->name);
+        free(aggregates);
+
+        generate_line_predicates(output, group->next, loop->var->name);
+
+        return true;
+}
+
+/* top() or longest() of the chain, from fn_calls on */
+static node_function_call *find_top(node_function_call *fn_calls)
+{
+        for (; fn_calls != NULL; fn_calls = fn_calls->next) {
+                if (strcmp(fn_calls->id->name, "top") == 0 ||
+                    strcmp(fn_calls->id->name, "longest") == 0)
+                        return fn_calls;
+        }
+
+        return NULL;
+}
+
+/*
+ * top(k, column) or longest(k), k 1 by default for longest(): constants.
+ * longest() ranks by length, as column 0. False if an argument is invalid.
+ */
+static bool top_arguments(node_function_call *top, unsigned long *k,
+                          unsigned long *column)
+{
+        node_list *args = top->args;
+        bool longest = strcmp(top->id->name, "longest") == 0;
+        size_t n_args = args == NULL ? 0 : args->len;
+
+        *k = 1;
+        *column = 0;
+        if (longest ? n_args > 1 : n_args != 2) {
+                error_invalid_top_argument(top->id->name);
+                return false;
+        }
+
+        for (size_t i = 0; i < n_args; i++) {
+                node_expression *arg = args->exprs[i];
+                if (arg->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+                    arg->var->type != NUMBER_TYPE ||
+                    arg->var->value.number < 1) {
+                        error_invalid_top_argument(top->id->name);
+                        return false;
+                }
+                *(i == 0 ? k : column) =
+                        (unsigned long)arg->var->value.number;
+        }
+
+        return true;
+}
+
+/*
+ * lines().top(...) and longest(...) rank every file of the 'with' at once,
+ * as group() does, and return the records best first. Filters after them
+ * test the records returned.
+ */
+static bool generate_top(FILE *const output, node_loop *loop,
+                         node_function_call *top,
+                         const char *working_filename)
+{
+        unsigned long k = 0;
+        unsigned long column = 0;
+        if (!top_arguments(top, &k, &column))
+                return false;
+
+        fprintf(output,
+                "texler_top *_top_implementation ="
+                "top_records(%s, %lu, %lu);"
+                "if (_top_implementation == NULL)"
+                "{"
+                "%s"
+                "}"
+                "while (_line_len_implementation > 0)"
+                "{",
+                working_filename, column, k, error_return());
+        fprintf(output,
+                "_line_len_implementation = "
+                "ranked_records("
+                "_top_implementation, &%s);"
+                "if ("
+                "_line_len_implementation <= 0"
+                "||"
+                "%s == NULL"
+                ")"
+                "{"
+                "break;"
+                "}",
+                loop->var->name, loop->var->name);
+
+        generate_line_predicates(output, top->next, loop->var->name);
+
+        return true;
+}
+
+/* distinct() or uniq() of the chain, from fn_calls on */
+static node_function_call *find_distinct(node_function_call *fn_calls)
+{
+        for (; fn_calls != NULL; fn_calls = fn_calls->next) {
+                if (strcmp(fn_calls->id->name, "distinct") == 0 ||
+                    strcmp(fn_calls->id->name, "uniq") == 0)
+                        return fn_calls;
+        }
+
+        return NULL;
+}
+
+/*
+ * distinct(column) or uniq(column): the keys seen so far (the last one for
+ * uniq), created before the loop that reads the lines. The column is a
+ * constant; without it whole lines are compared.
+ */
+static bool generate_distinct(FILE *const output,
+                              node_function_call *fn_calls,
+                              const char *working_filename)
+{
+        node_function_call *distinct = find_distinct(fn_calls);
+        node_list *args = distinct->args;
+        unsigned long column = 0;
+
+        if (find_distinct(distinct->next) != NULL) {
+                LogError("Only one distinct() or uniq() per chain");
+                return false;
+        }
+
+        if (args != NULL && args->len > 0) {
+                if (args->len > 1 ||
+                    args->exprs[0]->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+                    args->exprs[0]->var->type != NUMBER_TYPE ||
+                    args->exprs[0]->var->value.number < 1) {
+                        error_invalid_distinct_argument(distinct->id->name);
+                        return false;
+                }
+                column = (unsigned long)args->exprs[0]->var->value.number;
+        }
+
+        fprintf(output,
+                "texler_distinct *_distinct_implementation ="
+                "new_distinct(%s_file, %lu, %s);"
+                "if (_distinct_implementation == NULL)"
+                "{"
+                "%s"
+                "}",
+                working_filename, column,
+                strcmp(distinct->id->name, "uniq") == 0 ? "true" : "false",
+                error_return());
+
+        return true;
+}
+
+/*
+ * Line-level predicates of the chain (filter, distinct) are tested on the
+ * raw line, in the order of the chain, before any column splitting or
+ * per-cell work.
+ * Must be generated inside the loop that reads 'line_name'.
+ */
+static void generate_line_predicates(FILE *const output,
+                                     node_function_call *fn_calls,
+                                     const char *line_name)
+{
+        for (; fn_calls != NULL; fn_calls = fn_calls->next) {
+                // Only lines() chains declare _distinct_implementation
+                if (find_distinct(fn_calls) == fn_calls &&
+                    chain_has_function(fn_calls->prev, "lines")) {
+                        fprintf(output,
+                                "if (!distinct_record("
+                                "_distinct_implementation, %s))"
+                                "{"
+                                "continue;"
+                                "}",
+                                line_name);
+                        continue;
+                }
+
+                if (strcmp(fn_calls->id->name, "filter") != 0 ||
+                    fn_calls->args == NULL || fn_calls->args->len == 0)
+                        continue;
+
+                fprintf(output,
+                        "if (!is_in_string(%s, %s))"
+                        "{"
+                        "continue;"
+                        "}",
+                        fn_calls->args->exprs[0]->var->value.string,
+                        line_name);
+        }
+}
+
+/*
+ * A body like 'cell.filter("x") -> output.' only writes cells containing "x".
+ * A line can only have such a cell if the line itself contains "x", so lines
+ * without it are skipped before splitting.
+ */
+static void generate_cell_filter_pushdown(FILE *const output, node_loop *loop,
+                                          const char *line_name)
+{
+        node_expression *action = loop->action;
+
+        if (action == NULL || action->type != EXPRESSION_VARIABLE_ASSIGNMENT ||
+            action->expr == NULL ||
+            action->expr->type != EXPRESSION_FUNCTION_CALL)
+                return;
+
+        node_function_call *fn_calls = action->expr->fun_call;
+        if (fn_calls == NULL || fn_calls->id != loop->var)
+                return;
+
+        generate_line_predicates(output, fn_calls->next, line_name);
+}
+
 static bool generate_conditional(FILE *const output,
                                  node_conditional *conditional,
                                  const char *working_filename)
@@ -1785,15 +2792,23 @@ static bool generate_conditional(FILE *const output,
         case EXPRESSION_VARIABLE_TYPE_COMPARISON:
                 switch (conditional->condition->compare_type) {
                 case NUMBER_TYPE:
-                        fprintf(output,
-                                "IS_NUMBER_RETURN _isnum ="
-                                "is_number("
-                                "%s"
-                                ","
-                                "strlen(%s)"
-                                ");",
-                                conditional->condition->var->name,
-                                conditional->condition->var->name);
+                        if (conditional->condition->var ==
+                            columns_loop_variable)
+                                fprintf(output,
+                                        "IS_NUMBER_RETURN _isnum ="
+                                        "cell_type(%s_file, %s);",
+                                        columns_loop_file,
+                                        conditional->condition->var->name);
+                        else
+                                fprintf(output,
+                                        "IS_NUMBER_RETURN _isnum ="
+                                        "is_number("
+                                        "%s"
+                                        ","
+                                        "strlen(%s)"
+                                        ");",
+                                        conditional->condition->var->name,
+                                        conditional->condition->var->name);
 
                         fprintf(output, "if ("
                                         "_isnum == IS_NUMBER_RETURN_FLOATING"
@@ -1885,6 +2900,16 @@ static bool generate_conditional(FILE *const output,
         return true;
 }
 
+/* atof() of a variable, parsed already if it is a cell of a cached file */
+static void generate_cell_number(FILE *const output, const variable *var)
+{
+        if (var == columns_loop_variable)
+                fprintf(output, "cell_real(%s_file, %s);", columns_loop_file,
+                        var->name);
+        else
+                fprintf(output, "atof(%s);", var->name);
+}
+
 static const char *
 generate_number_arithmetic_add(FILE *const output, node_expression *left,
                                node_expression *right,
@@ -1899,7 +2924,8 @@ generate_number_arithmetic_add(FILE *const output, node_expression *left,
                         left->var->value.number);
                 break;
         case VARIABLE_TYPE:
-                fprintf(output, "%s += atof(%s);", var_name, left->var->name);
+                fprintf(output, "%s += ", var_name);
+                generate_cell_number(output, left->var);
                 break;
         default:
                 LogError("Arithmetic addition not implemented for type: %ld",
@@ -1913,7 +2939,8 @@ generate_number_arithmetic_add(FILE *const output, node_expression *left,
                         right->var->value.number);
                 break;
         case VARIABLE_TYPE:
-                fprintf(output, "%s += atof(%s);", var_name, right->var->name);
+                fprintf(output, "%s += ", var_name);
+                generate_cell_number(output, right->var);
                 break;
         default:
                 LogError("Arithmetic addition not implemented for type: "
@@ -1948,7 +2975,8 @@ generate_number_arithmetic_mul(FILE *const output, node_expression *left,
                         left->var->value.number);
                 break;
         case VARIABLE_TYPE:
-                fprintf(output, "%s *= atof(%s);", var_name, left->var->name);
+                fprintf(output, "%s *= ", var_name);
+                generate_cell_number(output, left->var);
                 break;
         default:
                 LogError("Arithmetic multiplication not implemented for type: "
@@ -1963,7 +2991,8 @@ generate_number_arithmetic_mul(FILE *const output, node_expression *left,
                         right->var->value.number);
                 break;
         case VARIABLE_TYPE:
-                fprintf(output, "%s *= atof(%s);", var_name, right->var->name);
+                fprintf(output, "%s *= ", var_name);
+                generate_cell_number(output, right->var);
                 break;
         default:
                 LogError("Arithmetic addition not implemented for type: %ld",
@@ -1999,10 +3028,10 @@ static const char *generate_number_arithmetic_mul_with_file(
                         ")"
                         "{"
                         "fprintf(stderr, \"Invalid object type in %s.\\n\");"
-                        "return 1;"
+                        "%s"
                         "}",
                         variable_id->var->name, variable_id->var->name,
-                        variable_id->var->name);
+                        variable_id->var->name, error_return());
         }
 
         fprintf(output, "long %s = 0;", var_name);
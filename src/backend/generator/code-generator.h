@@ -3,7 +3,8 @@
 
 #include "../../frontend/syntactic-analysis/node.h"
 
-bool generate_code(program_t *ast, const char *filename);
+/* library: shared object exporting texler_run() instead of main() */
+bool generate_code(program_t *ast, const char *filename, bool library);
 void generate_allocation_error_msg(FILE *const output, char *ptr_name);
 
 #endif
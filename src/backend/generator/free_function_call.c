@@ -67,7 +67,7 @@ bool push_free_function_call(free_function_call_array *ffca, const char *name,
                 ffc->fun = strdup(function);
 
         free_function_call **ffc_data_new = (free_function_call **)realloc(
-                ffca->data, (1 + ffca->size) + sizeof(free_function_call *));
+                ffca->data, (1 + ffca->size) * sizeof(free_function_call *));
         if (ffc_data_new == NULL) {
                 perror("Aborting due to");
                 exit(1);
@@ -1,7 +0,0 @@
-#ifndef INTERNAL_FUNCTIONS_H
-#define INTERNAL_FUNCTIONS_H
-
-void generate_internal_functions(FILE *const output);
-void generate_internal_functions_headers(FILE *const output);
-
-#endif /* INTERNAL_FUNCTIONS_H */
@@ -1,7 +0,0 @@
-#ifndef STANDARD_FUNCTIONS_H
-#define STANDARD_FUNCTIONS_H
-
-void generate_standard_functions(FILE *const output);
-void generate_standard_functions_headers(FILE *const output);
-
-#endif /* STANDARD_FUNCTIONS_H */
@@ -7,6 +7,13 @@
  * Implementación de "logger.h".
  */
 
+static bool quiet = false;
+
+void LogQuiet(const bool value)
+{
+        quiet = value;
+}
+
 void Log(FILE *const stream, const char *prefix, const char *const format,
          const char *suffix, va_list arguments)
 {
@@ -18,6 +25,9 @@ void Log(FILE *const stream, const char *prefix, const char *const format,
 void LogDebug(const char *const format, ...)
 {
 #ifdef DEBUG
+        if (quiet)
+                return;
+
         va_list arguments;
         va_start(arguments, format);
         Log(stdout, "[DEBUG] ", format, "\n", arguments);
@@ -43,6 +53,9 @@ void LogErrorRaw(const char *const format, ...)
 
 void LogInfo(const char *const format, ...)
 {
+        if (quiet)
+                return;
+
         va_list arguments;
         va_start(arguments, format);
         Log(stdout, "[INFO ] ", format, "\n", arguments);
@@ -2,6 +2,7 @@
 #define LOGGER_HEADER
 
 #include <stdio.h>
+#include <stdbool.h>
 
 void Log(FILE *const stream, const char *prefix, const char *const format,
          const char *suffix, va_list arguments);
@@ -14,4 +15,7 @@ void LogErrorRaw(const char *const format, ...);
 
 void LogInfo(const char *const format, ...);
 
+/* Mutes LogInfo and LogDebug, which write to stdout */
+void LogQuiet(const bool quiet);
+
 #endif
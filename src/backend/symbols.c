@@ -193,6 +193,13 @@ static void insert_std_functions()
         insert_function("lines");
         insert_function("byIndex");
         insert_function("filter");
+        insert_function("sort");
+        insert_function("group");
+        insert_function("distinct");
+        insert_function("uniq");
+        insert_function("join");
+        insert_function("top");
+        insert_function("longest");
         insert_function("toString");
         insert_function("at");
 }
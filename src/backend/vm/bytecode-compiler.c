@@ -0,0 +1,2717 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "texler_runtime.h" /* BUFFER_SIZE */
+
+#include "../logger.h"
+#include "../error.h"
+
+#include "bytecode-compiler.h"
+
+/*
+ * Lowers the AST to bytecode. Every compile_* function mirrors the
+ * generate_* function of code-generator.c with the same name, emitting one
+ * instruction where the generator emits one C statement.
+ *
+ * Registers are bound to the names of the C variables the generator
+ * declares ("input", "input_file", "_line_len_implementation", ...) and
+ * live until the block that declares them is closed, like in C.
+ */
+
+typedef struct binding {
+        char *name;
+        long reg;
+} binding;
+
+typedef enum BLOCK_TYPE {
+        BLOCK_IF = 0,
+        BLOCK_WHILE,
+        BLOCK_FOR,
+} BLOCK_TYPE;
+
+typedef struct jump_list {
+        size_t *jumps;
+        size_t len;
+} jump_list;
+
+/* A '{' of the generated C that is not closed yet */
+typedef struct block {
+        BLOCK_TYPE type;
+        /* First instruction of the loop condition */
+        size_t head;
+        /* Incremented at the end of each iteration of a for */
+        long counter;
+        /* Failed condition and break */
+        jump_list exits;
+        jump_list continues;
+        /* Bindings declared before the block was opened */
+        size_t n_bindings;
+        /* Run once after leaving the block */
+        bool has_epilogue;
+        bytecode_instruction epilogue;
+} block;
+
+static binding *bindings = NULL;
+static size_t n_bindings = 0;
+static size_t bindings_size = 0;
+
+static block *blocks = NULL;
+static size_t n_blocks = 0;
+static size_t blocks_size = 0;
+
+/* Aggregates group() takes, by name */
+static const struct {
+        const char *name;
+        texler_aggregate_type type;
+} group_aggregates[] = {
+        { "count", TEXLER_AGGREGATE_COUNT },
+        { "sum", TEXLER_AGGREGATE_SUM },
+        { "min", TEXLER_AGGREGATE_MIN },
+        { "max", TEXLER_AGGREGATE_MAX },
+        { "avg", TEXLER_AGGREGATE_AVG },
+};
+
+/* Loop variable of the columns().lines() loop being compiled, if any */
+static variable *columns_loop_variable = NULL;
+/* and the register of the file it splits (cache.c) */
+static long columns_loop_file = -1;
+
+static bool compile_function(bytecode_program *program,
+                             node_function *function);
+static bool compile_args(bytecode_program *program, node_list *args);
+
+static bool compile_expressions_list(bytecode_program *program,
+                                     node_expression_list *expressions,
+                                     const char *working_filename);
+static bool compile_expression(bytecode_program *program,
+                               node_expression *expr,
+                               const char *working_filename);
+
+static bool compile_variable(bytecode_program *program, variable *var,
+                             node_list *separators);
+static bool compile_variable_file(bytecode_program *program, long reg,
+                                  variable *var, node_list *separators);
+
+static bool compile_variable_assignment(bytecode_program *program,
+                                        variable *var, node_expression *expr,
+                                        const char *working_filename);
+static bool compile_variable_assignment_to_variable(bytecode_program *program,
+                                                    variable *dest,
+                                                    variable *source);
+static bool compile_variable_assignment_to_constant(bytecode_program *program,
+                                                    variable *dest,
+                                                    variable *source);
+static bool compile_variable_assignment_from_number_arithmetic(
+        bytecode_program *program, variable *var, node_expression *operation);
+static bool compile_variable_assignment_from_function_call_from_id(
+        bytecode_program *program, variable *dest,
+        node_function_call *id_plus_function, const char *working_file);
+
+static bool compile_string_arithmetic_add_expression(bytecode_program *program,
+                                                     node_expression *left,
+                                                     node_expression *right,
+                                                     variable *var);
+static bool compile_write_variable(bytecode_program *program, variable *source,
+                                   long dest);
+static bool compile_string_append(bytecode_program *program, long dest,
+                                  node_expression *operand);
+
+static bool compile_number_arithmetic(bytecode_program *program,
+                                      BYTECODE_OPCODE buffer_op,
+                                      BYTECODE_OPCODE constant_op, long reg,
+                                      node_expression *operand);
+static bool compile_number_arithmetic_mul_with_file(bytecode_program *program,
+                                                    node_expression *left,
+                                                    node_expression *right,
+                                                    variable *var);
+
+static bool compile_expressions_list_with_file(bytecode_program *program,
+                                               node_file_block *fhandler);
+static bool compile_loop_expression(bytecode_program *program,
+                                    node_loop *loop,
+                                    const char *working_filename);
+static bool compile_loop_function_calls_expression(
+        bytecode_program *program, node_loop *loop,
+        const char *working_filename);
+static bool compile_lines_byIndex(bytecode_program *program, node_loop *loop,
+                                  node_function_call *by_index, long file,
+                                  long line_len);
+static bool compile_columns(bytecode_program *program, node_loop *loop,
+                            node_function_call *fn_calls, long file,
+                            long line_len, const char *working_filename);
+static bool compile_byIndex_row_set(bytecode_program *program, node_list *rows,
+                                    long file);
+static bool compile_column_set(bytecode_program *program,
+                               node_function_call *columns, long file);
+static bool compile_conditional(bytecode_program *program,
+                                node_conditional *conditional,
+                                const char *working_filename);
+
+static node_function_call *find_top(node_function_call *fn_calls);
+static bool top_arguments(node_function_call *top, unsigned long *k,
+                          unsigned long *column);
+static node_function_call *find_distinct(node_function_call *fn_calls);
+static long compile_distinct(bytecode_program *program,
+                             node_function_call *fn_calls, long file);
+static void compile_line_predicates(bytecode_program *program,
+                                    node_function_call *fn_calls, long line);
+static void compile_cell_filter_pushdown(bytecode_program *program,
+                                         node_loop *loop, long line);
+static bool chain_has_function(node_function_call *fn_calls, const char *name);
+static node_function_call *find_next_function(node_function_call *fn_calls,
+                                              const char *name);
+static bool sort_arguments(node_function_call *sort, unsigned long *column,
+                           bool *numeric, bool *descending);
+static bool join_arguments(node_function_call *join, const char **other,
+                           unsigned long *column, unsigned long *other_column,
+                           bool *left);
+static texler_aggregate *group_arguments(node_function_call *group,
+                                         unsigned long *column,
+                                         size_t *n_aggregates);
+static int compare_rows(const void *a, const void *b);
+
+bytecode_program *compile_bytecode(program_t *ast)
+{
+        if (ast == NULL || ast->main_function == NULL)
+                return NULL;
+
+        bytecode_program *program = new_bytecode_program();
+
+        bool compiled = compile_function(program, ast->main_function);
+
+        while (n_blocks > 0) {
+                n_blocks--;
+                free(blocks[n_blocks].exits.jumps);
+                free(blocks[n_blocks].continues.jumps);
+        }
+        free(blocks);
+        blocks = NULL;
+        blocks_size = 0;
+
+        while (n_bindings > 0)
+                free(bindings[--n_bindings].name);
+        free(bindings);
+        bindings = NULL;
+        bindings_size = 0;
+
+        if (!compiled) {
+                free_bytecode_program(program);
+                return NULL;
+        }
+
+        return program;
+}
+
+/* Registers */
+
+static void bind_register(const char *name, long reg)
+{
+        if (n_bindings == bindings_size) {
+                bindings_size = bindings_size == 0 ? 16 : 2 * bindings_size;
+                binding *aux = (binding *)realloc(
+                        bindings, bindings_size * sizeof(binding));
+                if (aux == NULL) {
+                        error_no_memory();
+                        exit(1);
+                }
+                bindings = aux;
+        }
+
+        bindings[n_bindings].name = strdup(name);
+        if (bindings[n_bindings].name == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+        bindings[n_bindings].reg = reg;
+        n_bindings++;
+}
+
+static long declare_register(bytecode_program *program, const char *name,
+                             BYTECODE_REGISTER type)
+{
+        long reg = new_register(program, type);
+        bind_register(name, reg);
+
+        return reg;
+}
+
+static long lookup_register(const char *name)
+{
+        if (name == NULL)
+                return -1;
+
+        for (size_t i = n_bindings; i > 0; i--) {
+                if (strcmp(bindings[i - 1].name, name) == 0)
+                        return bindings[i - 1].reg;
+        }
+
+        return -1;
+}
+
+/* Register of 'name', which must hold a 'type' */
+static long variable_register(bytecode_program *program, const char *name,
+                              BYTECODE_REGISTER type)
+{
+        long reg = lookup_register(name);
+
+        if (reg < 0) {
+                error_variable_not_found(name == NULL ? "(null)" : name);
+                return -1;
+        }
+
+        if (program->registers[reg] != type) {
+                LogError("Variable %s can not be used here.", name);
+                return -1;
+        }
+
+        return reg;
+}
+
+/* '<with file>_file', the file being read inside a 'with' block */
+static long working_file_register(bytecode_program *program,
+                                  const char *working_filename)
+{
+        if (working_filename == NULL) {
+                LogError("Functions on lines must be used inside 'with'.");
+                return -1;
+        }
+
+        size_t name_len = 1 + strlen(working_filename) + strlen("_file");
+        char *name = (char *)calloc(name_len, sizeof(char));
+        if (name == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+        snprintf(name, name_len, "%s_file", working_filename);
+
+        long reg = variable_register(program, name, REGISTER_FILE);
+        free(name);
+
+        return reg;
+}
+
+/* Blocks */
+
+static void push_jump(jump_list *list, size_t jump)
+{
+        size_t *aux = (size_t *)realloc(list->jumps,
+                                        (1 + list->len) * sizeof(size_t));
+        if (aux == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+
+        aux[list->len++] = jump;
+        list->jumps = aux;
+}
+
+static void open_block(bytecode_program *program, BLOCK_TYPE type,
+                       long counter)
+{
+        if (n_blocks == blocks_size) {
+                blocks_size = blocks_size == 0 ? 8 : 2 * blocks_size;
+                block *aux = (block *)realloc(blocks,
+                                              blocks_size * sizeof(block));
+                if (aux == NULL) {
+                        error_no_memory();
+                        exit(1);
+                }
+                blocks = aux;
+        }
+
+        blocks[n_blocks++] = (block){ .type = type,
+                                      .head = program->n_instructions,
+                                      .counter = counter,
+                                      .n_bindings = n_bindings };
+}
+
+/* Jumps to the end of the innermost block when the condition fails */
+static void add_exit(size_t jump)
+{
+        push_jump(&blocks[n_blocks - 1].exits, jump);
+}
+
+static block *innermost_loop()
+{
+        for (size_t i = n_blocks; i > 0; i--) {
+                if (blocks[i - 1].type != BLOCK_IF)
+                        return &blocks[i - 1];
+        }
+
+        return NULL;
+}
+
+static bool add_continue(size_t jump)
+{
+        block *loop = innermost_loop();
+        if (loop == NULL) {
+                LogError("'continue' outside of a loop.");
+                return false;
+        }
+
+        push_jump(&loop->continues, jump);
+        return true;
+}
+
+static bool add_break(size_t jump)
+{
+        block *loop = innermost_loop();
+        if (loop == NULL) {
+                LogError("'break' outside of a loop.");
+                return false;
+        }
+
+        push_jump(&loop->exits, jump);
+        return true;
+}
+
+static void close_block(bytecode_program *program)
+{
+        block *top = &blocks[--n_blocks];
+        size_t continue_target = top->head;
+
+        if (top->type == BLOCK_FOR) {
+                continue_target = program->n_instructions;
+                emit_instruction(program, OP_ADD_INTEGER, top->counter,
+                                 top->counter, 1, 0);
+        }
+
+        if (top->type != BLOCK_IF)
+                emit_instruction(program, OP_JUMP, 0, 0, 0, top->head);
+
+        for (size_t i = 0; i < top->continues.len; i++)
+                patch_jump(program, top->continues.jumps[i], continue_target);
+
+        for (size_t i = 0; i < top->exits.len; i++)
+                patch_jump(program, top->exits.jumps[i],
+                           program->n_instructions);
+
+        if (top->has_epilogue) {
+                emit_instruction(program, top->epilogue.op, top->epilogue.a,
+                                 top->epilogue.b, top->epilogue.c,
+                                 top->epilogue.d);
+        }
+
+        free(top->exits.jumps);
+        free(top->continues.jumps);
+
+        while (n_bindings > top->n_bindings)
+                free(bindings[--n_bindings].name);
+}
+
+static void close_blocks(bytecode_program *program, size_t depth)
+{
+        while (n_blocks > depth)
+                close_block(program);
+}
+
+/* Constants */
+
+/*
+ * Value of a string literal as it appears in the source, quotes and escapes
+ * included. Adjacent literals are concatenated, as the C compiler does with
+ * the separators code-generator.c emits ("," "\t").
+ */
+static char *string_literal_value(const char *literal)
+{
+        if (strchr(literal, '"') == NULL)
+                return strdup(literal);
+
+        char *value = (char *)calloc(1 + strlen(literal), sizeof(char));
+        if (value == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+
+        size_t len = 0;
+        bool quoted = false;
+        for (const char *c = literal; *c != '\0'; c++) {
+                if (*c == '"') {
+                        quoted = !quoted;
+                        continue;
+                }
+
+                if (!quoted)
+                        continue;
+
+                if (*c != '\\' || c[1] == '\0') {
+                        value[len++] = *c;
+                        continue;
+                }
+
+                c++;
+                switch (*c) {
+                case 'n':
+                        value[len++] = '\n';
+                        break;
+                case 't':
+                        value[len++] = '\t';
+                        break;
+                case 'r':
+                        value[len++] = '\r';
+                        break;
+                case 'v':
+                        value[len++] = '\v';
+                        break;
+                case 'f':
+                        value[len++] = '\f';
+                        break;
+                case 'a':
+                        value[len++] = '\a';
+                        break;
+                case 'b':
+                        value[len++] = '\b';
+                        break;
+                case 'x': {
+                        char *end = NULL;
+                        value[len++] = (char)strtol(c + 1, &end, 16);
+                        c = end - 1;
+                        break;
+                }
+                case '0' ... '7': {
+                        int octal = 0;
+                        for (int i = 0; i < 3 && *c >= '0' && *c <= '7';
+                             i++, c++)
+                                octal = 8 * octal + (*c - '0');
+                        value[len++] = (char)octal;
+                        c--;
+                        break;
+                }
+                default:
+                        value[len++] = *c;
+                        break;
+                }
+        }
+
+        return value;
+}
+
+static long add_literal_constant(bytecode_program *program,
+                                 const char *literal)
+{
+        char *value = string_literal_value(literal);
+        long constant = add_string_constant(program, value, strlen(literal));
+        free(value);
+
+        return constant;
+}
+
+/* Numbers reach the generated C printed with "%f" */
+static double printed_number(double number)
+{
+        char printed[512];
+        snprintf(printed, sizeof(printed), "%f", number);
+
+        return strtod(printed, NULL);
+}
+
+static long add_number_constant(bytecode_program *program, double number)
+{
+        return add_real_constant(program, printed_number(number));
+}
+
+/* Function compilation */
+static bool compile_function(bytecode_program *program,
+                             node_function *function)
+{
+        if (function == NULL)
+                return false;
+
+        if (!compile_args(program, function->args)) {
+                error_in_function(function->name);
+                return false;
+        }
+
+        if (!compile_expressions_list(program, function->expressions, NULL)) {
+                error_in_function(function->name);
+                return false;
+        }
+
+        /* A returned file only matters to C callers: exit with 0 */
+        emit_instruction(program, OP_RETURN, 0, 0, 0, 0);
+
+        return true;
+}
+
+/* Arguments are numbers given in the command line, like in generate_c_main */
+static bool compile_args(bytecode_program *program, node_list *args)
+{
+        if (args == NULL || args->type != LIST_ARGS_TYPE ||
+            args->exprs == NULL)
+                return false;
+
+        for (size_t i = 0; i < args->len; i++) {
+                node_expression *arg = args->exprs[i];
+                if (arg == NULL)
+                        continue;
+
+                if (arg->var == NULL || arg->var->name == NULL ||
+                    arg->type != EXPRESSION_VARIABLE) {
+                        error_invalid_function_arguments();
+                        return false;
+                }
+
+                long reg = declare_register(program, arg->var->name,
+                                            REGISTER_OBJECT);
+                emit_instruction(program, OP_NEW_OBJECT, reg, 0, 0, 0);
+                emit_instruction(program, OP_LOAD_ARGUMENT, reg, i + 1, 0, 0);
+        }
+
+        return true;
+}
+
+static bool compile_expressions_list(bytecode_program *program,
+                                     node_expression_list *expressions,
+                                     const char *working_filename)
+{
+        if (expressions == NULL || expressions->expr == NULL)
+                return false;
+
+        while (expressions != NULL && expressions->expr != NULL) {
+                if (!compile_expression(program, expressions->expr,
+                                        working_filename))
+                        return false;
+
+                expressions = expressions->next;
+        }
+
+        return true;
+}
+
+static bool compile_expression(bytecode_program *program,
+                               node_expression *expr,
+                               const char *working_filename)
+{
+        if (program == NULL || expr == NULL)
+                return false;
+
+        switch (expr->type) {
+        case EXPRESSION_VARIABLE_ASSIGNMENT:
+                return compile_variable_assignment(program, expr->var,
+                                                   expr->expr,
+                                                   working_filename);
+        case EXPRESSION_VARIABLE_DECLARATION: /* Fallsthrough */
+        case EXPRESSION_FILE_DECLARATION:
+                return compile_variable(program, expr->var, expr->list_expr);
+        case EXPRESSION_LOOP:
+                return compile_loop_expression(program, expr->loop_expr,
+                                               working_filename);
+        case EXPRESSION_FILE_HANDLE:
+                return compile_expressions_list_with_file(program,
+                                                          expr->file_handler);
+        case EXPRESSION_CONDITIONAL:
+                return compile_conditional(program, expr->conditional,
+                                           working_filename);
+        default:
+                LogDebug("Got expression of type: %d\n"
+                         "\tFunction: %s",
+                         expr->type, __func__);
+                break;
+        }
+
+        return true;
+}
+
+static bool compile_variable(bytecode_program *program, variable *var,
+                             node_list *separators)
+{
+        if (program == NULL || var == NULL || var->name == NULL)
+                return false;
+
+        long reg = declare_register(program, var->name, REGISTER_OBJECT);
+        emit_instruction(program, OP_NEW_OBJECT, reg, 0, 0, 0);
+
+        variable *value = var;
+        if (var->type == CONSTANT_TYPE)
+                value = var->value.expr->var;
+
+        switch (value->type) {
+        case NUMBER_TYPE:
+                emit_instruction(
+                        program, OP_SET_REAL, reg,
+                        add_number_constant(program, value->value.number), 0,
+                        0);
+                break;
+        case BOOL_TYPE:
+                emit_instruction(program, OP_SET_BOOLEAN, reg,
+                                 value->value.boolean, 0, 0);
+                break;
+        case STRING_TYPE:
+                emit_instruction(
+                        program, OP_SET_STRING, reg,
+                        add_literal_constant(program, value->value.string), 0,
+                        0);
+                break;
+        case FILE_PATH_TYPE:
+                if (separators == NULL)
+                        return compile_variable_file(program, reg, var, NULL);
+
+                return compile_variable_file(program, reg, var,
+                                             separators->exprs[0]->list_expr);
+        default:
+                LogDebug("Got variable type: %d\n"
+                         "\tFunction: %s",
+                         var->type, __func__);
+        }
+
+        return true;
+}
+
+static bool compile_variable_file(bytecode_program *program, long reg,
+                                  variable *var, node_list *separators)
+{
+        long str_separators = -1;
+        if (separators != NULL && separators->exprs != NULL &&
+            strcmp(separators->exprs[0]->var->value.string, "") != 0) {
+                size_t literals_len = 1;
+                for (size_t i = 0; i < separators->len; i++) {
+                        const char *separator =
+                                separators->exprs[i]->var->value.string;
+                        literals_len += strlen(separator);
+                }
+
+                char *literals = (char *)calloc(literals_len, sizeof(char));
+                if (literals == NULL) {
+                        error_no_memory();
+                        exit(1);
+                }
+
+                for (size_t i = 0; i < separators->len; i++)
+                        strcat(literals,
+                               separators->exprs[i]->var->value.string);
+
+                str_separators = add_literal_constant(program, literals);
+                free(literals);
+        }
+
+        // Paths can be replaced by --file and --batch, by variable name
+        long name = add_string_constant(program, var->name, strlen(var->name));
+
+        if (strstr(var->name, "input") == var->name) {
+                long path = add_literal_constant(program, var->value.string);
+
+                if (strrchr(var->value.string, '/') != NULL) {
+                        emit_instruction(program, OP_OPEN_DIRECTORY, reg, path,
+                                         str_separators, name);
+                } else {
+                        emit_instruction(program, OP_OPEN_READ, reg, path,
+                                         str_separators, name);
+                }
+        } else if (strstr(var->name, "output") == var->name) {
+                if (strlen(var->value.string) == 0 ||
+                    strcmp(var->value.string, "\"\"") == 0) { // Filename: ""
+                        emit_instruction(program, OP_OPEN_TEMPORARY, reg, 0, 0,
+                                         0);
+                } else if (strcmp(var->value.string, "STDOUT") == 0) {
+                        emit_instruction(program, OP_OPEN_STDOUT, reg, 0, 0,
+                                         name);
+                } else {
+                        emit_instruction(
+                                program, OP_OPEN_WRITE, reg,
+                                add_literal_constant(program,
+                                                     var->value.string),
+                                str_separators, name);
+                }
+        } else {
+                error_invalid_file_variable_name(var->name);
+                return false;
+        }
+
+        return true;
+}
+
+/* Writes a variable that is not a file: a line, a cell or a string */
+static bool compile_write_variable(bytecode_program *program, variable *source,
+                                   long dest)
+{
+        long reg = lookup_register(source->name);
+        if (reg < 0) {
+                error_variable_not_found(source->name);
+                return false;
+        }
+
+        switch (program->registers[reg]) {
+        case REGISTER_BUFFER:
+                emit_instruction(program, OP_WRITE_BUFFER, reg, dest, 0, 0);
+                break;
+        case REGISTER_OBJECT:
+                emit_instruction(program, OP_WRITE_STRING, reg, dest, 0, 0);
+                break;
+        default:
+                LogError("Variable %s can not be written to a file.",
+                         source->name);
+                return false;
+        }
+
+        return true;
+}
+
+/* string_addition() of a constant or a line to the string in 'dest' */
+static bool compile_string_append(bytecode_program *program, long dest,
+                                  node_expression *operand)
+{
+        if (operand->type == EXPRESSION_GRAMMAR_CONSTANT_TYPE) {
+                emit_instruction(program, OP_APPEND_CONSTANT, dest,
+                                 add_literal_constant(
+                                         program, operand->var->value.string),
+                                 0, 0);
+                return true;
+        }
+
+        long reg = variable_register(program, operand->var->name,
+                                     REGISTER_BUFFER);
+        if (reg < 0)
+                return false;
+
+        emit_instruction(program, OP_APPEND_BUFFER, dest, reg, 0, 0);
+        return true;
+}
+
+static bool compile_string_arithmetic_add_expression(bytecode_program *program,
+                                                     node_expression *left,
+                                                     node_expression *right,
+                                                     variable *var)
+{
+        long dest = lookup_register(var->name);
+        if (dest < 0) {
+                error_variable_not_found(var->name);
+                return false;
+        }
+
+        if (left->type == EXPRESSION_GRAMMAR_CONSTANT_TYPE &&
+            right->type == EXPRESSION_GRAMMAR_CONSTANT_TYPE) {
+                if (var->type == FILE_PATH_TYPE) {
+                        size_t literals_len = 1 +
+                                              strlen(left->var->value.string) +
+                                              strlen(right->var->value.string);
+                        char *literals =
+                                (char *)calloc(literals_len, sizeof(char));
+                        if (literals == NULL) {
+                                error_no_memory();
+                                exit(1);
+                        }
+
+                        strcat(literals, left->var->value.string);
+                        strcat(literals, right->var->value.string);
+
+                        emit_instruction(program, OP_WRITE_CONSTANT,
+                                         add_literal_constant(program,
+                                                              literals),
+                                         dest, 0, 0);
+                        free(literals);
+                }
+        } else if (left->type == VARIABLE_TYPE &&
+                   left->var->type == FILE_PATH_TYPE) {
+                if (var->type != FILE_PATH_TYPE) {
+                        LogError("File addition must be stored in a file");
+                        return false;
+                }
+
+                long left_file = variable_register(program, left->var->name,
+                                                   REGISTER_OBJECT);
+                if (left_file < 0)
+                        return false;
+                emit_instruction(program, OP_COPY_FILE, left_file, dest, 0, 0);
+
+                if (right->type == VARIABLE_TYPE &&
+                    right->var->type == FILE_PATH_TYPE) {
+                        long right_file = variable_register(
+                                program, right->var->name, REGISTER_OBJECT);
+                        if (right_file < 0)
+                                return false;
+                        emit_instruction(program, OP_COPY_FILE, right_file,
+                                         dest, 0, 0);
+                } else if (right->type == EXPRESSION_GRAMMAR_CONSTANT_TYPE) {
+                        emit_instruction(
+                                program, OP_WRITE_CONSTANT,
+                                add_literal_constant(program,
+                                                     right->var->value.string),
+                                dest, 0, 0);
+                } else if (right->type == VARIABLE_TYPE) {
+                        return compile_write_variable(program, right->var,
+                                                      dest);
+                }
+        } else if (right->type == VARIABLE_TYPE &&
+                   right->var->type == FILE_PATH_TYPE) {
+                if (var->type != FILE_PATH_TYPE) {
+                        LogError("File addition must be stored in a file");
+                        return false;
+                }
+
+                long right_file = variable_register(program, right->var->name,
+                                                    REGISTER_OBJECT);
+                if (right_file < 0)
+                        return false;
+                emit_instruction(program, OP_COPY_FILE, right_file, dest, 0,
+                                 0);
+
+                if (left->type == EXPRESSION_GRAMMAR_CONSTANT_TYPE) {
+                        emit_instruction(
+                                program, OP_WRITE_CONSTANT,
+                                add_literal_constant(program,
+                                                     left->var->value.string),
+                                dest, 0, 0);
+                } else if (left->type == VARIABLE_TYPE) {
+                        return compile_write_variable(program, left->var,
+                                                      dest);
+                }
+        } else if (left->type == VARIABLE_TYPE) {
+                if (strcmp(left->var->name, var->name) == 0) {
+                        return compile_string_append(program, dest, right);
+                } else if (right->type == VARIABLE_TYPE &&
+                           strcmp(right->var->name, var->name) == 0) {
+                        return compile_string_append(program, dest, left);
+                } else if (var->type == CONSTANT_TYPE &&
+                           var->value.expr->var->type == STRING_TYPE) {
+                        return compile_string_append(program, dest, left) &&
+                               compile_string_append(program, dest, right);
+                } else if (left->var->type == LOOP_VARIABLE_TYPE) {
+                        long line = variable_register(
+                                program, left->var->name, REGISTER_BUFFER);
+                        if (line < 0)
+                                return false;
+
+                        long has_newline =
+                                new_register(program, REGISTER_NUMBER);
+                        emit_instruction(program, OP_STRIP_NEWLINE, line,
+                                         has_newline, 0, 0);
+                        emit_instruction(program, OP_WRITE_BUFFER, line, dest,
+                                         0, 0);
+
+                        if (right->type == EXPRESSION_GRAMMAR_CONSTANT_TYPE) {
+                                emit_instruction(
+                                        program, OP_WRITE_CONSTANT,
+                                        add_literal_constant(
+                                                program,
+                                                right->var->value.string),
+                                        dest, 0, 0);
+                        } else if (right->type == VARIABLE_TYPE &&
+                                   !compile_write_variable(
+                                           program, right->var, dest)) {
+                                return false;
+                        }
+
+                        size_t no_newline =
+                                emit_instruction(program, OP_JUMP_IF_ZERO,
+                                                 has_newline, 0, 0, 0);
+                        emit_instruction(program, OP_WRITE_CONSTANT,
+                                         add_string_constant(program, "\n", 4),
+                                         dest, 0, 0);
+                        patch_jump(program, no_newline,
+                                   program->n_instructions);
+                } else {
+                        if (!compile_write_variable(program, left->var, dest))
+                                return false;
+
+                        if (right->type == EXPRESSION_GRAMMAR_CONSTANT_TYPE) {
+                                emit_instruction(
+                                        program, OP_WRITE_CONSTANT,
+                                        add_literal_constant(
+                                                program,
+                                                right->var->value.string),
+                                        dest, 0, 0);
+                        } else if (right->type == VARIABLE_TYPE) {
+                                return compile_write_variable(
+                                        program, right->var, dest);
+                        }
+                }
+        } else if (right->type == VARIABLE_TYPE) {
+                if (left->type == EXPRESSION_GRAMMAR_CONSTANT_TYPE) {
+                        emit_instruction(
+                                program, OP_WRITE_CONSTANT,
+                                add_literal_constant(program,
+                                                     left->var->value.string),
+                                dest, 0, 0);
+                } else if (left->type == VARIABLE_TYPE &&
+                           !compile_write_variable(program, left->var, dest)) {
+                        return false;
+                }
+
+                return compile_write_variable(program, right->var, dest);
+        } else {
+                LogError(
+                        "String addition not posible for types: %ld and %ld\n",
+                        left->type, right->type);
+
+                return false;
+        }
+
+        return true;
+}
+
+static bool compile_variable_assignment(bytecode_program *program,
+                                        variable *var, node_expression *expr,
+                                        const char *working_filename)
+{
+        if (program == NULL || var == NULL || expr == NULL)
+                return false;
+
+        switch (expr->type) {
+        case VARIABLE_TYPE: // ID -> ID.
+                return compile_variable_assignment_to_variable(program, var,
+                                                               expr->var);
+        case EXPRESSION_GRAMMAR_CONSTANT_TYPE: // ie: True -> ID.
+                return compile_variable_assignment_to_constant(program, var,
+                                                               expr->var);
+        case EXPRESSION_NUMBER_ARITHMETIC_ADD:
+        case EXPRESSION_NUMBER_ARITHMETIC_SUB:
+        case EXPRESSION_NUMBER_ARITHMETIC_MUL:
+        case EXPRESSION_NUMBER_ARITHMETIC_DIV:
+        case EXPRESSION_NUMBER_ARITHMETIC_MOD:
+                return compile_variable_assignment_from_number_arithmetic(
+                        program, var, expr);
+        case EXPRESSION_STR_ARITHMETIC_ADD:
+                return compile_string_arithmetic_add_expression(
+                        program, expr->left, expr->right, var);
+        case EXPRESSION_STR_ARITHMETIC_SUB:
+                /* Not implemented by the generator either */
+                return true;
+        case EXPRESSION_FUNCTION_CALL: // line.filter("ERROR") -> ID
+                return compile_variable_assignment_from_function_call_from_id(
+                        program, var, expr->fun_call, working_filename);
+        default:
+                break;
+        }
+
+        return true;
+}
+
+static bool compile_variable_assignment_from_function_call_from_id(
+        bytecode_program *program, variable *dest,
+        node_function_call *id_plus_function, const char *working_file)
+{
+        if (dest == NULL || id_plus_function == NULL ||
+            id_plus_function->next == NULL)
+                return false;
+
+        size_t depth = n_blocks;
+        size_t concat_functions = 1;
+        variable *working_id = id_plus_function->id; // 'line'
+        node_function_call *fn_calls = id_plus_function; // Alias
+
+        long dest_reg = variable_register(program, dest->name,
+                                          REGISTER_OBJECT);
+        if (dest_reg < 0)
+                return false;
+
+        while (fn_calls != NULL && fn_calls->next != NULL) {
+                fn_calls = fn_calls->next;
+                concat_functions++;
+        }
+
+        while (concat_functions > 0) {
+                if (strcmp(fn_calls->id->name, "filter") == 0 &&
+                    working_id == columns_loop_variable) {
+                        // Inside columns().lines(): filter the current cell
+                        long cell = variable_register(
+                                program, working_id->name, REGISTER_BUFFER);
+                        if (cell < 0)
+                                return false;
+
+                        size_t jump = emit_instruction(
+                                program, OP_JUMP_IF_NOT_IN_STRING, cell,
+                                add_literal_constant(
+                                        program, fn_calls->args->exprs[0]
+                                                         ->var->value.string),
+                                0, 0);
+                        if (!add_continue(jump))
+                                return false;
+                } else if (strcmp(fn_calls->id->name, "filter") == 0) {
+                        long file =
+                                working_file_register(program, working_file);
+                        long line_len = variable_register(
+                                program, "_line_len_implementation",
+                                REGISTER_NUMBER);
+                        long line = variable_register(
+                                program, working_id->name, REGISTER_BUFFER);
+                        if (file < 0 || line_len < 0 || line < 0)
+                                return false;
+
+                        emit_instruction(program, OP_REWIND, file, 0, 0, 0);
+
+                        open_block(program, BLOCK_WHILE, 0);
+                        add_exit(emit_instruction(program,
+                                                  OP_JUMP_IF_NOT_POSITIVE,
+                                                  line_len, 0, 0, 0));
+                        emit_instruction(program, OP_LINES, file, line, 0, 0);
+                        emit_instruction(program, OP_STORE_ACC, line_len, 0,
+                                         0, 0);
+
+                        open_block(program, BLOCK_IF, 0);
+                        add_exit(emit_instruction(
+                                program, OP_JUMP_IF_NOT_IN_STRING, line,
+                                add_literal_constant(
+                                        program, fn_calls->args->exprs[0]
+                                                         ->var->value.string),
+                                0, 0));
+                } else if (strcmp(fn_calls->id->name, "toString") == 0) {
+                        long source = variable_register(
+                                program, working_id->name, REGISTER_OBJECT);
+                        if (source < 0)
+                                return false;
+
+                        if (dest->type == FILE_PATH_TYPE) {
+                                emit_instruction(program, OP_WRITE_TO_STRING,
+                                                 source, dest_reg, 0, 0);
+                        } else if (dest->type == CONSTANT_TYPE) {
+                                emit_instruction(program, OP_TO_STRING,
+                                                 dest_reg, source, 0, 0);
+                        }
+                } else if (strcmp(fn_calls->id->name, "at") == 0) {
+                        long source = variable_register(
+                                program, working_id->name, REGISTER_OBJECT);
+                        if (source < 0)
+                                return false;
+
+                        emit_instruction(program, OP_AT, source,
+                                         (long)fn_calls->args->exprs[0]
+                                                 ->var->value.number,
+                                         0, 0);
+                        if (dest->type == FILE_PATH_TYPE) {
+                                emit_instruction(program, OP_WRITE_ACC,
+                                                 dest_reg, 0, 0, 0);
+                        } else if (dest->type == CONSTANT_TYPE) {
+                                emit_instruction(program, OP_SET_CHARACTER,
+                                                 dest_reg, 0, 0, 0);
+                        }
+                } else if (fn_calls->id->type == LOOP_VARIABLE_TYPE) {
+                        long line = variable_register(
+                                program, working_id->name, REGISTER_BUFFER);
+                        if (line < 0)
+                                return false;
+
+                        emit_instruction(program, OP_WRITE_BUFFER, line,
+                                         dest_reg, 0, 0);
+                }
+
+                fn_calls = fn_calls->prev;
+                concat_functions--;
+        }
+
+        close_blocks(program, depth);
+
+        return true;
+}
+
+static bool compile_variable_assignment_to_variable(bytecode_program *program,
+                                                    variable *dest,
+                                                    variable *source)
+{
+        if (program == NULL || dest == NULL || source == NULL)
+                return false;
+
+        if (dest->name == NULL || source->name == NULL)
+                return false;
+
+        long dest_reg = variable_register(program, dest->name,
+                                          REGISTER_OBJECT);
+        if (dest_reg < 0)
+                return false;
+
+        if (dest->type == FILE_PATH_TYPE && source->type == FILE_PATH_TYPE) {
+                long source_reg = variable_register(program, source->name,
+                                                    REGISTER_OBJECT);
+                if (source_reg < 0)
+                        return false;
+
+                emit_instruction(program, OP_COPY_FILE_TEXLER, source_reg,
+                                 dest_reg, 0, 0);
+        } else if (source->type == LOOP_VARIABLE_TYPE) {
+                long line = variable_register(program, source->name,
+                                              REGISTER_BUFFER);
+                if (line < 0)
+                        return false;
+
+                if (dest->type == FILE_PATH_TYPE) {
+                        emit_instruction(program, OP_WRITE_BUFFER, line,
+                                         dest_reg, 0, 0);
+                } else if (dest->type == CONSTANT_TYPE &&
+                           dest->value.expr->var->type == STRING_TYPE) {
+                        emit_instruction(program, OP_COPY_BUFFER, dest_reg,
+                                         line, 0, 0);
+                } else {
+                        LogError("A line can only be assigned to a file or "
+                                 "a string.");
+                        return false;
+                }
+        } else {
+                long source_reg = variable_register(program, source->name,
+                                                    REGISTER_OBJECT);
+                if (source_reg < 0)
+                        return false;
+
+                if (source->type == CONSTANT_TYPE &&
+                    source->value.expr->var->type == STRING_TYPE &&
+                    dest->type == FILE_PATH_TYPE) {
+                        emit_instruction(program, OP_WRITE_STRING, source_reg,
+                                         dest_reg, 0, 0);
+                } else {
+                        emit_instruction(program, OP_COPY_OBJECT, dest_reg,
+                                         source_reg, 0, 0);
+                }
+        }
+
+        return true;
+}
+
+static bool compile_variable_assignment_to_constant(bytecode_program *program,
+                                                    variable *dest,
+                                                    variable *source)
+{
+        if (program == NULL || dest == NULL || source == NULL)
+                return false;
+
+        long reg = variable_register(program, dest->name, REGISTER_OBJECT);
+        if (reg < 0)
+                return false;
+
+        switch (source->type) {
+        case NUMBER_TYPE:
+                emit_instruction(
+                        program, OP_SET_REAL, reg,
+                        add_number_constant(program, source->value.number), 0,
+                        0);
+                break;
+        case BOOL_TYPE:
+                emit_instruction(program, OP_SET_BOOLEAN, reg,
+                                 source->value.boolean, 0, 0);
+                break;
+        case STRING_TYPE:
+                emit_instruction(
+                        program, OP_SET_STRING, reg,
+                        add_literal_constant(program, source->value.string), 0,
+                        0);
+                break;
+        default:
+                LogDebug("Got variable of type: %d\n"
+                         "\tFunction: %s",
+                         source->type, __func__);
+                return false;
+        }
+
+        return true;
+}
+
+static bool compile_variable_assignment_from_number_arithmetic(
+        bytecode_program *program, variable *var, node_expression *operation)
+{
+        long dest = variable_register(program, var->name, REGISTER_OBJECT);
+        if (dest < 0)
+                return false;
+
+        node_expression *left = operation->left;
+        node_expression *right = operation->right;
+        long result = new_register(program, REGISTER_NUMBER);
+
+        switch (operation->type) {
+        case EXPRESSION_NUMBER_ARITHMETIC_ADD:
+                emit_instruction(program, OP_LOAD_REAL, result,
+                                 add_real_constant(program, 0), 0, 0);
+                if (!compile_number_arithmetic(program, OP_ADD_REAL_BUFFER,
+                                               OP_ADD_REAL_CONSTANT, result,
+                                               left) ||
+                    !compile_number_arithmetic(program, OP_ADD_REAL_BUFFER,
+                                               OP_ADD_REAL_CONSTANT, result,
+                                               right))
+                        return false;
+                break;
+        case EXPRESSION_NUMBER_ARITHMETIC_MUL:
+                if ((left->type == VARIABLE_TYPE &&
+                     left->var->type == FILE_PATH_TYPE) ||
+                    (right->type == VARIABLE_TYPE &&
+                     right->var->type == FILE_PATH_TYPE)) {
+                        return compile_number_arithmetic_mul_with_file(
+                                program, left, right, var);
+                }
+
+                emit_instruction(program, OP_LOAD_REAL, result,
+                                 add_real_constant(program, 1), 0, 0);
+                if (!compile_number_arithmetic(program, OP_MUL_REAL_BUFFER,
+                                               OP_MUL_REAL_CONSTANT, result,
+                                               left) ||
+                    !compile_number_arithmetic(program, OP_MUL_REAL_BUFFER,
+                                               OP_MUL_REAL_CONSTANT, result,
+                                               right))
+                        return false;
+                break;
+        default:
+                error_not_supported_by_vm("Arithmetic other than + and *");
+                return false;
+        }
+
+        emit_instruction(program, OP_WRITE_REAL, result, dest, 0, 0);
+
+        return true;
+}
+
+/* A constant, or a cell read from a file (atof) */
+static bool compile_number_arithmetic(bytecode_program *program,
+                                      BYTECODE_OPCODE buffer_op,
+                                      BYTECODE_OPCODE constant_op, long reg,
+                                      node_expression *operand)
+{
+        switch (operand->type) {
+        case EXPRESSION_GRAMMAR_CONSTANT_TYPE:
+                emit_instruction(
+                        program, constant_op, reg,
+                        add_number_constant(program,
+                                            operand->var->value.number),
+                        0, 0);
+                break;
+        case VARIABLE_TYPE: {
+                long cell = variable_register(program, operand->var->name,
+                                              REGISTER_BUFFER);
+                if (cell < 0)
+                        return false;
+
+                emit_instruction(program, buffer_op, reg, cell,
+                                 operand->var == columns_loop_variable ?
+                                         columns_loop_file :
+                                         -1,
+                                 0);
+                break;
+        }
+        default:
+                LogError("Arithmetic not implemented for type: %ld",
+                         operand->type);
+                return false;
+        }
+
+        return true;
+}
+
+static bool compile_number_arithmetic_mul_with_file(bytecode_program *program,
+                                                    node_expression *left,
+                                                    node_expression *right,
+                                                    variable *var)
+{
+        node_expression *file_id = left;
+        node_expression *variable_id = right;
+
+        if (left->var->type != FILE_PATH_TYPE) {
+                file_id = right;
+                variable_id = left;
+        }
+
+        long dest = variable_register(program, var->name, REGISTER_OBJECT);
+        long file = variable_register(program, file_id->var->name,
+                                      REGISTER_OBJECT);
+        if (dest < 0 || file < 0)
+                return false;
+
+        long times = new_register(program, REGISTER_NUMBER);
+
+        if (variable_id->type == VARIABLE_TYPE) {
+                long number = variable_register(
+                        program, variable_id->var->name, REGISTER_OBJECT);
+                if (number < 0)
+                        return false;
+
+                emit_instruction(
+                        program, OP_OBJECT_TO_INTEGER, times, number,
+                        add_string_constant(program, variable_id->var->name,
+                                            strlen(variable_id->var->name)),
+                        0);
+        } else if (variable_id->type == EXPRESSION_GRAMMAR_CONSTANT_TYPE &&
+                   variable_id->var->type == NUMBER_TYPE) {
+                emit_instruction(
+                        program, OP_LOAD_INTEGER, times,
+                        (long)printed_number(variable_id->var->value.number),
+                        0, 0);
+        } else {
+                error_invalid_multiplication_type();
+                return false;
+        }
+
+        open_block(program, BLOCK_WHILE, 0);
+        add_exit(emit_instruction(program, OP_JUMP_IF_NOT_POSITIVE, times, 0,
+                                  0, 0));
+        emit_instruction(program, OP_COPY_FILE, file, dest, 0, 0);
+        emit_instruction(program, OP_ADD_INTEGER, times, times, -1, 0);
+        close_block(program);
+
+        return true;
+}
+
+static bool compile_expressions_list_with_file(bytecode_program *program,
+                                               node_file_block *fhandler)
+{
+        if (program == NULL || fhandler == NULL)
+                return false;
+
+        if (fhandler->var == NULL || fhandler->var->name == NULL ||
+            fhandler->var->type != FILE_PATH_TYPE) {
+                error_invalid_node_file_handler(__func__);
+                return false;
+        }
+
+        return compile_expressions_list(program, fhandler->exprs_list,
+                                        fhandler->var->name);
+}
+
+static bool compile_loop_expression(bytecode_program *program,
+                                    node_loop *loop,
+                                    const char *working_filename)
+{
+        if (program == NULL || loop == NULL || loop->iterable == NULL ||
+            loop->action == NULL || loop->var == NULL)
+                return false;
+
+        switch (loop->iterable->type) {
+        case EXPRESSION_LIST: {
+                if (loop->iterable->list_expr->type != LIST_RANGE_TYPE) {
+                        error_loop_iterable_of_invalid_type();
+                        return false;
+                }
+
+                long counter = new_register(program, REGISTER_NUMBER);
+                emit_instruction(program, OP_LOAD_INTEGER, counter,
+                                 loop->iterable->list_expr->from - 1, 0, 0);
+
+                open_block(program, BLOCK_FOR, counter);
+                bind_register(loop->var->name, counter);
+                add_exit(emit_instruction(program, OP_JUMP_IF_NOT_LESS,
+                                          counter,
+                                          loop->iterable->list_expr->to, 0,
+                                          0));
+
+                if (!compile_expression(program, loop->action,
+                                        working_filename))
+                        return false;
+
+                close_block(program);
+                break;
+        }
+        case EXPRESSION_FUNCTION_CALL:
+                return compile_loop_function_calls_expression(
+                        program, loop, working_filename);
+        default:
+                LogDebug("Got expression of type: %d\n"
+                         "\tFunction: %s",
+                         loop->iterable->type, __func__);
+                break;
+        }
+
+        return true;
+}
+
+static bool compile_loop_function_calls_expression(
+        bytecode_program *program, node_loop *loop,
+        const char *working_filename)
+{
+        if (program == NULL || loop == NULL)
+                return false;
+
+        long working = -1;
+        if (working_filename == NULL ||
+            (working = variable_register(program, working_filename,
+                                         REGISTER_OBJECT)) < 0) {
+                LogError("Functions on lines must be used inside 'with'.");
+                return false;
+        }
+
+        bool loop_action_compiled = false;
+        size_t depth = n_blocks;
+        size_t concat_functions = 1;
+        node_function_call *fn_calls = loop->iterable->fun_call; // Alias
+
+        while (fn_calls != NULL && fn_calls->next != NULL) {
+                fn_calls = fn_calls->next;
+                concat_functions++;
+        }
+
+        /* One iteration per file of the input folder (or just one) */
+        long file_index = new_register(program, REGISTER_NUMBER);
+        emit_instruction(program, OP_LOAD_INTEGER, file_index, 0, 0, 0);
+        open_block(program, BLOCK_FOR, file_index);
+        add_exit(emit_instruction(program, OP_JUMP_IF_NO_FILES_LEFT,
+                                  file_index, working, 0, 0));
+
+        char *file_name = (char *)calloc(
+                1 + strlen(working_filename) + strlen("_file"), sizeof(char));
+        if (file_name == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+        strcpy(file_name, working_filename);
+        strcat(file_name, "_file");
+        long file = declare_register(program, file_name, REGISTER_FILE);
+        free(file_name);
+
+        /* Files of a folder that can not be opened are skipped */
+        add_continue(emit_instruction(program, OP_NEXT_FILE, file, working, 0,
+                                      0));
+
+        long line_len = -1;
+        bool grouped = false;
+
+        while (concat_functions > 0) {
+                if (strcmp(fn_calls->id->name, "lines") == 0) {
+                        line_len = declare_register(program,
+                                                    "_line_len_implementation",
+                                                    REGISTER_NUMBER);
+                        emit_instruction(program, OP_LOAD_INTEGER, line_len,
+                                         BUFFER_SIZE, 0, 0);
+
+                        long line = declare_register(program, loop->var->name,
+                                                     REGISTER_BUFFER);
+                        emit_instruction(program, OP_NEW_BUFFER, line, 0, 0,
+                                         0);
+
+                        if (fn_calls->next != NULL &&
+                            strcmp(fn_calls->next->id->name, "byIndex") == 0) {
+                                if (!compile_lines_byIndex(program, loop,
+                                                           fn_calls->next,
+                                                           file, line_len))
+                                        return false;
+                        } else if (find_next_function(fn_calls->next,
+                                                      "group") != NULL) {
+                                node_function_call *group_call =
+                                        find_next_function(fn_calls->next,
+                                                           "group");
+                                unsigned long column = 0;
+                                size_t n_aggregates = 0;
+                                texler_aggregate *aggregates =
+                                        group_arguments(group_call, &column,
+                                                        &n_aggregates);
+                                if (aggregates == NULL)
+                                        return false;
+
+                                /* Of every file of the 'with' at once */
+                                long group = new_register(program,
+                                                          REGISTER_GROUP);
+                                emit_instruction(
+                                        program, OP_GROUP_RECORDS, group,
+                                        working, column,
+                                        add_aggregates_constant(
+                                                program, aggregates,
+                                                n_aggregates));
+                                grouped = true;
+
+                                open_block(program, BLOCK_WHILE, 0);
+                                add_exit(emit_instruction(
+                                        program, OP_JUMP_IF_NOT_POSITIVE,
+                                        line_len, 0, 0, 0));
+                                emit_instruction(program, OP_GROUPED_RECORDS,
+                                                 group, line, 0, 0);
+                                emit_instruction(program, OP_STORE_ACC,
+                                                 line_len, 0, 0, 0);
+                                add_break(emit_instruction(
+                                        program, OP_JUMP_IF_NOT_POSITIVE,
+                                        line_len, 0, 0, 0));
+                                add_break(emit_instruction(program,
+                                                           OP_JUMP_IF_NULL,
+                                                           line, 0, 0, 0));
+
+                                blocks[n_blocks - 1].has_epilogue = true;
+                                blocks[n_blocks - 1].epilogue =
+                                        (bytecode_instruction){
+                                                .op = OP_FREE_GROUP,
+                                                .a = group
+                                        };
+
+                                // Filters after group() test the groups
+                                compile_line_predicates(program,
+                                                        group_call->next,
+                                                        line);
+                        } else if (find_top(fn_calls->next) != NULL) {
+                                node_function_call *top_call =
+                                        find_top(fn_calls->next);
+                                unsigned long k = 0;
+                                unsigned long column = 0;
+                                if (!top_arguments(top_call, &k, &column))
+                                        return false;
+
+                                /* Of every file of the 'with' at once */
+                                long top = new_register(program,
+                                                        REGISTER_TOP);
+                                emit_instruction(program, OP_TOP_RECORDS, top,
+                                                 working, column, k);
+                                grouped = true;
+
+                                open_block(program, BLOCK_WHILE, 0);
+                                add_exit(emit_instruction(
+                                        program, OP_JUMP_IF_NOT_POSITIVE,
+                                        line_len, 0, 0, 0));
+                                emit_instruction(program, OP_RANKED_RECORDS,
+                                                 top, line, 0, 0);
+                                emit_instruction(program, OP_STORE_ACC,
+                                                 line_len, 0, 0, 0);
+                                add_break(emit_instruction(
+                                        program, OP_JUMP_IF_NOT_POSITIVE,
+                                        line_len, 0, 0, 0));
+                                add_break(emit_instruction(program,
+                                                           OP_JUMP_IF_NULL,
+                                                           line, 0, 0, 0));
+
+                                blocks[n_blocks - 1].has_epilogue = true;
+                                blocks[n_blocks - 1].epilogue =
+                                        (bytecode_instruction){
+                                                .op = OP_FREE_TOP, .a = top
+                                        };
+
+                                // Filters after top() test the records
+                                compile_line_predicates(program,
+                                                        top_call->next, line);
+                        } else if (find_next_function(fn_calls->next,
+                                                      "join") != NULL) {
+                                const char *other_name = NULL;
+                                unsigned long column = 0;
+                                unsigned long other_column = 0;
+                                bool left = false;
+                                if (!join_arguments(
+                                            find_next_function(fn_calls->next,
+                                                               "join"),
+                                            &other_name, &column,
+                                            &other_column, &left))
+                                        return false;
+                                long other = variable_register(
+                                        program, other_name, REGISTER_OBJECT);
+                                if (other < 0)
+                                        return false;
+
+                                long join = new_register(program,
+                                                         REGISTER_JOIN);
+                                emit_instruction(program, OP_JOIN_RECORDS,
+                                                 join, file, other,
+                                                 (long)(column << 32 |
+                                                        other_column << 1 |
+                                                        (left ? 1 : 0)));
+                                /* Released by the next file, or the VM */
+                                if (find_distinct(fn_calls->next) != NULL &&
+                                    compile_distinct(program, fn_calls->next,
+                                                     file) < 0)
+                                        return false;
+
+                                open_block(program, BLOCK_WHILE, 0);
+                                add_exit(emit_instruction(
+                                        program, OP_JUMP_IF_NOT_POSITIVE,
+                                        line_len, 0, 0, 0));
+                                emit_instruction(program, OP_JOINED_RECORDS,
+                                                 join, line, 0, 0);
+                                emit_instruction(program, OP_STORE_ACC,
+                                                 line_len, 0, 0, 0);
+                                add_break(emit_instruction(
+                                        program, OP_JUMP_IF_NOT_POSITIVE,
+                                        line_len, 0, 0, 0));
+                                add_break(emit_instruction(program,
+                                                           OP_JUMP_IF_NULL,
+                                                           line, 0, 0, 0));
+
+                                blocks[n_blocks - 1].has_epilogue = true;
+                                blocks[n_blocks - 1].epilogue =
+                                        (bytecode_instruction){
+                                                .op = OP_FREE_JOIN, .a = join
+                                        };
+
+                                // Filters and distinct() after join() test
+                                // the joined lines
+                                compile_line_predicates(program,
+                                                        fn_calls->next, line);
+                        } else if (find_next_function(fn_calls->next,
+                                                      "sort") != NULL) {
+                                unsigned long column = 0;
+                                bool numeric = false;
+                                bool descending = false;
+                                if (!sort_arguments(
+                                            find_next_function(fn_calls->next,
+                                                               "sort"),
+                                            &column, &numeric, &descending))
+                                        return false;
+
+                                long sort = new_register(program,
+                                                         REGISTER_SORT);
+                                emit_instruction(program, OP_REWIND, file, 0,
+                                                 0, 0);
+                                emit_instruction(program, OP_SORT_RECORDS,
+                                                 sort, file, column,
+                                                 (numeric ? 1 : 0) |
+                                                         (descending ? 2 : 0));
+                                /* Released by the next file, or the VM */
+                                if (find_distinct(fn_calls->next) != NULL &&
+                                    compile_distinct(program, fn_calls->next,
+                                                     file) < 0)
+                                        return false;
+
+                                open_block(program, BLOCK_WHILE, 0);
+                                add_exit(emit_instruction(
+                                        program, OP_JUMP_IF_NOT_POSITIVE,
+                                        line_len, 0, 0, 0));
+                                emit_instruction(program, OP_SORTED_RECORDS,
+                                                 sort, line, 0, 0);
+                                emit_instruction(program, OP_STORE_ACC,
+                                                 line_len, 0, 0, 0);
+                                add_break(emit_instruction(
+                                        program, OP_JUMP_IF_NOT_POSITIVE,
+                                        line_len, 0, 0, 0));
+                                add_break(emit_instruction(program,
+                                                           OP_JUMP_IF_NULL,
+                                                           line, 0, 0, 0));
+
+                                /* The runs are released once it is done */
+                                blocks[n_blocks - 1].has_epilogue = true;
+                                blocks[n_blocks - 1].epilogue =
+                                        (bytecode_instruction){
+                                                .op = OP_FREE_SORT, .a = sort
+                                        };
+
+                                // Filters and distinct() of the chain test
+                                // the sorted lines
+                                compile_line_predicates(program,
+                                                        fn_calls->next, line);
+                        } else if (fn_calls->next != NULL &&
+                                   ((fn_calls->next->args != NULL &&
+                                     strcmp(fn_calls->next->id->name,
+                                            "filter") == 0) ||
+                                    find_distinct(fn_calls->next) != NULL) &&
+                                   (fn_calls->prev == NULL ||
+                                    strcmp(fn_calls->prev->id->name,
+                                           "columns") != 0)) {
+                                // columns().lines().filter() is handled by
+                                // the columns branch, before splitting
+                                emit_instruction(program, OP_REWIND, file, 0,
+                                                 0, 0);
+                                long distinct = -1;
+                                if (find_distinct(fn_calls->next) != NULL) {
+                                        distinct = compile_distinct(
+                                                program, fn_calls->next, file);
+                                        if (distinct < 0)
+                                                return false;
+                                }
+
+                                open_block(program, BLOCK_WHILE, 0);
+                                add_exit(emit_instruction(
+                                        program, OP_JUMP_IF_NOT_POSITIVE,
+                                        line_len, 0, 0, 0));
+                                emit_instruction(program, OP_LINES, file, line,
+                                                 0, 0);
+                                emit_instruction(program, OP_STORE_ACC,
+                                                 line_len, 0, 0, 0);
+                                add_break(emit_instruction(
+                                        program, OP_JUMP_IF_NOT_POSITIVE,
+                                        line_len, 0, 0, 0));
+                                add_break(emit_instruction(program,
+                                                           OP_JUMP_IF_NULL,
+                                                           line, 0, 0, 0));
+
+                                /* The keys are released once it is done */
+                                if (distinct >= 0) {
+                                        blocks[n_blocks - 1].has_epilogue =
+                                                true;
+                                        blocks[n_blocks - 1].epilogue =
+                                                (bytecode_instruction){
+                                                        .op = OP_FREE_DISTINCT,
+                                                        .a = distinct
+                                                };
+                                }
+
+                                compile_line_predicates(program,
+                                                        fn_calls->next, line);
+                        }
+                } else if (strcmp(fn_calls->id->name, "columns") == 0) {
+                        if (fn_calls->next == NULL ||
+                            strcmp(fn_calls->next->id->name, "lines") != 0) {
+                                LogError("columns() not fully implemented. "
+                                         "Use it with lines: "
+                                         "columns().lines()");
+                                return false;
+                        }
+
+                        if (!compile_columns(program, loop, fn_calls, file,
+                                             line_len, working_filename))
+                                return false;
+
+                        loop_action_compiled = true;
+                } else if (strcmp(fn_calls->id->name, "byIndex") == 0) {
+                        node_expression *arg = fn_calls->args->exprs[0];
+
+                        switch (arg->type) {
+                        case EXPRESSION_VARIABLE:
+                                if (arg->var->type != LOOP_VARIABLE_TYPE) {
+                                        error_invalid_byIndex_argument();
+                                        return false;
+                                }
+                                break;
+                        case EXPRESSION_GRAMMAR_CONSTANT_TYPE:
+                                if (arg->var->type != NUMBER_TYPE) {
+                                        error_invalid_byIndex_argument();
+                                        return false;
+                                }
+                                break;
+                        case EXPRESSION_LIST:
+                                if (arg->list_expr->type == LIST_RANGE_TYPE) {
+                                        // Skip straight to the first row;
+                                        // the loop stops reading right
+                                        // after the last one, its bound.
+                                        // The file is not closed there:
+                                        // another loop may read it later
+                                        emit_instruction(program, OP_SEEK_LINE,
+                                                         file,
+                                                         arg->list_expr->from,
+                                                         0, 0);
+
+                                        long row = new_register(
+                                                program, REGISTER_NUMBER);
+                                        emit_instruction(
+                                                program, OP_LOAD_INTEGER, row,
+                                                arg->list_expr->from - 1, 0,
+                                                0);
+                                        open_block(program, BLOCK_FOR, row);
+                                        bind_register(
+                                                "_byIndex_implementation",
+                                                row);
+                                        add_exit(emit_instruction(
+                                                program, OP_JUMP_IF_NOT_LESS,
+                                                row, arg->list_expr->to, 0,
+                                                0));
+                                } else if (!compile_byIndex_row_set(
+                                                   program, arg->list_expr,
+                                                   file)) {
+                                        return false;
+                                }
+                                break;
+                        default:
+                                error_invalid_byIndex_argument();
+                                return false;
+                        }
+                } else if (strcmp(fn_calls->id->name, "filter") == 0 &&
+                           chain_has_function(fn_calls->prev, "lines")) {
+                        // Already applied to the raw line by lines()
+                } else if (strcmp(fn_calls->id->name, "sort") == 0 &&
+                           chain_has_function(fn_calls->prev, "lines") &&
+                           !chain_has_function(fn_calls->prev, "columns") &&
+                           !chain_has_function(fn_calls->prev, "byIndex") &&
+                           !chain_has_function(fn_calls->prev, "group") &&
+                           !chain_has_function(fn_calls->prev, "join") &&
+                           !chain_has_function(fn_calls->prev, "top") &&
+                           !chain_has_function(fn_calls->prev, "longest") &&
+                           !chain_has_function(fn_calls->prev, "distinct") &&
+                           !chain_has_function(fn_calls->prev, "uniq")) {
+                        // Records already sorted by lines()
+                } else if (strcmp(fn_calls->id->name, "sort") == 0) {
+                        LogError("sort() not implemented there. "
+                                 "Use it on lines: lines().sort(...)");
+                        return false;
+                } else if (strcmp(fn_calls->id->name, "group") == 0 &&
+                           fn_calls->prev != NULL &&
+                           strcmp(fn_calls->prev->id->name, "lines") == 0 &&
+                           fn_calls->prev->prev == NULL) {
+                        // Records already grouped by lines()
+                } else if (strcmp(fn_calls->id->name, "group") == 0) {
+                        LogError("group() not implemented there. "
+                                 "Use it right after lines: "
+                                 "lines().group(...)");
+                        return false;
+                } else if (find_top(fn_calls) == fn_calls &&
+                           fn_calls->prev != NULL &&
+                           strcmp(fn_calls->prev->id->name, "lines") == 0 &&
+                           fn_calls->prev->prev == NULL) {
+                        // Records already ranked by lines()
+                } else if (find_top(fn_calls) == fn_calls) {
+                        LogError("%s() not implemented there. "
+                                 "Use it right after lines: "
+                                 "lines().%s(...)",
+                                 fn_calls->id->name, fn_calls->id->name);
+                        return false;
+                } else if (strcmp(fn_calls->id->name, "join") == 0 &&
+                           fn_calls->prev != NULL &&
+                           strcmp(fn_calls->prev->id->name, "lines") == 0 &&
+                           fn_calls->prev->prev == NULL) {
+                        // Records already joined by lines()
+                } else if (strcmp(fn_calls->id->name, "join") == 0) {
+                        LogError("join() not implemented there. "
+                                 "Use it right after lines: "
+                                 "lines().join(...)");
+                        return false;
+                } else if ((strcmp(fn_calls->id->name, "distinct") == 0 ||
+                            strcmp(fn_calls->id->name, "uniq") == 0) &&
+                           chain_has_function(fn_calls->prev, "lines") &&
+                           !chain_has_function(fn_calls->prev, "columns") &&
+                           !chain_has_function(fn_calls->prev, "byIndex") &&
+                           !chain_has_function(fn_calls->prev, "group") &&
+                           !chain_has_function(fn_calls->prev, "top") &&
+                           !chain_has_function(fn_calls->prev, "longest")) {
+                        // Lines already tested by lines()
+                } else if (strcmp(fn_calls->id->name, "distinct") == 0 ||
+                           strcmp(fn_calls->id->name, "uniq") == 0) {
+                        LogError("%s() not implemented there. "
+                                 "Use it on lines: lines().%s(...)",
+                                 fn_calls->id->name, fn_calls->id->name);
+                        return false;
+                } else if (strcmp(fn_calls->id->name, "filter") == 0) {
+                        long line = variable_register(
+                                program, loop->var->name, REGISTER_BUFFER);
+                        long len = variable_register(
+                                program, "_line_len_implementation",
+                                REGISTER_NUMBER);
+                        if (line < 0 || len < 0)
+                                return false;
+
+                        emit_instruction(program, OP_REWIND, file, 0, 0, 0);
+
+                        open_block(program, BLOCK_WHILE, 0);
+                        add_exit(emit_instruction(program,
+                                                  OP_JUMP_IF_NOT_POSITIVE, len,
+                                                  0, 0, 0));
+                        emit_instruction(program, OP_LINES, file, line, 0, 0);
+                        emit_instruction(program, OP_STORE_ACC, len, 0, 0, 0);
+
+                        open_block(program, BLOCK_IF, 0);
+                        add_exit(emit_instruction(
+                                program, OP_JUMP_IF_NOT_IN_STRING, line,
+                                add_literal_constant(
+                                        program, fn_calls->args->exprs[0]
+                                                         ->var->value.string),
+                                0, 0));
+                } else {
+                        LogError("Not implemented for function: %s\n"
+                                 "\tFunction: %s",
+                                 fn_calls->id->name, __func__);
+                        return false;
+                }
+
+                fn_calls = fn_calls->prev;
+                concat_functions--;
+        }
+
+        if (loop_action_compiled == false &&
+            !compile_expression(program, loop->action, working_filename))
+                return false;
+
+        /* Everything but the loop over the files */
+        close_blocks(program, depth + 1);
+        emit_instruction(program, OP_RELEASE_FILE, file, working, 0, 0);
+        /* group() or top() already read every file of the folder */
+        if (grouped)
+                add_break(emit_instruction(program, OP_JUMP, 0, 0, 0, 0));
+        close_block(program);
+
+        return true;
+}
+
+/* lines().byIndex(...): reads the rows asked for into the loop variable */
+static bool compile_lines_byIndex(bytecode_program *program, node_loop *loop,
+                                  node_function_call *by_index, long file,
+                                  long line_len)
+{
+        node_expression *arg = by_index->args->exprs[0];
+        long line = lookup_register(loop->var->name);
+        long row = new_register(program, REGISTER_NUMBER);
+
+        switch (arg->type) {
+        case EXPRESSION_VARIABLE:
+        case EXPRESSION_GRAMMAR_CONSTANT_TYPE: {
+                if (arg->type == EXPRESSION_VARIABLE) {
+                        long index = variable_register(
+                                program, arg->var->name, REGISTER_NUMBER);
+                        if (index < 0)
+                                return false;
+
+                        emit_instruction(program, OP_ADD_INTEGER, row, index,
+                                         1, 0);
+                } else {
+                        emit_instruction(program, OP_LOAD_INTEGER, row,
+                                         (long)arg->var->value.number, 0, 0);
+                }
+
+                emit_instruction(program, OP_LINE_BY_NUMBER, file, line, row,
+                                 0);
+                emit_instruction(program, OP_STORE_ACC, line_len, 0, 0, 0);
+
+                size_t not_found = emit_instruction(
+                        program, OP_JUMP_IF_NOT_POSITIVE, line_len, 0, 0, 0);
+                size_t null_line = emit_instruction(program, OP_JUMP_IF_NULL,
+                                                    line, 0, 0, 0);
+                size_t found = emit_instruction(program, OP_JUMP, 0, 0, 0, 0);
+
+                patch_jump(program, not_found, program->n_instructions);
+                patch_jump(program, null_line, program->n_instructions);
+                emit_instruction(program, OP_MISSING_LINE, row, 0, 0, 0);
+                emit_instruction(program, OP_RETURN, 1, 0, 0, 0);
+
+                patch_jump(program, found, program->n_instructions);
+                break;
+        }
+        case EXPRESSION_LIST: {
+                long index = variable_register(program,
+                                               "_byIndex_implementation",
+                                               REGISTER_NUMBER);
+                if (index < 0)
+                        return false;
+
+                if (arg->list_expr->type == LIST_RANGE_TYPE) {
+                        emit_instruction(program, OP_LINES, file, line, 0, 0);
+                        emit_instruction(program, OP_STORE_ACC, line_len, 0, 0,
+                                         0);
+
+                        size_t not_found =
+                                emit_instruction(program,
+                                                 OP_JUMP_IF_NOT_POSITIVE,
+                                                 line_len, 0, 0, 0);
+                        size_t null_line = emit_instruction(
+                                program, OP_JUMP_IF_NULL, line, 0, 0, 0);
+                        size_t found =
+                                emit_instruction(program, OP_JUMP, 0, 0, 0, 0);
+
+                        patch_jump(program, not_found,
+                                   program->n_instructions);
+                        patch_jump(program, null_line,
+                                   program->n_instructions);
+                        emit_instruction(program, OP_ADD_INTEGER, row, index,
+                                         1, 0);
+                        emit_instruction(program, OP_MISSING_LINE, row, 0, 0,
+                                         0);
+                        if (!add_break(emit_instruction(program, OP_JUMP, 0, 0,
+                                                        0, 0)))
+                                return false;
+
+                        patch_jump(program, found, program->n_instructions);
+                } else {
+                        // Rows already read by lines_by_numbers()
+                        long slots = variable_register(
+                                program, "_byIndex_slots_implementation",
+                                REGISTER_SLOTS);
+                        if (slots < 0)
+                                return false;
+
+                        emit_instruction(program, OP_LOAD_SLOT, line, slots,
+                                         index,
+                                         blocks[n_blocks - 1].epilogue.b);
+                        if (!add_continue(emit_instruction(
+                                    program, OP_JUMP_IF_ACC_NOT_POSITIVE, 0, 0,
+                                    0, 0)))
+                                return false;
+                }
+                break;
+        }
+        default:
+                error_invalid_byIndex_argument();
+                return false;
+        }
+
+        return true;
+}
+
+/* columns().lines(): runs the loop action once per cell */
+static bool compile_columns(bytecode_program *program, node_loop *loop,
+                            node_function_call *fn_calls, long file,
+                            long line_len, const char *working_filename)
+{
+        if (line_len < 0 || !compile_column_set(program, fn_calls, file))
+                return false;
+
+        long remaining = -1;
+
+        if (fn_calls->next->next != NULL &&
+            strcmp(fn_calls->next->next->id->name, "byIndex") == 0) {
+                long line = variable_register(program, loop->var->name,
+                                              REGISTER_BUFFER);
+                if (line < 0)
+                        return false;
+
+                remaining = declare_register(
+                        program, "_columns_remaining_implementation",
+                        REGISTER_NUMBER);
+                emit_instruction(program, OP_MOVE, remaining, line, 0, 0);
+        } else {
+                long line = declare_register(program, "_line_line",
+                                             REGISTER_BUFFER);
+                emit_instruction(program, OP_NEW_BUFFER, line, 0, 0, 0);
+
+                open_block(program, BLOCK_WHILE, 0);
+                add_exit(emit_instruction(program, OP_JUMP_IF_NOT_POSITIVE,
+                                          line_len, 0, 0, 0));
+                emit_instruction(program, OP_RECORDS, file, line, 0, 0);
+                emit_instruction(program, OP_STORE_ACC, line_len, 0, 0, 0);
+                add_break(emit_instruction(program, OP_JUMP_IF_NOT_POSITIVE,
+                                           line_len, 0, 0, 0));
+                add_break(emit_instruction(program, OP_JUMP_IF_NULL, line, 0,
+                                           0, 0));
+
+                // Predicate pushdown: discard lines on the raw buffer, so
+                // that only surviving lines are split
+                compile_line_predicates(program, fn_calls->next, line);
+                compile_cell_filter_pushdown(program, loop, line);
+
+                remaining = declare_register(
+                        program, "_columns_remaining_implementation",
+                        REGISTER_NUMBER);
+                emit_instruction(program, OP_MOVE, remaining, line, 0, 0);
+        }
+
+        long columns_len = declare_register(program,
+                                            "_columns_len_implementation",
+                                            REGISTER_NUMBER);
+        emit_instruction(program, OP_LOAD_INTEGER, columns_len, BUFFER_SIZE,
+                         0, 0);
+        long cell = new_register(program, REGISTER_BUFFER);
+        emit_instruction(program, OP_NEW_BUFFER, cell, 0, 0, 0);
+
+        open_block(program, BLOCK_WHILE, 0);
+        add_exit(emit_instruction(program, OP_JUMP_IF_NULL, remaining, 0, 0,
+                                  0));
+
+        long separator = declare_register(
+                program, "_columns_separator_char_implementation",
+                REGISTER_NUMBER);
+        emit_instruction(program, OP_LOAD_INTEGER, separator, 0, 0, 0);
+        emit_instruction(program, OP_COLUMNS, remaining, file, cell,
+                         separator);
+        emit_instruction(program, OP_STORE_ACC, columns_len, 0, 0, 0);
+
+        open_block(program, BLOCK_IF, 0);
+        add_exit(emit_instruction(program, OP_JUMP_IF_NULL, cell, 0, 0, 0));
+        add_exit(emit_instruction(program, OP_JUMP_IF_ACC_NOT_POSITIVE, 0, 0,
+                                  0, 0));
+
+        // The loop variable is the cell inside the action
+        bind_register(loop->var->name, cell);
+
+        columns_loop_variable = loop->var;
+        columns_loop_file = file;
+        bool action_compiled =
+                compile_expression(program, loop->action, working_filename);
+        columns_loop_variable = NULL;
+        columns_loop_file = -1;
+        if (!action_compiled)
+                return false;
+
+        long output = variable_register(program, "output", REGISTER_OBJECT);
+        if (output < 0)
+                return false;
+
+        size_t no_separator = emit_instruction(program, OP_JUMP_IF_ZERO,
+                                               separator, 0, 0, 0);
+        emit_instruction(program, OP_WRITE_CHARACTER, separator, output, 0,
+                         0);
+        patch_jump(program, no_separator, program->n_instructions);
+
+        return true;
+}
+
+/*
+ * byIndex([7, 2, 5, 2]) is compiled into a sorted, deduplicated row set
+ * (2, 5, 7) that lines_by_numbers() reads in a single forward pass, plus the
+ * order in which the user asked for them (2, 0, 1, 0).
+ * Opens the loop over the requested rows.
+ */
+static bool compile_byIndex_row_set(bytecode_program *program, node_list *rows,
+                                    long file)
+{
+        if (rows == NULL || rows->type != LIST_EXPRESSION_TYPE ||
+            rows->len == 0) {
+                error_invalid_byIndex_argument();
+                return false;
+        }
+
+        unsigned long *requested =
+                (unsigned long *)calloc(rows->len, sizeof(unsigned long));
+        unsigned long *sorted =
+                (unsigned long *)calloc(rows->len, sizeof(unsigned long));
+        size_t *order = (size_t *)calloc(rows->len, sizeof(size_t));
+        if (requested == NULL || sorted == NULL || order == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+
+        for (size_t i = 0; i < rows->len; i++) {
+                node_expression *row = rows->exprs[i];
+                if (row == NULL ||
+                    row->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+                    row->var->type != NUMBER_TYPE ||
+                    row->var->value.number < 1) {
+                        error_invalid_byIndex_argument();
+                        free(requested);
+                        free(sorted);
+                        free(order);
+                        return false;
+                }
+
+                requested[i] = (unsigned long)row->var->value.number;
+                sorted[i] = requested[i];
+        }
+
+        qsort(sorted, rows->len, sizeof(unsigned long), compare_rows);
+
+        size_t n_unique = 0;
+        for (size_t i = 0; i < rows->len; i++) {
+                if (n_unique == 0 || sorted[n_unique - 1] != sorted[i])
+                        sorted[n_unique++] = sorted[i];
+        }
+
+        for (size_t i = 0; i < rows->len; i++) {
+                unsigned long *slot = (unsigned long *)bsearch(
+                        &requested[i], sorted, n_unique, sizeof(unsigned long),
+                        compare_rows);
+                order[i] = slot - sorted;
+        }
+        free(requested);
+
+        long row_set = add_rows_constant(program, sorted, n_unique, order,
+                                         rows->len);
+
+        long slots = declare_register(program, "_byIndex_slots_implementation",
+                                      REGISTER_SLOTS);
+        emit_instruction(program, OP_LINES_BY_NUMBERS, slots, file, row_set,
+                         0);
+
+        long index = new_register(program, REGISTER_NUMBER);
+        emit_instruction(program, OP_LOAD_INTEGER, index, 0, 0, 0);
+
+        open_block(program, BLOCK_FOR, index);
+        bind_register("_byIndex_implementation", index);
+        add_exit(emit_instruction(program, OP_JUMP_IF_NOT_LESS, index,
+                                  rows->len, 0, 0));
+
+        /* The rows read are freed once the loop is done */
+        blocks[n_blocks - 1].has_epilogue = true;
+        blocks[n_blocks - 1].epilogue = (bytecode_instruction){
+                .op = OP_FREE_SLOTS, .a = slots, .b = row_set
+        };
+
+        return true;
+}
+
+/*
+ * columns(2, [7, 5], [1..3]) reads columns 1, 2, 3, 5 and 7 of each line
+ * only. The sorted, deduplicated set is handed to project_columns().
+ */
+static bool compile_column_set(bytecode_program *program,
+                               node_function_call *columns, long file)
+{
+        size_t n_columns = 0;
+        unsigned long *set = NULL;
+
+        for (size_t i = 0; columns->args != NULL && i < columns->args->len;
+             i++) {
+                node_expression *arg = columns->args->exprs[i];
+                node_list *list = NULL;
+                size_t n_new = 1;
+
+                if (arg != NULL && arg->type == EXPRESSION_LIST &&
+                    arg->list_expr != NULL &&
+                    (arg->list_expr->type != LIST_RANGE_TYPE ||
+                     arg->list_expr->from >= 1)) {
+                        list = arg->list_expr;
+                        n_new = list->type == LIST_RANGE_TYPE ?
+                                        (size_t)(list->to - list->from + 1) :
+                                        list->len;
+                } else if (arg == NULL ||
+                           arg->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE) {
+                        error_invalid_columns_argument();
+                        free(set);
+                        return false;
+                }
+
+                unsigned long *expanded = (unsigned long *)realloc(
+                        set, (n_columns + n_new) * sizeof(unsigned long));
+                if (expanded == NULL) {
+                        error_no_memory();
+                        exit(1);
+                }
+                set = expanded;
+
+                for (size_t j = 0; j < n_new; j++) {
+                        if (list != NULL && list->type == LIST_RANGE_TYPE) {
+                                set[n_columns++] = list->from + j;
+                                continue;
+                        }
+
+                        node_expression *column =
+                                list == NULL ? arg : list->exprs[j];
+                        if (column == NULL ||
+                            column->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+                            column->var->type != NUMBER_TYPE ||
+                            column->var->value.number < 1) {
+                                error_invalid_columns_argument();
+                                free(set);
+                                return false;
+                        }
+                        set[n_columns++] =
+                                (unsigned long)column->var->value.number;
+                }
+        }
+
+        if (n_columns == 0) {
+                free(set);
+                emit_instruction(program, OP_PROJECT_COLUMNS, file, -1, 0, 0);
+                return true;
+        }
+
+        qsort(set, n_columns, sizeof(unsigned long), compare_rows);
+
+        size_t n_unique = 0;
+        for (size_t i = 0; i < n_columns; i++) {
+                if (n_unique == 0 || set[n_unique - 1] != set[i])
+                        set[n_unique++] = set[i];
+        }
+
+        long column_set = add_rows_constant(program, set, n_unique, NULL, 0);
+        emit_instruction(program, OP_PROJECT_COLUMNS, file, column_set, 0, 0);
+
+        return true;
+}
+
+static bool chain_has_function(node_function_call *fn_calls, const char *name)
+{
+        for (; fn_calls != NULL; fn_calls = fn_calls->prev) {
+                if (strcmp(fn_calls->id->name, name) == 0)
+                        return true;
+        }
+
+        return false;
+}
+
+static node_function_call *find_next_function(node_function_call *fn_calls,
+                                              const char *name)
+{
+        for (; fn_calls != NULL; fn_calls = fn_calls->next) {
+                if (strcmp(fn_calls->id->name, name) == 0)
+                        return fn_calls;
+        }
+
+        return NULL;
+}
+
+/* sort(column, numeric|lexical, asc|desc), as code-generator.c reads it */
+static bool sort_arguments(node_function_call *sort, unsigned long *column,
+                           bool *numeric, bool *descending)
+{
+        node_list *args = sort->args;
+
+        if (args == NULL || args->len == 0 || args->len > 3 ||
+            args->exprs[0]->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+            args->exprs[0]->var->type != NUMBER_TYPE ||
+            args->exprs[0]->var->value.number < 1) {
+                error_invalid_sort_argument();
+                return false;
+        }
+        *column = (unsigned long)args->exprs[0]->var->value.number;
+
+        for (size_t i = 1; i < args->len; i++) {
+                node_expression *arg = args->exprs[i];
+                const char *option =
+                        arg->type == EXPRESSION_VARIABLE ? arg->var->name : "";
+
+                if (i == 1 && strcmp(option, "numeric") == 0) {
+                        *numeric = true;
+                } else if (i == 1 && strcmp(option, "lexical") == 0) {
+                        *numeric = false;
+                } else if (strcmp(option, "desc") == 0) {
+                        *descending = true;
+                } else if (strcmp(option, "asc") == 0) {
+                        *descending = false;
+                } else {
+                        error_invalid_sort_argument();
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/*
+ * join(other, column, other_column, inner|left), as code-generator.c reads
+ * it. Both columns go in one operand, so they must fit in 31 bits.
+ */
+static bool join_arguments(node_function_call *join, const char **other,
+                           unsigned long *column, unsigned long *other_column,
+                           bool *left)
+{
+        node_list *args = join->args;
+
+        if (args == NULL || args->len < 3 || args->len > 4 ||
+            args->exprs[0]->type != EXPRESSION_VARIABLE ||
+            args->exprs[0]->var->type != FILE_PATH_TYPE ||
+            strstr(args->exprs[0]->var->name, "input") !=
+                    args->exprs[0]->var->name) {
+                error_invalid_join_argument();
+                return false;
+        }
+        *other = args->exprs[0]->var->name;
+
+        for (size_t i = 1; i < 3; i++) {
+                node_expression *arg = args->exprs[i];
+                if (arg->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+                    arg->var->type != NUMBER_TYPE ||
+                    arg->var->value.number < 1 ||
+                    arg->var->value.number >= 1UL << 31) {
+                        error_invalid_join_argument();
+                        return false;
+                }
+        }
+        *column = (unsigned long)args->exprs[1]->var->value.number;
+        *other_column = (unsigned long)args->exprs[2]->var->value.number;
+
+        *left = false;
+        if (args->len == 4) {
+                node_expression *arg = args->exprs[3];
+                const char *option =
+                        arg->type == EXPRESSION_VARIABLE ? arg->var->name : "";
+
+                if (strcmp(option, "left") == 0) {
+                        *left = true;
+                } else if (strcmp(option, "inner") != 0) {
+                        error_invalid_join_argument();
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/* group(column, aggregates...), as code-generator.c reads it */
+static texler_aggregate *group_arguments(node_function_call *group,
+                                         unsigned long *column,
+                                         size_t *n_aggregates)
+{
+        node_list *args = group->args;
+        size_t n_names = sizeof(group_aggregates) / sizeof(*group_aggregates);
+
+        if (args == NULL || args->len == 0 ||
+            args->exprs[0]->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+            args->exprs[0]->var->type != NUMBER_TYPE ||
+            args->exprs[0]->var->value.number < 1) {
+                error_invalid_group_argument();
+                return NULL;
+        }
+        *column = (unsigned long)args->exprs[0]->var->value.number;
+
+        texler_aggregate *aggregates = (texler_aggregate *)calloc(
+                args->len, sizeof(texler_aggregate));
+        if (aggregates == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+
+        *n_aggregates = 0;
+        for (size_t i = 1; i < args->len; i++) {
+                node_expression *arg = args->exprs[i];
+                const char *name =
+                        arg->type == EXPRESSION_VARIABLE ? arg->var->name : "";
+                texler_aggregate *aggregate = &aggregates[(*n_aggregates)++];
+
+                size_t j = 0;
+                while (j < n_names && strcmp(name, group_aggregates[j].name))
+                        j++;
+                if (j == n_names) {
+                        error_invalid_group_argument();
+                        free(aggregates);
+                        return NULL;
+                }
+                aggregate->type = group_aggregates[j].type;
+                if (aggregate->type == TEXLER_AGGREGATE_COUNT)
+                        continue;
+
+                node_expression *value = ++i < args->len ? args->exprs[i] :
+                                                            NULL;
+                if (value == NULL ||
+                    value->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+                    value->var->type != NUMBER_TYPE ||
+                    value->var->value.number < 1) {
+                        error_invalid_group_argument();
+                        free(aggregates);
+                        return NULL;
+                }
+                aggregate->column = (unsigned long)value->var->value.number;
+        }
+
+        return aggregates;
+}
+
+static int compare_rows(const void *a, const void *b)
+{
+        unsigned long left = *(const unsigned long *)a;
+        unsigned long right = *(const unsigned long *)b;
+
+        return (left > right) - (left < right);
+}
+
+/* top() or longest() of the chain, from fn_calls on */
+static node_function_call *find_top(node_function_call *fn_calls)
+{
+        for (; fn_calls != NULL; fn_calls = fn_calls->next) {
+                if (strcmp(fn_calls->id->name, "top") == 0 ||
+                    strcmp(fn_calls->id->name, "longest") == 0)
+                        return fn_calls;
+        }
+
+        return NULL;
+}
+
+/* top(k, column) or longest(k), as code-generator.c reads them */
+static bool top_arguments(node_function_call *top, unsigned long *k,
+                          unsigned long *column)
+{
+        node_list *args = top->args;
+        bool longest = strcmp(top->id->name, "longest") == 0;
+        size_t n_args = args == NULL ? 0 : args->len;
+
+        *k = 1;
+        *column = 0;
+        if (longest ? n_args > 1 : n_args != 2) {
+                error_invalid_top_argument(top->id->name);
+                return false;
+        }
+
+        for (size_t i = 0; i < n_args; i++) {
+                node_expression *arg = args->exprs[i];
+                if (arg->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+                    arg->var->type != NUMBER_TYPE ||
+                    arg->var->value.number < 1) {
+                        error_invalid_top_argument(top->id->name);
+                        return false;
+                }
+                *(i == 0 ? k : column) =
+                        (unsigned long)arg->var->value.number;
+        }
+
+        return true;
+}
+
+/* distinct() or uniq() of the chain, from fn_calls on */
+static node_function_call *find_distinct(node_function_call *fn_calls)
+{
+        for (; fn_calls != NULL; fn_calls = fn_calls->next) {
+                if (strcmp(fn_calls->id->name, "distinct") == 0 ||
+                    strcmp(fn_calls->id->name, "uniq") == 0)
+                        return fn_calls;
+        }
+
+        return NULL;
+}
+
+/*
+ * distinct(column) or uniq(column), as code-generator.c reads it: the keys
+ * of 'file' seen so far, in _distinct_implementation. Returns its register,
+ * -1 if an argument is invalid.
+ */
+static long compile_distinct(bytecode_program *program,
+                             node_function_call *fn_calls, long file)
+{
+        node_function_call *distinct = find_distinct(fn_calls);
+        node_list *args = distinct->args;
+        unsigned long column = 0;
+
+        if (find_distinct(distinct->next) != NULL) {
+                LogError("Only one distinct() or uniq() per chain");
+                return -1;
+        }
+
+        if (args != NULL && args->len > 0) {
+                if (args->len > 1 ||
+                    args->exprs[0]->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE ||
+                    args->exprs[0]->var->type != NUMBER_TYPE ||
+                    args->exprs[0]->var->value.number < 1) {
+                        error_invalid_distinct_argument(distinct->id->name);
+                        return -1;
+                }
+                column = (unsigned long)args->exprs[0]->var->value.number;
+        }
+
+        long reg = declare_register(program, "_distinct_implementation",
+                                    REGISTER_DISTINCT);
+        emit_instruction(program, OP_NEW_DISTINCT, reg, file, column,
+                         strcmp(distinct->id->name, "uniq") == 0);
+
+        return reg;
+}
+
+/*
+ * Line-level predicates of the chain (filter, distinct) are tested on the
+ * raw line, in the order of the chain, before any column splitting or
+ * per-cell work.
+ * Must be compiled inside the loop that reads 'line'.
+ */
+static void compile_line_predicates(bytecode_program *program,
+                                    node_function_call *fn_calls, long line)
+{
+        for (; fn_calls != NULL; fn_calls = fn_calls->next) {
+                // Only lines() chains declare _distinct_implementation
+                if (find_distinct(fn_calls) == fn_calls &&
+                    chain_has_function(fn_calls->prev, "lines")) {
+                        add_continue(emit_instruction(
+                                program, OP_JUMP_IF_NOT_DISTINCT,
+                                lookup_register("_distinct_implementation"),
+                                line, 0, 0));
+                        continue;
+                }
+
+                if (strcmp(fn_calls->id->name, "filter") != 0 ||
+                    fn_calls->args == NULL || fn_calls->args->len == 0)
+                        continue;
+
+                add_continue(emit_instruction(
+                        program, OP_JUMP_IF_NOT_IN_STRING, line,
+                        add_literal_constant(
+                                program,
+                                fn_calls->args->exprs[0]->var->value.string),
+                        0, 0));
+        }
+}
+
+/*
+ * A body like 'cell.filter("x") -> output.' only writes cells containing "x".
+ * A line can only have such a cell if the line itself contains "x", so lines
+ * without it are skipped before splitting.
+ */
+static void compile_cell_filter_pushdown(bytecode_program *program,
+                                         node_loop *loop, long line)
+{
+        node_expression *action = loop->action;
+
+        if (action == NULL || action->type != EXPRESSION_VARIABLE_ASSIGNMENT ||
+            action->expr == NULL ||
+            action->expr->type != EXPRESSION_FUNCTION_CALL)
+                return;
+
+        node_function_call *fn_calls = action->expr->fun_call;
+        if (fn_calls == NULL || fn_calls->id != loop->var)
+                return;
+
+        compile_line_predicates(program, fn_calls->next, line);
+}
+
+/* Object holding a constant of the condition (_constant_number_if) */
+static long compile_condition_operand(bytecode_program *program,
+                                      node_expression *operand)
+{
+        if (operand->type != EXPRESSION_GRAMMAR_CONSTANT_TYPE)
+                return lookup_register(operand->var->name);
+
+        long reg = declare_register(program, "_constant_number_if",
+                                    REGISTER_OBJECT);
+        emit_instruction(program, OP_NEW_OBJECT, reg, 0, 0, 0);
+
+        switch (operand->var->type) {
+        case NUMBER_TYPE:
+                emit_instruction(
+                        program, OP_SET_REAL, reg,
+                        add_number_constant(program,
+                                            operand->var->value.number),
+                        0, 0);
+                break;
+        case BOOL_TYPE:
+                emit_instruction(program, OP_SET_BOOLEAN, reg,
+                                 operand->var->value.boolean, 0, 0);
+                break;
+        case STRING_TYPE:
+                emit_instruction(program, OP_SET_STRING, reg,
+                                 add_literal_constant(
+                                         program, operand->var->value.string),
+                                 0, 0);
+                break;
+        default:
+                break;
+        }
+
+        return reg;
+}
+
+static bool compile_conditional(bytecode_program *program,
+                                node_conditional *conditional,
+                                const char *working_filename)
+{
+        node_expression *left = conditional->condition->left;
+        node_expression *right = conditional->condition->right;
+        long constants[2] = { -1, -1 };
+        size_t to_else = 0;
+
+        switch (conditional->condition->type) {
+        case EXPRESSION_VARIABLE_TYPE_COMPARISON: {
+                if (conditional->condition->compare_type != NUMBER_TYPE) {
+                        LogError("Type comparison not implemented for "
+                                 "this type (%ld)",
+                                 conditional->condition->compare_type);
+                        return false;
+                }
+
+                long cell = variable_register(
+                        program, conditional->condition->var->name,
+                        REGISTER_BUFFER);
+                if (cell < 0)
+                        return false;
+
+                to_else = emit_instruction(
+                        program, OP_JUMP_IF_NOT_NUMBER, cell,
+                        conditional->condition->var == columns_loop_variable ?
+                                columns_loop_file :
+                                -1,
+                        0, 0);
+                break;
+        }
+        case EXPRESSION_COMPARE_EQUALS:
+        case EXPRESSION_COMPARE_NOT_EQUALS:
+        case EXPRESSION_COMPARE_GREATER_THAN:
+        case EXPRESSION_COMPARE_GREATER_EQUAL:
+        case EXPRESSION_COMPARE_LESS_THAN:
+        case EXPRESSION_COMPARE_LESS_EQUAL: {
+                // Like the generator, every comparison tests equality
+                long left_reg = compile_condition_operand(program, left);
+                if (left->type == EXPRESSION_GRAMMAR_CONSTANT_TYPE)
+                        constants[0] = left_reg;
+
+                long right_reg = compile_condition_operand(program, right);
+                if (right->type == EXPRESSION_GRAMMAR_CONSTANT_TYPE)
+                        constants[1] = right_reg;
+
+                if (left_reg < 0 || right_reg < 0 ||
+                    program->registers[right_reg] != REGISTER_OBJECT) {
+                        LogError("Invalid operands in comparison.");
+                        return false;
+                }
+
+                if (left->var->type == LOOP_VARIABLE_TYPE) {
+                        if (program->registers[left_reg] != REGISTER_NUMBER) {
+                                LogError("Invalid operands in comparison.");
+                                return false;
+                        }
+
+                        long row = new_register(program, REGISTER_NUMBER);
+                        emit_instruction(program, OP_ADD_INTEGER, row,
+                                         left_reg, 1, 0);
+                        to_else = emit_instruction(
+                                program, OP_JUMP_IF_NOT_EQUAL_INTEGER, row,
+                                right_reg, 0, 0);
+                } else {
+                        if (program->registers[left_reg] != REGISTER_OBJECT) {
+                                LogError("Invalid operands in comparison.");
+                                return false;
+                        }
+
+                        to_else = emit_instruction(program,
+                                                   OP_JUMP_IF_NOT_EQUAL,
+                                                   left_reg, right_reg, 0, 0);
+                }
+                break;
+        }
+        default:
+                error_not_supported_by_vm("This condition");
+                return false;
+        }
+
+        if (conditional->true_condition != NULL &&
+            !compile_expression(program, conditional->true_condition,
+                                working_filename))
+                return false;
+
+        size_t to_end = emit_instruction(program, OP_JUMP, 0, 0, 0, 0);
+        patch_jump(program, to_else, program->n_instructions);
+
+        if (conditional->else_condition != NULL &&
+            !compile_expression(program, conditional->else_condition,
+                                working_filename))
+                return false;
+
+        patch_jump(program, to_end, program->n_instructions);
+
+        for (int i = 1; i >= 0; i--) {
+                if (constants[i] >= 0)
+                        emit_instruction(program, OP_FREE_OBJECT,
+                                         constants[i], 0, 0, 0);
+        }
+
+        return true;
+}
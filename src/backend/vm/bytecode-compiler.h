@@ -0,0 +1,11 @@
+#ifndef BYTECODE_COMPILER_H
+#define BYTECODE_COMPILER_H
+
+#include "../../frontend/syntactic-analysis/node.h"
+
+#include "bytecode.h"
+
+/* Returns NULL if the program uses something the VM can not run */
+bytecode_program *compile_bytecode(program_t *ast);
+
+#endif /* BYTECODE_COMPILER_H */
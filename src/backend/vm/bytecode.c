@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../error.h"
+
+#include "bytecode.h"
+
+#define BYTECODE_INITIAL_SIZE 64
+
+static void *grow_array(void *array, size_t *size, size_t element_size)
+{
+        size_t new_size = *size == 0 ? BYTECODE_INITIAL_SIZE : 2 * *size;
+
+        void *aux = realloc(array, new_size * element_size);
+        if (aux == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+
+        *size = new_size;
+        return aux;
+}
+
+bytecode_program *new_bytecode_program()
+{
+        bytecode_program *program =
+                (bytecode_program *)calloc(1, sizeof(bytecode_program));
+        if (program == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+
+        return program;
+}
+
+void free_bytecode_program(bytecode_program *program)
+{
+        if (program == NULL)
+                return;
+
+        for (size_t i = 0; i < program->n_constants; i++) {
+                bytecode_constant *constant = &program->constants[i];
+
+                if (constant->type == CONSTANT_STRING) {
+                        free(constant->string);
+                } else if (constant->type == CONSTANT_ROWS) {
+                        free(constant->rows);
+                        free(constant->order);
+                } else if (constant->type == CONSTANT_AGGREGATES) {
+                        free(constant->aggregates);
+                }
+        }
+
+        free(program->instructions);
+        free(program->constants);
+        free(program->registers);
+        free(program);
+}
+
+size_t emit_instruction(bytecode_program *program, BYTECODE_OPCODE op, long a,
+                        long b, long c, long d)
+{
+        if (program->n_instructions == program->instructions_size) {
+                program->instructions = grow_array(
+                        program->instructions, &program->instructions_size,
+                        sizeof(bytecode_instruction));
+        }
+
+        program->instructions[program->n_instructions] =
+                (bytecode_instruction){
+                        .op = op, .a = a, .b = b, .c = c, .d = d
+                };
+
+        return program->n_instructions++;
+}
+
+void patch_jump(bytecode_program *program, size_t instruction, size_t target)
+{
+        program->instructions[instruction].d = target;
+}
+
+long new_register(bytecode_program *program, BYTECODE_REGISTER type)
+{
+        if (program->n_registers == program->registers_size) {
+                program->registers = grow_array(program->registers,
+                                                &program->registers_size,
+                                                sizeof(BYTECODE_REGISTER));
+        }
+
+        program->registers[program->n_registers] = type;
+
+        return program->n_registers++;
+}
+
+static long add_constant(bytecode_program *program,
+                         const bytecode_constant *constant)
+{
+        if (program->n_constants == program->constants_size) {
+                program->constants =
+                        grow_array(program->constants,
+                                   &program->constants_size,
+                                   sizeof(bytecode_constant));
+        }
+
+        program->constants[program->n_constants] = *constant;
+
+        return program->n_constants++;
+}
+
+long add_string_constant(bytecode_program *program, const char *string,
+                         size_t length)
+{
+        bytecode_constant constant = { .type = CONSTANT_STRING,
+                                       .string = strdup(string),
+                                       .length = length };
+        if (constant.string == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+
+        return add_constant(program, &constant);
+}
+
+long add_real_constant(bytecode_program *program, double real)
+{
+        bytecode_constant constant = { .type = CONSTANT_REAL, .real = real };
+
+        return add_constant(program, &constant);
+}
+
+/* Takes ownership of 'rows' and 'order' */
+long add_rows_constant(bytecode_program *program, unsigned long *rows,
+                       size_t n_rows, size_t *order, size_t n_order)
+{
+        bytecode_constant constant = { .type = CONSTANT_ROWS,
+                                       .rows = rows,
+                                       .n_rows = n_rows,
+                                       .order = order,
+                                       .n_order = n_order };
+
+        return add_constant(program, &constant);
+}
+
+/* Takes ownership of 'aggregates' */
+long add_aggregates_constant(bytecode_program *program,
+                             struct texler_aggregate *aggregates,
+                             size_t n_aggregates)
+{
+        bytecode_constant constant = { .type = CONSTANT_AGGREGATES,
+                                       .aggregates = aggregates,
+                                       .n_aggregates = n_aggregates };
+
+        return add_constant(program, &constant);
+}
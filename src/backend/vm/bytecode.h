@@ -0,0 +1,206 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stddef.h>
+
+/*
+ * Register bytecode run by the texler virtual machine (vm.h).
+ *
+ * Instructions have up to four operands: registers (R), constants (K, index
+ * in the constant pool) or immediates. Conditional jumps keep their target
+ * in 'd'. Runtime calls whose result is tested right away (lines(),
+ * columns(), at(), ...) leave it in the accumulator (acc).
+ *
+ * Each opcode does what one statement of the C generated by
+ * code-generator.c does, calling the same libtexlerrt functions, so both
+ * backends produce the same output.
+ */
+
+typedef enum BYTECODE_OPCODE {
+        /* Objects */
+        OP_NEW_OBJECT = 0, /* R[a] = new TexlerObject */
+        OP_FREE_OBJECT, /* free_texlerobject(R[a]) */
+        OP_SET_REAL, /* R[a] = K[b] */
+        OP_SET_BOOLEAN, /* R[a] = b */
+        OP_SET_STRING, /* R[a] = copy of K[b] */
+        OP_LOAD_ARGUMENT, /* R[a] = atof(argv[b]) */
+        OP_COPY_OBJECT, /* *R[a] = *R[b] */
+        OP_COPY_BUFFER, /* R[a]->string = copy of buffer R[b] */
+        OP_TO_STRING, /* R[a]->string = toString(R[b]) */
+        OP_APPEND_BUFFER, /* R[a]->string += buffer R[b] */
+        OP_APPEND_CONSTANT, /* R[a]->string += K[b] */
+        OP_AT, /* acc = at(R[a]->string, b), stops with 1 if out of range */
+        OP_SET_CHARACTER, /* R[a]->string = acc */
+        OP_NEW_BUFFER, /* R[a] = new line buffer */
+        OP_MOVE, /* R[a] = R[b] */
+
+        /* Files */
+        OP_OPEN_READ, /* open K[b] in R[a], separators K[c], variable K[d] */
+        OP_OPEN_WRITE, /* same as OP_OPEN_READ, for writing */
+        OP_OPEN_DIRECTORY, /* R[a] = files in K[b], separators K[c],
+                              variable K[d] */
+        OP_OPEN_TEMPORARY, /* R[a] = tmpfile() */
+        OP_OPEN_STDOUT, /* R[a] = stdout, variable K[d] */
+        OP_NEXT_FILE, /* R[a] = get_next_file(R[b]), goto d if NULL */
+        OP_RELEASE_FILE, /* frees R[a] if get_next_file(R[b]) allocated it */
+        OP_REWIND, /* rewind(R[a]) */
+        OP_SEEK_LINE, /* seek_line(R[a], b) */
+        OP_LINES, /* acc = lines(R[a], &R[b]) */
+        OP_RECORDS, /* acc = records(R[a], &R[b]) */
+        OP_LINE_BY_NUMBER, /* acc = line_by_number(R[a], &R[b], R[c]) */
+        OP_LINES_BY_NUMBERS, /* R[a] = lines_by_numbers(R[b], rows K[c]) */
+        OP_LOAD_SLOT, /* R[a] = copy of slot R[c] of R[b] (rows K[d]) */
+        OP_FREE_SLOTS, /* frees the slots R[a] of rows K[b] */
+        OP_PROJECT_COLUMNS, /* project_columns(R[a], columns K[b]), all
+                               of them if b is -1 */
+        OP_COLUMNS, /* acc = file_columns(R[b], &R[a], &R[c], &R[d]) */
+        OP_STRIP_NEWLINE, /* removes the '\n' of R[a], R[b] = it had one */
+        OP_SORT_RECORDS, /* R[a] = sort_records(R[b], c, d & 1 numeric,
+                            d & 2 descending), stops with 1 on error */
+        OP_SORTED_RECORDS, /* acc = sorted_records(R[a], &R[b]) */
+        OP_FREE_SORT, /* free_sort(R[a]) */
+        OP_GROUP_RECORDS, /* R[a] = group_records(R[b], c, aggregates K[d]),
+                             stops with 1 on error */
+        OP_GROUPED_RECORDS, /* acc = grouped_records(R[a], &R[b]) */
+        OP_FREE_GROUP, /* free_group(R[a]) */
+        OP_NEW_DISTINCT, /* R[a] = new_distinct(R[b], c, d consecutive),
+                            stops with 1 on error */
+        OP_FREE_DISTINCT, /* free_distinct(R[a]) */
+        OP_JOIN_RECORDS, /* R[a] = join_records(R[b], R[c], d >> 32,
+                            d >> 1 & 0x7fffffff, d & 1 left), stops with 1
+                            on error */
+        OP_JOINED_RECORDS, /* acc = joined_records(R[a], &R[b]) */
+        OP_FREE_JOIN, /* free_join(R[a]) */
+        OP_TOP_RECORDS, /* R[a] = top_records(R[b], c, d), stops with 1 on
+                           error */
+        OP_RANKED_RECORDS, /* acc = ranked_records(R[a], &R[b]) */
+        OP_FREE_TOP, /* free_top(R[a]) */
+
+        /* Output */
+        OP_WRITE_CONSTANT, /* writes K[a] to R[b] */
+        OP_WRITE_BUFFER, /* writes buffer R[a] to R[b] */
+        OP_WRITE_STRING, /* writes R[a]->string to R[b] */
+        OP_WRITE_TO_STRING, /* writes toString(R[a]) to R[b] */
+        OP_WRITE_REAL, /* writes R[a] to R[b] ("%f") */
+        OP_WRITE_CHARACTER, /* writes character R[a] to R[b] */
+        OP_WRITE_ACC, /* writes character acc to R[a] */
+        OP_COPY_FILE, /* copy_file_content(R[a], R[b]) */
+        OP_COPY_FILE_TEXLER, /* copy_file_content_texler(R[a], R[b]) */
+
+        /* Numbers */
+        OP_LOAD_INTEGER, /* R[a] = b */
+        OP_ADD_INTEGER, /* R[a] = R[b] + c */
+        OP_STORE_ACC, /* R[a] = acc */
+        OP_LOAD_REAL, /* R[a] = K[b] */
+        OP_ADD_REAL_BUFFER, /* R[a] += atof(R[b]), cell_real() of file R[c]
+                               if c is not -1 */
+        OP_ADD_REAL_CONSTANT, /* R[a] += K[b] */
+        OP_MUL_REAL_BUFFER, /* R[a] *= atof(R[b]), as OP_ADD_REAL_BUFFER */
+        OP_MUL_REAL_CONSTANT, /* R[a] *= K[b] */
+        OP_OBJECT_TO_INTEGER, /* R[a] = R[b], stops with 1 if not a number */
+
+        /* Control flow */
+        OP_JUMP, /* goto d */
+        OP_JUMP_IF_NOT_LESS, /* if (R[a] >= b) goto d */
+        OP_JUMP_IF_NO_FILES_LEFT, /* if (R[a] >= R[b] n_files) goto d */
+        OP_JUMP_IF_NOT_POSITIVE, /* if (R[a] <= 0) goto d */
+        OP_JUMP_IF_ACC_NOT_POSITIVE, /* if (acc <= 0) goto d */
+        OP_JUMP_IF_NULL, /* if (R[a] == NULL) goto d */
+        OP_JUMP_IF_ZERO, /* if (R[a] == 0) goto d */
+        OP_JUMP_IF_NOT_IN_STRING, /* if (!is_in_string(K[b], R[a])) goto d */
+        OP_JUMP_IF_NOT_DISTINCT, /* if (!distinct_record(R[a], R[b])) goto d */
+        OP_JUMP_IF_NOT_NUMBER, /* if (!is_number(R[a])) goto d, cell_type()
+                                  of file R[b] if b is not -1 */
+        OP_JUMP_IF_NOT_EQUAL, /* if (!compare_equality(R[a], R[b])) goto d */
+        OP_JUMP_IF_NOT_EQUAL_INTEGER, /* same, with R[a] an integer */
+        OP_MISSING_LINE, /* reports that line R[a] does not exist */
+        OP_RETURN, /* stops with exit code a */
+        N_BYTECODE_OPCODE
+} BYTECODE_OPCODE;
+
+/* What a register holds, so the VM knows how to release it */
+typedef enum BYTECODE_REGISTER {
+        REGISTER_NUMBER = 0, /* integers, reals and pointers it does not own */
+        REGISTER_OBJECT,
+        REGISTER_FILE, /* current file of a 'with' block */
+        REGISTER_BUFFER,
+        REGISTER_SLOTS,
+        REGISTER_SORT,
+        REGISTER_GROUP,
+        REGISTER_DISTINCT,
+        REGISTER_JOIN,
+        REGISTER_TOP,
+} BYTECODE_REGISTER;
+
+typedef enum BYTECODE_CONSTANT {
+        CONSTANT_STRING = 0,
+        CONSTANT_REAL,
+        CONSTANT_ROWS,
+        CONSTANT_AGGREGATES,
+} BYTECODE_CONSTANT;
+
+typedef struct bytecode_instruction {
+        BYTECODE_OPCODE op;
+        long a;
+        long b;
+        long c;
+        long d;
+} bytecode_instruction;
+
+typedef struct bytecode_constant {
+        BYTECODE_CONSTANT type;
+        union {
+                struct {
+                        char *string;
+                        /* Length of the literal in the source */
+                        size_t length;
+                };
+                double real;
+                /* byIndex([...]): sorted rows and the order asked for */
+                struct {
+                        unsigned long *rows;
+                        size_t n_rows;
+                        size_t *order;
+                        size_t n_order;
+                };
+                /* group(...): what is computed for each group */
+                struct {
+                        struct texler_aggregate *aggregates;
+                        size_t n_aggregates;
+                };
+        };
+} bytecode_constant;
+
+typedef struct bytecode_program {
+        bytecode_instruction *instructions;
+        size_t n_instructions;
+        size_t instructions_size;
+
+        bytecode_constant *constants;
+        size_t n_constants;
+        size_t constants_size;
+
+        BYTECODE_REGISTER *registers;
+        size_t n_registers;
+        size_t registers_size;
+} bytecode_program;
+
+bytecode_program *new_bytecode_program();
+void free_bytecode_program(bytecode_program *program);
+
+size_t emit_instruction(bytecode_program *program, BYTECODE_OPCODE op, long a,
+                        long b, long c, long d);
+void patch_jump(bytecode_program *program, size_t instruction, size_t target);
+
+long new_register(bytecode_program *program, BYTECODE_REGISTER type);
+
+long add_string_constant(bytecode_program *program, const char *string,
+                         size_t length);
+long add_real_constant(bytecode_program *program, double real);
+long add_rows_constant(bytecode_program *program, unsigned long *rows,
+                       size_t n_rows, size_t *order, size_t n_order);
+long add_aggregates_constant(bytecode_program *program,
+                             struct texler_aggregate *aggregates,
+                             size_t n_aggregates);
+
+#endif /* BYTECODE_H */
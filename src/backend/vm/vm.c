@@ -0,0 +1,661 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "texler_runtime.h"
+
+#include "../error.h"
+
+#include "vm.h"
+
+typedef union vm_register {
+        TexlerObject *object;
+        char *buffer;
+        char **slots;
+        texler_sort *sort;
+        texler_group *group;
+        texler_distinct *distinct;
+        texler_join *join;
+        texler_top *top;
+        long integer;
+        double real;
+} vm_register;
+
+typedef struct vm_state {
+        const bytecode_program *program;
+        const texler_context *context;
+        vm_register *registers;
+        long acc;
+        int argc;
+        const char **argv;
+} vm_state;
+
+static void *vm_calloc(size_t n, size_t size)
+{
+        void *ptr = calloc(n, size);
+        if (ptr == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+
+        return ptr;
+}
+
+static char *vm_strdup(const char *str)
+{
+        char *copy = strdup(str);
+        if (copy == NULL) {
+                error_no_memory();
+                exit(1);
+        }
+
+        return copy;
+}
+
+static const char *constant_string(const vm_state *vm, long constant)
+{
+        if (constant < 0)
+                return NULL;
+
+        return vm->program->constants[constant].string;
+}
+
+/* Stream of a file object, NULL for anything else */
+static FILE *object_stream(TexlerObject *object)
+{
+        if (object == NULL || object->type != TYPE_T_FILEPTR)
+                return NULL;
+
+        return object->value.file.stream;
+}
+
+/* Objects own their strings: nothing is shared between two registers */
+static void set_object_string(TexlerObject *object, char *string)
+{
+        if (object->type == TYPE_T_STRING && object->value.string != string)
+                free(object->value.string);
+
+        object->type = TYPE_T_STRING;
+        object->value.string = string;
+        object->value.length = string == NULL ? 0 : strlen(string);
+}
+
+static void copy_object(TexlerObject *dest, TexlerObject *source)
+{
+        if (dest->type == TYPE_T_STRING)
+                free(dest->value.string);
+
+        memcpy(dest, source, sizeof(TexlerObject));
+
+        if (source->type == TYPE_T_STRING && source->value.string != NULL)
+                dest->value.string = vm_strdup(source->value.string);
+}
+
+static void append_string(TexlerObject *object, char *string)
+{
+        if (object->type != TYPE_T_STRING || object->value.string == NULL) {
+                set_object_string(object, vm_strdup(string));
+                return;
+        }
+
+        object->value.string = string_addition(object->value.string, string);
+        object->value.length = strlen(object->value.string);
+}
+
+/* Number in the buffer R[b], pre-parsed by the cache of file R[c] */
+static double cell_number(vm_register *R, const bytecode_instruction *ins)
+{
+        return cell_real(ins->c < 0 ? NULL : R[ins->c].object,
+                         R[ins->b].buffer);
+}
+
+static void free_slots(char **slots)
+{
+        if (slots == NULL)
+                return;
+
+        for (char **slot = slots; *slot != NULL; slot++)
+                free(*slot);
+        free(slots);
+}
+
+/*
+ * Releases what the registers still hold. Objects may share streams (an
+ * assignment between files copies the object), so each stream is closed
+ * only once.
+ */
+static void free_registers(vm_state *vm)
+{
+        const bytecode_program *program = vm->program;
+        FILE **closed = vm_calloc(1 + program->n_registers, sizeof(FILE *));
+        size_t n_closed = 0;
+
+        for (size_t i = 0; i < program->n_registers; i++) {
+                vm_register *reg = &vm->registers[i];
+
+                switch (program->registers[i]) {
+                case REGISTER_BUFFER:
+                        free(reg->buffer);
+                        break;
+                case REGISTER_SLOTS:
+                        free_slots(reg->slots);
+                        break;
+                case REGISTER_SORT:
+                        free_sort(reg->sort);
+                        break;
+                case REGISTER_GROUP:
+                        free_group(reg->group);
+                        break;
+                case REGISTER_DISTINCT:
+                        free_distinct(reg->distinct);
+                        break;
+                case REGISTER_JOIN:
+                        free_join(reg->join);
+                        break;
+                case REGISTER_TOP:
+                        free_top(reg->top);
+                        break;
+                case REGISTER_FILE: {
+                        bool is_object = false;
+                        for (size_t j = 0; j < program->n_registers; j++) {
+                                if (program->registers[j] == REGISTER_OBJECT &&
+                                    vm->registers[j].object == reg->object)
+                                        is_object = true;
+                        }
+
+                        if (!is_object)
+                                free_texlerobject(reg->object);
+                        break;
+                }
+                default:
+                        break;
+                }
+        }
+
+        for (size_t i = 0; i < program->n_registers; i++) {
+                TexlerObject *object = vm->registers[i].object;
+                if (program->registers[i] != REGISTER_OBJECT || object == NULL)
+                        continue;
+
+                FILE *stream = object_stream(object);
+                if (stream != NULL) {
+                        bool is_closed = false;
+                        for (size_t j = 0; j < n_closed; j++) {
+                                if (closed[j] == stream)
+                                        is_closed = true;
+                        }
+
+                        if (is_closed) {
+                                free(object);
+                                continue;
+                        }
+
+                        closed[n_closed++] = stream;
+                }
+
+                free_texlerobject(object);
+        }
+
+        free(closed);
+}
+
+static int run(vm_state *vm)
+{
+        const bytecode_program *program = vm->program;
+        const bytecode_constant *K = program->constants;
+        vm_register *R = vm->registers;
+        size_t pc = 0;
+
+        while (pc < program->n_instructions) {
+                const bytecode_instruction *ins = &program->instructions[pc++];
+
+                switch (ins->op) {
+                /* Objects */
+                case OP_NEW_OBJECT:
+                        if (R[ins->a].object != NULL &&
+                            object_stream(R[ins->a].object) == NULL)
+                                free_texlerobject(R[ins->a].object);
+                        R[ins->a].object =
+                                vm_calloc(1, sizeof(TexlerObject));
+                        break;
+                case OP_FREE_OBJECT:
+                        free_texlerobject(R[ins->a].object);
+                        R[ins->a].object = NULL;
+                        break;
+                case OP_SET_REAL:
+                        if (R[ins->a].object->type == TYPE_T_STRING)
+                                free(R[ins->a].object->value.string);
+                        R[ins->a].object->type = TYPE_T_REAL;
+                        R[ins->a].object->value.real = K[ins->b].real;
+                        break;
+                case OP_SET_BOOLEAN:
+                        if (R[ins->a].object->type == TYPE_T_STRING)
+                                free(R[ins->a].object->value.string);
+                        R[ins->a].object->type = TYPE_T_BOOLEAN;
+                        R[ins->a].object->value.boolean = ins->b;
+                        break;
+                case OP_SET_STRING:
+                        set_object_string(R[ins->a].object,
+                                          vm_strdup(K[ins->b].string));
+                        R[ins->a].object->value.length = K[ins->b].length;
+                        break;
+                case OP_LOAD_ARGUMENT:
+                        R[ins->a].object->type = TYPE_T_REAL;
+                        R[ins->a].object->value.real =
+                                ins->b < vm->argc ? atof(vm->argv[ins->b]) : 0;
+                        break;
+                case OP_COPY_OBJECT:
+                        copy_object(R[ins->a].object, R[ins->b].object);
+                        break;
+                case OP_COPY_BUFFER:
+                        set_object_string(R[ins->a].object,
+                                          vm_strdup(R[ins->b].buffer));
+                        break;
+                case OP_TO_STRING:
+                        set_object_string(R[ins->a].object,
+                                          toString(R[ins->b].object));
+                        break;
+                case OP_APPEND_BUFFER:
+                        append_string(R[ins->a].object, R[ins->b].buffer);
+                        break;
+                case OP_APPEND_CONSTANT:
+                        append_string(R[ins->a].object, K[ins->b].string);
+                        break;
+                case OP_AT:
+                        vm->acc = at(R[ins->a].object->value.string, ins->b);
+                        if (vm->acc < 0)
+                                return 1;
+                        break;
+                case OP_SET_CHARACTER: {
+                        char *character = vm_calloc(2, sizeof(char));
+                        character[0] = (char)vm->acc;
+                        set_object_string(R[ins->a].object, character);
+                        break;
+                }
+                case OP_NEW_BUFFER:
+                        free(R[ins->a].buffer);
+                        R[ins->a].buffer =
+                                vm_calloc(BUFFER_SIZE, sizeof(char));
+                        break;
+                case OP_MOVE:
+                        R[ins->a] = R[ins->b];
+                        break;
+
+                /* Files */
+                case OP_OPEN_READ:
+                        if (open_variable_file(vm->context, K[ins->d].string,
+                                               K[ins->b].string, "r",
+                                               R[ins->a].object,
+                                               constant_string(vm, ins->c)) ==
+                            false)
+                                return 1;
+                        R[ins->a].object->value.file.n_files = 1;
+                        break;
+                case OP_OPEN_WRITE:
+                        if (open_variable_file(vm->context, K[ins->d].string,
+                                               K[ins->b].string, "w+",
+                                               R[ins->a].object,
+                                               constant_string(vm, ins->c)) ==
+                            false)
+                                return 1;
+                        break;
+                case OP_OPEN_DIRECTORY: {
+                        TexlerObject *object = R[ins->a].object;
+                        const char *separators = constant_string(vm, ins->c);
+
+                        object->type = TYPE_T_FILE_LIST;
+                        object->value.file.next_open_file = 0;
+                        object->value.file.n_files = get_list_of_files_in_dir(
+                                &object->value.file.path_list,
+                                variable_path(vm->context, K[ins->d].string,
+                                              K[ins->b].string));
+                        object->value.file.separators =
+                                separators == NULL ? NULL :
+                                                     vm_strdup(separators);
+                        break;
+                }
+                case OP_OPEN_TEMPORARY:
+                        R[ins->a].object->type = TYPE_T_FILEPTR;
+                        R[ins->a].object->value.file.next_open_file = 0;
+                        R[ins->a].object->value.file.stream = tmpfile();
+                        if (R[ins->a].object->value.file.stream == NULL) {
+                                perror("Error while creating temporary file");
+                                return 1;
+                        }
+                        break;
+                case OP_OPEN_STDOUT:
+                        if (open_variable_stdout(vm->context,
+                                                 K[ins->d].string,
+                                                 R[ins->a].object) == false)
+                                return 1;
+                        break;
+                case OP_NEXT_FILE:
+                        R[ins->a].object = get_next_file(
+                                R[ins->b].object,
+                                R[ins->b].object->value.file.separators);
+                        if (R[ins->a].object == NULL)
+                                pc = ins->d;
+                        break;
+                case OP_RELEASE_FILE:
+                        if (R[ins->a].object != R[ins->b].object)
+                                free_texlerobject(R[ins->a].object);
+                        R[ins->a].object = NULL;
+                        break;
+                case OP_REWIND:
+                        rewind(R[ins->a].object->value.file.stream);
+                        break;
+                case OP_SEEK_LINE:
+                        seek_line(R[ins->a].object, ins->b);
+                        break;
+                case OP_LINES:
+                        vm->acc = lines(R[ins->a].object, &R[ins->b].buffer);
+                        break;
+                case OP_RECORDS:
+                        vm->acc = records(R[ins->a].object, &R[ins->b].buffer);
+                        break;
+                case OP_LINE_BY_NUMBER:
+                        vm->acc = line_by_number(R[ins->a].object,
+                                                 &R[ins->b].buffer,
+                                                 R[ins->c].integer);
+                        break;
+                case OP_LINES_BY_NUMBERS: {
+                        const bytecode_constant *rows = &K[ins->c];
+
+                        free_slots(R[ins->a].slots);
+                        R[ins->a].slots =
+                                vm_calloc(1 + rows->n_rows, sizeof(char *));
+                        lines_by_numbers(R[ins->b].object, rows->rows,
+                                         rows->n_rows, R[ins->a].slots);
+                        break;
+                }
+                case OP_LOAD_SLOT: {
+                        const bytecode_constant *rows = &K[ins->d];
+                        size_t slot = rows->order[R[ins->c].integer];
+
+                        if (R[ins->b].slots[slot] == NULL) {
+                                fprintf(stderr, "Line number %lu not found.\n",
+                                        rows->rows[slot]);
+                                vm->acc = 0;
+                                break;
+                        }
+
+                        free(R[ins->a].buffer);
+                        R[ins->a].buffer = vm_strdup(R[ins->b].slots[slot]);
+                        vm->acc = 1;
+                        break;
+                }
+                case OP_FREE_SLOTS:
+                        free_slots(R[ins->a].slots);
+                        R[ins->a].slots = NULL;
+                        break;
+                case OP_PROJECT_COLUMNS:
+                        if (ins->b < 0)
+                                project_columns(R[ins->a].object, NULL, 0);
+                        else
+                                project_columns(R[ins->a].object,
+                                                K[ins->b].rows,
+                                                K[ins->b].n_rows);
+                        break;
+                case OP_COLUMNS: {
+                        int separator = R[ins->d].integer;
+
+                        vm->acc = file_columns(R[ins->b].object,
+                                               &R[ins->a].buffer,
+                                               &R[ins->c].buffer, &separator);
+                        R[ins->d].integer = separator;
+                        break;
+                }
+                case OP_STRIP_NEWLINE: {
+                        char *line = R[ins->a].buffer;
+                        size_t len = strlen(line);
+
+                        R[ins->b].integer = len > 1 && line[len - 1] == '\n';
+                        if (R[ins->b].integer)
+                                line[len - 1] = '\0';
+                        break;
+                }
+                case OP_SORT_RECORDS:
+                        free_sort(R[ins->a].sort);
+                        R[ins->a].sort = sort_records(R[ins->b].object, ins->c,
+                                                      ins->d & 1, ins->d & 2);
+                        if (R[ins->a].sort == NULL)
+                                return 1;
+                        break;
+                case OP_SORTED_RECORDS:
+                        vm->acc = sorted_records(R[ins->a].sort,
+                                                 &R[ins->b].buffer);
+                        break;
+                case OP_FREE_SORT:
+                        free_sort(R[ins->a].sort);
+                        R[ins->a].sort = NULL;
+                        break;
+                case OP_GROUP_RECORDS:
+                        free_group(R[ins->a].group);
+                        R[ins->a].group = group_records(
+                                R[ins->b].object, ins->c,
+                                K[ins->d].aggregates, K[ins->d].n_aggregates);
+                        if (R[ins->a].group == NULL)
+                                return 1;
+                        break;
+                case OP_GROUPED_RECORDS:
+                        vm->acc = grouped_records(R[ins->a].group,
+                                                  &R[ins->b].buffer);
+                        break;
+                case OP_FREE_GROUP:
+                        free_group(R[ins->a].group);
+                        R[ins->a].group = NULL;
+                        break;
+                case OP_NEW_DISTINCT:
+                        free_distinct(R[ins->a].distinct);
+                        R[ins->a].distinct = new_distinct(
+                                R[ins->b].object, ins->c, ins->d != 0);
+                        if (R[ins->a].distinct == NULL)
+                                return 1;
+                        break;
+                case OP_FREE_DISTINCT:
+                        free_distinct(R[ins->a].distinct);
+                        R[ins->a].distinct = NULL;
+                        break;
+                case OP_JOIN_RECORDS:
+                        free_join(R[ins->a].join);
+                        R[ins->a].join = join_records(
+                                R[ins->b].object, R[ins->c].object,
+                                ins->d >> 32, ins->d >> 1 & 0x7fffffff,
+                                ins->d & 1);
+                        if (R[ins->a].join == NULL)
+                                return 1;
+                        break;
+                case OP_JOINED_RECORDS:
+                        vm->acc = joined_records(R[ins->a].join,
+                                                 &R[ins->b].buffer);
+                        break;
+                case OP_FREE_JOIN:
+                        free_join(R[ins->a].join);
+                        R[ins->a].join = NULL;
+                        break;
+                case OP_TOP_RECORDS:
+                        free_top(R[ins->a].top);
+                        R[ins->a].top =
+                                top_records(R[ins->b].object, ins->c, ins->d);
+                        if (R[ins->a].top == NULL)
+                                return 1;
+                        break;
+                case OP_RANKED_RECORDS:
+                        vm->acc = ranked_records(R[ins->a].top,
+                                                 &R[ins->b].buffer);
+                        break;
+                case OP_FREE_TOP:
+                        free_top(R[ins->a].top);
+                        R[ins->a].top = NULL;
+                        break;
+
+                /* Output */
+                case OP_WRITE_CONSTANT:
+                        copy_buffer_content(K[ins->a].string,
+                                            object_stream(R[ins->b].object));
+                        break;
+                case OP_WRITE_BUFFER:
+                        copy_buffer_content(R[ins->a].buffer,
+                                            object_stream(R[ins->b].object));
+                        break;
+                case OP_WRITE_STRING:
+                        copy_buffer_content(R[ins->a].object->value.string,
+                                            object_stream(R[ins->b].object));
+                        break;
+                case OP_WRITE_TO_STRING: {
+                        char *string = toString(R[ins->a].object);
+                        copy_buffer_content(string,
+                                            object_stream(R[ins->b].object));
+                        free(string);
+                        break;
+                }
+                case OP_WRITE_REAL:
+                        if (object_stream(R[ins->b].object) != NULL)
+                                fprintf(object_stream(R[ins->b].object), "%f",
+                                        R[ins->a].real);
+                        break;
+                case OP_WRITE_CHARACTER:
+                        if (object_stream(R[ins->b].object) != NULL)
+                                fputc(R[ins->a].integer,
+                                      object_stream(R[ins->b].object));
+                        break;
+                case OP_WRITE_ACC:
+                        if (object_stream(R[ins->a].object) != NULL)
+                                fputc(vm->acc,
+                                      object_stream(R[ins->a].object));
+                        break;
+                case OP_COPY_FILE:
+                        copy_file_content(object_stream(R[ins->a].object),
+                                          object_stream(R[ins->b].object));
+                        break;
+                case OP_COPY_FILE_TEXLER:
+                        copy_file_content_texler(R[ins->a].object,
+                                                 R[ins->b].object);
+                        break;
+
+                /* Numbers */
+                case OP_LOAD_INTEGER:
+                        R[ins->a].integer = ins->b;
+                        break;
+                case OP_ADD_INTEGER:
+                        R[ins->a].integer = R[ins->b].integer + ins->c;
+                        break;
+                case OP_STORE_ACC:
+                        R[ins->a].integer = vm->acc;
+                        break;
+                case OP_LOAD_REAL:
+                        R[ins->a].real = K[ins->b].real;
+                        break;
+                case OP_ADD_REAL_BUFFER:
+                        R[ins->a].real += cell_number(R, ins);
+                        break;
+                case OP_ADD_REAL_CONSTANT:
+                        R[ins->a].real += K[ins->b].real;
+                        break;
+                case OP_MUL_REAL_BUFFER:
+                        R[ins->a].real *= cell_number(R, ins);
+                        break;
+                case OP_MUL_REAL_CONSTANT:
+                        R[ins->a].real *= K[ins->b].real;
+                        break;
+                case OP_OBJECT_TO_INTEGER:
+                        if (R[ins->b].object->type != TYPE_T_REAL &&
+                            R[ins->b].object->type != TYPE_T_INTEGER) {
+                                fprintf(stderr, "Invalid object type in %s.\n",
+                                        K[ins->c].string);
+                                return 1;
+                        }
+                        R[ins->a].integer = R[ins->b].object->value.real;
+                        break;
+
+                /* Control flow */
+                case OP_JUMP:
+                        pc = ins->d;
+                        break;
+                case OP_JUMP_IF_NOT_LESS:
+                        if (R[ins->a].integer >= ins->b)
+                                pc = ins->d;
+                        break;
+                case OP_JUMP_IF_NO_FILES_LEFT:
+                        if (R[ins->a].integer >=
+                            (long)R[ins->b].object->value.file.n_files)
+                                pc = ins->d;
+                        break;
+                case OP_JUMP_IF_NOT_POSITIVE:
+                        if (R[ins->a].integer <= 0)
+                                pc = ins->d;
+                        break;
+                case OP_JUMP_IF_ACC_NOT_POSITIVE:
+                        if (vm->acc <= 0)
+                                pc = ins->d;
+                        break;
+                case OP_JUMP_IF_NULL:
+                        if (R[ins->a].buffer == NULL)
+                                pc = ins->d;
+                        break;
+                case OP_JUMP_IF_ZERO:
+                        if (R[ins->a].integer == 0)
+                                pc = ins->d;
+                        break;
+                case OP_JUMP_IF_NOT_IN_STRING:
+                        if (!is_in_string(K[ins->b].string, R[ins->a].buffer))
+                                pc = ins->d;
+                        break;
+                case OP_JUMP_IF_NOT_DISTINCT:
+                        if (!distinct_record(R[ins->a].distinct,
+                                             R[ins->b].buffer))
+                                pc = ins->d;
+                        break;
+                case OP_JUMP_IF_NOT_NUMBER:
+                        if (cell_type(ins->b < 0 ? NULL : R[ins->b].object,
+                                      R[ins->a].buffer) ==
+                            IS_NUMBER_RETURN_NAN)
+                                pc = ins->d;
+                        break;
+                case OP_JUMP_IF_NOT_EQUAL:
+                        if (!compare_equality(R[ins->a].object,
+                                              R[ins->b].object))
+                                pc = ins->d;
+                        break;
+                case OP_JUMP_IF_NOT_EQUAL_INTEGER:
+                        if (!compare_equality_constant_number_int(
+                                    R[ins->a].integer, R[ins->b].object))
+                                pc = ins->d;
+                        break;
+                case OP_MISSING_LINE:
+                        fprintf(stderr, "Line number %ld not found.\n",
+                                R[ins->a].integer);
+                        break;
+                case OP_RETURN:
+                        return ins->a;
+                default:
+                        fprintf(stderr, "Invalid opcode %d at %lu.\n",
+                                ins->op, pc - 1);
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+int run_bytecode(const bytecode_program *program,
+                 const texler_context *context, const int argc,
+                 const char **argv)
+{
+        if (program == NULL)
+                return 1;
+
+        vm_state vm = { .program = program,
+                        .context = context,
+                        .registers = vm_calloc(1 + program->n_registers,
+                                               sizeof(vm_register)),
+                        .argc = argc,
+                        .argv = argv };
+
+        int status = run(&vm);
+
+        free_registers(&vm);
+        free(vm.registers);
+
+        return status;
+}
@@ -0,0 +1,19 @@
+#ifndef VM_H
+#define VM_H
+
+#include "texler_runtime.h"
+
+#include "bytecode.h"
+
+/*
+ * Runs a program compiled by compile_bytecode() inside texler, without
+ * generating C nor calling gcc. argv[1..] are the arguments of the main
+ * function and context the streams bound to its File variables, like
+ * texler_run() in the generated code.
+ * Returns the exit code the generated executable would have returned.
+ */
+int run_bytecode(const bytecode_program *program,
+                 const texler_context *context, const int argc,
+                 const char **argv);
+
+#endif /* VM_H */
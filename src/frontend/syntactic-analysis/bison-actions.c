@@ -214,6 +214,19 @@ node_function_call *grammar_function_call(const char *fun_id,
                 exit(1);
         }
 
+        // sort(3, numeric, desc), group(2, count), join(inputB, 1, 1, left):
+        // options are names, not variables
+        if ((strcmp(fun_id, "sort") == 0 || strcmp(fun_id, "group") == 0 ||
+             strcmp(fun_id, "join") == 0) &&
+            args != NULL) {
+                for (size_t i = 0; i < args->len; i++) {
+                        if (args->exprs[i] != NULL &&
+                            args->exprs[i]->type == EXPRESSION_VARIABLE)
+                                assign_scope_to_dangling_variable(
+                                        args->exprs[i]->var);
+                }
+        }
+
         node->id = fun_id_table_entry;
         node->args = (node_list *)args; // Could be NULL
         node->next = NULL;
@@ -1,6 +1,7 @@
 // #include "backend/code-generation/generator.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "backend/error.h"
 #include "backend/logger.h"
@@ -11,12 +12,43 @@
 #include "frontend/syntactic-analysis/bison-parser.h"
 #include "backend/symbols.h"
 #include "backend/generator/code-generator.h"
+#include "backend/vm/bytecode-compiler.h"
+#include "backend/vm/vm.h"
 
 //Estado de la aplicación.
 CompilerState state;
 
 extern void free_yylval();
 
+// Programa que ejecuta run_vm(), texler_main() no recibe otro dato.
+static const bytecode_program *vm_program = NULL;
+
+static int run_vm(texler_stream *streams, size_t n_streams, const int argc,
+                  const char **argv)
+{
+        const texler_context context = { streams, n_streams };
+
+        return run_bytecode(vm_program, &context, argc, argv);
+}
+
+// Ejecuta el programa en la VM, sin generar C ni llamar a gcc.
+static int run_program(program_t *root, const int argumentCount,
+                       const char **arguments)
+{
+        bytecode_program *program = compile_bytecode(root);
+        if (program == NULL) {
+                LogError("No se pudo ejecutar el programa en la VM.");
+                return 1;
+        }
+
+        // Igual que los ejecutables: acepta --file y --batch.
+        vm_program = program;
+        const int status = texler_main(run_vm, argumentCount, arguments);
+        free_bytecode_program(program);
+
+        return status;
+}
+
 // Punto de entrada principal del compilador.
 const int main(const int argumentCount, const char **arguments)
 {
@@ -25,6 +57,18 @@ const int main(const int argumentCount, const char **arguments)
         state.succeed = false;
         state.syntax_error = false;
 
+        // texler_compiler --run [argumentos] < programa.texler
+        const bool run = argumentCount > 1 &&
+                         strcmp(arguments[1], "--run") == 0;
+
+        // La salida estándar es la del programa.
+        LogQuiet(run);
+
+        // texler_compiler --library programa.c < programa.texler
+        const bool library = argumentCount > 2 &&
+                             strcmp(arguments[1], "--library") == 0;
+        const char *c_filename = arguments[library ? 2 : 1];
+
         // Mostrar parámetros recibidos por consola.
         for (int i = 0; i < argumentCount; ++i) {
                 LogInfo("Argumento %d: '%s'", i, arguments[i]);
@@ -39,8 +83,13 @@ const int main(const int argumentCount, const char **arguments)
 
         switch (result) {
         case COMPILER_STATE_RESULTS_FINISHED:
-                if (state.succeed) {
-                        if (generate_code(root, arguments[1])) {
+                if (state.succeed && run) {
+                        const int status = run_program(
+                                root, argumentCount - 1, arguments + 1);
+                        free_program(root);
+                        return status;
+                } else if (state.succeed) {
+                        if (generate_code(root, c_filename, library)) {
                                 LogInfo("La compilación fue exitosa.");
                         } else {
                                 LogError("Se produjo un error durante "
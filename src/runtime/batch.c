@@ -0,0 +1,475 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "texler_runtime.h"
+
+/*
+ * Command line of the generated executables:
+ *
+ *   program [--file variable=path]... [--batch manifest | --serve socket]
+ *           [args...]
+ *
+ * --file replaces the path of a File variable. --batch runs the program
+ * once per line of the manifest ("-" reads it from stdin) and --serve once
+ * per request received on a UNIX socket, all in the same process.
+ *
+ * Manifest lines and requests have the same syntax: paths as
+ * variable=path or, for the common case, just "input_path output_path",
+ * optionally followed by "-- args..." to replace the program arguments.
+ * Requests can also send file descriptors (SCM_RIGHTS) and bind them with
+ * variable=fd:N, N being the position of the descriptor in the message.
+ */
+
+#define REQUEST_SEPARATORS " \t\r\n"
+#define REQUEST_FD_PREFIX "fd:"
+
+/* Bytes and descriptors of a --serve request */
+#define REQUEST_SIZE 4096
+#define REQUEST_MAX_FDS 16
+
+static const char *const positional_variables[] = { "input", "output" };
+#define N_POSITIONAL_VARIABLES \
+        (sizeof(positional_variables) / sizeof(*positional_variables))
+
+/* Streams and arguments of one run of the program */
+typedef struct run_request {
+        texler_stream *streams;
+        size_t n_streams;
+        const char **argv;
+        int argc;
+} run_request;
+
+/* Set by SIGINT and SIGTERM, stops --serve after the current request */
+static volatile sig_atomic_t stop_serving = 0;
+
+/* Fills 'stream' from "variable=path". 'binding' must outlive the stream */
+static bool bind_path(texler_stream *stream, char *binding)
+{
+        char *equals = strchr(binding, '=');
+        if (equals == NULL || equals == binding || equals[1] == '\0')
+                return false;
+
+        *equals = '\0';
+        stream->name = binding;
+        stream->type = TEXLER_STREAM_PATH;
+        stream->path = equals + 1;
+
+        return true;
+}
+
+/* "variable=fd:N" binds the descriptor N of the request */
+static bool bind_fd(texler_stream *stream, const int *fds, size_t n_fds)
+{
+        if (strncmp(stream->path, REQUEST_FD_PREFIX,
+                    strlen(REQUEST_FD_PREFIX)) != 0)
+                return true;
+
+        char *end = NULL;
+        const char *index = stream->path + strlen(REQUEST_FD_PREFIX);
+        unsigned long fd = strtoul(index, &end, 10);
+        if (end == index || *end != '\0' || fd >= n_fds)
+                return false;
+
+        stream->type = TEXLER_STREAM_FD;
+        stream->fd = fds[fd];
+        stream->path = NULL;
+
+        return true;
+}
+
+/*
+ * Parses a manifest line or a request into 'request'. Its bindings go
+ * before the ones in 'defaults' (the command line), so they win when both
+ * name a variable. 'where' prefixes the errors.
+ */
+static bool parse_request(char *line, const char *where, const int *fds,
+                          size_t n_fds, const run_request *defaults,
+                          run_request *request)
+{
+        size_t max_tokens = strlen(line) / 2 + 1;
+        size_t max_args = 1 + max_tokens > (size_t)defaults->argc ?
+                                  1 + max_tokens :
+                                  (size_t)defaults->argc;
+
+        request->streams = (texler_stream *)calloc(
+                max_tokens + defaults->n_streams, sizeof(texler_stream));
+        request->argv = (const char **)calloc(max_args + 1, sizeof(char *));
+        if (request->streams == NULL || request->argv == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        request->n_streams = 0;
+        request->argc = 0;
+
+        size_t n_positional = 0;
+        bool arguments = false;
+        char *save_ptr = NULL;
+        char *token = strtok_r(line, REQUEST_SEPARATORS, &save_ptr);
+
+        for (; token != NULL;
+             token = strtok_r(NULL, REQUEST_SEPARATORS, &save_ptr)) {
+                texler_stream *stream = &request->streams[request->n_streams];
+
+                if (arguments) {
+                        request->argv[request->argc++] = token;
+                        continue;
+                }
+
+                if (strcmp(token, "--") == 0) {
+                        arguments = true;
+                        request->argv[request->argc++] = defaults->argv[0];
+                } else if (strchr(token, '=') != NULL) {
+                        if (bind_path(stream, token) == false) {
+                                fprintf(stderr, "%s: invalid binding '%s'\n",
+                                        where, token);
+                                return false;
+                        }
+                        if (bind_fd(stream, fds, n_fds) == false) {
+                                fprintf(stderr,
+                                        "%s: no descriptor for '%s=%s'\n",
+                                        where, stream->name, stream->path);
+                                return false;
+                        }
+                        request->n_streams++;
+                } else if (n_positional < N_POSITIONAL_VARIABLES) {
+                        stream->name = positional_variables[n_positional++];
+                        stream->type = TEXLER_STREAM_PATH;
+                        stream->path = token;
+                        request->n_streams++;
+                } else {
+                        fprintf(stderr,
+                                "%s: too many paths, use variable=path\n",
+                                where);
+                        return false;
+                }
+        }
+
+        memcpy(&request->streams[request->n_streams], defaults->streams,
+               defaults->n_streams * sizeof(texler_stream));
+        request->n_streams += defaults->n_streams;
+
+        if (arguments == false) {
+                memcpy(request->argv, defaults->argv,
+                       defaults->argc * sizeof(char *));
+                request->argc = defaults->argc;
+        }
+
+        return true;
+}
+
+static void free_request(run_request *request)
+{
+        free(request->streams);
+        free(request->argv);
+}
+
+/* Returns the highest exit code of all the runs */
+static int run_manifest(texler_run_function run, const char *manifest,
+                        const run_request *defaults)
+{
+        FILE *fptr = strcmp(manifest, "-") == 0 ? stdin : fopen(manifest, "r");
+        if (fptr == NULL) {
+                perror("Error while opening the manifest");
+                return 1;
+        }
+
+        int max_ret = 0;
+        char *line = NULL;
+        size_t line_size = 0;
+        size_t line_number = 0;
+
+        while (getline(&line, &line_size, fptr) != -1) {
+                line_number++;
+
+                size_t skip = strspn(line, REQUEST_SEPARATORS);
+                if (line[skip] == '\0' || line[skip] == '#')
+                        continue;
+
+                char where[64];
+                snprintf(where, sizeof(where), "Manifest line %zu",
+                         line_number);
+
+                int ret = 1;
+                run_request request = { 0 };
+                if (parse_request(line, where, NULL, 0, defaults, &request))
+                        ret = run(request.streams, request.n_streams,
+                                  request.argc, request.argv);
+                free_request(&request);
+
+                if (ret != 0)
+                        fprintf(stderr, "%s: exited with code %d\n", where,
+                                ret);
+                if (ret > max_ret)
+                        max_ret = ret;
+        }
+
+        free(line);
+        if (fptr != stdin)
+                fclose(fptr);
+
+        return max_ret;
+}
+
+static void stop_worker(int signal_number)
+{
+        (void)signal_number;
+        stop_serving = 1;
+}
+
+static long elapsed_us(const struct timespec *start)
+{
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        return (end.tv_sec - start->tv_sec) * 1000000L +
+               (end.tv_nsec - start->tv_nsec) / 1000L;
+}
+
+/*
+ * Receives one request of 'client' into 'buffer' and its descriptors into
+ * 'fds'. Returns the length of the request, -1 if it is too big, and 0
+ * when the client is done, its socket fails or the worker is stopped.
+ * Signals that do not stop the worker do not end the connection.
+ */
+static ssize_t receive_request(int client, char *buffer, int *fds,
+                               size_t *n_fds)
+{
+        union {
+                char buffer[CMSG_SPACE(REQUEST_MAX_FDS * sizeof(int))];
+                struct cmsghdr align;
+        } control;
+        struct iovec iov = { .iov_base = buffer, .iov_len = REQUEST_SIZE - 1 };
+        struct msghdr message = { .msg_iov = &iov,
+                                  .msg_iovlen = 1,
+                                  .msg_control = control.buffer,
+                                  .msg_controllen = sizeof(control.buffer) };
+
+        *n_fds = 0;
+
+        ssize_t length = 0;
+        do {
+                length = recvmsg(client, &message, MSG_CMSG_CLOEXEC);
+        } while (length < 0 && errno == EINTR && stop_serving == 0);
+
+        if (length < 0 && errno != EINTR)
+                perror("Error while receiving a request");
+        if (length <= 0)
+                return 0;
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        for (; cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+                if (cmsg->cmsg_level != SOL_SOCKET ||
+                    cmsg->cmsg_type != SCM_RIGHTS)
+                        continue;
+
+                size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                memcpy(fds + *n_fds, CMSG_DATA(cmsg), n * sizeof(int));
+                *n_fds += n;
+        }
+
+        buffer[length] = '\0';
+
+        if (message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+                fprintf(stderr, "Request too big, at most %d bytes and %d "
+                                "descriptors\n",
+                        REQUEST_SIZE - 1, REQUEST_MAX_FDS);
+                return -1;
+        }
+
+        return length;
+}
+
+/* Runs the requests of 'client' until it closes its side */
+static void serve_client(texler_run_function run, int client,
+                         const run_request *defaults, size_t *n_requests)
+{
+        char *buffer = (char *)calloc(REQUEST_SIZE, sizeof(char));
+        if (buffer == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        int fds[REQUEST_MAX_FDS];
+        size_t n_fds = 0;
+        ssize_t length = 0;
+
+        while ((length = receive_request(client, buffer, fds, &n_fds)) != 0) {
+                struct timespec start;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+
+                char where[64];
+                snprintf(where, sizeof(where), "Request %zu",
+                         *n_requests + 1);
+
+                int ret = 1;
+                run_request request = { 0 };
+                bool valid = length > 0 && parse_request(buffer, where, fds,
+                                                         n_fds, defaults,
+                                                         &request);
+                if (valid)
+                        ret = run(request.streams, request.n_streams,
+                                  request.argc, request.argv);
+                free_request(&request);
+                fflush(stdout);
+
+                for (size_t i = 0; i < n_fds; i++)
+                        close(fds[i]);
+
+                /* Invalid requests are answered, but not counted */
+                if (valid)
+                        (*n_requests)++;
+
+                char response[128];
+                int response_len = snprintf(response, sizeof(response),
+                                            "status=%d time_us=%ld "
+                                            "requests=%zu\n",
+                                            ret, elapsed_us(&start),
+                                            *n_requests);
+                if (send(client, response, response_len, MSG_NOSIGNAL) < 0 ||
+                    length < 0)
+                        break;
+        }
+
+        free(buffer);
+}
+
+/* Listens on 'socket_path' until SIGINT or SIGTERM */
+static int serve(texler_run_function run, const char *socket_path,
+                 const run_request *defaults)
+{
+        struct sockaddr_un address = { .sun_family = AF_UNIX };
+        if (strlen(socket_path) >= sizeof(address.sun_path)) {
+                fprintf(stderr, "Socket path too long: %s\n", socket_path);
+                return 1;
+        }
+        strcpy(address.sun_path, socket_path);
+
+        int server = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (server < 0) {
+                perror("Error while creating the socket");
+                return 1;
+        }
+
+        /* A socket left by a previous worker, never a regular file */
+        struct stat info;
+        if (stat(socket_path, &info) == 0 && S_ISSOCK(info.st_mode))
+                unlink(socket_path);
+
+        if (bind(server, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+            listen(server, SOMAXCONN) < 0) {
+                perror("Error while listening on the socket");
+                close(server);
+                return 1;
+        }
+
+        /* No SA_RESTART, so accept() returns when they arrive */
+        struct sigaction action = { .sa_handler = stop_worker };
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+
+        size_t n_requests = 0;
+        int ret = 0;
+
+        while (stop_serving == 0) {
+                int client = accept4(server, NULL, NULL, SOCK_CLOEXEC);
+                if (client < 0) {
+                        if (errno == EINTR || errno == ECONNABORTED)
+                                continue;
+
+                        perror("Error while accepting a connection");
+                        ret = 1;
+                        break;
+                }
+
+                serve_client(run, client, defaults, &n_requests);
+                close(client);
+        }
+
+        close(server);
+        unlink(socket_path);
+
+        return ret;
+}
+
+/* main() of the generated executables, 'run' is the program itself */
+int texler_main(texler_run_function run, const int argc, const char **argv)
+{
+        texler_stream *streams =
+                (texler_stream *)calloc(argc + 1, sizeof(texler_stream));
+        const char **args = (const char **)calloc(argc + 1, sizeof(char *));
+        char **bindings = (char **)calloc(argc + 1, sizeof(char *));
+        if (streams == NULL || args == NULL || bindings == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        size_t n_streams = 0;
+        int n_args = 0;
+        const char *manifest = NULL;
+        const char *socket_path = NULL;
+        bool valid = true;
+
+        args[n_args++] = argc > 0 ? argv[0] : "texler";
+
+        for (int i = 1; i < argc && valid; i++) {
+                if (strcmp(argv[i], "--file") == 0 && i + 1 < argc) {
+                        i++;
+                        bindings[n_streams] = strdup(argv[i]);
+                        if (bindings[n_streams] == NULL) {
+                                perror("Aborting due to");
+                                exit(1);
+                        }
+
+                        valid = bind_path(&streams[n_streams],
+                                          bindings[n_streams]);
+                        if (valid == false)
+                                fprintf(stderr,
+                                        "Invalid --file '%s', expected "
+                                        "variable=path\n",
+                                        argv[i]);
+                        n_streams++;
+                } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+                        manifest = argv[++i];
+                } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+                        socket_path = argv[++i];
+                } else if (strcmp(argv[i], "--") == 0) {
+                        while (++i < argc)
+                                args[n_args++] = argv[i];
+                } else {
+                        args[n_args++] = argv[i];
+                }
+        }
+
+        if (manifest != NULL && socket_path != NULL) {
+                fputs("--batch and --serve can not be used together\n",
+                      stderr);
+                valid = false;
+        }
+
+        const run_request defaults = { streams, n_streams, args, n_args };
+        int ret = 1;
+
+        if (valid && manifest != NULL)
+                ret = run_manifest(run, manifest, &defaults);
+        else if (valid && socket_path != NULL)
+                ret = serve(run, socket_path, &defaults);
+        else if (valid)
+                ret = run(streams, n_streams, n_args, args);
+
+        for (size_t i = 0; i < n_streams; i++)
+                free(bindings[i]);
+        free(bindings);
+        free(args);
+        free(streams);
+
+        return ret;
+}
@@ -0,0 +1,809 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "texler_runtime.h"
+
+/*
+ * Columnar cache of the inputs split by columns().lines() loops. With
+ * TEXLER_SIDECAR=1, the first program that splits a file writes next to it
+ * a sidecar (<file>.texc) with every column already located and parsed;
+ * the programs that open the file later, with the same separators, map it
+ * and take the columns from there instead of splitting the lines again.
+ *
+ * The sidecar keeps, column by column, where each cell starts in its
+ * record, its length, the separator after it, its type (is_number()) and,
+ * for columns with numbers, its value (atof()). The text of a cell is
+ * copied from the record read, unless CSV quotes had to be removed: that
+ * text is kept in the sidecar too. Cells are found with the same
+ * functions a program uses, so they are byte for byte what it would get.
+ *
+ * A sidecar is only used while the size and modification time of its
+ * file are those it was built from. Records whose offset it does not know
+ * (seeks, lines read some other way) are split as usual.
+ */
+
+#define CACHE_MAGIC "TEXLERC"
+#define CACHE_VERSION 1
+#define CACHE_SUFFIX ".texc"
+#define CACHE_NONE UINT32_MAX
+#define CACHE_RAW_TEXT UINT64_MAX
+
+typedef struct {
+        char magic[8];
+        uint32_t version;
+        uint32_t csv;
+        char separators[32];
+        uint64_t size; /* Of the file, when the cache was built */
+        int64_t mtime_sec;
+        int64_t mtime_nsec;
+        uint64_t n_rows;
+        uint64_t n_columns;
+        /* Offsets of the sections in the sidecar */
+        uint64_t rows; /* uint64_t[n_rows + 1], offset of each record */
+        uint64_t fields; /* uint32_t[n_rows], columns of each record */
+        uint64_t columns; /* cache_column[n_columns] */
+        uint64_t text; /* Unquoted text of the cells that had quotes */
+        uint64_t text_size;
+} cache_header;
+
+/* Offsets of the arrays of a column, one element per record */
+typedef struct {
+        uint64_t starts; /* uint32_t, in its record (CACHE_NONE: no cell) */
+        uint64_t lengths; /* uint32_t */
+        uint64_t texts; /* uint64_t, in text (CACHE_RAW_TEXT: as read) */
+        uint64_t separators; /* uint8_t, 0 after the last one */
+        uint64_t types; /* uint8_t, IS_NUMBER_RETURN */
+        uint64_t numbers; /* double, 0 if no cell of the column is a number */
+} cache_column;
+
+struct texler_cache {
+        char *path;
+        char *sidecar;
+        char *separators;
+        struct stat source;
+        bool built; /* Building it was tried */
+
+        const char *map;
+        size_t map_size;
+        const cache_header *header;
+        const uint64_t *rows;
+        const uint32_t *fields;
+        const cache_column *columns;
+
+        const char *record; /* Record being split, NULL if not cached */
+        uint64_t row;
+        uint64_t next_row;
+        uint32_t column; /* Next column returned */
+
+        const char *cell; /* Last cell returned and what it is */
+        size_t cell_length;
+        IS_NUMBER_RETURN cell_type;
+        double cell_number;
+        bool cell_parsed; /* cell_number is set (a numeric column) */
+};
+
+/* Arrays of a column, in the order they are written */
+typedef enum {
+        ARRAY_STARTS = 0,
+        ARRAY_LENGTHS,
+        ARRAY_TEXTS,
+        ARRAY_SEPARATORS,
+        ARRAY_TYPES,
+        ARRAY_NUMBERS,
+        N_ARRAY
+} cache_array;
+
+/* A cell while the sidecar is built */
+typedef struct {
+        uint32_t start;
+        uint32_t length;
+        uint64_t text;
+        double number;
+        uint8_t separator;
+        uint8_t type;
+} cache_cell;
+
+typedef struct {
+        cache_cell *cells;
+        size_t n_cells;
+        size_t cells_capacity;
+        uint64_t *rows; /* Offset of each record */
+        uint64_t *first_cells; /* Index in cells of the first of each */
+        size_t n_rows;
+        size_t rows_capacity;
+        char *text;
+        size_t text_size;
+        size_t text_capacity;
+} cache_builder;
+
+static void *grow(void *array, size_t *capacity, size_t needed, size_t size)
+{
+        if (needed <= *capacity)
+                return array;
+
+        size_t new_capacity = *capacity == 0 ? 1024 : *capacity;
+        while (new_capacity < needed)
+                new_capacity *= 2;
+
+        array = realloc(array, new_capacity * size);
+        if (array == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        *capacity = new_capacity;
+
+        return array;
+}
+
+static bool cache_enabled(void)
+{
+        const char *env = getenv("TEXLER_SIDECAR");
+
+        return env != NULL && *env != '\0' && strcmp(env, "0") != 0;
+}
+
+static bool same_source(const struct stat *a, const struct stat *b)
+{
+        return a->st_size == b->st_size &&
+               a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+               a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+static bool section_fits(const texler_cache *cache, uint64_t offset,
+                         uint64_t size)
+{
+        return offset <= cache->map_size && size <= cache->map_size - offset;
+}
+
+/* Maps the sidecar if it was built from this very file */
+static bool map_sidecar(texler_cache *cache)
+{
+        int fd = open(cache->sidecar, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+                return false;
+
+        struct stat st;
+        if (fstat(fd, &st) || (size_t)st.st_size < sizeof(cache_header)) {
+                close(fd);
+                return false;
+        }
+
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+                return false;
+
+        cache->map = (const char *)map;
+        cache->map_size = st.st_size;
+        const cache_header *header = (const cache_header *)map;
+        uint64_t n_rows = header->n_rows;
+        uint64_t n_columns = header->n_columns;
+
+        bool valid =
+                memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+                header->version == CACHE_VERSION &&
+                header->csv == (strcmp(cache->separators, ",") == 0) &&
+                strncmp(header->separators, cache->separators,
+                        sizeof(header->separators)) == 0 &&
+                header->size == (uint64_t)cache->source.st_size &&
+                header->mtime_sec == cache->source.st_mtim.tv_sec &&
+                header->mtime_nsec == cache->source.st_mtim.tv_nsec &&
+                n_rows < UINT32_MAX && n_columns < UINT32_MAX &&
+                section_fits(cache, header->rows,
+                             (n_rows + 1) * sizeof(uint64_t)) &&
+                section_fits(cache, header->fields,
+                             n_rows * sizeof(uint32_t)) &&
+                section_fits(cache, header->columns,
+                             n_columns * sizeof(cache_column)) &&
+                section_fits(cache, header->text, header->text_size);
+
+        for (uint64_t i = 0; valid && i < n_columns; i++) {
+                const cache_column *column =
+                        (const cache_column *)(cache->map + header->columns) +
+                        i;
+                valid = section_fits(cache, column->starts,
+                                     n_rows * sizeof(uint32_t)) &&
+                        section_fits(cache, column->lengths,
+                                     n_rows * sizeof(uint32_t)) &&
+                        section_fits(cache, column->texts,
+                                     n_rows * sizeof(uint64_t)) &&
+                        section_fits(cache, column->separators, n_rows) &&
+                        section_fits(cache, column->types, n_rows) &&
+                        (column->numbers == 0 ||
+                         section_fits(cache, column->numbers,
+                                      n_rows * sizeof(double)));
+        }
+
+        if (valid == false) {
+                munmap(map, cache->map_size);
+                cache->map = NULL;
+                return false;
+        }
+
+        cache->header = header;
+        cache->rows = (const uint64_t *)(cache->map + header->rows);
+        cache->fields = (const uint32_t *)(cache->map + header->fields);
+        cache->columns = (const cache_column *)(cache->map + header->columns);
+
+        return true;
+}
+
+/*
+ * Cache of the file at path, split with separators. NULL unless
+ * TEXLER_SIDECAR is set and the file is a regular one.
+ */
+texler_cache *open_cache(const char *path, const char *separators)
+{
+        if (path == NULL || separators == NULL || cache_enabled() == false ||
+            strlen(separators) >= sizeof(((cache_header *)NULL)->separators))
+                return NULL;
+
+        struct stat source;
+        if (stat(path, &source) || S_ISREG(source.st_mode) == false)
+                return NULL;
+
+        texler_cache *cache = (texler_cache *)calloc(1, sizeof(texler_cache));
+        char *sidecar = (char *)malloc(strlen(path) + sizeof(CACHE_SUFFIX));
+        if (cache == NULL || sidecar == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        strcpy(sidecar, path);
+        strcat(sidecar, CACHE_SUFFIX);
+
+        cache->path = strdup(path);
+        cache->sidecar = sidecar;
+        cache->separators = strdup(separators);
+        if (cache->path == NULL || cache->separators == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        cache->source = source;
+        map_sidecar(cache);
+
+        return cache;
+}
+
+void free_cache(texler_cache *cache)
+{
+        if (cache == NULL)
+                return;
+
+        if (cache->map != NULL)
+                munmap((void *)cache->map, cache->map_size);
+        free(cache->path);
+        free(cache->sidecar);
+        free(cache->separators);
+        free(cache);
+}
+
+static void add_cell(cache_builder *builder, const char *record,
+                     const char *start, const char *text, long length,
+                     int separator)
+{
+        size_t text_length = length == 0 ? 0 : length - 1;
+
+        builder->cells = (cache_cell *)grow(builder->cells,
+                                            &builder->cells_capacity,
+                                            builder->n_cells + 1,
+                                            sizeof(cache_cell));
+        cache_cell *cell = &builder->cells[builder->n_cells++];
+        cell->start = start - record;
+        cell->length = text_length;
+        cell->separator = separator;
+        cell->type = is_number((char *)text, text_length);
+        cell->number = atof(text);
+
+        if (memcmp(start, text, text_length) == 0) {
+                cell->text = CACHE_RAW_TEXT;
+                return;
+        }
+
+        builder->text = (char *)grow(builder->text, &builder->text_capacity,
+                                     builder->text_size + text_length, 1);
+        memcpy(builder->text + builder->text_size, text, text_length);
+        cell->text = builder->text_size;
+        builder->text_size += text_length;
+}
+
+static void add_row(cache_builder *builder, uint64_t offset)
+{
+        if (builder->n_rows + 2 > builder->rows_capacity) {
+                size_t capacity = builder->rows_capacity;
+                builder->rows = (uint64_t *)grow(builder->rows, &capacity,
+                                                 builder->n_rows + 2,
+                                                 sizeof(uint64_t));
+                builder->first_cells = (uint64_t *)grow(
+                        builder->first_cells, &builder->rows_capacity,
+                        builder->n_rows + 2, sizeof(uint64_t));
+        }
+
+        builder->rows[builder->n_rows] = offset;
+        builder->first_cells[builder->n_rows] = builder->n_cells;
+        builder->n_rows++;
+}
+
+/* Splits the whole file the way a columns().lines() loop does */
+static bool read_cells(texler_cache *cache, cache_builder *builder)
+{
+        TexlerObject *file = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        if (file == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        if (open_file(cache->path, "r", file, cache->separators) == false) {
+                free(file);
+                return false;
+        }
+        /* It is the one being built */
+        free_cache(file->value.file.cache);
+        file->value.file.cache = NULL;
+
+        char *line = (char *)calloc(BUFFER_SIZE, sizeof(char));
+        char *cell = (char *)calloc(BUFFER_SIZE, sizeof(char));
+        if (line == NULL || cell == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        bool read = true;
+        off_t offset = 0;
+        while (records(file, &line) > 0) {
+                add_row(builder, offset);
+
+                char *remaining = line;
+                while (remaining != NULL) {
+                        const char *start = remaining;
+                        int separator = 0;
+                        long length = file_columns(file, &remaining, &cell,
+                                                   &separator);
+                        add_cell(builder, line, start, cell, length,
+                                 separator);
+                }
+
+                offset = ftello(file->value.file.stream);
+                if (offset < 0 || strlen(line) > UINT32_MAX) {
+                        read = false;
+                        break;
+                }
+        }
+        add_row(builder, offset);
+        builder->n_rows--;
+
+        free(cell);
+        free(line);
+        free_texlerobject(file);
+
+        return read;
+}
+
+static bool write_all(int fd, const void *data, size_t size, uint64_t *offset)
+{
+        const char *bytes = (const char *)data;
+
+        while (size > 0) {
+                ssize_t n = write(fd, bytes, size);
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n <= 0)
+                        return false;
+                bytes += n;
+                size -= n;
+                *offset += n;
+        }
+
+        return true;
+}
+
+/* Pads the sidecar to 8 bytes, so that every array is aligned */
+static bool align(int fd, uint64_t *offset)
+{
+        static const char zeros[8];
+
+        return write_all(fd, zeros, (8 - *offset % 8) % 8, offset);
+}
+
+/* Writes the array 'what' of column c, for every record */
+static bool write_column_array(int fd, const cache_builder *builder,
+                               size_t c, cache_array what, uint64_t *offset)
+{
+        char block[4096];
+        size_t used = 0;
+
+        for (size_t row = 0; row < builder->n_rows; row++) {
+                uint64_t first = builder->first_cells[row];
+                uint64_t n_fields = builder->first_cells[row + 1] - first;
+                const cache_cell *cell =
+                        c < n_fields ? &builder->cells[first + c] : NULL;
+
+                union {
+                        uint32_t u32;
+                        uint64_t u64;
+                        uint8_t u8;
+                        double real;
+                } value;
+                size_t size = 0;
+                switch (what) {
+                case ARRAY_STARTS:
+                        value.u32 = cell ? cell->start : CACHE_NONE;
+                        size = sizeof(uint32_t);
+                        break;
+                case ARRAY_LENGTHS:
+                        value.u32 = cell ? cell->length : 0;
+                        size = sizeof(uint32_t);
+                        break;
+                case ARRAY_TEXTS:
+                        value.u64 = cell ? cell->text : CACHE_RAW_TEXT;
+                        size = sizeof(uint64_t);
+                        break;
+                case ARRAY_SEPARATORS:
+                        value.u8 = cell ? cell->separator : 0;
+                        size = sizeof(uint8_t);
+                        break;
+                case ARRAY_TYPES:
+                        value.u8 = cell ? cell->type : IS_NUMBER_RETURN_NAN;
+                        size = sizeof(uint8_t);
+                        break;
+                case ARRAY_NUMBERS:
+                default:
+                        value.real = cell ? cell->number : 0;
+                        size = sizeof(double);
+                        break;
+                }
+
+                if (used + size > sizeof(block)) {
+                        if (write_all(fd, block, used, offset) == false)
+                                return false;
+                        used = 0;
+                }
+                memcpy(block + used, &value, size);
+                used += size;
+        }
+
+        return write_all(fd, block, used, offset) && align(fd, offset);
+}
+
+static bool has_numbers(const cache_builder *builder, size_t c)
+{
+        for (size_t row = 0; row < builder->n_rows; row++) {
+                uint64_t first = builder->first_cells[row];
+                if (c < builder->first_cells[row + 1] - first &&
+                    builder->cells[first + c].type != IS_NUMBER_RETURN_NAN)
+                        return true;
+        }
+
+        return false;
+}
+
+static bool write_sidecar(int fd, const texler_cache *cache,
+                          const cache_builder *builder)
+{
+        size_t n_columns = 0;
+        for (size_t row = 0; row < builder->n_rows; row++) {
+                size_t n_fields = builder->first_cells[row + 1] -
+                                  builder->first_cells[row];
+                if (n_fields > n_columns)
+                        n_columns = n_fields;
+        }
+
+        cache_header header = { .version = CACHE_VERSION };
+        memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.csv = strcmp(cache->separators, ",") == 0;
+        strncpy(header.separators, cache->separators,
+                sizeof(header.separators) - 1);
+        header.size = cache->source.st_size;
+        header.mtime_sec = cache->source.st_mtim.tv_sec;
+        header.mtime_nsec = cache->source.st_mtim.tv_nsec;
+        header.n_rows = builder->n_rows;
+        header.n_columns = n_columns;
+
+        cache_column *columns =
+                (cache_column *)calloc(n_columns + 1, sizeof(cache_column));
+        uint32_t *fields =
+                (uint32_t *)calloc(builder->n_rows + 1, sizeof(uint32_t));
+        if (columns == NULL || fields == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        for (size_t row = 0; row < builder->n_rows; row++)
+                fields[row] = builder->first_cells[row + 1] -
+                              builder->first_cells[row];
+
+        /* The header and column table go last, once their offsets are known */
+        uint64_t offset = sizeof(header);
+        bool written = lseek(fd, offset, SEEK_SET) == (off_t)offset;
+
+        header.rows = offset;
+        written = written &&
+                  write_all(fd, builder->rows,
+                            (builder->n_rows + 1) * sizeof(uint64_t),
+                            &offset);
+        header.fields = offset;
+        written = written &&
+                  write_all(fd, fields, builder->n_rows * sizeof(uint32_t),
+                            &offset) &&
+                  align(fd, &offset);
+        header.text = offset;
+        header.text_size = builder->text_size;
+        written = written &&
+                  write_all(fd, builder->text, builder->text_size, &offset) &&
+                  align(fd, &offset);
+
+        for (size_t c = 0; written && c < n_columns; c++) {
+                uint64_t *arrays[N_ARRAY] = {
+                        [ARRAY_STARTS] = &columns[c].starts,
+                        [ARRAY_LENGTHS] = &columns[c].lengths,
+                        [ARRAY_TEXTS] = &columns[c].texts,
+                        [ARRAY_SEPARATORS] = &columns[c].separators,
+                        [ARRAY_TYPES] = &columns[c].types,
+                        [ARRAY_NUMBERS] = &columns[c].numbers,
+                };
+                /* Numbers are only kept for columns that have some */
+                cache_array n_arrays =
+                        has_numbers(builder, c) ? N_ARRAY : ARRAY_NUMBERS;
+                for (cache_array what = 0; written && what < n_arrays;
+                     what++) {
+                        *arrays[what] = offset;
+                        written = write_column_array(fd, builder, c, what,
+                                                     &offset);
+                }
+        }
+
+        header.columns = offset;
+        written = written &&
+                  write_all(fd, columns, n_columns * sizeof(cache_column),
+                            &offset);
+
+        uint64_t start = 0;
+        written = written && lseek(fd, 0, SEEK_SET) == 0 &&
+                  write_all(fd, &header, sizeof(header), &start);
+
+        free(fields);
+        free(columns);
+
+        return written;
+}
+
+/*
+ * Splits the file and writes its sidecar. Written to a temporary file and
+ * renamed, so programs running at the same time never map half of one.
+ */
+static void build_cache(texler_cache *cache)
+{
+        cache->built = true;
+
+        cache_builder builder = { 0 };
+        bool read = read_cells(cache, &builder);
+
+        struct stat after;
+        if (read && stat(cache->path, &after) == 0 &&
+            same_source(&after, &cache->source)) {
+                char *temporary = (char *)malloc(strlen(cache->sidecar) +
+                                                 sizeof(".XXXXXX"));
+                if (temporary == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+                strcpy(temporary, cache->sidecar);
+                strcat(temporary, ".XXXXXX");
+
+                /* A folder that cannot be written just has no cache */
+                int fd = mkstemp(temporary);
+                if (fd >= 0) {
+                        /* Holds the text: same permissions as the file */
+                        mode_t mode = cache->source.st_mode & 0666;
+                        bool written = fchmod(fd, mode) == 0 &&
+                                       write_sidecar(fd, cache, &builder);
+                        if (close(fd))
+                                written = false;
+                        if (written == false ||
+                            rename(temporary, cache->sidecar))
+                                unlink(temporary);
+                }
+                free(temporary);
+        }
+
+        free(builder.cells);
+        free(builder.rows);
+        free(builder.first_cells);
+        free(builder.text);
+
+        map_sidecar(cache);
+}
+
+static const void *column_array(const texler_cache *cache, uint64_t offset)
+{
+        return cache->map + offset;
+}
+
+static uint32_t cell_start(const texler_cache *cache, uint32_t column)
+{
+        const uint32_t *starts = (const uint32_t *)column_array(
+                cache, cache->columns[column].starts);
+
+        return starts[cache->row];
+}
+
+static int compare_offsets(const void *a, const void *b)
+{
+        uint64_t left = *(const uint64_t *)a;
+        uint64_t right = *(const uint64_t *)b;
+
+        return (left > right) - (left < right);
+}
+
+/*
+ * Called by records() once it read the line of length 'length' (plus one)
+ * into *buffer: true if that line is a whole record the cache has, whose
+ * columns cached_column() returns from now on. Builds the sidecar the
+ * first time.
+ */
+bool cached_record(TexlerObject *tex_obj, char **buffer, long length)
+{
+        texler_cache *cache = tex_obj->value.file.cache;
+
+        cache->record = NULL;
+        if (cache->map == NULL && cache->built == false)
+                build_cache(cache);
+        if (cache->map == NULL)
+                return false;
+
+        off_t end = ftello(tex_obj->value.file.stream);
+        if (end < length - 1)
+                return false;
+        uint64_t start = end - (length - 1);
+
+        uint64_t row = cache->next_row;
+        uint64_t n_rows = cache->header->n_rows;
+        if (row >= n_rows || cache->rows[row] != start) {
+                const uint64_t *found = (const uint64_t *)bsearch(
+                        &start, cache->rows, n_rows, sizeof(uint64_t),
+                        compare_offsets);
+                if (found == NULL)
+                        return false;
+                row = found - cache->rows;
+        }
+        cache->next_row = row + 1;
+
+        /* Records of several lines (CSV) are joined by records() */
+        if (cache->rows[row + 1] != (uint64_t)end)
+                return false;
+
+        cache->record = *buffer;
+        cache->row = row;
+        cache->column = 0;
+        return true;
+}
+
+/*
+ * columns() of the record cached_record() accepted: copies the next
+ * column into *buffer, or skips it if buffer is NULL. False if *str is not
+ * where that column starts, so the caller splits it itself.
+ */
+bool cached_column(texler_cache *cache, char **str, char **buffer,
+                   int *separator, long *length)
+{
+        if (cache == NULL)
+                return false;
+
+        /* Whatever the caller returns now is not the cell cached before */
+        if (buffer != NULL)
+                cache->cell = NULL;
+
+        if (cache->record == NULL || *str == NULL ||
+            cache->column >= cache->fields[cache->row] ||
+            *str < cache->record ||
+            (size_t)(*str - cache->record) !=
+                    cell_start(cache, cache->column))
+                return false;
+
+        const cache_column *column = &cache->columns[cache->column];
+        uint64_t row = cache->row;
+
+        if (buffer != NULL) {
+                uint32_t cell_length =
+                        ((const uint32_t *)column_array(cache,
+                                                        column->lengths))[row];
+                uint64_t text = ((const uint64_t *)column_array(
+                        cache, column->texts))[row];
+                const char *source = text == CACHE_RAW_TEXT ?
+                                             *str :
+                                             cache->map + cache->header->text +
+                                                     text;
+
+                char *new_buffer = (char *)realloc(*buffer, cell_length + 1);
+                if (new_buffer == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+                memcpy(new_buffer, source, cell_length);
+                new_buffer[cell_length] = '\0';
+                *buffer = new_buffer;
+
+                uint8_t found = ((const uint8_t *)column_array(
+                        cache, column->separators))[row];
+                if (found != 0)
+                        *separator = found;
+
+                cache->cell = new_buffer;
+                cache->cell_length = cell_length;
+                cache->cell_type = ((const uint8_t *)column_array(
+                        cache, column->types))[row];
+                cache->cell_parsed = column->numbers != 0;
+                if (cache->cell_parsed)
+                        cache->cell_number = ((const double *)column_array(
+                                cache, column->numbers))[row];
+
+                /* buffer contains '\0' */
+                *length = cell_length == 0 ? 0 : cell_length + 1;
+        }
+
+        cache->column++;
+        if (cache->column < cache->fields[row]) {
+                *str = (char *)cache->record +
+                       cell_start(cache, cache->column);
+        } else {
+                *str = NULL;
+                cache->record = NULL;
+        }
+
+        return true;
+}
+
+/* Drops the rest of the record, as end_csv_record() */
+void end_cached_record(texler_cache *cache)
+{
+        if (cache != NULL)
+                cache->record = NULL;
+}
+
+/* The cell of a columns().lines() loop, as returned by the cache */
+static bool is_cached_cell(const texler_cache *cache, const char *cell)
+{
+        return cache != NULL && cell != NULL && cell == cache->cell &&
+               cell[cache->cell_length] == '\0';
+}
+
+/* is_number() of a cell of tex_obj, parsed already if it is cached */
+IS_NUMBER_RETURN cell_type(const TexlerObject *tex_obj, char *cell)
+{
+        if (tex_obj != NULL && tex_obj->type == TYPE_T_FILEPTR &&
+            is_cached_cell(tex_obj->value.file.cache, cell))
+                return tex_obj->value.file.cache->cell_type;
+
+        return is_number(cell, cell == NULL ? 0 : strlen(cell));
+}
+
+/* atof() of a cell of tex_obj, parsed already if it is cached */
+double cell_real(const TexlerObject *tex_obj, char *cell)
+{
+        if (tex_obj != NULL && tex_obj->type == TYPE_T_FILEPTR &&
+            is_cached_cell(tex_obj->value.file.cache, cell) &&
+            tex_obj->value.file.cache->cell_parsed)
+                return tex_obj->value.file.cache->cell_number;
+
+        return atof(cell);
+}
+
+/* Number in cell, if all of it is one (cell_type() or strtod()) */
+bool cell_value(const TexlerObject *tex_obj, char *cell, double *number)
+{
+        if (*cell == '\0')
+                return false;
+        if (cell_type(tex_obj, cell) != IS_NUMBER_RETURN_NAN) {
+                *number = cell_real(tex_obj, cell);
+                return true;
+        }
+
+        char *end = NULL;
+        *number = strtod(cell, &end);
+
+        return *end == '\0' && !isnan(*number);
+}
@@ -0,0 +1,180 @@
+#include "texler_runtime.h"
+
+/*
+ * Copies the first column of *str into *buffer and advances *str past it
+ * and its separator (NULL once the line is consumed). The separator found
+ * is stored in *separator.
+ */
+long int columns(char **str, char *separators, char **buffer, int *separator)
+{
+        char *seps = separators;
+        if (separators == NULL)
+                seps = TEXLER_DEFAULT_SEPARATORS;
+
+        char *column_last_character = strpbrk(*str, seps);
+        /* Value to return in *str */
+        char *next_column = column_last_character;
+
+        long int new_size = 1; /* '\0' */
+        if (column_last_character == NULL)
+                new_size += strlen(*str);
+        else
+                new_size += (column_last_character - *str);
+
+        char *new_buffer = (char *)realloc(*buffer, new_size);
+        if (new_buffer == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        new_buffer[new_size - 1] = '\0';
+        strncpy(new_buffer, *str, new_size - 1);
+
+        /* buffer contains '\0' */
+        if (new_size == 1)
+                new_size = 0;
+
+        *buffer = new_buffer;
+
+        if (next_column != NULL && *next_column != '\0' &&
+            strchr(seps, *next_column) != NULL) {
+                *separator = *next_column++;
+        }
+
+        *str = (next_column == NULL || *next_column == '\0') ? NULL :
+                                                                next_column;
+
+        return new_size;
+}
+
+/* Leaves *str past its first column, as columns() does, without copying it */
+static void skip_column(char **str, const char *separators)
+{
+        char *next_column = strpbrk(*str, separators);
+
+        if (next_column != NULL)
+                next_column++;
+        *str = (next_column == NULL || *next_column == '\0') ? NULL :
+                                                                next_column;
+}
+
+/*
+ * Makes the columns().lines() loops of tex_obj return only the given
+ * columns (1-based, sorted and without repetitions). NULL returns them all.
+ */
+void project_columns(TexlerObject *tex_obj, const unsigned long *columns,
+                     size_t n_columns)
+{
+        texler_projection *projection = &tex_obj->value.file.projection;
+
+        projection->columns = n_columns == 0 ? NULL : columns;
+        projection->n_columns = n_columns;
+        projection->next = 0;
+        projection->column = 0;
+        projection->cursor = NULL;
+}
+
+static long next_column(TexlerObject *tex_obj, char **str, char **buffer,
+                        int *separator)
+{
+        long length = 0;
+        if (cached_column(tex_obj->value.file.cache, str, buffer, separator,
+                          &length))
+                return length;
+
+        if (tex_obj->value.file.csv != NULL)
+                return csv_columns(tex_obj->value.file.csv, str, buffer,
+                                   separator);
+
+        return columns(str, tex_obj->value.file.separators, buffer, separator);
+}
+
+/* Skips the columns of *str before the next one projected */
+static void skip_columns(TexlerObject *tex_obj, char **str)
+{
+        texler_projection *projection = &tex_obj->value.file.projection;
+        const char *separators = tex_obj->value.file.separators;
+        if (separators == NULL)
+                separators = TEXLER_DEFAULT_SEPARATORS;
+
+        if (projection->next == projection->n_columns) {
+                /* The rest of the line is not split */
+                *str = NULL;
+                if (tex_obj->value.file.csv != NULL)
+                        end_csv_record(tex_obj->value.file.csv);
+                end_cached_record(tex_obj->value.file.cache);
+                return;
+        }
+
+        while (*str != NULL &&
+               projection->column < projection->columns[projection->next]) {
+                if (cached_column(tex_obj->value.file.cache, str, NULL,
+                                  NULL, NULL) == false) {
+                        if (tex_obj->value.file.csv != NULL)
+                                skip_csv_column(tex_obj->value.file.csv, str);
+                        else
+                                skip_column(str, separators);
+                }
+                projection->column++;
+        }
+}
+
+/*
+ * columns() for the columns().lines() loops of tex_obj, in CSV mode when it
+ * was declared with [","]. With a projection (project_columns()) the line
+ * is split up to its last projected column only, and the columns between
+ * them are skipped without being copied. The separator of the last one is
+ * dropped and it gets the '\n' of the line, so the projected line reads as
+ * the original one.
+ */
+long file_columns(TexlerObject *tex_obj, char **str, char **buffer,
+                  int *separator)
+{
+        texler_projection *projection = &tex_obj->value.file.projection;
+        if (projection->columns == NULL)
+                return next_column(tex_obj, str, buffer, separator);
+
+        if (*str != projection->cursor) {
+                /* A new line */
+                projection->next = 0;
+                projection->column = 1;
+                skip_columns(tex_obj, str);
+        }
+        if (*str == NULL) {
+                /* Shorter than the first column projected */
+                projection->cursor = NULL;
+                if (*buffer != NULL)
+                        (*buffer)[0] = '\0';
+                return 0;
+        }
+
+        int found = 0;
+        long length = next_column(tex_obj, str, buffer, &found);
+        projection->column++;
+        projection->next++;
+
+        const char *rest = *str;
+        skip_columns(tex_obj, str);
+        projection->cursor = *str;
+        if (*str != NULL) {
+                *separator = found;
+                return length;
+        }
+
+        /* The last column of the line already has its '\n' */
+        size_t rest_length = rest == NULL ? 0 : strlen(rest);
+        if (rest_length == 0 || rest[rest_length - 1] != '\n')
+                return length;
+
+        size_t cell_length = length == 0 ? 0 : length - 1;
+        char *new_buffer = (char *)realloc(*buffer, cell_length + 2);
+        if (new_buffer == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        new_buffer[cell_length] = '\n';
+        new_buffer[cell_length + 1] = '\0';
+        *buffer = new_buffer;
+
+        return cell_length + 2;
+}
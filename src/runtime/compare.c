@@ -0,0 +1,45 @@
+#include <float.h>
+#include <math.h>
+
+#include "texler_runtime.h"
+
+bool compare_equality(TexlerObject *left, TexlerObject *right)
+{
+        if ((left->type == TYPE_T_BOOLEAN || left->type == TYPE_T_INTEGER) &&
+            (right->type == TYPE_T_BOOLEAN || right->type == TYPE_T_INTEGER)) {
+                return (left->value.integer - right->value.integer) == 0;
+        } else if ((left->type == TYPE_T_REAL &&
+                    (right->type == TYPE_T_BOOLEAN ||
+                     right->type == TYPE_T_INTEGER ||
+                     right->type == TYPE_T_REAL)) ||
+                   (right->type == TYPE_T_REAL &&
+                    (left->type == TYPE_T_BOOLEAN ||
+                     left->type == TYPE_T_INTEGER ||
+                     left->type == TYPE_T_REAL))) {
+                return fabs(left->value.real - right->value.real) <
+                       DBL_EPSILON;
+        } else if (left->type == TYPE_T_STRING &&
+                   right->type == TYPE_T_STRING) {
+                return strcmp(left->value.string, right->value.string) == 0;
+        }
+
+        return false;
+}
+
+bool compare_equality_constant_number_int(long left, TexlerObject *right)
+{
+        if (right->type == TYPE_T_BOOLEAN || right->type == TYPE_T_INTEGER)
+                return (left - right->value.integer) == 0;
+        else if (right->type == TYPE_T_REAL)
+                return fabs((double)left - right->value.real) < DBL_EPSILON;
+
+        return false;
+}
+
+bool compare_equality_constant_string(char *left, TexlerObject *right)
+{
+        if (right->type == TYPE_T_STRING)
+                return strcmp(left, right->value.string) == 0;
+
+        return false;
+}
@@ -0,0 +1,760 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "texler_runtime.h"
+
+/*
+ * Compressed files (io.c). Inputs compressed with gzip, or with zstd if the
+ * runtime was built with libzstd, are recognised by their first bytes and
+ * read decompressed; outputs named *.gz or *.zst are compressed as they
+ * are written. Either way the program gets a plain FILE * (fopencookie()),
+ * so lines(), columns() and the rest of the runtime work unchanged.
+ *
+ * Inputs are decompressed ahead of the program by a thread, into a ring of
+ * COMPRESS_SLOTS blocks guarded by a mutex, as prefetch.c does with files.
+ * Without a core to spare (pipeline_threads() in io.c) the same blocks are
+ * decompressed on the program thread when it asks for them. The block read
+ * before the current one is kept, so the short seeks back of seek_line()
+ * stay in memory; a seek further back starts decompressing from the top.
+ *
+ * Outputs are compressed on the program thread, block by block.
+ */
+
+#define COMPRESS_BLOCK_SIZE (256 * 1024)
+#define COMPRESS_SLOTS 4
+
+static const unsigned char gzip_magic[] = { 0x1f, 0x8b };
+static const unsigned char zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+typedef struct {
+        char *data;
+        ssize_t length; /* 0 at EOF, -1 on error */
+        off_t offset;   /* In the decompressed file */
+        int error;
+} compress_block;
+
+typedef struct {
+        int fd;
+        TEXLER_COMPRESSION format;
+        bool threaded;
+
+        /* Compressed bytes, read from fd by the decompressing side only */
+        unsigned char *input;
+        size_t input_length;
+        size_t input_pos;
+        off_t input_offset;
+        bool input_end;
+        bool in_frame; /* Inside a gzip member or zstd frame */
+        off_t produced; /* Decompressed bytes so far */
+#ifdef HAVE_ZLIB
+        z_stream gzip;
+#endif
+#ifdef HAVE_ZSTD
+        ZSTD_DStream *zstd;
+#endif
+
+        compress_block slots[COMPRESS_SLOTS];
+        /* Blocks decompressed, released and being read, only incremented */
+        size_t head;
+        size_t tail;
+        size_t reading;
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+        pthread_t thread;
+        bool running;
+        bool stop;
+
+        size_t current_pos; /* In the block being read */
+        off_t position;     /* Logical offset of the stream */
+} decompressor;
+
+typedef struct {
+        int fd;
+        TEXLER_COMPRESSION format;
+        unsigned char *output;
+        off_t position;
+#ifdef HAVE_ZLIB
+        z_stream gzip;
+#endif
+#ifdef HAVE_ZSTD
+        ZSTD_CStream *zstd;
+#endif
+} compressor;
+
+/* Format of the file fd, told by its first bytes; fd is not moved */
+TEXLER_COMPRESSION input_compression(int fd)
+{
+        unsigned char magic[sizeof(zstd_magic)];
+        ssize_t n;
+        do {
+                n = pread(fd, magic, sizeof(magic), 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n >= (ssize_t)sizeof(gzip_magic) &&
+            memcmp(magic, gzip_magic, sizeof(gzip_magic)) == 0)
+                return TEXLER_COMPRESSION_GZIP;
+        if (n >= (ssize_t)sizeof(zstd_magic) &&
+            memcmp(magic, zstd_magic, sizeof(zstd_magic)) == 0)
+                return TEXLER_COMPRESSION_ZSTD;
+
+        return TEXLER_COMPRESSION_NONE;
+}
+
+static bool has_suffix(const char *name, const char *suffix)
+{
+        size_t name_len = strlen(name);
+        size_t suffix_len = strlen(suffix);
+
+        return name_len > suffix_len &&
+               strcmp(name + name_len - suffix_len, suffix) == 0;
+}
+
+/* Format an output file is written in, told by its name */
+TEXLER_COMPRESSION output_compression(const char *name)
+{
+        if (name == NULL)
+                return TEXLER_COMPRESSION_NONE;
+        if (has_suffix(name, ".gz"))
+                return TEXLER_COMPRESSION_GZIP;
+        if (has_suffix(name, ".zst"))
+                return TEXLER_COMPRESSION_ZSTD;
+
+        return TEXLER_COMPRESSION_NONE;
+}
+
+static void *compress_malloc(size_t size)
+{
+        void *ptr = malloc(size);
+        if (ptr == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        return ptr;
+}
+
+/* Decompressing from the start of the file */
+static bool start_decoder(decompressor *d)
+{
+        d->input_length = 0;
+        d->input_pos = 0;
+        d->input_offset = 0;
+        d->input_end = false;
+        d->in_frame = false;
+        d->produced = 0;
+
+        switch (d->format) {
+#ifdef HAVE_ZLIB
+        case TEXLER_COMPRESSION_GZIP:
+                memset(&d->gzip, 0, sizeof(d->gzip));
+                /* 32: gzip header, 15: largest window */
+                if (inflateInit2(&d->gzip, 32 + 15) == Z_OK)
+                        return true;
+                errno = ENOMEM;
+                return false;
+#endif
+#ifdef HAVE_ZSTD
+        case TEXLER_COMPRESSION_ZSTD:
+                d->zstd = ZSTD_createDStream();
+                if (d->zstd != NULL &&
+                    ZSTD_isError(ZSTD_initDStream(d->zstd)) == 0)
+                        return true;
+                errno = ENOMEM;
+                return false;
+#endif
+        default:
+                errno = ENOTSUP;
+                return false;
+        }
+}
+
+static void end_decoder(decompressor *d)
+{
+        switch (d->format) {
+#ifdef HAVE_ZLIB
+        case TEXLER_COMPRESSION_GZIP:
+                inflateEnd(&d->gzip);
+                break;
+#endif
+#ifdef HAVE_ZSTD
+        case TEXLER_COMPRESSION_ZSTD:
+                ZSTD_freeDStream(d->zstd);
+                d->zstd = NULL;
+                break;
+#endif
+        default:
+                break;
+        }
+}
+
+/* Reads more compressed bytes once the previous ones were used */
+static bool fill_input(decompressor *d)
+{
+        if (d->input_pos < d->input_length || d->input_end)
+                return true;
+
+        ssize_t n;
+        do {
+                n = pread(d->fd, d->input, COMPRESS_BLOCK_SIZE,
+                          d->input_offset);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0)
+                return false;
+
+        d->input_length = n;
+        d->input_pos = 0;
+        d->input_offset += n;
+        d->input_end = n == 0;
+
+        return true;
+}
+
+/*
+ * Decompresses the next bytes into block->data, up to its size. Returns
+ * false on a corrupt or truncated file; gzip files of several members
+ * (cat a.gz b.gz) are read as one, like gzip -d does.
+ */
+static bool decode(decompressor *d, compress_block *block)
+{
+        switch (d->format) {
+#ifdef HAVE_ZLIB
+        case TEXLER_COMPRESSION_GZIP: {
+                z_stream *z = &d->gzip;
+                z->next_in = d->input + d->input_pos;
+                z->avail_in = d->input_length - d->input_pos;
+                z->next_out = (unsigned char *)block->data + block->length;
+                z->avail_out = COMPRESS_BLOCK_SIZE - block->length;
+
+                int ret = inflate(z, Z_NO_FLUSH);
+                d->input_pos = d->input_length - z->avail_in;
+                block->length = COMPRESS_BLOCK_SIZE - z->avail_out;
+
+                if (ret == Z_STREAM_END) {
+                        d->in_frame = false;
+                        return inflateReset(z) == Z_OK;
+                }
+                d->in_frame = true;
+                if (ret == Z_OK || (ret == Z_BUF_ERROR && z->avail_in == 0))
+                        return true;
+
+                errno = ret == Z_MEM_ERROR ? ENOMEM : EIO;
+                return false;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case TEXLER_COMPRESSION_ZSTD: {
+                ZSTD_inBuffer in = { d->input, d->input_length,
+                                     d->input_pos };
+                ZSTD_outBuffer out = { block->data, COMPRESS_BLOCK_SIZE,
+                                       block->length };
+
+                size_t ret = ZSTD_decompressStream(d->zstd, &out, &in);
+                d->input_pos = in.pos;
+                block->length = out.pos;
+                if (ZSTD_isError(ret)) {
+                        errno = EIO;
+                        return false;
+                }
+                d->in_frame = ret != 0;
+
+                return true;
+        }
+#endif
+        default:
+                errno = ENOTSUP;
+                return false;
+        }
+}
+
+/* Fills the next block of the decompressed file */
+static void decode_block(decompressor *d, compress_block *block)
+{
+        block->offset = d->produced;
+        block->length = 0;
+
+        while (block->length < COMPRESS_BLOCK_SIZE) {
+                if (fill_input(d) == false)
+                        goto error;
+                if (d->input_pos == d->input_length) {
+                        /* Ends in the middle of a member or frame */
+                        if (d->in_frame && block->length == 0) {
+                                errno = EIO;
+                                goto error;
+                        }
+                        break;
+                }
+
+                size_t input_pos = d->input_pos;
+                ssize_t length = block->length;
+                if (decode(d, block) == false)
+                        goto error;
+                /* Input left and room for more, but it cannot go on */
+                if (d->input_pos == input_pos && block->length == length &&
+                    d->in_frame) {
+                        errno = EIO;
+                        goto error;
+                }
+        }
+
+        d->produced += block->length;
+        return;
+
+error:
+        /* What was decompressed before the error is dropped with it */
+        block->error = errno;
+        block->length = -1;
+}
+
+static void *decompress_thread(void *arg)
+{
+        decompressor *d = (decompressor *)arg;
+
+        pthread_mutex_lock(&d->lock);
+        for (;;) {
+                while (d->stop == false && d->head - d->tail >= COMPRESS_SLOTS)
+                        pthread_cond_wait(&d->cond, &d->lock);
+                if (d->stop)
+                        break;
+                compress_block *block = &d->slots[d->head % COMPRESS_SLOTS];
+                pthread_mutex_unlock(&d->lock);
+
+                decode_block(d, block);
+
+                pthread_mutex_lock(&d->lock);
+                d->head++;
+                pthread_cond_broadcast(&d->cond);
+                if (block->length <= 0)
+                        break;
+        }
+        pthread_mutex_unlock(&d->lock);
+
+        return NULL;
+}
+
+/* Block at d->reading, decompressed or waited for. NULL on failure */
+static compress_block *reading_block(decompressor *d)
+{
+        if (d->threaded == false) {
+                if (d->head == d->reading) {
+                        decode_block(d, &d->slots[d->head % COMPRESS_SLOTS]);
+                        d->head++;
+                }
+                return &d->slots[d->reading % COMPRESS_SLOTS];
+        }
+
+        pthread_mutex_lock(&d->lock);
+        if (d->running == false) {
+                d->stop = false;
+                if (pthread_create(&d->thread, NULL, decompress_thread, d)) {
+                        pthread_mutex_unlock(&d->lock);
+                        return NULL;
+                }
+                d->running = true;
+        }
+        while (d->head == d->reading)
+                pthread_cond_wait(&d->cond, &d->lock);
+        pthread_mutex_unlock(&d->lock);
+
+        return &d->slots[d->reading % COMPRESS_SLOTS];
+}
+
+/* Moves on to the next block, keeping only the one read last */
+static void next_block(decompressor *d)
+{
+        if (d->threaded)
+                pthread_mutex_lock(&d->lock);
+        d->reading++;
+        if (d->reading - d->tail > 1) {
+                d->tail = d->reading - 1;
+                if (d->threaded)
+                        pthread_cond_broadcast(&d->cond);
+        }
+        if (d->threaded)
+                pthread_mutex_unlock(&d->lock);
+        d->current_pos = 0;
+}
+
+static void stop_decompressing(decompressor *d)
+{
+        if (d->running) {
+                pthread_mutex_lock(&d->lock);
+                d->stop = true;
+                pthread_cond_broadcast(&d->cond);
+                pthread_mutex_unlock(&d->lock);
+                pthread_join(d->thread, NULL);
+                d->running = false;
+        }
+
+        d->head = 0;
+        d->tail = 0;
+        d->reading = 0;
+        d->current_pos = 0;
+        d->position = 0;
+}
+
+static ssize_t decompress_read(void *cookie, char *buffer, size_t size)
+{
+        decompressor *d = (decompressor *)cookie;
+
+        compress_block *block = reading_block(d);
+        while (block != NULL && block->length > 0 &&
+               d->current_pos == (size_t)block->length) {
+                next_block(d);
+                block = reading_block(d);
+        }
+        if (block == NULL)
+                return -1;
+
+        /* The EOF or error block stays current until the next seek */
+        if (block->length < 0) {
+                errno = block->error;
+                return -1;
+        }
+        if (block->length == 0)
+                return 0;
+
+        size_t available = block->length - d->current_pos;
+        if (size > available)
+                size = available;
+        memcpy(buffer, block->data + d->current_pos, size);
+        d->current_pos += size;
+        d->position += size;
+
+        return size;
+}
+
+/* Leaves d at target, decompressing up to it */
+static bool seek_forward(decompressor *d, off_t target)
+{
+        for (;;) {
+                compress_block *block = reading_block(d);
+                if (block == NULL)
+                        return false;
+                if (block->length < 0) {
+                        errno = block->error;
+                        return false;
+                }
+
+                /* Past the end it reads EOF, as a plain file would */
+                if (block->length == 0 ||
+                    target < block->offset + block->length) {
+                        d->current_pos = block->length == 0 ?
+                                                 0 :
+                                                 target - block->offset;
+                        d->position = target;
+                        return true;
+                }
+                next_block(d);
+        }
+}
+
+static int decompress_seek(void *cookie, off64_t *offset, int whence)
+{
+        decompressor *d = (decompressor *)cookie;
+        off_t target;
+
+        switch (whence) {
+        case SEEK_SET:
+                target = *offset;
+                break;
+        case SEEK_CUR:
+                target = d->position + *offset;
+                break;
+        default:
+                /* The size is not known without decompressing it all */
+                errno = EINVAL;
+                return -1;
+        }
+        if (target < 0) {
+                errno = EINVAL;
+                return -1;
+        }
+
+        if (target != d->position) {
+                compress_block *previous =
+                        &d->slots[(d->reading - 1) % COMPRESS_SLOTS];
+                off_t start = d->reading > d->tail ?
+                                      previous->offset :
+                                      d->position - (off_t)d->current_pos;
+
+                if (target < start) {
+                        stop_decompressing(d);
+                        end_decoder(d);
+                        if (start_decoder(d) == false)
+                                return -1;
+                } else if (d->reading > d->tail &&
+                           target < previous->offset + previous->length) {
+                        d->reading--;
+                        d->current_pos = target - previous->offset;
+                        d->position = target;
+                }
+                if (target != d->position && seek_forward(d, target) == false)
+                        return -1;
+        }
+
+        *offset = target;
+        return 0;
+}
+
+static int decompress_close(void *cookie)
+{
+        decompressor *d = (decompressor *)cookie;
+
+        stop_decompressing(d);
+        end_decoder(d);
+        int ret = close(d->fd);
+
+        pthread_mutex_destroy(&d->lock);
+        pthread_cond_destroy(&d->cond);
+        for (int i = 0; i < COMPRESS_SLOTS; i++)
+                free(d->slots[i].data);
+        free(d->input);
+        free(d);
+
+        return ret;
+}
+
+static FILE *open_decompressor(int fd, TEXLER_COMPRESSION format,
+                               bool threaded)
+{
+        decompressor *d = (decompressor *)calloc(1, sizeof(decompressor));
+        if (d == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        d->fd = fd;
+        d->format = format;
+        d->threaded = threaded;
+        d->input = (unsigned char *)compress_malloc(COMPRESS_BLOCK_SIZE);
+        for (int i = 0; i < COMPRESS_SLOTS; i++)
+                d->slots[i].data =
+                        (char *)compress_malloc(COMPRESS_BLOCK_SIZE);
+        pthread_mutex_init(&d->lock, NULL);
+        pthread_cond_init(&d->cond, NULL);
+
+        if (start_decoder(d) == false) {
+                int error = errno;
+                decompress_close(d);
+                errno = error;
+                return NULL;
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        cookie_io_functions_t functions = {
+                .read = decompress_read,
+                .seek = decompress_seek,
+                .close = decompress_close,
+        };
+        FILE *fptr = fopencookie(d, "r", functions);
+        if (fptr == NULL)
+                decompress_close(d);
+
+        return fptr;
+}
+
+static bool write_output(compressor *c, size_t length)
+{
+        size_t written = 0;
+        while (written < length) {
+                ssize_t n = write(c->fd, c->output + written,
+                                  length - written);
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n <= 0) {
+                        if (n == 0)
+                                errno = EIO;
+                        return false;
+                }
+                written += n;
+        }
+
+        return true;
+}
+
+/* Compresses size bytes of data; with finish, also ends the stream */
+static bool encode(compressor *c, const char *data, size_t size, bool finish)
+{
+        switch (c->format) {
+#ifdef HAVE_ZLIB
+        case TEXLER_COMPRESSION_GZIP: {
+                z_stream *z = &c->gzip;
+                z->next_in = (unsigned char *)data;
+                z->avail_in = size;
+                int ret;
+                do {
+                        z->next_out = c->output;
+                        z->avail_out = COMPRESS_BLOCK_SIZE;
+                        ret = deflate(z, finish ? Z_FINISH : Z_NO_FLUSH);
+                        if (ret == Z_STREAM_ERROR) {
+                                errno = EIO;
+                                return false;
+                        }
+                        if (write_output(c, COMPRESS_BLOCK_SIZE -
+                                                    z->avail_out) == false)
+                                return false;
+                } while (z->avail_out == 0 || (finish && ret != Z_STREAM_END));
+
+                return true;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case TEXLER_COMPRESSION_ZSTD: {
+                ZSTD_inBuffer in = { data, size, 0 };
+                size_t ret;
+                do {
+                        ZSTD_outBuffer out = { c->output, COMPRESS_BLOCK_SIZE,
+                                               0 };
+                        ret = ZSTD_compressStream2(c->zstd, &out, &in,
+                                                   finish ? ZSTD_e_end :
+                                                            ZSTD_e_continue);
+                        if (ZSTD_isError(ret)) {
+                                errno = EIO;
+                                return false;
+                        }
+                        if (write_output(c, out.pos) == false)
+                                return false;
+                } while (finish ? ret != 0 : in.pos < in.size);
+
+                return true;
+        }
+#endif
+        default:
+                errno = ENOTSUP;
+                return false;
+        }
+}
+
+static ssize_t compress_write(void *cookie, const char *buffer, size_t size)
+{
+        compressor *c = (compressor *)cookie;
+
+        if (encode(c, buffer, size, false) == false)
+                return -1;
+        c->position += size;
+
+        return size;
+}
+
+/* Only where it is (ftell()); a compressed output is not rewritten */
+static int compress_seek(void *cookie, off64_t *offset, int whence)
+{
+        compressor *c = (compressor *)cookie;
+
+        if ((whence == SEEK_CUR && *offset == 0) ||
+            (whence == SEEK_SET && *offset == c->position)) {
+                *offset = c->position;
+                return 0;
+        }
+
+        errno = EINVAL;
+        return -1;
+}
+
+static int compress_close(void *cookie)
+{
+        compressor *c = (compressor *)cookie;
+        int ret = encode(c, NULL, 0, true) ? 0 : -1;
+
+        switch (c->format) {
+#ifdef HAVE_ZLIB
+        case TEXLER_COMPRESSION_GZIP:
+                deflateEnd(&c->gzip);
+                break;
+#endif
+#ifdef HAVE_ZSTD
+        case TEXLER_COMPRESSION_ZSTD:
+                ZSTD_freeCStream(c->zstd);
+                break;
+#endif
+        default:
+                break;
+        }
+
+        if (close(c->fd) && ret == 0)
+                ret = -1;
+        free(c->output);
+        free(c);
+
+        return ret;
+}
+
+static FILE *open_compressor(int fd, TEXLER_COMPRESSION format)
+{
+        compressor *c = (compressor *)calloc(1, sizeof(compressor));
+        if (c == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        c->fd = fd;
+        c->format = format;
+        c->output = (unsigned char *)compress_malloc(COMPRESS_BLOCK_SIZE);
+
+        /* ENOTSUP unless the library was built in and failed to start */
+        bool started = false;
+        int error = ENOTSUP;
+        switch (format) {
+#ifdef HAVE_ZLIB
+        case TEXLER_COMPRESSION_GZIP:
+                /* 16: gzip header and trailer instead of zlib ones */
+                started = deflateInit2(&c->gzip, Z_DEFAULT_COMPRESSION,
+                                       Z_DEFLATED, 16 + 15, 8,
+                                       Z_DEFAULT_STRATEGY) == Z_OK;
+                error = ENOMEM;
+                break;
+#endif
+#ifdef HAVE_ZSTD
+        case TEXLER_COMPRESSION_ZSTD:
+                c->zstd = ZSTD_createCStream();
+                started = c->zstd != NULL;
+                error = ENOMEM;
+                break;
+#endif
+        default:
+                break;
+        }
+        if (started == false) {
+                close(fd);
+                free(c->output);
+                free(c);
+                errno = error;
+                return NULL;
+        }
+
+        cookie_io_functions_t functions = {
+                .write = compress_write,
+                .seek = compress_seek,
+                .close = compress_close,
+        };
+        FILE *fptr = fopencookie(c, "w", functions);
+        if (fptr == NULL)
+                compress_close(c);
+
+        return fptr;
+}
+
+/*
+ * Stream over fd (a regular file opened with mode "r", "w" or "w+") that
+ * decompresses what is read or compresses what is written in 'format'.
+ * Closing the stream closes fd, and so does a failure: ENOTSUP if the
+ * runtime was built without that format. Outputs opened with "w+" are
+ * not read back.
+ */
+FILE *open_compressed(int fd, const char *mode, TEXLER_COMPRESSION format,
+                      bool threaded)
+{
+        if (mode[0] == 'w')
+                return open_compressor(fd, format);
+
+        return open_decompressor(fd, format, threaded);
+}
@@ -0,0 +1,290 @@
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "texler_runtime.h"
+
+/*
+ * CSV mode (RFC 4180) of the files declared with [","]. A field can be
+ * quoted, so it may contain commas, newlines and quotes (escaped as "").
+ *
+ * Records are indexed the way simdcsv does: for each block of 64 bytes,
+ * bitmasks of its quotes and commas are computed, and the prefix XOR of
+ * the quote mask gives the bytes inside quotes. The commas outside them
+ * end the fields. The state inside/outside quotes is carried from a block
+ * to the next, and from a line to the next one when a quoted field spans
+ * several lines, so every byte of the record is looked at once.
+ */
+
+#define CSV_BLOCK 64
+
+struct texler_csv {
+        const char *record; /* Record indexed, owned by the caller */
+        size_t length;
+        size_t *ends; /* Offset of the separator (or the end) of each field */
+        size_t n_fields;
+        size_t capacity;
+        size_t next;        /* Field file_columns() returns next */
+        const char *cursor; /* *str expected by that call */
+};
+
+texler_csv *new_csv(void)
+{
+        texler_csv *csv = (texler_csv *)calloc(1, sizeof(texler_csv));
+        if (csv == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        return csv;
+}
+
+void free_csv(texler_csv *csv)
+{
+        if (csv == NULL)
+                return;
+
+        free(csv->ends);
+        free(csv);
+}
+
+static void add_field(texler_csv *csv, size_t end)
+{
+        if (csv->n_fields == csv->capacity) {
+                csv->capacity = csv->capacity == 0 ? 16 : 2 * csv->capacity;
+                csv->ends = (size_t *)realloc(csv->ends,
+                                              csv->capacity * sizeof(size_t));
+                if (csv->ends == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+        }
+        csv->ends[csv->n_fields++] = end;
+}
+
+/* Bit i set if block[i] == c */
+static uint64_t byte_mask(const unsigned char *block, unsigned char c)
+{
+        uint64_t mask = 0;
+#ifdef __SSE2__
+        __m128i needle = _mm_set1_epi8((char)c);
+        for (int i = 0; i < CSV_BLOCK / 16; i++) {
+                __m128i bytes = _mm_loadu_si128((const __m128i *)block + i);
+                uint16_t found = (uint16_t)_mm_movemask_epi8(
+                        _mm_cmpeq_epi8(bytes, needle));
+                mask |= (uint64_t)found << (16 * i);
+        }
+#else
+        for (int i = 0; i < CSV_BLOCK; i++)
+                mask |= (uint64_t)(block[i] == c) << i;
+#endif
+        return mask;
+}
+
+/* Bit i is the XOR of bits 0..i: set between an opening and closing quote */
+static uint64_t prefix_xor(uint64_t mask)
+{
+        mask ^= mask << 1;
+        mask ^= mask << 2;
+        mask ^= mask << 4;
+        mask ^= mask << 8;
+        mask ^= mask << 16;
+        mask ^= mask << 32;
+        return mask;
+}
+
+/*
+ * Adds the fields ended by the commas of data[from, to), starting inside
+ * quotes if 'quoted'. Returns whether data[to - 1] is inside quotes.
+ */
+static bool index_fields(texler_csv *csv, const char *data, size_t from,
+                         size_t to, bool quoted)
+{
+        unsigned char tail[CSV_BLOCK];
+        uint64_t carry = quoted ? ~(uint64_t)0 : 0;
+
+        for (size_t offset = from; offset < to; offset += CSV_BLOCK) {
+                const unsigned char *block =
+                        (const unsigned char *)data + offset;
+                if (to - offset < CSV_BLOCK) {
+                        memset(tail, 0, sizeof(tail));
+                        memcpy(tail, block, to - offset);
+                        block = tail;
+                }
+
+                uint64_t inside = prefix_xor(byte_mask(block, '"')) ^ carry;
+                uint64_t commas = byte_mask(block, ',') & ~inside;
+                /* All ones or all zeros, as the state after the block */
+                carry = (uint64_t)((int64_t)inside >> 63);
+
+                while (commas != 0) {
+                        add_field(csv, offset + __builtin_ctzll(commas));
+                        commas &= commas - 1;
+                }
+        }
+
+        return carry != 0;
+}
+
+static void start_record(texler_csv *csv, const char *record, size_t length)
+{
+        csv->record = record;
+        csv->length = length;
+        csv->next = 0;
+        csv->cursor = record;
+        add_field(csv, length);
+}
+
+/*
+ * lines() for the columns().lines() loops: in CSV mode a record whose
+ * quoted field spans several lines is read whole into *buffer, and its
+ * fields are indexed for file_columns(). Records the cache has are not
+ * indexed.
+ */
+long records(TexlerObject *tex_obj, char **buffer)
+{
+        texler_csv *csv = tex_obj == NULL ? NULL : tex_obj->value.file.csv;
+        long line_len = lines(tex_obj, buffer);
+        if (line_len <= 0)
+                return line_len;
+
+        /* Its columns are in the sidecar already (cache.c) */
+        if (tex_obj->value.file.cache != NULL &&
+            cached_record(tex_obj, buffer, line_len)) {
+                if (csv != NULL)
+                        end_csv_record(csv);
+                return line_len;
+        }
+        if (csv == NULL)
+                return line_len;
+
+        size_t length = line_len - 1;
+        csv->n_fields = 0;
+        bool quoted = index_fields(csv, *buffer, 0, length, false);
+
+        long next_len = BUFFER_SIZE;
+        char *next = NULL;
+        while (quoted) {
+                if (next == NULL)
+                        next = (char *)calloc(next_len, sizeof(char));
+                if (next == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+
+                /* An unterminated quote ends at EOF */
+                next_len = lines(tex_obj, &next);
+                if (next_len <= 0)
+                        break;
+
+                char *record = (char *)realloc(*buffer, length + next_len);
+                if (record == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+                memcpy(record + length, next, next_len);
+                *buffer = record;
+
+                quoted = index_fields(csv, record, length,
+                                      length + next_len - 1, true);
+                length += next_len - 1;
+        }
+        free(next);
+
+        start_record(csv, *buffer, length);
+        return length + 1;
+}
+
+/* Copies data[start, end) to buffer, without the quotes of a quoted field */
+static size_t unquote(const char *data, size_t start, size_t end, char *buffer)
+{
+        if (start == end || data[start] != '"') {
+                memcpy(buffer, data + start, end - start);
+                return end - start;
+        }
+
+        size_t length = 0;
+        size_t i = start + 1;
+        while (i < end) {
+                if (data[i] != '"') {
+                        buffer[length++] = data[i++];
+                } else if (i + 1 < end && data[i + 1] == '"') {
+                        buffer[length++] = '"';
+                        i += 2;
+                } else {
+                        /* Closing quote: anything after it is kept as is */
+                        memcpy(buffer + length, data + i + 1, end - i - 1);
+                        length += end - i - 1;
+                        break;
+                }
+        }
+
+        return length;
+}
+
+/* Indexes *str first if it is not where the last field returned ended */
+static void index_line(texler_csv *csv, const char *str)
+{
+        if (str == csv->cursor && csv->next < csv->n_fields)
+                return;
+
+        size_t length = strlen(str);
+        csv->n_fields = 0;
+        index_fields(csv, str, 0, length, false);
+        start_record(csv, str, length);
+}
+
+/* Leaves *str after the field that ends at 'end' (NULL past the record) */
+static void next_field(texler_csv *csv, char **str, size_t end)
+{
+        if (end + 1 >= csv->length) {
+                *str = NULL;
+                csv->cursor = NULL;
+        } else {
+                *str = (char *)csv->record + end + 1;
+                csv->cursor = *str;
+        }
+}
+
+/*
+ * columns() in CSV mode: the fields come from the index records() built (a
+ * line read some other way, as with byIndex, is indexed here first) and
+ * quoted fields are unquoted. Same contract as columns() otherwise.
+ */
+long csv_columns(texler_csv *csv, char **str, char **buffer, int *separator)
+{
+        index_line(csv, *str);
+
+        size_t start = *str - csv->record;
+        size_t end = csv->ends[csv->next++];
+
+        char *new_buffer = (char *)realloc(*buffer, end - start + 1);
+        if (new_buffer == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        size_t length = unquote(csv->record, start, end, new_buffer);
+        new_buffer[length] = '\0';
+        *buffer = new_buffer;
+
+        if (end < csv->length)
+                *separator = ',';
+        next_field(csv, str, end);
+
+        /* buffer contains '\0' */
+        return length == 0 ? 0 : length + 1;
+}
+
+/* Leaves *str past its field, without copying it */
+void skip_csv_column(texler_csv *csv, char **str)
+{
+        index_line(csv, *str);
+        next_field(csv, str, csv->ends[csv->next++]);
+}
+
+/* Drops the rest of the record, so the next line is indexed anew */
+void end_csv_record(texler_csv *csv)
+{
+        csv->cursor = NULL;
+}
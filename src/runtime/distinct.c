@@ -0,0 +1,236 @@
+#include "texler_runtime.h"
+
+/*
+ * lines().distinct() and lines().uniq(): drop the lines whose key (the
+ * line, or one of its columns) was already seen, or that repeat the key of
+ * the line right before them. Lines are tested as they are read, so the
+ * first line of each key goes through in its place.
+ *
+ * distinct() keeps a set of 64-bit fingerprints (hash_bytes()) of the keys
+ * seen, in an open addressing table (linear probing) that grows without
+ * hashing any key again. Each slot also has the offset of its key in an
+ * arena: fingerprints that match are verified against it, so two keys
+ * that share a fingerprint are never taken for the same one.
+ *
+ * uniq() only keeps the key of the previous line.
+ */
+
+#define DISTINCT_MIN_SLOTS 64
+
+typedef struct {
+        uint64_t fingerprint; /* 0 when free */
+        size_t offset; /* Of the key in the arena, after its length */
+} distinct_slot;
+
+struct texler_distinct {
+        TexlerObject *tex_obj; /* Splits the columns */
+        unsigned long column; /* 0: the whole line */
+        bool consecutive;
+
+        distinct_slot *slots;
+        size_t n_slots; /* A power of two */
+        size_t n_keys;
+        char *keys; /* Length (size_t) and bytes of each key */
+        size_t keys_length;
+        size_t keys_size;
+
+        char *cell;
+        char *previous; /* consecutive: key of the last line */
+        size_t previous_length;
+        bool has_previous;
+};
+
+static void *distinct_realloc(void *ptr, size_t size)
+{
+        void *new_ptr = realloc(ptr, size);
+        if (new_ptr == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        return new_ptr;
+}
+
+/*
+ * Lines of tex_obj (a file) are compared by their column 'column'
+ * (1-based), or whole if it is 0. With consecutive, only against the line
+ * right before them.
+ */
+texler_distinct *new_distinct(TexlerObject *tex_obj, unsigned long column,
+                              bool consecutive)
+{
+        if (tex_obj == NULL || (column > 0 && tex_obj->type != TYPE_T_FILEPTR))
+                return NULL;
+
+        texler_distinct *distinct =
+                (texler_distinct *)calloc(1, sizeof(texler_distinct));
+        if (distinct == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        distinct->tex_obj = tex_obj;
+        distinct->column = column;
+        distinct->consecutive = consecutive;
+
+        return distinct;
+}
+
+/* Column 'column' of record, without its '\n' */
+static const char *record_key(texler_distinct *distinct, char *record,
+                              size_t *length)
+{
+        if (distinct->column == 0) {
+                *length = strlen(record);
+        } else {
+                TexlerObject *tex_obj = distinct->tex_obj;
+                char *str = record;
+                int separator = 0;
+
+                if (distinct->cell == NULL)
+                        distinct->cell = distinct_realloc(NULL, BUFFER_SIZE);
+                distinct->cell[0] = '\0';
+                project_columns(tex_obj, &distinct->column, 1);
+                file_columns(tex_obj, &str, &distinct->cell, &separator);
+                project_columns(tex_obj, NULL, 0);
+
+                record = distinct->cell;
+                *length = strlen(record);
+        }
+
+        while (*length > 0 && record[*length - 1] == '\n')
+                (*length)--;
+
+        return record;
+}
+
+static void grow_slots(texler_distinct *distinct)
+{
+        size_t n_slots = distinct->n_slots == 0 ? DISTINCT_MIN_SLOTS :
+                                                  2 * distinct->n_slots;
+        distinct_slot *slots =
+                (distinct_slot *)calloc(n_slots, sizeof(distinct_slot));
+        if (slots == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        /* The fingerprints are kept, keys are not hashed again */
+        for (size_t i = 0; i < distinct->n_slots; i++) {
+                const distinct_slot *slot = &distinct->slots[i];
+                if (slot->fingerprint == 0)
+                        continue;
+
+                size_t j = slot->fingerprint & (n_slots - 1);
+                while (slots[j].fingerprint != 0)
+                        j = (j + 1) & (n_slots - 1);
+                slots[j] = *slot;
+        }
+
+        free(distinct->slots);
+        distinct->slots = slots;
+        distinct->n_slots = n_slots;
+}
+
+static size_t add_key(texler_distinct *distinct, const char *key,
+                      size_t length)
+{
+        size_t needed = distinct->keys_length + sizeof(size_t) + length;
+        if (needed > distinct->keys_size) {
+                size_t size = distinct->keys_size == 0 ? BUFFER_SIZE :
+                                                         distinct->keys_size;
+                while (size < needed)
+                        size *= 2;
+                distinct->keys = distinct_realloc(distinct->keys, size);
+                distinct->keys_size = size;
+        }
+
+        char *ptr = distinct->keys + distinct->keys_length;
+        memcpy(ptr, &length, sizeof(size_t));
+        memcpy(ptr + sizeof(size_t), key, length);
+        distinct->keys_length = needed;
+
+        return ptr + sizeof(size_t) - distinct->keys;
+}
+
+/* Adds key to the set, false if it was already there */
+static bool insert_key(texler_distinct *distinct, const char *key,
+                       size_t length)
+{
+        if (2 * (distinct->n_keys + 1) > distinct->n_slots)
+                grow_slots(distinct);
+
+        uint64_t fingerprint = hash_bytes(key, length);
+        if (fingerprint == 0)
+                fingerprint = 1;
+
+        size_t mask = distinct->n_slots - 1;
+        size_t i = fingerprint & mask;
+        for (; distinct->slots[i].fingerprint != 0; i = (i + 1) & mask) {
+                if (distinct->slots[i].fingerprint != fingerprint)
+                        continue;
+
+                /* Same fingerprint: the same key, unless they differ */
+                const char *stored =
+                        distinct->keys + distinct->slots[i].offset;
+                size_t stored_length = 0;
+                memcpy(&stored_length, stored - sizeof(size_t),
+                       sizeof(size_t));
+                if (stored_length == length &&
+                    memcmp(stored, key, length) == 0)
+                        return false;
+        }
+
+        distinct->slots[i].fingerprint = fingerprint;
+        distinct->slots[i].offset = add_key(distinct, key, length);
+        distinct->n_keys++;
+
+        return true;
+}
+
+/* Whether the key of record differs from the one of the previous record */
+static bool new_run(texler_distinct *distinct, const char *key,
+                    size_t length)
+{
+        if (distinct->has_previous && distinct->previous_length == length &&
+            memcmp(distinct->previous, key, length) == 0)
+                return false;
+
+        distinct->previous = distinct_realloc(distinct->previous, length + 1);
+        memcpy(distinct->previous, key, length);
+        distinct->previous_length = length;
+        distinct->has_previous = true;
+
+        return true;
+}
+
+/*
+ * Whether record (a line read from the file of distinct) goes through: its
+ * key was not seen before or, if consecutive, it is not the key of the
+ * previous record.
+ */
+bool distinct_record(texler_distinct *distinct, char *record)
+{
+        if (distinct == NULL || record == NULL)
+                return true;
+
+        size_t length = 0;
+        const char *key = record_key(distinct, record, &length);
+
+        if (distinct->consecutive)
+                return new_run(distinct, key, length);
+
+        return insert_key(distinct, key, length);
+}
+
+void free_distinct(texler_distinct *distinct)
+{
+        if (distinct == NULL)
+                return;
+
+        free(distinct->slots);
+        free(distinct->keys);
+        free(distinct->cell);
+        free(distinct->previous);
+        free(distinct);
+}
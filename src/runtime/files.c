@@ -0,0 +1,377 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "texler_runtime.h"
+
+static bool init_file_object(FILE *fptr, TexlerObject *tex_obj,
+                             const char *separators, off_t size);
+
+/* Files declared with [","] are read as CSV (csv.c) */
+static bool csv_mode(const char *separators)
+{
+        return separators != NULL && strcmp(separators, ",") == 0;
+}
+
+bool open_file(const char *name, const char *mode, TexlerObject *tex_obj,
+               const char *separators)
+{
+        if (name == NULL || mode == NULL || tex_obj == NULL)
+                return false;
+
+        size_t error_msg_len =
+                strlen("Error while opening file ''") + strlen(name);
+        char *error_msg = (char *)calloc(1 + error_msg_len, sizeof(char));
+        if (error_msg == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        strcpy(error_msg, "Error while opening file '");
+        strcat(error_msg, name);
+        strcat(error_msg, "'");
+
+        off_t size = 0;
+        FILE *fptr = open_io(name, mode, &size);
+        if (fptr == NULL) {
+                perror(error_msg);
+                free(error_msg);
+                return false;
+        }
+        free(error_msg);
+
+        if (init_file_object(fptr, tex_obj, separators, size) == false)
+                return false;
+        if (strcmp(mode, "r") == 0)
+                tex_obj->value.file.cache = open_cache(
+                        name, tex_obj->value.file.separators);
+
+        return true;
+}
+
+static bool init_file_object(FILE *fptr, TexlerObject *tex_obj,
+                             const char *separators, off_t size)
+{
+        rewind(fptr);
+
+        tex_obj->type = TYPE_T_FILEPTR;
+        tex_obj->value.file.stream = fptr;
+        if (fgetpos(tex_obj->value.file.stream, &tex_obj->value.file.pos)) {
+                perror("Error while getting file position");
+                return false;
+        }
+        tex_obj->value.file.n_line = 1;
+
+        if (separators == NULL)
+                tex_obj->value.file.separators =
+                        strdup(TEXLER_DEFAULT_SEPARATORS);
+        else
+                tex_obj->value.file.separators = strdup(separators);
+        tex_obj->value.file.csv = csv_mode(separators) ? new_csv() : NULL;
+        tex_obj->value.file.cache = NULL;
+        tex_obj->value.file.size = size;
+        project_columns(tex_obj, NULL, 0);
+
+        return true;
+}
+
+static texler_stream *find_stream(const texler_context *context,
+                                  const char *variable)
+{
+        if (context == NULL || variable == NULL)
+                return NULL;
+
+        for (size_t i = 0; i < context->n_streams; i++) {
+                if (context->streams[i].name != NULL &&
+                    strcmp(context->streams[i].name, variable) == 0)
+                        return &context->streams[i];
+        }
+
+        return NULL;
+}
+
+/* Mode of fdopen() that matches how the host opened fd */
+static const char *fd_mode(int fd, const char *mode)
+{
+        if (mode[0] == 'r')
+                return "r";
+
+        int flags = fcntl(fd, F_GETFL);
+        if (flags >= 0 && (flags & O_ACCMODE) == O_RDWR)
+                return "w+";
+
+        return "w";
+}
+
+/*
+ * Streams of a descriptor go through open_io_fd(), as files do: compressed
+ * inputs are decompressed and TEXLER_IO picks the backend. Buffers are
+ * read and written by stdio.
+ */
+static FILE *open_stream(texler_stream *stream, const char *mode,
+                         off_t *size)
+{
+        *size = 0;
+
+        switch (stream->type) {
+        case TEXLER_STREAM_FD: {
+                int fd = dup(stream->fd);
+                if (fd < 0)
+                        return NULL;
+
+                return open_io_fd(fd, fd_mode(stream->fd, mode), size);
+        }
+        case TEXLER_STREAM_BUFFER:
+                if (mode[0] == 'r')
+                        return fmemopen(stream->buffer, stream->length, "r");
+
+                /* Written to stream->buffer when the object is freed */
+                stream->buffer = NULL;
+                stream->length = 0;
+                return open_memstream(&stream->buffer, &stream->length);
+        default:
+                return NULL;
+        }
+}
+
+/*
+ * open_file() for File variables: if the host bound a stream to 'variable'
+ * (texler -l, --file or --batch) it is used instead of the file 'name'.
+ */
+bool open_variable_file(const texler_context *context, const char *variable,
+                        const char *name, const char *mode,
+                        TexlerObject *tex_obj, const char *separators)
+{
+        texler_stream *stream = find_stream(context, variable);
+        if (stream == NULL)
+                return open_file(name, mode, tex_obj, separators);
+        if (stream->type == TEXLER_STREAM_PATH)
+                return open_file(stream->path, mode, tex_obj, separators);
+
+        if (tex_obj == NULL || mode == NULL)
+                return false;
+
+        off_t size = 0;
+        FILE *fptr = open_stream(stream, mode, &size);
+        if (fptr == NULL) {
+                fprintf(stderr, "Error while opening the stream of '%s'\n",
+                        variable);
+                return false;
+        }
+
+        return init_file_object(fptr, tex_obj, separators, size);
+}
+
+/* Path bound to 'variable', or 'name' if it has none (input folders) */
+const char *variable_path(const texler_context *context, const char *variable,
+                          const char *name)
+{
+        texler_stream *stream = find_stream(context, variable);
+
+        if (stream == NULL || stream->type != TEXLER_STREAM_PATH)
+                return name;
+
+        return stream->path;
+}
+
+/* File STDOUT: the stream bound to 'variable' or the process stdout */
+bool open_variable_stdout(const texler_context *context, const char *variable,
+                          TexlerObject *tex_obj)
+{
+        if (tex_obj == NULL)
+                return false;
+
+        if (find_stream(context, variable) != NULL) {
+                if (open_variable_file(context, variable, NULL, "w", tex_obj,
+                                       NULL) == false)
+                        return false;
+
+                /* Written as is, like stdout */
+                free(tex_obj->value.file.separators);
+                tex_obj->value.file.separators = NULL;
+                return true;
+        }
+
+        tex_obj->type = TYPE_T_FILEPTR;
+        tex_obj->value.file.next_open_file = 0;
+        tex_obj->value.file.stream = stdout;
+
+        return true;
+}
+
+TexlerObject *get_next_file(TexlerObject *tex_obj, const char *separators)
+{
+        TexlerObject *input_file = NULL;
+
+        if (tex_obj == NULL)
+                return NULL;
+
+        if (tex_obj->type == TYPE_T_FILE_LIST) {
+                input_file = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+                if (input_file == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+
+                size_t index = tex_obj->value.file.next_open_file;
+                char **path_list = tex_obj->value.file.path_list;
+                tex_obj->value.file.next_open_file++;
+
+                /* (Re)started when the list is walked from another file */
+                if (prefetch_at(tex_obj->value.file.prefetch, index) ==
+                    false) {
+                        stop_prefetch(tex_obj->value.file.prefetch);
+                        tex_obj->value.file.prefetch = start_prefetch(
+                                path_list, tex_obj->value.file.n_files, index);
+                }
+
+                /* Files that could not be prefetched are opened here */
+                int fd = prefetched_fd(tex_obj->value.file.prefetch, index);
+                off_t size = 0;
+                FILE *fptr = fd < 0 ? NULL : open_io_fd(fd, "r", &size);
+                bool opened = fptr != NULL ?
+                                      init_file_object(fptr, input_file,
+                                                       separators, size) :
+                                      open_file(path_list[index], "r",
+                                                input_file, separators);
+
+                /* The list belongs to the caller, it just skips this file */
+                if (opened == false) {
+                        free_texlerobject(input_file);
+                        return NULL;
+                }
+                if (fptr != NULL)
+                        input_file->value.file.cache = open_cache(
+                                path_list[index],
+                                input_file->value.file.separators);
+        } else if (tex_obj->type == TYPE_T_FILEPTR) {
+                input_file = tex_obj;
+        }
+
+        return input_file;
+}
+
+long get_list_of_files_in_dir(char ***files, const char *path)
+{
+        if (files == NULL)
+                return -1;
+
+        char **files_list = *files;
+
+        DIR *dir_ptr = NULL;
+        struct dirent *dir = NULL;
+        long count_files = 0;
+
+        dir_ptr = opendir(path);
+
+        if (dir_ptr) {
+                while ((dir = readdir(dir_ptr)) != NULL) {
+                        if (dir->d_type == DT_REG) {
+                                count_files++;
+                                files_list = (char **)realloc(
+                                        files_list,
+                                        count_files * sizeof(char *));
+                                files_list[count_files - 1] = (char *)calloc(
+                                        strlen(path) + 1 +
+                                                strlen(dir->d_name) + 1,
+                                        sizeof(char));
+                                sprintf(files_list[count_files - 1], "%s/%s",
+                                        path, dir->d_name);
+                        }
+                }
+                closedir(dir_ptr);
+        }
+        *files = files_list;
+        return count_files;
+}
+
+void copy_buffer_content(char *from, FILE *to)
+{
+        if (from == NULL || to == NULL || (void *)from == (void *)to)
+                return;
+
+        fputs(from, to);
+}
+
+void copy_file_content(FILE *from, FILE *to)
+{
+        if (from == NULL || to == NULL || (void *)from == (void *)to)
+                return;
+
+        char buffer[BUFFER_SIZE] = { 0 };
+        rewind(from);
+        while (!feof(from)) {
+                if (fgets(buffer, BUFFER_SIZE, from) == NULL)
+                        break;
+                fputs(buffer, to);
+        }
+}
+
+void copy_file_content_texler(TexlerObject *source, TexlerObject *destination)
+{
+        /* Outputs without separators (STDOUT, "") are written as is */
+        if (destination->value.file.separators == NULL ||
+            source->value.file.separators == NULL ||
+            strcmp(destination->value.file.separators,
+                   TEXLER_DEFAULT_SEPARATORS) == 0) {
+                copy_file_content(source->value.file.stream,
+                                  destination->value.file.stream);
+                return;
+        }
+
+        long source_separators_len = strlen(source->value.file.separators);
+        long destination_separators_len =
+                strlen(destination->value.file.separators);
+
+        long line_len = BUFFER_SIZE;
+        char *line = (char *)calloc(line_len, sizeof(char));
+        if (line == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        while (line_len > 0) {
+                line_len = lines(source, &line);
+                if (line_len <= 0 || line == NULL)
+                        break;
+
+                char *remaining = line;
+                long int col_len = BUFFER_SIZE;
+                char *column = (char *)calloc(col_len, sizeof(char));
+                if (column == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+
+                while (remaining != NULL) {
+                        int separator_char = 0;
+                        col_len = columns(&remaining,
+                                          source->value.file.separators,
+                                          &column, &separator_char);
+                        if (column != NULL && col_len > 0) {
+                                copy_buffer_content(
+                                        column,
+                                        destination->value.file.stream);
+                        }
+                        if (separator_char &&
+                            source_separators_len ==
+                                    destination_separators_len) {
+                                for (long i = 0; i < source_separators_len;
+                                     i++) {
+                                        if (source->value.file.separators[i] ==
+                                            separator_char) {
+                                                fputc(destination->value.file
+                                                              .separators[i],
+                                                      destination->value.file
+                                                              .stream);
+                                        }
+                                }
+                        } else if (separator_char) {
+                                fputc(destination->value.file.separators[0],
+                                      destination->value.file.stream);
+                        }
+                }
+                free(column);
+        }
+        free(line);
+}
@@ -0,0 +1,887 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "texler_runtime.h"
+
+/*
+ * lines().group(column, aggregates...): hash aggregation of the records of
+ * a file, or of every file of a folder, by one of their columns.
+ *
+ * Groups live in an open addressing table (linear probing) of indexes into
+ * a dense array of entries, in the order they were found. Each entry keeps
+ * the hash of its key, so that probing compares the key bytes only when
+ * the hashes match and growing the table never hashes a key again. Keys
+ * of up to GROUP_INLINE_KEY bytes are stored in the entry itself, longer
+ * ones in an arena.
+ *
+ * Once a table holds TEXLER_GROUP_MEMORY MiB its partial groups are
+ * spilled to temporary files, one per partition of the hashes, and it
+ * starts over empty. The partitions are then aggregated one at a time, so
+ * only the groups of one partition are in memory when they are returned.
+ *
+ * The files of a folder are aggregated by several threads, each into its
+ * own table, and the tables are merged at the end.
+ */
+
+#define GROUP_MEMORY (256UL * 1024 * 1024)
+#define GROUP_INLINE_KEY 16
+#define GROUP_MIN_SLOTS 64
+/* Partitions of the spilled groups, by the top bits of their hash */
+#define GROUP_PARTITION_BITS 4
+#define GROUP_PARTITIONS (1 << GROUP_PARTITION_BITS)
+/* Position of a record: its file in the upper bits, then its number */
+#define GROUP_FILE_SHIFT 40
+
+/* Partial aggregate: n numeric values seen, their sum/min/max */
+typedef struct {
+        double value;
+        size_t n;
+} group_state;
+
+typedef struct {
+        uint64_t hash;
+        size_t first; /* Position of its first record */
+        size_t count; /* Records */
+        size_t key_length;
+        union {
+                char bytes[GROUP_INLINE_KEY];
+                size_t offset; /* In the key arena, if longer */
+        } key;
+} group_entry;
+
+/* Spilled group: group_spill, key, a group_state per aggregate */
+typedef struct {
+        uint64_t hash;
+        size_t first;
+        size_t count;
+        size_t key_length;
+} group_spill;
+
+typedef struct {
+        group_entry *entries;
+        size_t n_entries;
+        size_t entries_size;
+        group_state *states; /* n_aggregates per entry */
+        size_t *slots; /* Index of an entry plus one, 0 when free */
+        size_t n_slots; /* A power of two */
+        char *keys;
+        size_t keys_length;
+        size_t keys_size;
+
+        size_t memory; /* Spilled from there on */
+        FILE *partitions[GROUP_PARTITIONS];
+        bool spilled;
+} group_table;
+
+struct texler_group {
+        texler_aggregate *aggregates;
+        size_t n_aggregates;
+        /* Columns split from each record, sorted (project_columns()) */
+        unsigned long *columns;
+        size_t n_columns;
+        size_t key_cell; /* Index in columns of the key */
+        size_t *value_cells; /* Of each aggregate */
+        bool csv;
+        int separator; /* Between the columns of the groups returned */
+
+        group_table *tables; /* One per thread */
+        size_t n_tables;
+        bool spilled;
+        size_t partition; /* Being returned, if spilled */
+        size_t next; /* Entry of tables[0] returned next */
+};
+
+typedef struct {
+        texler_group *group;
+        group_table *table;
+        char **path_list;
+        size_t n_files;
+        const char *separators;
+        atomic_size_t *next_file;
+        atomic_bool *failed; /* Shared: every worker stops once one fails */
+} group_worker;
+
+static void *group_realloc(void *ptr, size_t size)
+{
+        void *new_ptr = realloc(ptr, size);
+        if (new_ptr == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        return new_ptr;
+}
+
+static size_t group_memory(void)
+{
+        const char *env = getenv("TEXLER_GROUP_MEMORY");
+        if (env == NULL || *env == '\0')
+                return GROUP_MEMORY;
+
+        char *end = NULL;
+        long mebibytes = strtol(env, &end, 10);
+        if (*end != '\0' || mebibytes <= 0)
+                return GROUP_MEMORY;
+
+        return mebibytes * 1024UL * 1024;
+}
+
+static size_t group_threads(void)
+{
+        const char *env = getenv("TEXLER_GROUP_THREADS");
+        if (env != NULL && *env != '\0') {
+                char *end = NULL;
+                long threads = strtol(env, &end, 10);
+                if (*end == '\0' && threads > 0)
+                        return threads;
+        }
+
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return cpus > 0 ? cpus : 1;
+}
+
+/* Never 0 bytes, realloc() could return NULL */
+static size_t states_size(const texler_group *group, size_t n_entries)
+{
+        return (n_entries * group->n_aggregates + 1) * sizeof(group_state);
+}
+
+static const char *entry_key(const group_table *table,
+                             const group_entry *entry)
+{
+        return entry->key_length <= GROUP_INLINE_KEY ?
+                       entry->key.bytes :
+                       table->keys + entry->key.offset;
+}
+
+static group_state *entry_states(const texler_group *group,
+                                 const group_table *table, size_t index)
+{
+        return table->states + index * group->n_aggregates;
+}
+
+/* Bytes the groups of table take, compared against its memory */
+static size_t table_memory(const texler_group *group,
+                           const group_table *table)
+{
+        return table->n_entries *
+                       (sizeof(group_entry) + 2 * sizeof(size_t) +
+                        group->n_aggregates * sizeof(group_state)) +
+               table->keys_length;
+}
+
+static void grow_slots(group_table *table)
+{
+        size_t n_slots = table->n_slots == 0 ? GROUP_MIN_SLOTS :
+                                               2 * table->n_slots;
+
+        free(table->slots);
+        table->slots = group_realloc(NULL, n_slots * sizeof(size_t));
+        memset(table->slots, 0, n_slots * sizeof(size_t));
+        table->n_slots = n_slots;
+
+        /* The hashes were kept, keys are not hashed again */
+        for (size_t i = 0; i < table->n_entries; i++) {
+                size_t slot = table->entries[i].hash & (n_slots - 1);
+                while (table->slots[slot] != 0)
+                        slot = (slot + 1) & (n_slots - 1);
+                table->slots[slot] = i + 1;
+        }
+}
+
+/*
+ * Index of the entry of key in table, added (with no records) if it was
+ * not there. first is where it was found, the earliest one is kept.
+ */
+static size_t find_entry(texler_group *group, group_table *table,
+                         uint64_t hash, const char *key, size_t key_length,
+                         size_t first)
+{
+        if (2 * (table->n_entries + 1) > table->n_slots)
+                grow_slots(table);
+
+        size_t mask = table->n_slots - 1;
+        size_t slot = hash & mask;
+        for (; table->slots[slot] != 0; slot = (slot + 1) & mask) {
+                size_t index = table->slots[slot] - 1;
+                group_entry *entry = &table->entries[index];
+
+                if (entry->hash == hash && entry->key_length == key_length &&
+                    memcmp(entry_key(table, entry), key, key_length) == 0) {
+                        if (first < entry->first)
+                                entry->first = first;
+                        return index;
+                }
+        }
+
+        if (table->n_entries == table->entries_size) {
+                table->entries_size = table->entries_size == 0 ?
+                                              BUFFER_SIZE :
+                                              2 * table->entries_size;
+                table->entries = group_realloc(
+                        table->entries,
+                        table->entries_size * sizeof(group_entry));
+                table->states = group_realloc(
+                        table->states,
+                        states_size(group, table->entries_size));
+        }
+
+        size_t index = table->n_entries++;
+        group_entry *entry = &table->entries[index];
+        *entry = (group_entry){ .hash = hash,
+                                .first = first,
+                                .key_length = key_length };
+
+        if (key_length <= GROUP_INLINE_KEY) {
+                memcpy(entry->key.bytes, key, key_length);
+        } else {
+                if (table->keys_length + key_length > table->keys_size) {
+                        size_t size = table->keys_size == 0 ?
+                                              BUFFER_SIZE :
+                                              table->keys_size;
+                        while (size < table->keys_length + key_length)
+                                size *= 2;
+                        table->keys = group_realloc(table->keys, size);
+                        table->keys_size = size;
+                }
+                entry->key.offset = table->keys_length;
+                memcpy(table->keys + table->keys_length, key, key_length);
+                table->keys_length += key_length;
+        }
+
+        memset(entry_states(group, table, index), 0,
+               group->n_aggregates * sizeof(group_state));
+        table->slots[slot] = index + 1;
+
+        return index;
+}
+
+static void add_value(const texler_aggregate *aggregate, group_state *state,
+                      double value)
+{
+        switch (aggregate->type) {
+        case TEXLER_AGGREGATE_SUM:
+        case TEXLER_AGGREGATE_AVG:
+                state->value += value;
+                break;
+        case TEXLER_AGGREGATE_MIN:
+                if (state->n == 0 || value < state->value)
+                        state->value = value;
+                break;
+        case TEXLER_AGGREGATE_MAX:
+                if (state->n == 0 || value > state->value)
+                        state->value = value;
+                break;
+        default:
+                return;
+        }
+        state->n++;
+}
+
+/* Adds the partial aggregates of another table (or spill) to state */
+static void merge_state(const texler_aggregate *aggregate, group_state *state,
+                        const group_state *other)
+{
+        if (other->n == 0)
+                return;
+
+        size_t n = state->n;
+        if (aggregate->type == TEXLER_AGGREGATE_SUM ||
+            aggregate->type == TEXLER_AGGREGATE_AVG) {
+                state->value += other->value;
+                state->n += other->n;
+                return;
+        }
+
+        add_value(aggregate, state, other->value);
+        state->n = n + other->n;
+}
+
+/* Writes the groups of table to its partitions, leaving it empty */
+static bool spill_table(texler_group *group, group_table *table)
+{
+        for (size_t i = 0; i < table->n_entries; i++) {
+                const group_entry *entry = &table->entries[i];
+                size_t partition =
+                        entry->hash >> (64 - GROUP_PARTITION_BITS);
+
+                if (table->partitions[partition] == NULL &&
+                    (table->partitions[partition] = tmpfile()) == NULL)
+                        return false;
+
+                FILE *stream = table->partitions[partition];
+                group_spill header = { entry->hash, entry->first,
+                                       entry->count, entry->key_length };
+                /* An empty key writes no bytes, fwrite() returns 0 */
+                if (fwrite(&header, sizeof(header), 1, stream) != 1 ||
+                    (entry->key_length > 0 &&
+                     fwrite(entry_key(table, entry), entry->key_length, 1,
+                            stream) != 1) ||
+                    fwrite(entry_states(group, table, i),
+                           sizeof(group_state), group->n_aggregates,
+                           stream) != group->n_aggregates)
+                        return false;
+        }
+
+        table->n_entries = 0;
+        table->keys_length = 0;
+        if (table->slots != NULL)
+                memset(table->slots, 0, table->n_slots * sizeof(size_t));
+        table->spilled = true;
+
+        return true;
+}
+
+/* Merges one group into table, spilling it if it gets too large */
+static bool merge_group(texler_group *group, group_table *table,
+                        const group_spill *header, const char *key,
+                        const group_state *states)
+{
+        size_t index = find_entry(group, table, header->hash, key,
+                                  header->key_length, header->first);
+        group_state *state = entry_states(group, table, index);
+
+        table->entries[index].count += header->count;
+        for (size_t i = 0; i < group->n_aggregates; i++)
+                merge_state(&group->aggregates[i], &state[i], &states[i]);
+
+        if (table->memory != 0 &&
+            table_memory(group, table) >= table->memory)
+                return spill_table(group, table);
+
+        return true;
+}
+
+/* Aggregates the records of tex_obj, from where its stream is */
+static bool group_file(texler_group *group, group_table *table,
+                       TexlerObject *tex_obj, size_t file)
+{
+        char *record = group_realloc(NULL, BUFFER_SIZE);
+        char **cells = group_realloc(NULL, group->n_columns * sizeof(char *));
+        for (size_t i = 0; i < group->n_columns; i++)
+                cells[i] = group_realloc(NULL, BUFFER_SIZE);
+        bool failed = false;
+
+        project_columns(tex_obj, group->columns, group->n_columns);
+        for (size_t n = 0; !failed; n++) {
+                if (records(tex_obj, &record) <= 0)
+                        break;
+
+                /* The i-th call returns the i-th column projected */
+                char *str = record;
+                int separator = 0;
+                for (size_t i = 0; i < group->n_columns; i++)
+                        cells[i][0] = '\0';
+                for (size_t i = 0; i < group->n_columns && str != NULL; i++)
+                        file_columns(tex_obj, &str, &cells[i], &separator);
+                for (size_t i = 0; i < group->n_columns; i++) {
+                        size_t length = strlen(cells[i]);
+                        while (length > 0 && cells[i][length - 1] == '\n')
+                                cells[i][--length] = '\0';
+                }
+
+                const char *key = cells[group->key_cell];
+                size_t key_length = strlen(key);
+                size_t index = find_entry(group, table,
+                                          hash_bytes(key, key_length), key,
+                                          key_length,
+                                          (file << GROUP_FILE_SHIFT) | n);
+                group_state *state = entry_states(group, table, index);
+
+                table->entries[index].count++;
+                for (size_t i = 0; i < group->n_aggregates; i++) {
+                        double value = 0;
+                        if (group->aggregates[i].type !=
+                                    TEXLER_AGGREGATE_COUNT &&
+                            cell_value(tex_obj,
+                                        cells[group->value_cells[i]],
+                                        &value))
+                                add_value(&group->aggregates[i], &state[i],
+                                          value);
+                }
+
+                if (table_memory(group, table) >= table->memory)
+                        failed = !spill_table(group, table);
+        }
+        project_columns(tex_obj, NULL, 0);
+
+        for (size_t i = 0; i < group->n_columns; i++)
+                free(cells[i]);
+        free(cells);
+        free(record);
+
+        return !failed;
+}
+
+/* Takes the files of the folder left, one at a time */
+static void *group_files(void *arg)
+{
+        group_worker *worker = (group_worker *)arg;
+
+        for (;;) {
+                size_t file = atomic_fetch_add(worker->next_file, 1);
+                if (file >= worker->n_files || atomic_load(worker->failed))
+                        break;
+
+                TexlerObject *tex_obj =
+                        (TexlerObject *)calloc(1, sizeof(TexlerObject));
+                if (tex_obj == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+
+                /* Files that can not be opened are skipped */
+                if (open_file(worker->path_list[file], "r", tex_obj,
+                              worker->separators) &&
+                    !group_file(worker->group, worker->table, tex_obj, file))
+                        atomic_store(worker->failed, true);
+                free_texlerobject(tex_obj);
+        }
+
+        return NULL;
+}
+
+static bool group_folder(texler_group *group, TexlerObject *tex_obj)
+{
+        size_t n_files = tex_obj->value.file.n_files;
+        group_worker workers[group->n_tables];
+        pthread_t threads[group->n_tables];
+        bool started[group->n_tables];
+        atomic_size_t next_file = 0;
+        atomic_bool failed = false;
+
+        for (size_t i = 0; i < group->n_tables; i++)
+                workers[i] = (group_worker){
+                        .group = group,
+                        .table = &group->tables[i],
+                        .path_list = tex_obj->value.file.path_list,
+                        .n_files = n_files,
+                        .separators = tex_obj->value.file.separators,
+                        .next_file = &next_file,
+                        .failed = &failed,
+                };
+
+        for (size_t i = 1; i < group->n_tables; i++)
+                started[i] = pthread_create(&threads[i], NULL, group_files,
+                                            &workers[i]) == 0;
+        group_files(&workers[0]);
+
+        for (size_t i = 1; i < group->n_tables; i++) {
+                if (started[i])
+                        pthread_join(threads[i], NULL);
+        }
+
+        return !atomic_load(&failed);
+}
+
+/* Merges every table into the first one, freeing them */
+static bool merge_tables(texler_group *group)
+{
+        group_table *result = &group->tables[0];
+
+        for (size_t t = 1; t < group->n_tables; t++) {
+                group_table *table = &group->tables[t];
+
+                for (size_t i = 0; i < table->n_entries; i++) {
+                        const group_entry *entry = &table->entries[i];
+                        group_spill header = { entry->hash, entry->first,
+                                               entry->count,
+                                               entry->key_length };
+                        if (!merge_group(group, result, &header,
+                                         entry_key(table, entry),
+                                         entry_states(group, table, i)))
+                                return false;
+                }
+                /* Only its spilled partitions are left */
+                free(table->entries);
+                free(table->states);
+                free(table->slots);
+                free(table->keys);
+                table->entries = NULL;
+                table->states = NULL;
+                table->slots = NULL;
+                table->keys = NULL;
+                table->n_entries = table->entries_size = 0;
+                table->n_slots = 0;
+                table->keys_length = table->keys_size = 0;
+        }
+
+        return true;
+}
+
+/* qsort_r() comparison of indexes of the entries 'entries' */
+static int compare_first(const void *a, const void *b, void *entries)
+{
+        const group_entry *left =
+                &((const group_entry *)entries)[*(const size_t *)a];
+        const group_entry *right =
+                &((const group_entry *)entries)[*(const size_t *)b];
+
+        return (left->first > right->first) - (left->first < right->first);
+}
+
+/* Entries in the order their keys were first found, states with them */
+static void order_entries(texler_group *group, group_table *table)
+{
+        size_t n = table->n_entries;
+        size_t n_aggregates = group->n_aggregates;
+        size_t *order = group_realloc(NULL, (n + 1) * sizeof(size_t));
+        for (size_t i = 0; i < n; i++)
+                order[i] = i;
+        qsort_r(order, n, sizeof(size_t), compare_first, table->entries);
+
+        group_entry *entries = group_realloc(NULL,
+                                             (n + 1) * sizeof(group_entry));
+        group_state *states = group_realloc(NULL, states_size(group, n + 1));
+        for (size_t i = 0; i < n; i++) {
+                entries[i] = table->entries[order[i]];
+                memcpy(&states[i * n_aggregates],
+                       entry_states(group, table, order[i]),
+                       n_aggregates * sizeof(group_state));
+        }
+
+        /* The slots hold the old indexes, find_entry() rebuilds them */
+        free(table->slots);
+        table->slots = NULL;
+        table->n_slots = 0;
+        free(table->entries);
+        free(table->states);
+        free(order);
+        table->entries = entries;
+        table->states = states;
+        table->entries_size = n + 1;
+}
+
+/*
+ * Loads the next partition with groups into tables[0], from the spills of
+ * every table. False once there are none left.
+ */
+static bool load_partition(texler_group *group)
+{
+        group_table *result = &group->tables[0];
+        char *key = NULL;
+        group_state *states = group_realloc(
+                NULL, (group->n_aggregates + 1) * sizeof(group_state));
+
+        /* Partitions are not spilled again, they are the unit of memory */
+        result->memory = 0;
+        result->n_entries = 0;
+        result->keys_length = 0;
+        if (result->slots != NULL)
+                memset(result->slots, 0, result->n_slots * sizeof(size_t));
+
+        for (; group->partition < GROUP_PARTITIONS && result->n_entries == 0;
+             group->partition++) {
+                for (size_t t = 0; t < group->n_tables; t++) {
+                        FILE *stream =
+                                group->tables[t].partitions[group->partition];
+                        if (stream == NULL || fseek(stream, 0, SEEK_SET) != 0)
+                                continue;
+
+                        group_spill header;
+                        while (fread(&header, sizeof(header), 1, stream) ==
+                               1) {
+                                key = group_realloc(key,
+                                                    header.key_length + 1);
+                                if (fread(key, header.key_length, 1,
+                                          stream) != 1 &&
+                                    header.key_length > 0)
+                                        break;
+                                if (fread(states, sizeof(group_state),
+                                          group->n_aggregates, stream) !=
+                                    group->n_aggregates)
+                                        break;
+                                merge_group(group, result, &header, key,
+                                            states);
+                        }
+                        if (ferror(stream))
+                                perror("Error while grouping");
+                }
+        }
+        free(key);
+        free(states);
+
+        if (result->n_entries == 0)
+                return false;
+
+        order_entries(group, result);
+        group->next = 0;
+
+        return true;
+}
+
+static bool has_aggregate_column(const texler_aggregate *aggregate)
+{
+        return aggregate->type != TEXLER_AGGREGATE_COUNT;
+}
+
+static int compare_columns(const void *a, const void *b)
+{
+        unsigned long left = *(const unsigned long *)a;
+        unsigned long right = *(const unsigned long *)b;
+
+        return (left > right) - (left < right);
+}
+
+static size_t column_index(const texler_group *group, unsigned long column)
+{
+        unsigned long *found = (unsigned long *)bsearch(
+                &column, group->columns, group->n_columns,
+                sizeof(unsigned long), compare_columns);
+
+        return found - group->columns;
+}
+
+static texler_group *new_group(TexlerObject *tex_obj, unsigned long column,
+                               const texler_aggregate *aggregates,
+                               size_t n_aggregates)
+{
+        texler_group *group = (texler_group *)calloc(1, sizeof(texler_group));
+        if (group == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        group->n_aggregates = n_aggregates;
+        group->aggregates = group_realloc(
+                NULL, (n_aggregates + 1) * sizeof(texler_aggregate));
+        if (n_aggregates > 0)
+                memcpy(group->aggregates, aggregates,
+                       n_aggregates * sizeof(texler_aggregate));
+
+        group->columns = group_realloc(NULL, (n_aggregates + 1) *
+                                                     sizeof(unsigned long));
+        group->columns[group->n_columns++] = column;
+        for (size_t i = 0; i < n_aggregates; i++) {
+                if (has_aggregate_column(&aggregates[i]))
+                        group->columns[group->n_columns++] =
+                                aggregates[i].column;
+        }
+        qsort(group->columns, group->n_columns, sizeof(unsigned long),
+              compare_columns);
+        size_t n_unique = 0;
+        for (size_t i = 0; i < group->n_columns; i++) {
+                if (n_unique == 0 ||
+                    group->columns[n_unique - 1] != group->columns[i])
+                        group->columns[n_unique++] = group->columns[i];
+        }
+        group->n_columns = n_unique;
+
+        group->key_cell = column_index(group, column);
+        group->value_cells = group_realloc(NULL, (n_aggregates + 1) *
+                                                         sizeof(size_t));
+        for (size_t i = 0; i < n_aggregates; i++)
+                group->value_cells[i] =
+                        has_aggregate_column(&aggregates[i]) ?
+                                column_index(group, aggregates[i].column) :
+                                0;
+
+        /* As open_file() decides it, for the files of a folder too */
+        const char *separators = tex_obj->value.file.separators;
+        group->csv = separators != NULL && strcmp(separators, ",") == 0;
+        group->separator = group->csv ? ',' :
+                           separators == NULL || *separators == '\0' ?
+                                        TEXLER_DEFAULT_SEPARATORS[0] :
+                                        separators[0];
+
+        size_t n_tables = 1;
+        if (tex_obj->type == TYPE_T_FILE_LIST) {
+                n_tables = group_threads();
+                if (n_tables > tex_obj->value.file.n_files)
+                        n_tables = tex_obj->value.file.n_files;
+                if (n_tables == 0)
+                        n_tables = 1;
+        }
+        group->n_tables = n_tables;
+        group->tables = (group_table *)calloc(n_tables, sizeof(group_table));
+        if (group->tables == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        size_t memory = group_memory() / n_tables;
+        for (size_t i = 0; i < n_tables; i++)
+                group->tables[i].memory = memory;
+
+        return group;
+}
+
+/*
+ * Groups the records of tex_obj (a file, from its start, or every file of
+ * a folder) by their column 'column' (1-based) and computes the aggregates
+ * of each group. Values that are not numbers are left out of sum, min,
+ * max and avg. Returns NULL if the groups could not be spilled.
+ */
+texler_group *group_records(TexlerObject *tex_obj, unsigned long column,
+                            const texler_aggregate *aggregates,
+                            size_t n_aggregates)
+{
+        if (tex_obj == NULL || column == 0 ||
+            (n_aggregates > 0 && aggregates == NULL) ||
+            (tex_obj->type != TYPE_T_FILEPTR &&
+             tex_obj->type != TYPE_T_FILE_LIST))
+                return NULL;
+        for (size_t i = 0; i < n_aggregates; i++) {
+                if (has_aggregate_column(&aggregates[i]) &&
+                    aggregates[i].column == 0)
+                        return NULL;
+        }
+
+        texler_group *group =
+                new_group(tex_obj, column, aggregates, n_aggregates);
+        bool failed = false;
+
+        if (tex_obj->type == TYPE_T_FILEPTR) {
+                rewind(tex_obj->value.file.stream);
+                failed = !group_file(group, &group->tables[0], tex_obj, 0);
+        } else {
+                failed = !group_folder(group, tex_obj);
+        }
+
+        if (failed == false)
+                failed = !merge_tables(group);
+
+        for (size_t i = 0; i < group->n_tables; i++)
+                group->spilled = group->spilled || group->tables[i].spilled;
+        for (size_t i = 0; failed == false && group->spilled &&
+                           i < group->n_tables;
+             i++)
+                failed = !spill_table(group, &group->tables[i]);
+
+        if (failed) {
+                perror("Error while grouping");
+                free_group(group);
+                return NULL;
+        }
+
+        if (group->spilled)
+                load_partition(group);
+        else
+                order_entries(group, &group->tables[0]);
+
+        return group;
+}
+
+static void append(char **buffer, size_t *length, size_t *size,
+                   const char *bytes, size_t n)
+{
+        if (*length + n + 1 > *size) {
+                while (*length + n + 1 > *size)
+                        *size *= 2;
+                *buffer = group_realloc(*buffer, *size);
+        }
+
+        memcpy(*buffer + *length, bytes, n);
+        *length += n;
+        (*buffer)[*length] = '\0';
+}
+
+/* Key of a CSV group, quoted if it has to be */
+static void append_key(const texler_group *group, char **buffer,
+                       size_t *length, size_t *size, const char *key,
+                       size_t key_length)
+{
+        bool quote = false;
+        for (size_t i = 0; group->csv && i < key_length && !quote; i++)
+                quote = key[i] != '\0' && strchr(",\"\r\n", key[i]) != NULL;
+
+        if (!quote) {
+                append(buffer, length, size, key, key_length);
+                return;
+        }
+
+        append(buffer, length, size, "\"", 1);
+        for (size_t i = 0; i < key_length; i++) {
+                if (key[i] == '"')
+                        append(buffer, length, size, "\"", 1);
+                append(buffer, length, size, &key[i], 1);
+        }
+        append(buffer, length, size, "\"", 1);
+}
+
+/*
+ * Next group into *buffer (a malloc()ed string, as lines() takes it): its
+ * key and its aggregates, split by the first separator of the file, and a
+ * '\n'. min, max and avg of groups without numbers are empty. Groups come
+ * in the order their keys were first found (by partition, if they did not
+ * fit in memory). Returns its length plus one, 0 after the last one.
+ */
+long grouped_records(texler_group *group, char **buffer)
+{
+        if (group == NULL || buffer == NULL)
+                return 0;
+
+        group_table *table = &group->tables[0];
+        if (group->next == table->n_entries &&
+            (!group->spilled || !load_partition(group)))
+                return 0;
+
+        size_t index = group->next++;
+        const group_entry *entry = &table->entries[index];
+        const group_state *states = entry_states(group, table, index);
+
+        size_t size = BUFFER_SIZE;
+        size_t length = 0;
+        *buffer = group_realloc(*buffer, size);
+        append_key(group, buffer, &length, &size, entry_key(table, entry),
+                   entry->key_length);
+
+        for (size_t i = 0; i < group->n_aggregates; i++) {
+                const group_state *state = &states[i];
+                char value[64] = "";
+                char separator = group->separator;
+
+                switch (group->aggregates[i].type) {
+                case TEXLER_AGGREGATE_COUNT:
+                        snprintf(value, sizeof(value), "%zu", entry->count);
+                        break;
+                case TEXLER_AGGREGATE_SUM:
+                        snprintf(value, sizeof(value), "%.15g",
+                                 state->value);
+                        break;
+                case TEXLER_AGGREGATE_AVG:
+                        if (state->n > 0)
+                                snprintf(value, sizeof(value), "%.15g",
+                                         state->value / state->n);
+                        break;
+                default:
+                        if (state->n > 0)
+                                snprintf(value, sizeof(value), "%.15g",
+                                         state->value);
+                        break;
+                }
+
+                append(buffer, &length, &size, &separator, 1);
+                append(buffer, &length, &size, value, strlen(value));
+        }
+        append(buffer, &length, &size, "\n", 1);
+
+        return length + 1;
+}
+
+void free_group(texler_group *group)
+{
+        if (group == NULL)
+                return;
+
+        for (size_t t = 0; t < group->n_tables; t++) {
+                group_table *table = &group->tables[t];
+
+                for (size_t i = 0; i < GROUP_PARTITIONS; i++) {
+                        if (table->partitions[i] != NULL)
+                                fclose(table->partitions[i]);
+                }
+                free(table->entries);
+                free(table->states);
+                free(table->slots);
+                free(table->keys);
+        }
+        free(group->tables);
+        free(group->aggregates);
+        free(group->columns);
+        free(group->value_cells);
+        free(group);
+}
@@ -0,0 +1,260 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "texler_runtime.h"
+
+/*
+ * I/O backends of the files opened by open_file(). TEXLER_IO picks one:
+ *
+ *   stdio  fopen(), the stdio buffering of the C library
+ *   read   pread()/pwrite() by large blocks, pipelined on threads
+ *          (pipeline.c)
+ *   mmap   the file mapped in memory; only to read, outputs use "read"
+ *   uring  reads and writes queued in io_uring (uring.c); "read" where
+ *          the kernel does not support it
+ *   auto   (default) chosen by type and size of the file
+ *
+ * Whatever the backend, pipes, terminals and other files that are not
+ * regular always use stdio. Regular inputs compressed with gzip or zstd,
+ * and outputs named *.gz or *.zst, are read and written through
+ * compress.c instead.
+ */
+
+#define IO_SMALL_FILE (256 * 1024)
+
+typedef enum {
+        IO_AUTO = 0,
+        IO_STDIO,
+        IO_READ,
+        IO_MMAP,
+        IO_URING,
+} io_backend;
+
+static const char *io_backend_names[] = {
+        [IO_AUTO] = "auto", [IO_STDIO] = "stdio", [IO_READ] = "read",
+        [IO_MMAP] = "mmap", [IO_URING] = "uring",
+};
+
+static io_backend requested_backend(void)
+{
+        const char *env = getenv("TEXLER_IO");
+        if (env == NULL || *env == '\0')
+                return IO_AUTO;
+
+        for (size_t i = 0;
+             i < sizeof(io_backend_names) / sizeof(io_backend_names[0]); i++) {
+                if (strcmp(env, io_backend_names[i]) == 0)
+                        return (io_backend)i;
+        }
+
+        return IO_AUTO;
+}
+
+/*
+ * TEXLER_PIPELINE=0 keeps the block backend on the program thread and
+ * TEXLER_PIPELINE=1 always gives it threads.
+ */
+static bool pipeline_threads(void)
+{
+        static atomic_int n_cpus;
+
+        const char *env = getenv("TEXLER_PIPELINE");
+        if (env != NULL && *env != '\0')
+                return strcmp(env, "0") != 0;
+
+        /* Without a core to spare the threads only add switches */
+        if (atomic_load_explicit(&n_cpus, memory_order_relaxed) == 0)
+                atomic_store_explicit(&n_cpus, sysconf(_SC_NPROCESSORS_ONLN),
+                                      memory_order_relaxed);
+
+        return atomic_load_explicit(&n_cpus, memory_order_relaxed) > 1;
+}
+
+static io_backend auto_backend(bool writer, off_t size)
+{
+        /* Nothing to gain over a single stdio read */
+        if (writer == false && size <= IO_SMALL_FILE)
+                return IO_STDIO;
+
+        /* Mapped inputs skip a copy, unless a thread can read ahead */
+        if (writer == false && pipeline_threads() == false)
+                return IO_MMAP;
+
+        return IO_READ;
+}
+
+typedef struct {
+        char *data;
+        size_t size;
+        size_t position;
+} mapping;
+
+static ssize_t mapping_read(void *cookie, char *buffer, size_t size)
+{
+        mapping *m = (mapping *)cookie;
+
+        if (m->position >= m->size)
+                return 0;
+        if (size > m->size - m->position)
+                size = m->size - m->position;
+        memcpy(buffer, m->data + m->position, size);
+        m->position += size;
+
+        return size;
+}
+
+static int mapping_seek(void *cookie, off64_t *offset, int whence)
+{
+        mapping *m = (mapping *)cookie;
+        off64_t target = *offset;
+
+        if (whence == SEEK_CUR)
+                target += m->position;
+        else if (whence == SEEK_END)
+                target += m->size;
+        if (target < 0 || (whence != SEEK_SET && whence != SEEK_CUR &&
+                           whence != SEEK_END)) {
+                errno = EINVAL;
+                return -1;
+        }
+
+        m->position = target;
+        *offset = target;
+        return 0;
+}
+
+static int mapping_close(void *cookie)
+{
+        mapping *m = (mapping *)cookie;
+        int ret = munmap(m->data, m->size);
+        free(m);
+
+        return ret;
+}
+
+/* Stream over the whole file fd maps; fd can be closed afterwards */
+static FILE *open_mmap(int fd, off_t size)
+{
+        if (size <= 0)
+                return NULL;
+
+        char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+                return NULL;
+        madvise(data, size, MADV_SEQUENTIAL);
+
+        mapping *m = (mapping *)calloc(1, sizeof(mapping));
+        if (m == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        m->data = data;
+        m->size = size;
+
+        cookie_io_functions_t functions = {
+                .read = mapping_read,
+                .seek = mapping_seek,
+                .close = mapping_close,
+        };
+        FILE *fptr = fopencookie(m, "r", functions);
+        if (fptr == NULL)
+                mapping_close(m);
+
+        return fptr;
+}
+
+static FILE *open_stdio(int fd, const char *mode)
+{
+        FILE *fptr = fdopen(fd, mode);
+        if (fptr == NULL)
+                close(fd);
+
+        return fptr;
+}
+
+/*
+ * fopen() for the files of a program, through the backend TEXLER_IO asks
+ * for. Modes other than "r", "w" and "w+" are left to stdio. *size is set
+ * as open_io_fd() does.
+ */
+FILE *open_io(const char *name, const char *mode, off_t *size)
+{
+        *size = 0;
+        bool writer = strcmp(mode, "w") == 0 || strcmp(mode, "w+") == 0;
+        if (writer == false && strcmp(mode, "r") != 0)
+                return fopen(name, mode);
+
+        /* Inputs are told by their content, in open_io_fd() */
+        TEXLER_COMPRESSION format = writer ? output_compression(name) :
+                                             TEXLER_COMPRESSION_NONE;
+
+        int flags = O_CLOEXEC;
+        if (writer)
+                flags |= (mode[1] == '+' ? O_RDWR : O_WRONLY) | O_CREAT |
+                         O_TRUNC;
+        else
+                flags |= O_RDONLY;
+
+        int fd = open(name, flags, 0666);
+        if (fd < 0)
+                return NULL;
+
+        if (format != TEXLER_COMPRESSION_NONE)
+                return open_compressed(fd, mode, format, pipeline_threads());
+
+        return open_io_fd(fd, mode, size);
+}
+
+/*
+ * Stream over fd, already opened with mode "r", "w" or "w+". Closing the
+ * stream closes fd, and so does a failure. *size is the size of fd if it
+ * is a regular, uncompressed input, which cookie streams cannot tell
+ * later, and 0 otherwise.
+ */
+FILE *open_io_fd(int fd, const char *mode, off_t *size)
+{
+        io_backend backend = requested_backend();
+        bool writer = mode[0] == 'w';
+
+        *size = 0;
+
+        struct stat st;
+        if (fstat(fd, &st) || S_ISREG(st.st_mode) == false)
+                return open_stdio(fd, mode);
+
+        TEXLER_COMPRESSION format = writer ? TEXLER_COMPRESSION_NONE :
+                                             input_compression(fd);
+        if (format != TEXLER_COMPRESSION_NONE)
+                return open_compressed(fd, mode, format, pipeline_threads());
+        if (writer == false)
+                *size = st.st_size;
+
+        if (backend == IO_AUTO)
+                backend = auto_backend(writer, st.st_size);
+
+        FILE *fptr = NULL;
+        switch (backend) {
+        case IO_STDIO:
+                return open_stdio(fd, mode);
+        case IO_MMAP:
+                if (writer == false && (fptr = open_mmap(fd, st.st_size))) {
+                        close(fd);
+                        return fptr;
+                }
+                break;
+        case IO_URING:
+                if ((fptr = open_uring(fd, mode)))
+                        return fptr;
+                break;
+        default:
+                break;
+        }
+
+        return open_pipeline(fd, mode, pipeline_threads());
+}
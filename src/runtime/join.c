@@ -0,0 +1,594 @@
+#include "texler_runtime.h"
+
+/*
+ * lines().join(other, column, other_column, inner|left): hash join of the
+ * records of a file (the probe side, read once as a stream) with the ones
+ * of another file (the build side) that have the same key.
+ *
+ * The records of the build side are kept in an arena, each one after its
+ * key, and indexed by an open addressing table (linear probing) of their
+ * keys. Records of the same key are chained in the order they were read,
+ * so each probe record is followed by its matches in that order, and probe
+ * records come out in the order they are read.
+ *
+ * The build side is the other file, unless both are plain files (their
+ * size known from open_io()) and the input is the smaller one: then the
+ * input is built and the other file probes it. Results still have the
+ * input record first, but come out in the order of the other file, and a
+ * left join returns the input records without matches once it is read.
+ *
+ * If the build side does not fit in TEXLER_JOIN_MEMORY MiB, both sides are
+ * partitioned into temporary files by the top bits of the hash of their
+ * keys (grace hash join), and each partition is then joined on its own:
+ * its build records in memory, its probe records streamed. Records then
+ * come out partition by partition.
+ */
+
+#define JOIN_MEMORY (256UL * 1024 * 1024)
+#define JOIN_MIN_SLOTS 64
+/* Partitions of a spilled join, by the top bits of the hash of the keys */
+#define JOIN_PARTITION_BITS 4
+#define JOIN_PARTITIONS (1 << JOIN_PARTITION_BITS)
+
+typedef struct {
+        uint64_t hash;
+        size_t offset; /* Of its key in the arena, its record after it */
+        size_t key_length;
+        size_t length; /* Of the record, without its '\n' */
+        size_t next; /* Next record of the same key, plus one. 0: none */
+        size_t last; /* Of the first record of a key: its last one */
+        bool matched; /* By a probe record */
+} join_entry;
+
+/* Spilled record: join_spill, key, record */
+typedef struct {
+        uint64_t hash;
+        size_t key_length;
+        size_t length;
+} join_spill;
+
+struct texler_join {
+        TexlerObject *probe;
+        unsigned long probe_column;
+        bool keep_unmatched; /* left */
+        bool swapped; /* The input is the build side */
+        int separator; /* Between the two records of a result */
+
+        join_entry *entries;
+        size_t n_entries;
+        size_t entries_size;
+        size_t *slots; /* First entry of a key, plus one. 0 when free */
+        size_t n_slots; /* A power of two */
+        char *arena;
+        size_t arena_length;
+        size_t arena_size;
+
+        size_t memory; /* Build side spilled from there on */
+        bool spilled;
+        FILE *build_partitions[JOIN_PARTITIONS];
+        FILE *probe_partitions[JOIN_PARTITIONS];
+        size_t partition; /* Being joined, if spilled */
+        size_t unmatched; /* Next entry to check once probed, if swapped */
+
+        /* Probe record being joined, without its '\n', and its key */
+        char *record;
+        size_t length;
+        char *key;
+        size_t key_length;
+        size_t key_size;
+        size_t match; /* Next entry to return for it, plus one */
+        char *cell;
+};
+
+static void *join_realloc(void *ptr, size_t size)
+{
+        void *new_ptr = realloc(ptr, size);
+        if (new_ptr == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        return new_ptr;
+}
+
+static size_t join_memory(void)
+{
+        const char *env = getenv("TEXLER_JOIN_MEMORY");
+        if (env == NULL || *env == '\0')
+                return JOIN_MEMORY;
+
+        char *end = NULL;
+        long mebibytes = strtol(env, &end, 10);
+        if (*end != '\0' || mebibytes <= 0)
+                return JOIN_MEMORY;
+
+        return mebibytes * 1024UL * 1024;
+}
+
+static size_t partition_of(uint64_t hash)
+{
+        return hash >> (64 - JOIN_PARTITION_BITS);
+}
+
+/* Column 'column' of record in join->cell, without its '\n' */
+static size_t record_key(texler_join *join, TexlerObject *tex_obj,
+                         char *record)
+{
+        char *str = record;
+        int separator = 0;
+
+        join->cell[0] = '\0';
+        file_columns(tex_obj, &str, &join->cell, &separator);
+
+        size_t length = strlen(join->cell);
+        while (length > 0 && join->cell[length - 1] == '\n')
+                join->cell[--length] = '\0';
+
+        return length;
+}
+
+static size_t record_length(const char *record)
+{
+        size_t length = strlen(record);
+        if (length > 0 && record[length - 1] == '\n')
+                length--;
+
+        return length;
+}
+
+static size_t table_memory(const texler_join *join)
+{
+        return join->arena_length + join->n_entries * sizeof(join_entry) +
+               join->n_slots * sizeof(size_t);
+}
+
+static const char *entry_key(const texler_join *join, const join_entry *entry)
+{
+        return join->arena + entry->offset;
+}
+
+/* First entry of key, plus one, or the free slot where it would go */
+static size_t *find_slot(texler_join *join, uint64_t hash, const char *key,
+                         size_t key_length)
+{
+        size_t mask = join->n_slots - 1;
+        size_t i = hash & mask;
+
+        for (; join->slots[i] != 0; i = (i + 1) & mask) {
+                const join_entry *entry = &join->entries[join->slots[i] - 1];
+                if (entry->hash == hash && entry->key_length == key_length &&
+                    memcmp(entry_key(join, entry), key, key_length) == 0)
+                        break;
+        }
+
+        return &join->slots[i];
+}
+
+static void grow_slots(texler_join *join)
+{
+        size_t n_slots =
+                join->n_slots == 0 ? JOIN_MIN_SLOTS : 2 * join->n_slots;
+        size_t *slots = (size_t *)calloc(n_slots, sizeof(size_t));
+        if (slots == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        /* Only the first entry of each key is in the table */
+        for (size_t i = 0; i < join->n_slots; i++) {
+                if (join->slots[i] == 0)
+                        continue;
+
+                size_t j = join->entries[join->slots[i] - 1].hash &
+                           (n_slots - 1);
+                while (slots[j] != 0)
+                        j = (j + 1) & (n_slots - 1);
+                slots[j] = join->slots[i];
+        }
+
+        free(join->slots);
+        join->slots = slots;
+        join->n_slots = n_slots;
+}
+
+static void add_entry(texler_join *join, uint64_t hash, const char *key,
+                      size_t key_length, const char *record, size_t length)
+{
+        size_t needed = join->arena_length + key_length + length;
+        if (needed > join->arena_size || join->arena == NULL) {
+                size_t size = join->arena_size == 0 ? BUFFER_SIZE :
+                                                      join->arena_size;
+                while (size < needed)
+                        size *= 2;
+                join->arena = join_realloc(join->arena, size);
+                join->arena_size = size;
+        }
+        if (join->n_entries == join->entries_size) {
+                join->entries_size = join->entries_size == 0 ?
+                                             BUFFER_SIZE :
+                                             2 * join->entries_size;
+                join->entries = join_realloc(
+                        join->entries,
+                        join->entries_size * sizeof(join_entry));
+        }
+        /* At most half full, there are no more keys than records */
+        if (2 * (join->n_entries + 1) > join->n_slots)
+                grow_slots(join);
+
+        join_entry *entry = &join->entries[join->n_entries++];
+        *entry = (join_entry){ .hash = hash,
+                               .offset = join->arena_length,
+                               .key_length = key_length,
+                               .length = length };
+        memcpy(join->arena + join->arena_length, key, key_length);
+        memcpy(join->arena + join->arena_length + key_length, record, length);
+        join->arena_length = needed;
+
+        size_t *slot = find_slot(join, hash, key, key_length);
+        if (*slot == 0) {
+                *slot = join->n_entries;
+        } else {
+                join_entry *first = &join->entries[*slot - 1];
+                size_t last = first->last == 0 ? *slot : first->last;
+                join->entries[last - 1].next = join->n_entries;
+                first->last = join->n_entries;
+        }
+}
+
+static void clear_table(texler_join *join)
+{
+        join->n_entries = 0;
+        join->arena_length = 0;
+        join->unmatched = 0;
+        if (join->slots != NULL)
+                memset(join->slots, 0, join->n_slots * sizeof(size_t));
+}
+
+static bool write_spill(FILE **partitions, uint64_t hash, const char *key,
+                        size_t key_length, const char *record, size_t length)
+{
+        size_t partition = partition_of(hash);
+        if (partitions[partition] == NULL &&
+            (partitions[partition] = tmpfile()) == NULL)
+                return false;
+
+        FILE *stream = partitions[partition];
+        join_spill header = { hash, key_length, length };
+
+        /* Empty keys and records write no bytes, fwrite() returns 0 */
+        return fwrite(&header, sizeof(header), 1, stream) == 1 &&
+               (key_length == 0 ||
+                fwrite(key, key_length, 1, stream) == 1) &&
+               (length == 0 || fwrite(record, length, 1, stream) == 1);
+}
+
+/* Reads the next spilled record into join->key and join->record */
+static bool read_spill(texler_join *join, FILE *stream, uint64_t *hash)
+{
+        join_spill header;
+        if (stream == NULL || fread(&header, sizeof(header), 1, stream) != 1)
+                return false;
+
+        if (header.key_length + 1 > join->key_size) {
+                join->key_size = header.key_length + 1;
+                join->key = join_realloc(join->key, join->key_size);
+        }
+        join->record = join_realloc(join->record, header.length + 1);
+
+        if ((header.key_length > 0 &&
+             fread(join->key, header.key_length, 1, stream) != 1) ||
+            (header.length > 0 &&
+             fread(join->record, header.length, 1, stream) != 1))
+                return false;
+
+        join->key[header.key_length] = '\0';
+        join->record[header.length] = '\0';
+        join->key_length = header.key_length;
+        join->length = header.length;
+        *hash = header.hash;
+
+        return true;
+}
+
+/* Moves the build records in memory to their partitions */
+static bool spill_table(texler_join *join)
+{
+        for (size_t i = 0; i < join->n_entries; i++) {
+                const join_entry *entry = &join->entries[i];
+                const char *key = entry_key(join, entry);
+
+                if (!write_spill(join->build_partitions, entry->hash, key,
+                                 entry->key_length, key + entry->key_length,
+                                 entry->length))
+                        return false;
+        }
+        clear_table(join);
+        join->spilled = true;
+
+        return true;
+}
+
+static bool build_table(texler_join *join, TexlerObject *build,
+                        unsigned long column)
+{
+        char *record = join_realloc(NULL, BUFFER_SIZE);
+        bool failed = false;
+
+        rewind(build->value.file.stream);
+        project_columns(build, &column, 1);
+        while (!failed && records(build, &record) > 0) {
+                size_t key_length = record_key(join, build, record);
+                size_t length = record_length(record);
+                uint64_t hash = hash_bytes(join->cell, key_length);
+
+                if (join->spilled) {
+                        failed = !write_spill(join->build_partitions, hash,
+                                              join->cell, key_length, record,
+                                              length);
+                        continue;
+                }
+
+                add_entry(join, hash, join->cell, key_length, record, length);
+                if (join->memory > 0 && table_memory(join) >= join->memory)
+                        failed = !spill_table(join);
+        }
+        project_columns(build, NULL, 0);
+        free(record);
+
+        return !failed;
+}
+
+/* Every probe record to its partition, once the build side spilled */
+static bool partition_probe(texler_join *join)
+{
+        TexlerObject *probe = join->probe;
+        char *record = join_realloc(NULL, BUFFER_SIZE);
+        bool failed = false;
+
+        project_columns(probe, &join->probe_column, 1);
+        while (!failed && records(probe, &record) > 0) {
+                size_t key_length = record_key(join, probe, record);
+
+                failed = !write_spill(join->probe_partitions,
+                                      hash_bytes(join->cell, key_length),
+                                      join->cell, key_length, record,
+                                      record_length(record));
+        }
+        project_columns(probe, NULL, 0);
+        free(record);
+
+        return !failed;
+}
+
+/* Loads the build records of partition p, and rewinds its probe ones */
+static bool load_partition(texler_join *join, size_t p)
+{
+        clear_table(join);
+
+        FILE *build = join->build_partitions[p];
+        if (build != NULL && fseek(build, 0, SEEK_SET) != 0)
+                return false;
+
+        uint64_t hash = 0;
+        while (read_spill(join, build, &hash))
+                add_entry(join, hash, join->key, join->key_length,
+                          join->record, join->length);
+
+        FILE *probe = join->probe_partitions[p];
+        return probe == NULL || fseek(probe, 0, SEEK_SET) == 0;
+}
+
+/*
+ * Reads the next probe record of the partition being joined and its key,
+ * false once there are none
+ */
+static bool next_probe(texler_join *join)
+{
+        if (join->spilled) {
+                uint64_t hash = 0;
+                return read_spill(
+                        join, join->probe_partitions[join->partition], &hash);
+        }
+
+        TexlerObject *probe = join->probe;
+        project_columns(probe, &join->probe_column, 1);
+        long length = records(probe, &join->record);
+        if (length > 0)
+                join->key_length = record_key(join, probe, join->record);
+        project_columns(probe, NULL, 0);
+        if (length <= 0)
+                return false;
+
+        if (join->key_length + 1 > join->key_size) {
+                join->key_size = join->key_length + 1;
+                join->key = join_realloc(join->key, join->key_size);
+        }
+        memcpy(join->key, join->cell, join->key_length + 1);
+        join->length = record_length(join->record);
+        join->record[join->length] = '\0';
+
+        return true;
+}
+
+/* Loads the next partition, false if there are no more */
+static bool next_partition(texler_join *join)
+{
+        return join->spilled && ++join->partition < JOIN_PARTITIONS &&
+               load_partition(join, join->partition);
+}
+
+/* Next build record no probe record matched, once they were all read */
+static const join_entry *next_unmatched(texler_join *join)
+{
+        while (join->unmatched < join->n_entries) {
+                const join_entry *entry = &join->entries[join->unmatched++];
+                if (!entry->matched)
+                        return entry;
+        }
+
+        return NULL;
+}
+
+/*
+ * Joins the records of probe (a file) with the ones of build (a file)
+ * whose column build_column is the same as their column probe_column.
+ * With keep_unmatched, probe records without any are returned too (left
+ * join).
+ */
+texler_join *join_records(TexlerObject *probe, TexlerObject *build,
+                          unsigned long probe_column,
+                          unsigned long build_column, bool keep_unmatched)
+{
+        if (probe == NULL || build == NULL || probe_column == 0 ||
+            build_column == 0 || probe->type != TYPE_T_FILEPTR ||
+            build->type != TYPE_T_FILEPTR)
+                return NULL;
+
+        texler_join *join = (texler_join *)calloc(1, sizeof(texler_join));
+        if (join == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        join->keep_unmatched = keep_unmatched;
+        join->memory = join_memory();
+        join->cell = join_realloc(NULL, BUFFER_SIZE);
+        join->record = join_realloc(NULL, BUFFER_SIZE);
+
+        /* As open_file() decides it */
+        const char *separators = probe->value.file.separators;
+        join->separator = separators != NULL && strcmp(separators, ",") == 0 ?
+                                  ',' :
+                          separators == NULL || *separators == '\0' ?
+                                  TEXLER_DEFAULT_SEPARATORS[0] :
+                                  separators[0];
+
+        /* The smaller side is built, if both sizes are known */
+        off_t probe_size = probe->value.file.size;
+        off_t build_size = build->value.file.size;
+        join->swapped = probe_size > 0 && build_size > 0 &&
+                        probe_size < build_size;
+        if (join->swapped) {
+                TexlerObject *tex_obj = probe;
+                unsigned long column = probe_column;
+                probe = build;
+                probe_column = build_column;
+                build = tex_obj;
+                build_column = column;
+        }
+        join->probe = probe;
+        join->probe_column = probe_column;
+
+        /* Both are read from their start, even if they are the same file */
+        bool failed = !build_table(join, build, build_column);
+        rewind(probe->value.file.stream);
+        if (failed == false && join->spilled)
+                failed = !partition_probe(join) || !load_partition(join, 0);
+
+        if (failed) {
+                perror("Error while joining");
+                free_join(join);
+                return NULL;
+        }
+
+        return join;
+}
+
+static void append(char **buffer, size_t *length, size_t *size,
+                   const char *bytes, size_t n)
+{
+        if (*length + n + 1 > *size) {
+                while (*length + n + 1 > *size)
+                        *size *= 2;
+                *buffer = join_realloc(*buffer, *size);
+        }
+
+        memcpy(*buffer + *length, bytes, n);
+        *length += n;
+        (*buffer)[*length] = '\0';
+}
+
+/*
+ * Next record of the join into buffer (reallocated as needed): the input
+ * record, the separator and the record of the other file, or just the
+ * input record if it has no match. Returns its length plus one, 0 at the
+ * end.
+ */
+long joined_records(texler_join *join, char **buffer)
+{
+        if (join == NULL || buffer == NULL)
+                return 0;
+
+        const join_entry *unmatched = NULL;
+        while (join->match == 0 && unmatched == NULL) {
+                if (!next_probe(join)) {
+                        /* Left join: the input records nothing matched */
+                        if (join->swapped && join->keep_unmatched)
+                                unmatched = next_unmatched(join);
+                        if (unmatched == NULL && !next_partition(join))
+                                return 0;
+                        continue;
+                }
+
+                uint64_t hash = hash_bytes(join->key, join->key_length);
+                if (join->n_slots > 0)
+                        join->match = *find_slot(join, hash, join->key,
+                                                 join->key_length);
+                if (join->match == 0 && join->keep_unmatched &&
+                    !join->swapped)
+                        break;
+        }
+
+        size_t size = BUFFER_SIZE;
+        size_t length = 0;
+        *buffer = join_realloc(*buffer, size);
+
+        if (unmatched != NULL) {
+                append(buffer, &length, &size,
+                       entry_key(join, unmatched) + unmatched->key_length,
+                       unmatched->length);
+        } else if (join->match != 0) {
+                join_entry *entry = &join->entries[join->match - 1];
+                const char *build = entry_key(join, entry) + entry->key_length;
+                char separator = join->separator;
+
+                if (join->swapped)
+                        append(buffer, &length, &size, build, entry->length);
+                else
+                        append(buffer, &length, &size, join->record,
+                               join->length);
+                append(buffer, &length, &size, &separator, 1);
+                if (join->swapped)
+                        append(buffer, &length, &size, join->record,
+                               join->length);
+                else
+                        append(buffer, &length, &size, build, entry->length);
+
+                entry->matched = true;
+                join->match = entry->next;
+        } else {
+                append(buffer, &length, &size, join->record, join->length);
+        }
+        append(buffer, &length, &size, "\n", 1);
+
+        return length + 1;
+}
+
+void free_join(texler_join *join)
+{
+        if (join == NULL)
+                return;
+
+        for (size_t i = 0; i < JOIN_PARTITIONS; i++) {
+                if (join->build_partitions[i] != NULL)
+                        fclose(join->build_partitions[i]);
+                if (join->probe_partitions[i] != NULL)
+                        fclose(join->probe_partitions[i]);
+        }
+        free(join->entries);
+        free(join->slots);
+        free(join->arena);
+        free(join->record);
+        free(join->key);
+        free(join->cell);
+        free(join);
+}
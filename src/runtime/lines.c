@@ -0,0 +1,220 @@
+#include <errno.h>
+#include <malloc.h>
+
+#include "texler_runtime.h"
+
+#define SEEK_BLOCK_SIZE 65536
+/* Lines between two rows of lines_by_numbers() skipped with a seek */
+#define LINES_SEEK_GAP 1024
+
+long int line_length(FILE *stream, const fpos_t *pos)
+{
+        long int start = ftell(stream);
+        long int end = 0;
+        int c = 0;
+
+        do {
+                c = fgetc(stream);
+        } while (c != EOF && c != '\n');
+
+        end = ftell(stream);
+
+        if (fsetpos(stream, pos)) {
+                perror("Error while getting file position");
+                return false;
+        }
+
+        if (end == 0)
+                return 0;
+
+        return end - start;
+}
+
+/*
+ * Reads the next line into *buffer (a malloc()ed string, grown as needed).
+ * The line is read in one pass, never seeking back, so the stream can be a
+ * pipelined one (pipeline.c). Returns its length plus one, 0 at EOF.
+ */
+long int lines(TexlerObject *tex_obj, char **buffer)
+{
+        if (tex_obj == NULL || buffer == NULL || *buffer == NULL)
+                return 0;
+
+        if (tex_obj->type != TYPE_T_FILEPTR ||
+            tex_obj->value.file.stream == NULL)
+                return 0;
+
+        size_t capacity = malloc_usable_size(*buffer);
+        ssize_t length =
+                getline(buffer, &capacity, tex_obj->value.file.stream);
+
+        /* EOF reached */
+        if (length <= 0) {
+                if (errno == ENOMEM) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+                return 0;
+        }
+
+        if (fgetpos(tex_obj->value.file.stream, &tex_obj->value.file.pos)) {
+                perror("Error while getting file position");
+                return false;
+        }
+        tex_obj->value.file.n_line++;
+
+        return length + 1;
+}
+
+/* Leaves the stream at its last line read, or at its start if n is before */
+static bool restore_position(TexlerObject *tex_obj, unsigned long n)
+{
+        FILE *stream = tex_obj->value.file.stream;
+
+        if (tex_obj->value.file.n_line > n) {
+                rewind(stream);
+                tex_obj->value.file.n_line = 1;
+        } else if (fsetpos(stream, &tex_obj->value.file.pos)) {
+                perror("Error while setting file position");
+                return false;
+        }
+
+        return true;
+}
+
+/*
+ * Moves the stream forward to the start of line n, counting the newlines
+ * of the blocks of SEEK_BLOCK_SIZE bytes it reads into block instead of
+ * reading the lines one at a time. Returns false if the file has less than
+ * n lines.
+ */
+static bool skip_to_line(TexlerObject *tex_obj, unsigned long n, char *block)
+{
+        FILE *stream = tex_obj->value.file.stream;
+        unsigned long remaining = n - tex_obj->value.file.n_line;
+        long offset = ftell(stream);
+
+        while (remaining > 0) {
+                size_t block_len = fread(block, 1, SEEK_BLOCK_SIZE, stream);
+                if (block_len == 0)
+                        break;
+
+                char *block_end = block + block_len;
+                char *newline = block;
+                while (remaining > 0 && newline < block_end &&
+                       (newline = memchr(newline, '\n',
+                                         block_end - newline)) != NULL) {
+                        newline++;
+                        remaining--;
+                }
+
+                if (remaining == 0)
+                        offset += newline - block;
+                else
+                        offset += block_len;
+        }
+
+        clearerr(stream);
+        if (offset < 0 || fseek(stream, offset, SEEK_SET)) {
+                perror("Error while setting file position");
+                return false;
+        }
+        tex_obj->value.file.n_line = n - remaining;
+
+        if (fgetpos(stream, &tex_obj->value.file.pos)) {
+                perror("Error while getting file position");
+                return false;
+        }
+
+        return remaining == 0;
+}
+
+/*
+ * Leaves the stream at the start of line n (1-based). Lines are counted
+ * block by block instead of reading them one at a time. Returns false if
+ * the file has less than n lines.
+ */
+bool seek_line(TexlerObject *tex_obj, unsigned long n)
+{
+        if (tex_obj == NULL || n == 0 || tex_obj->type != TYPE_T_FILEPTR ||
+            tex_obj->value.file.stream == NULL)
+                return false;
+
+        if (restore_position(tex_obj, n) == false)
+                return false;
+
+        char *block = (char *)malloc(SEEK_BLOCK_SIZE);
+        if (block == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        bool found = skip_to_line(tex_obj, n, block);
+        free(block);
+
+        return found;
+}
+
+/*
+ * Reads the lines in rows (sorted, without duplicates) in a single forward
+ * pass, storing a copy of each one in slots. The lines between two rows
+ * are read past, unless there are LINES_SEEK_GAP or more of them: those
+ * are counted block by block and skipped with a seek. Stops at the first
+ * missing line and returns how many were found.
+ */
+size_t lines_by_numbers(TexlerObject *tex_obj, const unsigned long *rows,
+                        size_t n_rows, char **slots)
+{
+        if (tex_obj == NULL || tex_obj->type != TYPE_T_FILEPTR ||
+            tex_obj->value.file.stream == NULL || n_rows == 0 ||
+            rows[0] == 0 || restore_position(tex_obj, rows[0]) == false)
+                return 0;
+
+        size_t found = 0;
+        char *block = (char *)malloc(SEEK_BLOCK_SIZE);
+        char *line = (char *)calloc(BUFFER_SIZE, sizeof(char));
+        if (block == NULL || line == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        for (size_t i = 0; i < n_rows; i++) {
+                if (rows[i] < tex_obj->value.file.n_line)
+                        break;
+
+                unsigned long gap = rows[i] - tex_obj->value.file.n_line;
+                if (gap >= LINES_SEEK_GAP) {
+                        if (skip_to_line(tex_obj, rows[i], block) == false)
+                                break;
+                } else {
+                        while (gap > 0 && lines(tex_obj, &line) > 0)
+                                gap--;
+                        if (gap > 0)
+                                break;
+                }
+
+                if (lines(tex_obj, &line) <= 0)
+                        break;
+
+                slots[i] = strdup(line);
+                if (slots[i] == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+                found++;
+        }
+        free(block);
+        free(line);
+
+        return found;
+}
+
+long line_by_number(TexlerObject *tex_obj, char **buffer, unsigned long n)
+{
+        if (tex_obj == NULL || buffer == NULL || *buffer == NULL)
+                return 0;
+
+        if (seek_line(tex_obj, n) == false)
+                return 0;
+
+        return lines(tex_obj, buffer); /* Line n */
+}
@@ -0,0 +1,445 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "texler_runtime.h"
+
+/*
+ * Block I/O backend (io.c): files are read and written with pread() and
+ * pwrite() of large blocks instead of the few KiB stdio asks for.
+ *
+ * Pipelined, reading, running the program and writing are overlapped: a
+ * reader thread reads the input ahead of the program and a writer thread
+ * writes the output blocks it fills, so the loop generated for the program
+ * only copies memory. Each thread is joined to the program by a
+ * single-producer/single-consumer ring of blocks; a full ring stops the
+ * producer until the consumer frees a slot. Without threads the same
+ * blocks are read and written in place, one at a time.
+ *
+ * The streams are plain FILE * (fopencookie()), so generated code, seeks
+ * and the rest of the runtime work on them unchanged.
+ */
+
+#define PIPELINE_BLOCK_SIZE (256 * 1024)
+#define PIPELINE_SLOTS 4
+
+typedef struct {
+        char *data;
+        ssize_t length; /* 0 at EOF, -1 on a read error */
+        off_t offset;
+        int error;
+} pipeline_block;
+
+typedef struct {
+        int fd;
+        bool writer; /* Opened to write: the thread drains the ring */
+        bool threaded;
+
+        pipeline_block slots[PIPELINE_SLOTS];
+        /* Blocks produced and consumed, only ever incremented */
+        atomic_uint head;
+        atomic_uint tail;
+        atomic_bool stop;
+        atomic_int error; /* First pwrite() error */
+
+        pthread_t thread;
+        bool running;
+
+        pipeline_block *current; /* Block the program reads or fills */
+        size_t current_pos;
+        off_t position; /* Logical offset of the stream */
+} pipeline;
+
+static void futex_wait(atomic_uint *word, unsigned value)
+{
+        syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT_PRIVATE, value, NULL,
+                NULL, 0);
+}
+
+static void futex_wake(atomic_uint *word)
+{
+        syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL,
+                0);
+}
+
+/* Waits for a free slot; false if the pipeline was stopped meanwhile */
+static bool wait_free_slot(pipeline *p)
+{
+        unsigned head = atomic_load_explicit(&p->head, memory_order_relaxed);
+        for (;;) {
+                if (atomic_load(&p->stop))
+                        return false;
+                unsigned tail =
+                        atomic_load_explicit(&p->tail, memory_order_acquire);
+                if (head - tail < PIPELINE_SLOTS)
+                        return true;
+                futex_wait(&p->tail, tail);
+        }
+}
+
+/* Waits for a used slot; false if the pipeline was stopped meanwhile */
+static bool wait_used_slot(pipeline *p)
+{
+        unsigned tail = atomic_load_explicit(&p->tail, memory_order_relaxed);
+        for (;;) {
+                if (atomic_load(&p->stop))
+                        return false;
+                unsigned head =
+                        atomic_load_explicit(&p->head, memory_order_acquire);
+                if (head != tail)
+                        return true;
+                futex_wait(&p->head, head);
+        }
+}
+
+static void publish(pipeline *p)
+{
+        atomic_fetch_add_explicit(&p->head, 1, memory_order_release);
+        futex_wake(&p->head);
+}
+
+static void release(pipeline *p)
+{
+        atomic_fetch_add_explicit(&p->tail, 1, memory_order_release);
+        futex_wake(&p->tail);
+}
+
+static pipeline_block *slot_at(pipeline *p, atomic_uint *index)
+{
+        return &p->slots[atomic_load_explicit(index, memory_order_relaxed) %
+                         PIPELINE_SLOTS];
+}
+
+static void read_block(pipeline *p, pipeline_block *block, off_t offset)
+{
+        block->offset = offset;
+        do {
+                block->length =
+                        pread(p->fd, block->data, PIPELINE_BLOCK_SIZE, offset);
+        } while (block->length < 0 && errno == EINTR);
+        block->error = errno;
+}
+
+static void *reader_thread(void *arg)
+{
+        pipeline *p = (pipeline *)arg;
+        off_t offset = p->position;
+
+        while (wait_free_slot(p)) {
+                pipeline_block *block = slot_at(p, &p->head);
+                read_block(p, block, offset);
+                publish(p);
+
+                if (block->length <= 0)
+                        break;
+                offset += block->length;
+        }
+
+        return NULL;
+}
+
+static bool write_block(pipeline *p, const pipeline_block *block)
+{
+        size_t written = 0;
+        while (written < (size_t)block->length) {
+                ssize_t n = pwrite(p->fd, block->data + written,
+                                   block->length - written,
+                                   block->offset + written);
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n <= 0) {
+                        int expected = 0;
+                        atomic_compare_exchange_strong(
+                                &p->error, &expected, n < 0 ? errno : EIO);
+                        return false;
+                }
+                written += n;
+        }
+
+        return true;
+}
+
+static void *writer_thread(void *arg)
+{
+        pipeline *p = (pipeline *)arg;
+
+        while (wait_used_slot(p)) {
+                write_block(p, slot_at(p, &p->tail));
+                release(p);
+        }
+
+        return NULL;
+}
+
+static bool start_thread(pipeline *p)
+{
+        if (p->running)
+                return true;
+
+        atomic_store(&p->stop, false);
+        if (pthread_create(&p->thread, NULL,
+                           p->writer ? writer_thread : reader_thread, p))
+                return false;
+        p->running = true;
+
+        return true;
+}
+
+/*
+ * Stops and joins the thread, dropping the blocks left in the ring: the
+ * writer has to be drained first.
+ */
+static void stop_thread(pipeline *p)
+{
+        if (p->running) {
+                atomic_store(&p->stop, true);
+                /* Changing the word makes a racing futex_wait() return */
+                atomic_uint *word = p->writer ? &p->head : &p->tail;
+                atomic_fetch_add(word, 1);
+                futex_wake(word);
+                pthread_join(p->thread, NULL);
+                p->running = false;
+        }
+
+        atomic_store(&p->head, 0);
+        atomic_store(&p->tail, 0);
+        p->current = NULL;
+        p->current_pos = 0;
+}
+
+/* Writes everything the program wrote so far */
+static bool drain(pipeline *p)
+{
+        if (p->current != NULL && p->current->length > 0) {
+                if (p->running) {
+                        publish(p);
+                } else {
+                        /* Unthreaded, or small enough to never start it */
+                        write_block(p, p->current);
+                }
+        }
+        p->current = NULL;
+
+        if (p->running) {
+                unsigned head = atomic_load(&p->head);
+                unsigned tail;
+                while ((tail = atomic_load_explicit(
+                                &p->tail, memory_order_acquire)) != head)
+                        futex_wait(&p->tail, tail);
+        }
+
+        int error = atomic_load(&p->error);
+        if (error) {
+                errno = error;
+                return false;
+        }
+
+        return true;
+}
+
+static ssize_t pipeline_read(void *cookie, char *buffer, size_t size)
+{
+        pipeline *p = (pipeline *)cookie;
+
+        /* Output files opened with "w+" are read back directly */
+        if (p->writer) {
+                if (drain(p) == false)
+                        return -1;
+                ssize_t n = pread(p->fd, buffer, size, p->position);
+                if (n > 0)
+                        p->position += n;
+                return n;
+        }
+
+        if (p->current != NULL && p->current->length > 0 &&
+            p->current_pos == (size_t)p->current->length) {
+                p->current = NULL;
+                if (p->threaded)
+                        release(p);
+        }
+
+        if (p->current == NULL) {
+                if (p->threaded) {
+                        if (start_thread(p) == false ||
+                            wait_used_slot(p) == false)
+                                return -1;
+                        p->current = slot_at(p, &p->tail);
+                } else {
+                        p->current = &p->slots[0];
+                        read_block(p, p->current, p->position);
+                }
+                p->current_pos = 0;
+        }
+
+        /* The EOF or error block stays current until the next seek */
+        if (p->current->length < 0) {
+                errno = p->current->error;
+                return -1;
+        }
+        if (p->current->length == 0)
+                return 0;
+
+        size_t available = p->current->length - p->current_pos;
+        if (size > available)
+                size = available;
+        memcpy(buffer, p->current->data + p->current_pos, size);
+        p->current_pos += size;
+        p->position += size;
+
+        return size;
+}
+
+static ssize_t pipeline_write(void *cookie, const char *buffer, size_t size)
+{
+        pipeline *p = (pipeline *)cookie;
+
+        if (atomic_load(&p->error)) {
+                errno = atomic_load(&p->error);
+                return -1;
+        }
+
+        size_t written = 0;
+        while (written < size) {
+                if (p->current == NULL) {
+                        if (wait_free_slot(p) == false)
+                                return -1;
+                        p->current = slot_at(p, &p->head);
+                        p->current->length = 0;
+                        p->current->offset = p->position;
+                }
+
+                size_t n = PIPELINE_BLOCK_SIZE - p->current->length;
+                if (n > size - written)
+                        n = size - written;
+                memcpy(p->current->data + p->current->length,
+                       buffer + written, n);
+                p->current->length += n;
+                p->position += n;
+                written += n;
+
+                if (p->current->length == PIPELINE_BLOCK_SIZE) {
+                        if (p->threaded == false) {
+                                if (write_block(p, p->current) == false)
+                                        return -1;
+                        } else if (start_thread(p)) {
+                                publish(p);
+                        } else {
+                                return -1;
+                        }
+                        p->current = NULL;
+                }
+        }
+
+        return written;
+}
+
+static int pipeline_seek(void *cookie, off64_t *offset, int whence)
+{
+        pipeline *p = (pipeline *)cookie;
+        off_t target;
+
+        switch (whence) {
+        case SEEK_SET:
+                target = *offset;
+                break;
+        case SEEK_CUR:
+                target = p->position + *offset;
+                break;
+        case SEEK_END: {
+                struct stat st;
+                if ((p->writer && drain(p) == false) || fstat(p->fd, &st))
+                        return -1;
+                target = st.st_size + *offset;
+                break;
+        }
+        default:
+                errno = EINVAL;
+                return -1;
+        }
+        if (target < 0) {
+                errno = EINVAL;
+                return -1;
+        }
+
+        if (target != p->position) {
+                if (p->writer) {
+                        if (drain(p) == false)
+                                return -1;
+                } else if (p->current != NULL && p->current->length > 0 &&
+                           target >= p->current->offset &&
+                           target < p->current->offset + p->current->length) {
+                        /* Inside the block already read, no need to ask */
+                        p->current_pos = target - p->current->offset;
+                } else {
+                        stop_thread(p);
+                }
+                p->position = target;
+        }
+
+        *offset = target;
+        return 0;
+}
+
+static int pipeline_close(void *cookie)
+{
+        pipeline *p = (pipeline *)cookie;
+        int ret = 0;
+
+        if (p->writer && drain(p) == false)
+                ret = -1;
+        stop_thread(p);
+        if (close(p->fd) && ret == 0)
+                ret = -1;
+
+        for (int i = 0; i < PIPELINE_SLOTS; i++)
+                free(p->slots[i].data);
+        free(p);
+
+        return ret;
+}
+
+/*
+ * Stream over fd (a regular file opened with mode "r", "w" or "w+"), read
+ * and written by blocks. Closing the stream closes fd.
+ */
+FILE *open_pipeline(int fd, const char *mode, bool threaded)
+{
+        pipeline *p = (pipeline *)calloc(1, sizeof(pipeline));
+        if (p == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        p->fd = fd;
+        p->writer = mode[0] == 'w';
+        p->threaded = threaded;
+        for (int i = 0; i < (threaded ? PIPELINE_SLOTS : 1); i++) {
+                p->slots[i].data = (char *)malloc(PIPELINE_BLOCK_SIZE);
+                if (p->slots[i].data == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+        }
+
+        if (p->writer == false)
+                posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        cookie_io_functions_t functions = {
+                .read = pipeline_read,
+                .write = pipeline_write,
+                .seek = pipeline_seek,
+                .close = pipeline_close,
+        };
+        FILE *fptr = fopencookie(p, mode, functions);
+        if (fptr == NULL)
+                pipeline_close(p);
+
+        return fptr;
+}
@@ -0,0 +1,174 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "texler_runtime.h"
+
+/*
+ * Read-ahead of the files of a folder input (get_next_file()). While the
+ * program processes one file, a thread opens the next ones and asks the
+ * kernel to read their first PREFETCH_BYTES (POSIX_FADV_WILLNEED), so the
+ * path lookup and the first read of a cold file do not stall the program.
+ * At most TEXLER_PREFETCH files (16 by default, 0 disables it) are kept
+ * open ahead of the program.
+ */
+
+#define PREFETCH_DEPTH 16
+#define PREFETCH_BYTES (1024 * 1024)
+
+struct texler_prefetch {
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+        bool stop;
+
+        char **paths;
+        size_t n_paths;
+        size_t depth;
+        int *fds;        /* Descriptor of each path, -1 if it failed */
+        size_t opened;   /* Paths [first, opened) were opened */
+        size_t consumed; /* Paths [first, consumed) were taken */
+};
+
+static void *prefetch_thread(void *arg)
+{
+        texler_prefetch *prefetch = (texler_prefetch *)arg;
+
+        pthread_mutex_lock(&prefetch->lock);
+        for (size_t i = prefetch->opened; i < prefetch->n_paths; i++) {
+                while (prefetch->stop == false &&
+                       i >= prefetch->consumed + prefetch->depth)
+                        pthread_cond_wait(&prefetch->cond, &prefetch->lock);
+                if (prefetch->stop)
+                        break;
+                pthread_mutex_unlock(&prefetch->lock);
+
+                int fd = open(prefetch->paths[i], O_RDONLY | O_CLOEXEC);
+                if (fd >= 0)
+                        posix_fadvise(fd, 0, PREFETCH_BYTES,
+                                      POSIX_FADV_WILLNEED);
+
+                pthread_mutex_lock(&prefetch->lock);
+                prefetch->fds[i] = fd;
+                prefetch->opened = i + 1;
+                pthread_cond_broadcast(&prefetch->cond);
+        }
+        pthread_mutex_unlock(&prefetch->lock);
+
+        return NULL;
+}
+
+static size_t prefetch_depth(void)
+{
+        const char *env = getenv("TEXLER_PREFETCH");
+        if (env == NULL || *env == '\0')
+                return PREFETCH_DEPTH;
+
+        char *end = NULL;
+        long depth = strtol(env, &end, 10);
+        if (*end != '\0' || depth < 0)
+                return PREFETCH_DEPTH;
+
+        return depth;
+}
+
+/*
+ * Starts prefetching paths from 'first' on. Returns NULL if there is
+ * nothing to prefetch or it is disabled.
+ */
+texler_prefetch *start_prefetch(char **paths, size_t n_paths, size_t first)
+{
+        size_t depth = prefetch_depth();
+        if (depth == 0 || first + 1 >= n_paths)
+                return NULL;
+
+        texler_prefetch *prefetch =
+                (texler_prefetch *)calloc(1, sizeof(texler_prefetch));
+        int *fds = (int *)malloc(n_paths * sizeof(int));
+        if (prefetch == NULL || fds == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        for (size_t i = 0; i < n_paths; i++)
+                fds[i] = -1;
+
+        prefetch->paths = paths;
+        prefetch->n_paths = n_paths;
+        prefetch->depth = depth;
+        prefetch->fds = fds;
+        prefetch->opened = first;
+        prefetch->consumed = first;
+        pthread_mutex_init(&prefetch->lock, NULL);
+        pthread_cond_init(&prefetch->cond, NULL);
+
+        if (pthread_create(&prefetch->thread, NULL, prefetch_thread,
+                           prefetch)) {
+                pthread_cond_destroy(&prefetch->cond);
+                pthread_mutex_destroy(&prefetch->lock);
+                free(fds);
+                free(prefetch);
+                return NULL;
+        }
+
+        return prefetch;
+}
+
+/*
+ * Takes the descriptor of paths[index], the next one after the last taken.
+ * Returns -1 if it could not be opened, or if index is out of order, in
+ * which case the caller opens it itself.
+ */
+int prefetched_fd(texler_prefetch *prefetch, size_t index)
+{
+        if (prefetch == NULL || index >= prefetch->n_paths)
+                return -1;
+
+        pthread_mutex_lock(&prefetch->lock);
+        if (index != prefetch->consumed) {
+                pthread_mutex_unlock(&prefetch->lock);
+                return -1;
+        }
+
+        while (prefetch->opened <= index)
+                pthread_cond_wait(&prefetch->cond, &prefetch->lock);
+        int fd = prefetch->fds[index];
+        prefetch->fds[index] = -1;
+        prefetch->consumed = index + 1;
+        /* The thread opens files by bursts, not one per file taken */
+        if (prefetch->opened <= prefetch->consumed + prefetch->depth / 2)
+                pthread_cond_broadcast(&prefetch->cond);
+        pthread_mutex_unlock(&prefetch->lock);
+
+        return fd;
+}
+
+/* Whether prefetched_fd() can take paths[index] */
+bool prefetch_at(const texler_prefetch *prefetch, size_t index)
+{
+        return prefetch != NULL && prefetch->consumed == index;
+}
+
+/* Stops the thread and closes the files the program did not take */
+void stop_prefetch(texler_prefetch *prefetch)
+{
+        if (prefetch == NULL)
+                return;
+
+        pthread_mutex_lock(&prefetch->lock);
+        prefetch->stop = true;
+        pthread_cond_broadcast(&prefetch->cond);
+        pthread_mutex_unlock(&prefetch->lock);
+        pthread_join(prefetch->thread, NULL);
+
+        for (size_t i = 0; i < prefetch->n_paths; i++) {
+                if (prefetch->fds[i] >= 0)
+                        close(prefetch->fds[i]);
+        }
+        pthread_cond_destroy(&prefetch->cond);
+        pthread_mutex_destroy(&prefetch->lock);
+        free(prefetch->fds);
+        free(prefetch);
+}
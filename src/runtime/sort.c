@@ -0,0 +1,690 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "texler_runtime.h"
+
+/*
+ * lines().sort(column, numeric|lexical, asc|desc): external merge sort of
+ * the records of a file by one of its columns.
+ *
+ * Records are read into an arena together with their key, until it holds
+ * TEXLER_SORT_MEMORY MiB. Each full arena is sorted in memory and spilled
+ * to a temporary file as a run; the runs are then merged with a binary
+ * heap, one record of each in memory at a time. Inputs that fit in the
+ * arena are never written to disk.
+ *
+ * Keys are normalized once, when the record is read, into bytes whose
+ * memcmp() order is the order asked for: numbers become 8 big-endian
+ * bytes, descending keys are complemented. Comparisons are then integer
+ * and memcmp() only. Ties keep the input order, so the sort is stable.
+ *
+ * When every key of the arena fits in the 8 bytes of its prefix (numbers,
+ * short codes) it is sorted with an LSD radix sort of (prefix, index)
+ * pairs instead, split across the cores, and the entries are permuted
+ * once at the end.
+ */
+
+#define SORT_MEMORY (256UL * 1024 * 1024)
+#define SORT_RUN_BUFFER (256 * 1024)
+#define SORT_MIN_RUN_BUFFER (4 * 1024)
+/* Smaller arenas are sorted with qsort_r(), on one thread */
+#define RADIX_MIN_ENTRIES 256
+#define RADIX_MIN_PER_THREAD (64 * 1024)
+#define RADIX_BUCKETS 256
+
+/*
+ * Starts the numeric keys that are not numbers. Numbers are 8 bytes below
+ * 0xfff1 (the first bytes of number_bits(INFINITY)), so they go first.
+ */
+static const unsigned char sort_key_text[] = { 0xff, 0xff };
+/* Ends descending strings, above any complemented byte of them */
+#define SORT_KEY_END 0xff
+
+typedef struct {
+        uint64_t prefix; /* First 8 bytes of the key, big-endian */
+        size_t offset; /* Of the key in the arena, the record follows it */
+        size_t key_length;
+        size_t length; /* Of the record, ends with '\n' */
+        size_t sequence; /* Input order, for ties */
+} sort_entry;
+
+/* Record of a run file: sort_header, key, record */
+typedef struct {
+        size_t key_length;
+        size_t length;
+} sort_header;
+
+typedef struct {
+        FILE *stream;
+        char *buffer; /* setvbuf() of stream */
+        sort_header header;
+        char *key;
+        size_t key_size;
+        char *record; /* malloc()ed, handed to sorted_records() callers */
+} sort_run;
+
+struct texler_sort {
+        char *arena;
+        size_t arena_length;
+        size_t arena_size;
+        sort_entry *entries;
+        size_t n_entries;
+        size_t entries_size;
+        size_t memory;
+        /* Shortest and longest keys of the arena, any with a '\0' byte */
+        size_t min_key;
+        size_t max_key;
+        bool key_zero;
+
+        /* Spilled runs, merged by heap (indexes in runs) */
+        sort_run *runs;
+        size_t n_runs;
+        size_t *heap;
+        size_t heap_length;
+
+        size_t next; /* Next entry returned when nothing was spilled */
+};
+
+static void *sort_realloc(void *ptr, size_t size)
+{
+        void *new_ptr = realloc(ptr, size);
+        if (new_ptr == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        return new_ptr;
+}
+
+static size_t sort_memory(void)
+{
+        const char *env = getenv("TEXLER_SORT_MEMORY");
+        if (env == NULL || *env == '\0')
+                return SORT_MEMORY;
+
+        char *end = NULL;
+        long mebibytes = strtol(env, &end, 10);
+        if (*end != '\0' || mebibytes <= 0)
+                return SORT_MEMORY;
+
+        return mebibytes * 1024UL * 1024;
+}
+
+/* Room for length more bytes in the arena, returns where they go */
+static char *arena_reserve(texler_sort *sort, size_t length)
+{
+        /* Allocated even for empty keys, memcpy() wants a pointer */
+        if (sort->arena_length + length > sort->arena_size ||
+            sort->arena == NULL) {
+                size_t size = sort->arena_size == 0 ? BUFFER_SIZE :
+                                                      sort->arena_size;
+                while (size < sort->arena_length + length)
+                        size *= 2;
+                sort->arena = sort_realloc(sort->arena, size);
+                sort->arena_size = size;
+        }
+
+        char *ptr = sort->arena + sort->arena_length;
+        sort->arena_length += length;
+
+        return ptr;
+}
+
+/* Order-preserving bytes of a double: negatives flipped, sign bit set */
+static uint64_t number_bits(double number)
+{
+        if (number == 0)
+                number = 0; /* -0 */
+
+        uint64_t bits = 0;
+        memcpy(&bits, &number, sizeof(bits));
+
+        return (bits & (1ULL << 63)) ? ~bits : bits | (1ULL << 63);
+}
+
+/*
+ * Writes the normalized key of cell to the arena, returns its length.
+ * Numbers have a fixed width, so they are never a prefix of another key
+ * and need no end when descending.
+ */
+static size_t normalize_key(texler_sort *sort, const TexlerObject *tex_obj,
+                            char *cell, bool numeric, bool descending)
+{
+        size_t cell_length = strlen(cell);
+        double number = 0;
+        bool is_number = numeric && cell_value(tex_obj, cell, &number);
+        size_t length = is_number ? sizeof(uint64_t) :
+                                    (numeric ? sizeof(sort_key_text) : 0) +
+                                            cell_length +
+                                            (descending ? 1 : 0);
+
+        unsigned char *key = (unsigned char *)arena_reserve(sort, length);
+        unsigned char *ptr = key;
+
+        if (is_number) {
+                uint64_t bits = number_bits(number);
+                for (int i = 7; i >= 0; i--)
+                        *ptr++ = bits >> (8 * i);
+        } else {
+                if (numeric) {
+                        memcpy(ptr, sort_key_text, sizeof(sort_key_text));
+                        ptr += sizeof(sort_key_text);
+                }
+                memcpy(ptr, cell, cell_length);
+                ptr += cell_length;
+        }
+
+        if (descending) {
+                for (unsigned char *byte = key; byte < ptr; byte++)
+                        *byte = ~*byte;
+                if (!is_number)
+                        *ptr = SORT_KEY_END;
+        }
+
+        if (sort->n_entries == 1 || length < sort->min_key)
+                sort->min_key = length;
+        if (sort->n_entries == 1 || length > sort->max_key)
+                sort->max_key = length;
+        if (length <= sizeof(uint64_t) && memchr(key, 0, length) != NULL)
+                sort->key_zero = true;
+
+        return length;
+}
+
+static uint64_t key_prefix(const unsigned char *key, size_t length)
+{
+        uint64_t prefix = 0;
+
+        for (size_t i = 0; i < sizeof(prefix); i++)
+                prefix = (prefix << 8) | (i < length ? key[i] : 0);
+
+        return prefix;
+}
+
+static int compare_keys(const char *left, size_t left_length,
+                        const char *right, size_t right_length)
+{
+        size_t length =
+                left_length < right_length ? left_length : right_length;
+        /* Keys of runs may be empty and never allocated */
+        int result = length == 0 ? 0 : memcmp(left, right, length);
+        if (result != 0)
+                return result;
+
+        return (left_length > right_length) - (left_length < right_length);
+}
+
+/* qsort_r() comparison of the entries of the arena 'arena' */
+static int compare_entries(const void *a, const void *b, void *arena)
+{
+        const sort_entry *left = (const sort_entry *)a;
+        const sort_entry *right = (const sort_entry *)b;
+        const char *keys = (const char *)arena;
+
+        if (left->prefix != right->prefix)
+                return left->prefix < right->prefix ? -1 : 1;
+
+        int result = compare_keys(keys + left->offset, left->key_length,
+                                  keys + right->offset, right->key_length);
+        if (result != 0)
+                return result;
+
+        return (left->sequence > right->sequence) -
+               (left->sequence < right->sequence);
+}
+
+static size_t sort_threads(void)
+{
+        const char *env = getenv("TEXLER_SORT_THREADS");
+        if (env != NULL && *env != '\0') {
+                char *end = NULL;
+                long threads = strtol(env, &end, 10);
+                if (*end == '\0' && threads > 0)
+                        return threads;
+        }
+
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return cpus > 0 ? cpus : 1;
+}
+
+typedef struct {
+        uint64_t key;
+        size_t index;
+} radix_pair;
+
+/* Slice [begin, end) of the pairs sorted by one thread */
+typedef struct {
+        const radix_pair *from;
+        radix_pair *to;
+        const sort_entry *entries;
+        sort_entry *sorted;
+        size_t begin;
+        size_t end;
+        unsigned shift;
+        size_t counts[RADIX_BUCKETS]; /* Then where each bucket goes */
+} radix_slice;
+
+static void *radix_count(void *arg)
+{
+        radix_slice *slice = (radix_slice *)arg;
+
+        memset(slice->counts, 0, sizeof(slice->counts));
+        for (size_t i = slice->begin; i < slice->end; i++)
+                slice->counts[(slice->from[i].key >> slice->shift) & 0xff]++;
+
+        return NULL;
+}
+
+/* Stable: each slice writes its pairs in order, after the earlier slices */
+static void *radix_scatter(void *arg)
+{
+        radix_slice *slice = (radix_slice *)arg;
+
+        for (size_t i = slice->begin; i < slice->end; i++) {
+                size_t bucket = (slice->from[i].key >> slice->shift) & 0xff;
+                slice->to[slice->counts[bucket]++] = slice->from[i];
+        }
+
+        return NULL;
+}
+
+static void *radix_permute(void *arg)
+{
+        radix_slice *slice = (radix_slice *)arg;
+
+        for (size_t i = slice->begin; i < slice->end; i++)
+                slice->sorted[i] = slice->entries[slice->from[i].index];
+
+        return NULL;
+}
+
+/* Runs step on every slice, the first one on this thread */
+static void radix_run(radix_slice *slices, size_t n_slices,
+                      void *(*step)(void *))
+{
+        pthread_t threads[n_slices];
+        bool started[n_slices];
+
+        for (size_t i = 1; i < n_slices; i++)
+                started[i] = pthread_create(&threads[i], NULL, step,
+                                            &slices[i]) == 0;
+        step(&slices[0]);
+        for (size_t i = 1; i < n_slices; i++) {
+                if (started[i])
+                        pthread_join(threads[i], NULL);
+                else
+                        step(&slices[i]);
+        }
+}
+
+/*
+ * LSD radix sort of the entries by their prefix, a byte per pass. Passes
+ * where every key has the same byte (the exponent of numbers in a narrow
+ * range, the padding of short codes) are skipped.
+ */
+static void radix_sort(texler_sort *sort)
+{
+        size_t n = sort->n_entries;
+        size_t n_slices = sort_threads();
+        if (n_slices > n / RADIX_MIN_PER_THREAD)
+                n_slices = n / RADIX_MIN_PER_THREAD;
+        if (n_slices == 0)
+                n_slices = 1;
+
+        radix_pair *pairs = sort_realloc(NULL, n * sizeof(radix_pair));
+        radix_pair *aux = sort_realloc(NULL, n * sizeof(radix_pair));
+        for (size_t i = 0; i < n; i++)
+                pairs[i] = (radix_pair){ sort->entries[i].prefix, i };
+
+        radix_slice *slices = sort_realloc(NULL,
+                                           n_slices * sizeof(radix_slice));
+        for (size_t i = 0; i < n_slices; i++) {
+                slices[i].begin = n * i / n_slices;
+                slices[i].end = n * (i + 1) / n_slices;
+        }
+
+        for (unsigned shift = 0; shift < 64; shift += 8) {
+                for (size_t i = 0; i < n_slices; i++) {
+                        slices[i].from = pairs;
+                        slices[i].to = aux;
+                        slices[i].shift = shift;
+                }
+                radix_run(slices, n_slices, radix_count);
+
+                size_t position = 0;
+                bool skip = false;
+                for (size_t bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+                        size_t total = 0;
+                        for (size_t i = 0; i < n_slices; i++) {
+                                size_t count = slices[i].counts[bucket];
+                                slices[i].counts[bucket] = position;
+                                position += count;
+                                total += count;
+                        }
+                        skip = skip || total == n;
+                }
+                if (skip)
+                        continue;
+
+                radix_run(slices, n_slices, radix_scatter);
+                radix_pair *swap = pairs;
+                pairs = aux;
+                aux = swap;
+        }
+
+        sort_entry *sorted = sort_realloc(NULL,
+                                          sort->entries_size *
+                                                  sizeof(sort_entry));
+        for (size_t i = 0; i < n_slices; i++) {
+                slices[i].from = pairs;
+                slices[i].entries = sort->entries;
+                slices[i].sorted = sorted;
+        }
+        radix_run(slices, n_slices, radix_permute);
+
+        free(sort->entries);
+        sort->entries = sorted;
+        free(slices);
+        free(aux);
+        free(pairs);
+}
+
+/*
+ * Sorts the records in memory. The prefixes alone give the order when no
+ * key is longer than them and, if their lengths differ, none has a '\0'
+ * that a shorter one padded with them could be confused with.
+ */
+static void sort_entries(texler_sort *sort)
+{
+        bool prefixes = sort->max_key <= sizeof(uint64_t) &&
+                        (sort->min_key == sort->max_key || !sort->key_zero);
+
+        if (prefixes && sort->n_entries >= RADIX_MIN_ENTRIES)
+                radix_sort(sort);
+        else if (sort->n_entries > 1)
+                qsort_r(sort->entries, sort->n_entries, sizeof(sort_entry),
+                        compare_entries, sort->arena);
+}
+
+/* Sorts the arena and writes it to a new run, leaving it empty */
+static bool spill_run(texler_sort *sort)
+{
+        sort_entries(sort);
+
+        FILE *stream = tmpfile();
+        if (stream == NULL)
+                return false;
+
+        for (size_t i = 0; i < sort->n_entries; i++) {
+                const sort_entry *entry = &sort->entries[i];
+                sort_header header = { entry->key_length, entry->length };
+
+                if (fwrite(&header, sizeof(header), 1, stream) != 1 ||
+                    fwrite(sort->arena + entry->offset,
+                           entry->key_length + entry->length, 1,
+                           stream) != 1) {
+                        fclose(stream);
+                        return false;
+                }
+        }
+        if (fflush(stream) != 0) {
+                fclose(stream);
+                return false;
+        }
+
+        sort->runs = sort_realloc(sort->runs,
+                                  (sort->n_runs + 1) * sizeof(sort_run));
+        sort->runs[sort->n_runs++] = (sort_run){ .stream = stream };
+        sort->arena_length = 0;
+        sort->n_entries = 0;
+        sort->key_zero = false;
+
+        return true;
+}
+
+/* Reads the next record of run into its buffers, false at its end */
+static bool read_run(sort_run *run)
+{
+        if (fread(&run->header, sizeof(run->header), 1, run->stream) != 1)
+                return false;
+
+        if (run->header.key_length > run->key_size) {
+                run->key_size = run->header.key_length;
+                run->key = sort_realloc(run->key, run->key_size);
+        }
+        run->record = sort_realloc(run->record, run->header.length + 1);
+        run->record[run->header.length] = '\0';
+
+        /* Records of an empty key (a missing column) have no key bytes */
+        return (run->header.key_length == 0 ||
+                fread(run->key, run->header.key_length, 1, run->stream) ==
+                        1) &&
+               fread(run->record, run->header.length, 1, run->stream) == 1;
+}
+
+/* Ties are broken by run: earlier runs hold earlier records */
+static bool heap_less(const texler_sort *sort, size_t a, size_t b)
+{
+        const sort_run *left = &sort->runs[a];
+        const sort_run *right = &sort->runs[b];
+        int result = compare_keys(left->key, left->header.key_length,
+                                  right->key, right->header.key_length);
+
+        return result < 0 || (result == 0 && a < b);
+}
+
+static void sift_down(texler_sort *sort, size_t i)
+{
+        size_t *heap = sort->heap;
+
+        for (;;) {
+                size_t smallest = i;
+                size_t left = 2 * i + 1;
+                size_t right = left + 1;
+
+                if (left < sort->heap_length &&
+                    heap_less(sort, heap[left], heap[smallest]))
+                        smallest = left;
+                if (right < sort->heap_length &&
+                    heap_less(sort, heap[right], heap[smallest]))
+                        smallest = right;
+                if (smallest == i)
+                        return;
+
+                size_t aux = heap[i];
+                heap[i] = heap[smallest];
+                heap[smallest] = aux;
+                i = smallest;
+        }
+}
+
+/* Rewinds the runs and heaps the first record of each */
+static bool start_merge(texler_sort *sort)
+{
+        size_t run_buffer = sort->memory / sort->n_runs;
+        if (run_buffer > SORT_RUN_BUFFER)
+                run_buffer = SORT_RUN_BUFFER;
+        if (run_buffer < SORT_MIN_RUN_BUFFER)
+                run_buffer = SORT_MIN_RUN_BUFFER;
+
+        free(sort->arena);
+        sort->arena = NULL;
+        sort->arena_size = 0;
+        free(sort->entries);
+        sort->entries = NULL;
+        sort->entries_size = 0;
+
+        sort->heap = sort_realloc(NULL, sort->n_runs * sizeof(size_t));
+        for (size_t i = 0; i < sort->n_runs; i++) {
+                sort_run *run = &sort->runs[i];
+
+                if (fseek(run->stream, 0, SEEK_SET) != 0)
+                        return false;
+                run->buffer = sort_realloc(NULL, run_buffer);
+                setvbuf(run->stream, run->buffer, _IOFBF, run_buffer);
+
+                if (read_run(run))
+                        sort->heap[sort->heap_length++] = i;
+                else if (ferror(run->stream))
+                        return false;
+        }
+
+        for (size_t i = sort->heap_length; i > 0; i--)
+                sift_down(sort, i - 1);
+
+        return true;
+}
+
+/*
+ * Reads the records of tex_obj, from where its stream is, sorted by their
+ * column 'column' (1-based). Numeric keys that are not numbers go after
+ * the numbers (before them if descending), in lexical order. Records get a
+ * '\n' if they lack one. Returns NULL if the runs could not be written.
+ */
+texler_sort *sort_records(TexlerObject *tex_obj, unsigned long column,
+                          bool numeric, bool descending)
+{
+        if (tex_obj == NULL || tex_obj->type != TYPE_T_FILEPTR || column == 0)
+                return NULL;
+
+        texler_sort *sort = (texler_sort *)calloc(1, sizeof(texler_sort));
+        if (sort == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        sort->memory = sort_memory();
+
+        char *record = sort_realloc(NULL, BUFFER_SIZE);
+        char *cell = sort_realloc(NULL, BUFFER_SIZE);
+        long length = 0;
+        bool failed = false;
+
+        project_columns(tex_obj, &column, 1);
+        for (size_t sequence = 0; !failed; sequence++) {
+                length = records(tex_obj, &record);
+                if (length <= 0)
+                        break;
+                length--;
+
+                char *str = record;
+                int separator = 0;
+                cell[0] = '\0';
+                file_columns(tex_obj, &str, &cell, &separator);
+                size_t cell_length = strlen(cell);
+                while (cell_length > 0 && cell[cell_length - 1] == '\n')
+                        cell[--cell_length] = '\0';
+
+                if (sort->n_entries == sort->entries_size) {
+                        sort->entries_size = sort->entries_size == 0 ?
+                                                     BUFFER_SIZE :
+                                                     2 * sort->entries_size;
+                        sort->entries = sort_realloc(
+                                sort->entries,
+                                sort->entries_size * sizeof(sort_entry));
+                }
+
+                sort_entry *entry = &sort->entries[sort->n_entries++];
+                entry->offset = sort->arena_length;
+                entry->key_length = normalize_key(sort, tex_obj, cell,
+                                                  numeric, descending);
+                entry->prefix = key_prefix(
+                        (unsigned char *)sort->arena + entry->offset,
+                        entry->key_length);
+                entry->sequence = sequence;
+
+                bool newline = length > 0 && record[length - 1] == '\n';
+                entry->length = length + (newline ? 0 : 1);
+                char *copy = arena_reserve(sort, entry->length);
+                memcpy(copy, record, length);
+                copy[entry->length - 1] = '\n';
+
+                if (sort->arena_length +
+                            sort->n_entries * sizeof(sort_entry) >=
+                    sort->memory)
+                        failed = !spill_run(sort);
+        }
+        project_columns(tex_obj, NULL, 0);
+        free(record);
+        free(cell);
+
+        if (failed == false && sort->n_runs == 0) {
+                sort_entries(sort);
+                return sort;
+        }
+        if (failed == false && sort->n_entries > 0)
+                failed = !spill_run(sort);
+        if (failed == false)
+                failed = !start_merge(sort);
+
+        if (failed) {
+                perror("Error while sorting");
+                free_sort(sort);
+                return NULL;
+        }
+
+        return sort;
+}
+
+/*
+ * Next record of sort into *buffer (a malloc()ed string, as lines() takes
+ * it). Returns its length plus one, 0 after the last one.
+ */
+long sorted_records(texler_sort *sort, char **buffer)
+{
+        if (sort == NULL || buffer == NULL)
+                return 0;
+
+        if (sort->n_runs == 0) {
+                if (sort->next == sort->n_entries)
+                        return 0;
+
+                const sort_entry *entry = &sort->entries[sort->next++];
+                *buffer = sort_realloc(*buffer, entry->length + 1);
+                memcpy(*buffer, sort->arena + entry->offset +
+                                        entry->key_length,
+                       entry->length);
+                (*buffer)[entry->length] = '\0';
+
+                return entry->length + 1;
+        }
+
+        if (sort->heap_length == 0)
+                return 0;
+
+        /* The record of the run is handed over, its buffer reused */
+        sort_run *run = &sort->runs[sort->heap[0]];
+        long length = run->header.length + 1;
+        char *record = run->record;
+        run->record = *buffer;
+        *buffer = record;
+
+        if (read_run(run) == false) {
+                if (ferror(run->stream))
+                        perror("Error while sorting");
+                sort->heap[0] = sort->heap[--sort->heap_length];
+        }
+        sift_down(sort, 0);
+
+        return length;
+}
+
+void free_sort(texler_sort *sort)
+{
+        if (sort == NULL)
+                return;
+
+        for (size_t i = 0; i < sort->n_runs; i++) {
+                fclose(sort->runs[i].stream);
+                free(sort->runs[i].buffer);
+                free(sort->runs[i].key);
+                free(sort->runs[i].record);
+        }
+        free(sort->runs);
+        free(sort->heap);
+        free(sort->arena);
+        free(sort->entries);
+        free(sort);
+}
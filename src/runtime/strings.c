@@ -0,0 +1,169 @@
+#include <ctype.h>
+#include <stdint.h>
+
+#include "texler_runtime.h"
+
+/* Concat str2 at the end of str1 and store it in str1 */
+char *string_addition(char *str1, char *str2)
+{
+        if (str2 == NULL)
+                return str1;
+        else if (str1 == NULL)
+                return str2;
+
+        int str1_len = strlen(str1);
+        int str2_len = strlen(str2);
+
+        if (str1_len > 1 && str1[str1_len - 1] == '\n')
+                str1[str1_len - 1] = '\0';
+
+        int aux_len = 1 + str1_len + str2_len;
+        char *aux = (char *)realloc(str1, aux_len * sizeof(char));
+        if (aux == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        strncat(aux, str2, aux_len);
+        aux[aux_len - 1] = '\0';
+        str1 = aux;
+
+        return str1;
+}
+
+/* Remove str2 from the end of str1, if str1 ends with it */
+char *string_substract(char *str1, char *str2)
+{
+        int str1_len = strlen(str1);
+        int str2_len = strlen(str2);
+
+        if (str1_len < str2_len)
+                return str1;
+
+        int i = 0;
+        int j = str2_len;
+        while (str2[i] == str1[str1_len - j] && str2_len > i) {
+                i++;
+                j--;
+        }
+
+        if (str2[i] == str1[str1_len - j] && j < 1) {
+                memset(str1 + str1_len - str2_len, 0, str2_len);
+                int aux_len = 1 + strlen(str1);
+                char *aux = (char *)realloc(str1, aux_len * sizeof(char));
+                if (aux == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+                aux[aux_len - 1] = '\0';
+                str1 = aux;
+        }
+
+        return str1;
+}
+
+/* Returns a new string, free() it */
+char *toString(TexlerObject *tex_obj)
+{
+        char *to_return = NULL;
+
+        switch (tex_obj->type) {
+        case TYPE_T_BOOLEAN:
+                if (tex_obj->value.boolean)
+                        to_return = strdup("True");
+                else
+                        to_return = strdup("False");
+                break;
+        case TYPE_T_REAL:
+                to_return = (char *)calloc(BUFFER_SIZE, sizeof(char));
+                if (to_return != NULL)
+                        snprintf(to_return, BUFFER_SIZE, "%f",
+                                 tex_obj->value.real);
+                break;
+        case TYPE_T_INTEGER:
+                to_return = (char *)calloc(BUFFER_SIZE, sizeof(char));
+                if (to_return != NULL)
+                        snprintf(to_return, BUFFER_SIZE, "%ld",
+                                 tex_obj->value.integer);
+                break;
+        case TYPE_T_STRING:
+                to_return = strdup(tex_obj->value.string);
+                break;
+        default:
+                fprintf(stderr,
+                        "\nError al querer pasar a string algo que no es una "
+                        "variable, solo variables de tipo numerico, "
+                        "booleanas o strings.\n");
+                return NULL;
+        }
+
+        if (to_return == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        return to_return;
+}
+
+int at(char *str, long pos)
+{
+        if (pos < 1 || pos > strlen(str)) {
+                fprintf(stderr,
+                        "\nError al querer pasar un string con longitud "
+                        "erronea\n");
+                return -1;
+        }
+
+        return str[pos - 1];
+}
+
+/*
+ * Return: NAN if is not a number
+ *         TYPE_T_INTEGER if it is an integer
+ *         FLOATING if it is a floating point number
+ */
+IS_NUMBER_RETURN is_number(char *str, long int n)
+{
+        if (str == NULL)
+                return IS_NUMBER_RETURN_NAN;
+
+        IS_NUMBER_RETURN ret_value = IS_NUMBER_RETURN_INTEGER;
+
+        for (int i = 0; i < n; i++) {
+                int c = 0;
+                c = str[i];
+                if (c == '.') {
+                        ret_value = IS_NUMBER_RETURN_FLOATING;
+                } else if (isdigit(c) == 0) {
+                        ret_value = IS_NUMBER_RETURN_NAN;
+                        break;
+                }
+        }
+
+        return ret_value;
+}
+
+bool is_in_string(char *str, char *line)
+{
+        char *aux = strstr(line, str);
+        return (aux == NULL) ? false : true;
+}
+
+/* 64-bit hash of length bytes, a word at a time */
+uint64_t hash_bytes(const char *bytes, size_t length)
+{
+        uint64_t hash = 0x9e3779b97f4a7c15ULL ^ length;
+        uint64_t word = 0;
+
+        for (; length >= sizeof(word); length -= sizeof(word)) {
+                memcpy(&word, bytes, sizeof(word));
+                bytes += sizeof(word);
+                hash = (hash ^ word) * 0xbf58476d1ce4e5b9ULL;
+                hash ^= hash >> 31;
+        }
+        word = 0;
+        memcpy(&word, bytes, length);
+        hash = (hash ^ word) * 0x94d049bb133111ebULL;
+
+        return hash ^ (hash >> 29);
+}
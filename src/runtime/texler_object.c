@@ -0,0 +1,51 @@
+#include "texler_runtime.h"
+
+void free_texlerobject(TexlerObject *tex_obj)
+{
+        if (tex_obj == NULL)
+                return;
+
+        switch (tex_obj->type) {
+        case TYPE_T_FILEPTR:
+                if (tex_obj->value.file.stream != NULL &&
+                    tex_obj->value.file.stream != stdout &&
+                    tex_obj->value.file.stream != stderr &&
+                    tex_obj->value.file.stream != stdin) {
+                        fclose(tex_obj->value.file.stream);
+                }
+                free(tex_obj->value.file.separators);
+                free_csv(tex_obj->value.file.csv);
+                free_cache(tex_obj->value.file.cache);
+                break;
+        case TYPE_T_FILE_LIST:
+                stop_prefetch(tex_obj->value.file.prefetch);
+                if (tex_obj->value.file.path_list != NULL) {
+                        while (tex_obj->value.file.n_files > 0) {
+                                if (tex_obj->value.file.path_list
+                                            [tex_obj->value.file.n_files - 1] !=
+                                    NULL) {
+                                        free(tex_obj->value.file.path_list
+                                                     [tex_obj->value.file
+                                                              .n_files -
+                                                      1]);
+                                }
+
+                                tex_obj->value.file.n_files--;
+                        }
+                        free(tex_obj->value.file.path_list);
+                }
+                free(tex_obj->value.file.separators);
+                break;
+        case TYPE_T_STRING:
+                if (tex_obj->value.string != NULL)
+                        free(tex_obj->value.string);
+                break;
+        case TYPE_T_BOOLEAN: /* Fallsthrough */
+        case TYPE_T_REAL:
+        case TYPE_T_INTEGER:
+                break;
+        default:
+                break;
+        }
+        free(tex_obj);
+}
@@ -0,0 +1,279 @@
+#ifndef TEXLER_RUNTIME_H
+#define TEXLER_RUNTIME_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+/*
+ * Runtime linked into every program generated by texler (libtexlerrt.a).
+ * Generated code only includes this header and calls into the library.
+ */
+
+#define BUFFER_SIZE 256
+
+/* Separators of files declared without them */
+#define TEXLER_DEFAULT_SEPARATORS " ,"
+
+/* Exported by shared objects built with texler -l */
+#define TEXLER_EXPORT __attribute__((visibility("default")))
+
+typedef enum {
+        TYPE_T_NONE = 0,
+        TYPE_T_BOOLEAN,
+        TYPE_T_STRING,
+        TYPE_T_REAL,
+        TYPE_T_INTEGER,
+        TYPE_T_FILEPTR,
+        TYPE_T_FILE_LIST,
+        N_TYPE_T
+} type_t;
+
+typedef struct TexlerObject TexlerObject;
+typedef struct texler_prefetch texler_prefetch;
+typedef struct texler_csv texler_csv;
+typedef struct texler_cache texler_cache;
+typedef struct texler_sort texler_sort;
+typedef struct texler_group texler_group;
+typedef struct texler_distinct texler_distinct;
+typedef struct texler_join texler_join;
+typedef struct texler_top texler_top;
+
+/* Aggregates of lines().group(), over the values of one column each */
+typedef enum {
+        TEXLER_AGGREGATE_COUNT = 0, /* Records of the group, no column */
+        TEXLER_AGGREGATE_SUM,
+        TEXLER_AGGREGATE_MIN,
+        TEXLER_AGGREGATE_MAX,
+        TEXLER_AGGREGATE_AVG,
+} texler_aggregate_type;
+
+typedef struct texler_aggregate {
+        texler_aggregate_type type;
+        unsigned long column; /* 1-based */
+} texler_aggregate;
+
+/* Columns the columns().lines() loops of a file return (project_columns()) */
+typedef struct {
+        const unsigned long *columns; /* 1-based, sorted. NULL: all of them */
+        size_t n_columns;
+        size_t next; /* Index in columns of the next one to return */
+        unsigned long column; /* Column of the line cursor points to */
+        const char *cursor; /* *str expected by file_columns() */
+} texler_projection;
+
+struct TexlerObject {
+        union {
+                bool boolean;
+                struct {
+                        char *string;
+                        size_t length;
+                };
+                double real;
+                long integer;
+                struct {
+                        FILE *stream;
+                        fpos_t pos;
+                        char *separators;
+                        char **path_list;
+                        size_t n_line;
+                        size_t n_files;
+                        unsigned next_open_file;
+                        texler_prefetch *prefetch; /* Of a path_list */
+                        texler_csv *csv; /* Declared with [","] */
+                        texler_projection projection;
+                        texler_cache *cache; /* Sidecar, with TEXLER_SIDECAR */
+                        off_t size; /* Of a plain input file, or 0 */
+                } file;
+        } value;
+        type_t type;
+};
+
+/*
+ * Embedding API. A host binds its own streams to File variables of the
+ * program (by name: "input", "output", ...), replacing the paths it
+ * declares, and calls texler_run() from the shared object:
+ *
+ *   texler_stream streams[] = {
+ *           { .name = "input", .type = TEXLER_STREAM_BUFFER,
+ *             .buffer = csv, .length = csv_len },
+ *           { .name = "output", .type = TEXLER_STREAM_FD, .fd = sock },
+ *   };
+ *   texler_run_function run = dlsym(handle, "texler_run");
+ *   run(streams, 2, argc, argv);
+ *
+ * Calls share no state, so a shared object can run in many threads at the
+ * same time, each one with its own streams.
+ */
+typedef enum {
+        TEXLER_STREAM_FD = 0, /* fd is duplicated, the host keeps it open */
+        TEXLER_STREAM_BUFFER, /* input: buffer and length are read.
+                                 output: set to the result, free() it */
+        TEXLER_STREAM_PATH, /* path is opened instead of the declared one */
+        N_TEXLER_STREAM
+} TEXLER_STREAM;
+
+typedef struct texler_stream {
+        const char *name;
+        TEXLER_STREAM type;
+        int fd;
+        char *buffer;
+        size_t length;
+        const char *path;
+} texler_stream;
+
+typedef struct texler_context {
+        texler_stream *streams;
+        size_t n_streams;
+} texler_context;
+
+/*
+ * Entry point of the shared objects. argv[1..] are the arguments of the
+ * program, like in the executables. Returns their exit code.
+ */
+typedef int (*texler_run_function)(texler_stream *streams, size_t n_streams,
+                                   const int argc, const char **argv);
+
+typedef enum {
+        IS_NUMBER_RETURN_NAN = 0,
+        IS_NUMBER_RETURN_INTEGER,
+        IS_NUMBER_RETURN_FLOATING,
+        N_IS_NUMBER_RETURN
+} IS_NUMBER_RETURN;
+
+/* Formats of compressed files (compress.c) */
+typedef enum {
+        TEXLER_COMPRESSION_NONE = 0,
+        TEXLER_COMPRESSION_GZIP,
+        TEXLER_COMPRESSION_ZSTD, /* Only with libzstd (HAVE_ZSTD) */
+        N_TEXLER_COMPRESSION
+} TEXLER_COMPRESSION;
+
+/* texler_object.c */
+void free_texlerobject(TexlerObject *tex_obj);
+
+/* files.c */
+bool open_file(const char *name, const char *mode, TexlerObject *tex_obj,
+               const char *separators);
+bool open_variable_file(const texler_context *context, const char *variable,
+                        const char *name, const char *mode,
+                        TexlerObject *tex_obj, const char *separators);
+bool open_variable_stdout(const texler_context *context, const char *variable,
+                          TexlerObject *tex_obj);
+const char *variable_path(const texler_context *context, const char *variable,
+                          const char *name);
+TexlerObject *get_next_file(TexlerObject *tex_obj, const char *separators);
+long get_list_of_files_in_dir(char ***files, const char *path);
+void copy_buffer_content(char *from, FILE *to);
+void copy_file_content(FILE *from, FILE *to);
+void copy_file_content_texler(TexlerObject *source, TexlerObject *destination);
+
+/* io.c */
+FILE *open_io(const char *name, const char *mode, off_t *size);
+FILE *open_io_fd(int fd, const char *mode, off_t *size);
+
+/* prefetch.c */
+texler_prefetch *start_prefetch(char **paths, size_t n_paths, size_t first);
+int prefetched_fd(texler_prefetch *prefetch, size_t index);
+bool prefetch_at(const texler_prefetch *prefetch, size_t index);
+void stop_prefetch(texler_prefetch *prefetch);
+
+/* pipeline.c */
+FILE *open_pipeline(int fd, const char *mode, bool threaded);
+
+/* uring.c */
+FILE *open_uring(int fd, const char *mode);
+
+/* compress.c */
+TEXLER_COMPRESSION input_compression(int fd);
+TEXLER_COMPRESSION output_compression(const char *name);
+FILE *open_compressed(int fd, const char *mode, TEXLER_COMPRESSION format,
+                      bool threaded);
+
+/* strings.c */
+char *string_addition(char *str1, char *str2);
+char *string_substract(char *str1, char *str2);
+char *toString(TexlerObject *tex_obj);
+int at(char *str, long pos);
+IS_NUMBER_RETURN is_number(char *str, long int n);
+bool is_in_string(char *str, char *line);
+uint64_t hash_bytes(const char *bytes, size_t length);
+
+/* compare.c */
+bool compare_equality(TexlerObject *left, TexlerObject *right);
+bool compare_equality_constant_number_int(long left, TexlerObject *right);
+bool compare_equality_constant_string(char *left, TexlerObject *right);
+
+/* lines.c */
+long int line_length(FILE *stream, const fpos_t *pos);
+long int lines(TexlerObject *tex_obj, char **buffer);
+bool seek_line(TexlerObject *tex_obj, unsigned long n);
+size_t lines_by_numbers(TexlerObject *tex_obj, const unsigned long *rows,
+                        size_t n_rows, char **slots);
+long line_by_number(TexlerObject *tex_obj, char **buffer, unsigned long n);
+
+/* columns.c */
+long int columns(char **str, char *separators, char **buffer, int *separator);
+void project_columns(TexlerObject *tex_obj, const unsigned long *columns,
+                     size_t n_columns);
+long file_columns(TexlerObject *tex_obj, char **str, char **buffer,
+                  int *separator);
+
+/* csv.c */
+texler_csv *new_csv(void);
+void free_csv(texler_csv *csv);
+long records(TexlerObject *tex_obj, char **buffer);
+long csv_columns(texler_csv *csv, char **str, char **buffer, int *separator);
+void skip_csv_column(texler_csv *csv, char **str);
+void end_csv_record(texler_csv *csv);
+
+/* cache.c */
+texler_cache *open_cache(const char *path, const char *separators);
+void free_cache(texler_cache *cache);
+bool cached_record(TexlerObject *tex_obj, char **buffer, long length);
+bool cached_column(texler_cache *cache, char **str, char **buffer,
+                   int *separator, long *length);
+void end_cached_record(texler_cache *cache);
+IS_NUMBER_RETURN cell_type(const TexlerObject *tex_obj, char *cell);
+double cell_real(const TexlerObject *tex_obj, char *cell);
+bool cell_value(const TexlerObject *tex_obj, char *cell, double *number);
+
+/* sort.c */
+texler_sort *sort_records(TexlerObject *tex_obj, unsigned long column,
+                          bool numeric, bool descending);
+long sorted_records(texler_sort *sort, char **buffer);
+void free_sort(texler_sort *sort);
+
+/* group.c */
+texler_group *group_records(TexlerObject *tex_obj, unsigned long column,
+                            const texler_aggregate *aggregates,
+                            size_t n_aggregates);
+long grouped_records(texler_group *group, char **buffer);
+void free_group(texler_group *group);
+
+/* distinct.c */
+texler_distinct *new_distinct(TexlerObject *tex_obj, unsigned long column,
+                              bool consecutive);
+bool distinct_record(texler_distinct *distinct, char *record);
+void free_distinct(texler_distinct *distinct);
+
+/* join.c */
+texler_join *join_records(TexlerObject *probe, TexlerObject *build,
+                          unsigned long probe_column,
+                          unsigned long build_column, bool keep_unmatched);
+long joined_records(texler_join *join, char **buffer);
+void free_join(texler_join *join);
+
+/* top.c */
+texler_top *top_records(TexlerObject *tex_obj, unsigned long column,
+                        size_t k);
+long ranked_records(texler_top *top, char **buffer);
+void free_top(texler_top *top);
+
+/* batch.c */
+int texler_main(texler_run_function run, const int argc, const char **argv);
+
+#endif /* TEXLER_RUNTIME_H */
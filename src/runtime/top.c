@@ -0,0 +1,431 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "texler_runtime.h"
+
+/*
+ * lines().top(k, column) and lines().longest(k): the k records of a file,
+ * or of every file of a folder, with the greatest number in one of their
+ * columns, or the longest ones, read only once.
+ *
+ * The k best records seen so far are kept in a binary heap with the worst
+ * of them at the root, so a record that does not beat it is dropped
+ * before it is copied anywhere. Records live in an arena: the one that
+ * takes the place of the root is appended, and the arena is compacted
+ * once most of it belongs to records already dropped, so memory stays
+ * proportional to k.
+ *
+ * The files of a folder are read by several threads, each into its own
+ * heap, and the heaps are merged at the end.
+ */
+
+/* Position of a record: its file in the upper bits, then its number */
+#define TOP_FILE_SHIFT 40
+#define TOP_MIN_ENTRIES 64
+
+typedef struct {
+        double rank; /* Number of the column, or length of the record */
+        size_t position;
+        size_t offset; /* In the arena */
+        size_t length;
+} top_entry;
+
+typedef struct {
+        top_entry *entries; /* Heap, worst at entries[0] */
+        size_t n_entries;
+        size_t entries_size;
+        char *arena;
+        size_t arena_length;
+        size_t arena_size;
+        size_t live; /* Bytes of the arena of records in the heap */
+} top_heap;
+
+struct texler_top {
+        unsigned long column; /* 0: by length */
+        size_t k;
+
+        top_heap *heaps; /* One per thread */
+        size_t n_heaps;
+        size_t next; /* Entry of heaps[0] returned next */
+};
+
+typedef struct {
+        texler_top *top;
+        top_heap *heap;
+        char **path_list;
+        size_t n_files;
+        const char *separators;
+        atomic_size_t *next_file;
+} top_worker;
+
+static void *top_realloc(void *ptr, size_t size)
+{
+        void *new_ptr = realloc(ptr, size);
+        if (new_ptr == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        return new_ptr;
+}
+
+static size_t top_threads(void)
+{
+        const char *env = getenv("TEXLER_TOP_THREADS");
+        if (env != NULL && *env != '\0') {
+                char *end = NULL;
+                long threads = strtol(env, &end, 10);
+                if (*end == '\0' && threads > 0)
+                        return threads;
+        }
+
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return cpus > 0 ? cpus : 1;
+}
+
+/* Whether left goes before right: greater rank, then the first read */
+static bool better(const top_entry *left, const top_entry *right)
+{
+        if (left->rank != right->rank)
+                return left->rank > right->rank;
+
+        return left->position < right->position;
+}
+
+static void sift_down(top_heap *heap, size_t i)
+{
+        top_entry *entries = heap->entries;
+
+        for (;;) {
+                size_t worst = i;
+                size_t left = 2 * i + 1;
+                size_t right = left + 1;
+
+                if (left < heap->n_entries &&
+                    better(&entries[worst], &entries[left]))
+                        worst = left;
+                if (right < heap->n_entries &&
+                    better(&entries[worst], &entries[right]))
+                        worst = right;
+                if (worst == i)
+                        return;
+
+                top_entry entry = entries[i];
+                entries[i] = entries[worst];
+                entries[worst] = entry;
+                i = worst;
+        }
+}
+
+static void sift_up(top_heap *heap, size_t i)
+{
+        top_entry *entries = heap->entries;
+
+        while (i > 0) {
+                size_t parent = (i - 1) / 2;
+                if (!better(&entries[parent], &entries[i]))
+                        return;
+
+                top_entry entry = entries[i];
+                entries[i] = entries[parent];
+                entries[parent] = entry;
+                i = parent;
+        }
+}
+
+/* Copies the records of the heap to a new arena, without the dropped ones */
+static void compact_arena(top_heap *heap)
+{
+        size_t size = heap->live + BUFFER_SIZE;
+        char *arena = top_realloc(NULL, size);
+        size_t length = 0;
+
+        for (size_t i = 0; i < heap->n_entries; i++) {
+                top_entry *entry = &heap->entries[i];
+                if (entry->length > 0)
+                        memcpy(arena + length, heap->arena + entry->offset,
+                               entry->length);
+                entry->offset = length;
+                length += entry->length;
+        }
+
+        free(heap->arena);
+        heap->arena = arena;
+        heap->arena_length = length;
+        heap->arena_size = size;
+}
+
+static size_t store_record(top_heap *heap, const char *record, size_t length)
+{
+        if (heap->arena_length > 2 * heap->live + BUFFER_SIZE)
+                compact_arena(heap);
+
+        size_t needed = heap->arena_length + length;
+        if (needed > heap->arena_size || heap->arena == NULL) {
+                size_t size = heap->arena_size == 0 ? BUFFER_SIZE :
+                                                      heap->arena_size;
+                while (size < needed)
+                        size *= 2;
+                heap->arena = top_realloc(heap->arena, size);
+                heap->arena_size = size;
+        }
+
+        size_t offset = heap->arena_length;
+        if (length > 0)
+                memcpy(heap->arena + offset, record, length);
+        heap->arena_length = needed;
+        heap->live += length;
+
+        return offset;
+}
+
+/* Keeps record if it is one of the k best seen so far */
+static void offer_record(const texler_top *top, top_heap *heap,
+                         top_entry entry, const char *record)
+{
+        if (heap->n_entries == top->k) {
+                if (!better(&entry, &heap->entries[0]))
+                        return;
+
+                /* The root is still in the heap if the arena is compacted */
+                entry.offset = store_record(heap, record, entry.length);
+                heap->live -= heap->entries[0].length;
+                heap->entries[0] = entry;
+                sift_down(heap, 0);
+                return;
+        }
+
+        if (heap->n_entries == heap->entries_size) {
+                size_t size = heap->entries_size == 0 ? TOP_MIN_ENTRIES :
+                                                        2 * heap->entries_size;
+                if (size > top->k)
+                        size = top->k;
+                heap->entries =
+                        top_realloc(heap->entries, size * sizeof(top_entry));
+                heap->entries_size = size;
+        }
+
+        entry.offset = store_record(heap, record, entry.length);
+        heap->entries[heap->n_entries++] = entry;
+        sift_up(heap, heap->n_entries - 1);
+}
+
+/* Ranks the records of tex_obj, from where its stream is */
+static void top_file(const texler_top *top, top_heap *heap,
+                     TexlerObject *tex_obj, size_t file)
+{
+        char *record = top_realloc(NULL, BUFFER_SIZE);
+        char *cell = top_realloc(NULL, BUFFER_SIZE);
+
+        if (top->column > 0)
+                project_columns(tex_obj, &top->column, 1);
+        for (size_t n = 0;; n++) {
+                long read = records(tex_obj, &record);
+                if (read <= 0)
+                        break;
+
+                top_entry entry = { .position = (file << TOP_FILE_SHIFT) | n,
+                                    .length = strlen(record) };
+                if (top->column == 0) {
+                        size_t length = entry.length;
+                        while (length > 0 && record[length - 1] == '\n')
+                                length--;
+                        entry.rank = length;
+                } else {
+                        char *str = record;
+                        int separator = 0;
+                        cell[0] = '\0';
+                        file_columns(tex_obj, &str, &cell, &separator);
+                        size_t length = strlen(cell);
+                        while (length > 0 && cell[length - 1] == '\n')
+                                cell[--length] = '\0';
+                        /* Records without a number there are left out */
+                        if (!cell_value(tex_obj, cell, &entry.rank))
+                                continue;
+                }
+
+                offer_record(top, heap, entry, record);
+        }
+        if (top->column > 0)
+                project_columns(tex_obj, NULL, 0);
+
+        free(cell);
+        free(record);
+}
+
+/* Takes the files of the folder left, one at a time */
+static void *top_files(void *arg)
+{
+        top_worker *worker = (top_worker *)arg;
+
+        for (;;) {
+                size_t file = atomic_fetch_add(worker->next_file, 1);
+                if (file >= worker->n_files)
+                        break;
+
+                TexlerObject *tex_obj =
+                        (TexlerObject *)calloc(1, sizeof(TexlerObject));
+                if (tex_obj == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+
+                /* Files that can not be opened are skipped */
+                if (open_file(worker->path_list[file], "r", tex_obj,
+                              worker->separators))
+                        top_file(worker->top, worker->heap, tex_obj, file);
+                free_texlerobject(tex_obj);
+        }
+
+        return NULL;
+}
+
+static void top_folder(texler_top *top, TexlerObject *tex_obj)
+{
+        top_worker workers[top->n_heaps];
+        pthread_t threads[top->n_heaps];
+        bool started[top->n_heaps];
+        atomic_size_t next_file = 0;
+
+        for (size_t i = 0; i < top->n_heaps; i++)
+                workers[i] = (top_worker){
+                        .top = top,
+                        .heap = &top->heaps[i],
+                        .path_list = tex_obj->value.file.path_list,
+                        .n_files = tex_obj->value.file.n_files,
+                        .separators = tex_obj->value.file.separators,
+                        .next_file = &next_file,
+                };
+
+        for (size_t i = 1; i < top->n_heaps; i++)
+                started[i] = pthread_create(&threads[i], NULL, top_files,
+                                            &workers[i]) == 0;
+        top_files(&workers[0]);
+
+        for (size_t i = 1; i < top->n_heaps; i++) {
+                if (started[i])
+                        pthread_join(threads[i], NULL);
+        }
+}
+
+static void free_heap(top_heap *heap)
+{
+        free(heap->entries);
+        free(heap->arena);
+        *heap = (top_heap){ 0 };
+}
+
+/* Merges every heap into the first one, freeing them */
+static void merge_heaps(texler_top *top)
+{
+        top_heap *result = &top->heaps[0];
+
+        for (size_t h = 1; h < top->n_heaps; h++) {
+                top_heap *heap = &top->heaps[h];
+
+                for (size_t i = 0; i < heap->n_entries; i++)
+                        offer_record(top, result, heap->entries[i],
+                                     heap->arena + heap->entries[i].offset);
+                free_heap(heap);
+        }
+}
+
+/* qsort() comparison of entries, the best first */
+static int compare_entries(const void *a, const void *b)
+{
+        const top_entry *left = (const top_entry *)a;
+        const top_entry *right = (const top_entry *)b;
+
+        return better(left, right) ? -1 : better(right, left) ? 1 : 0;
+}
+
+/*
+ * The k records of tex_obj (a file, from its start, or every file of a
+ * folder) with the greatest number in their column 'column' (1-based), or
+ * the longest ones (without their '\n') if column is 0. Records whose
+ * column is not a number are left out. Returns NULL if k is 0.
+ */
+texler_top *top_records(TexlerObject *tex_obj, unsigned long column,
+                        size_t k)
+{
+        if (tex_obj == NULL || k == 0 ||
+            (tex_obj->type != TYPE_T_FILEPTR &&
+             tex_obj->type != TYPE_T_FILE_LIST))
+                return NULL;
+
+        texler_top *top = (texler_top *)calloc(1, sizeof(texler_top));
+        if (top == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        top->column = column;
+        top->k = k;
+
+        size_t n_heaps = 1;
+        if (tex_obj->type == TYPE_T_FILE_LIST) {
+                n_heaps = top_threads();
+                if (n_heaps > tex_obj->value.file.n_files)
+                        n_heaps = tex_obj->value.file.n_files;
+                if (n_heaps == 0)
+                        n_heaps = 1;
+        }
+        top->n_heaps = n_heaps;
+        top->heaps = (top_heap *)calloc(n_heaps, sizeof(top_heap));
+        if (top->heaps == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        if (tex_obj->type == TYPE_T_FILEPTR) {
+                rewind(tex_obj->value.file.stream);
+                top_file(top, &top->heaps[0], tex_obj, 0);
+        } else {
+                top_folder(top, tex_obj);
+        }
+
+        merge_heaps(top);
+        if (top->heaps[0].n_entries > 0)
+                qsort(top->heaps[0].entries, top->heaps[0].n_entries,
+                      sizeof(top_entry), compare_entries);
+
+        return top;
+}
+
+/*
+ * Next record into *buffer (a malloc()ed string, as lines() takes it), as
+ * it was read. Records come from the greatest to the smallest, those that
+ * tie in the order they were read. Returns its length plus one, 0 after
+ * the last one.
+ */
+long ranked_records(texler_top *top, char **buffer)
+{
+        if (top == NULL || buffer == NULL)
+                return 0;
+
+        top_heap *heap = &top->heaps[0];
+        if (top->next == heap->n_entries)
+                return 0;
+
+        const top_entry *entry = &heap->entries[top->next++];
+        *buffer = top_realloc(*buffer, entry->length + 1);
+        if (entry->length > 0)
+                memcpy(*buffer, heap->arena + entry->offset, entry->length);
+        (*buffer)[entry->length] = '\0';
+
+        return entry->length + 1;
+}
+
+void free_top(texler_top *top)
+{
+        if (top == NULL)
+                return;
+
+        for (size_t i = 0; i < top->n_heaps; i++)
+                free_heap(&top->heaps[i]);
+        free(top->heaps);
+        free(top);
+}
@@ -0,0 +1,511 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "texler_runtime.h"
+
+/*
+ * io_uring I/O backend (io.c). Like the block backend, files are read and
+ * written by large blocks, but the program thread keeps URING_DEPTH of them
+ * queued in the kernel instead of handing them to other threads: reads are
+ * queued ahead of the position of the program, and each block it fills is
+ * queued to be written while it fills the next one.
+ *
+ * Talks to the kernel with the raw syscalls, so there is nothing to link;
+ * open_uring() fails if the kernel lacks io_uring or its read and write
+ * operations, and io.c falls back to the block backend.
+ */
+
+#define URING_BLOCK_SIZE (256 * 1024)
+#define URING_DEPTH 4
+
+typedef struct {
+        char *data;
+        ssize_t length; /* Result of the read: 0 at EOF, -errno on error */
+        off_t offset;
+        bool queued;
+} uring_block;
+
+typedef struct {
+        int fd;
+        int ring_fd;
+        bool writer;
+
+        unsigned *sq_tail;
+        unsigned *sq_mask;
+        unsigned *sq_array;
+        struct io_uring_sqe *sqes;
+        unsigned *cq_head;
+        unsigned *cq_tail;
+        unsigned *cq_mask;
+        struct io_uring_cqe *cqes;
+
+        void *sq_ring;
+        size_t sq_ring_size;
+        void *cq_ring;
+        size_t cq_ring_size;
+        size_t sqes_size;
+
+        uring_block blocks[URING_DEPTH];
+        unsigned current; /* Block the program reads or fills */
+        size_t current_pos;
+        bool started; /* Reads were queued from position */
+        off_t position;   /* Logical offset of the stream */
+        off_t next_read;  /* Offset of the next block to queue */
+        int error;        /* First write error */
+        unsigned unsubmitted; /* SQEs in the ring the kernel did not take */
+} uring;
+
+static int uring_enter(uring *u, unsigned to_submit, unsigned min_complete)
+{
+        int ret;
+        do {
+                ret = syscall(__NR_io_uring_enter, u->ring_fd, to_submit,
+                              min_complete,
+                              min_complete ? IORING_ENTER_GETEVENTS : 0, NULL,
+                              0);
+        } while (ret < 0 && errno == EINTR);
+
+        return ret;
+}
+
+/*
+ * Puts the read or write of the block at index in the ring. From then on
+ * it is queued, even if the kernel cannot take it yet: complete() submits
+ * it again, and the block is not reused before its completion.
+ */
+static void queue(uring *u, int op, unsigned index)
+{
+        uring_block *block = &u->blocks[index];
+        unsigned tail = *u->sq_tail;
+        unsigned slot = tail & *u->sq_mask;
+        struct io_uring_sqe *sqe = &u->sqes[slot];
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = op;
+        sqe->fd = u->fd;
+        sqe->addr = (unsigned long)block->data;
+        sqe->len = op == IORING_OP_READ ? URING_BLOCK_SIZE : block->length;
+        sqe->off = block->offset;
+        sqe->user_data = index;
+        u->sq_array[slot] = slot;
+        __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+        block->queued = true;
+        u->unsubmitted++;
+
+        int submitted = uring_enter(u, u->unsubmitted, 0);
+        if (submitted > 0)
+                u->unsubmitted -= submitted;
+}
+
+static void write_rest(uring *u, uring_block *block, size_t written)
+{
+        while (written < (size_t)block->length) {
+                ssize_t n = pwrite(u->fd, block->data + written,
+                                   block->length - written,
+                                   block->offset + written);
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n <= 0) {
+                        if (u->error == 0)
+                                u->error = n < 0 ? errno : EIO;
+                        return;
+                }
+                written += n;
+        }
+}
+
+/* Waits until the block at index is no longer queued */
+static bool complete(uring *u, unsigned index)
+{
+        while (u->blocks[index].queued) {
+                unsigned head = *u->cq_head;
+                if (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+                        int submitted = uring_enter(u, u->unsubmitted, 1);
+                        if (submitted < 0)
+                                return false;
+                        u->unsubmitted -= submitted;
+                        continue;
+                }
+
+                struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+                uring_block *block = &u->blocks[cqe->user_data];
+                int res = cqe->res;
+                __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+
+                block->queued = false;
+                if (u->writer == false) {
+                        block->length = res;
+                } else if (res < 0) {
+                        if (u->error == 0)
+                                u->error = -res;
+                } else if (res < block->length) {
+                        write_rest(u, block, res);
+                }
+        }
+
+        return true;
+}
+
+static bool complete_all(uring *u)
+{
+        for (unsigned i = 0; i < URING_DEPTH; i++) {
+                if (complete(u, i) == false)
+                        return false;
+        }
+
+        return true;
+}
+
+/* Queues the reads of every block, in order from position */
+static bool start_reads(uring *u)
+{
+        if (complete_all(u) == false)
+                return false;
+
+        u->current = 0;
+        u->current_pos = 0;
+        u->next_read = u->position;
+        for (unsigned i = 0; i < URING_DEPTH; i++) {
+                u->blocks[i].offset = u->next_read;
+                u->next_read += URING_BLOCK_SIZE;
+                queue(u, IORING_OP_READ, i);
+        }
+        u->started = true;
+
+        return true;
+}
+
+/* Queues the block being filled and waits for all the writes */
+static bool drain(uring *u)
+{
+        uring_block *block = &u->blocks[u->current];
+        if (block->length > 0) {
+                queue(u, IORING_OP_WRITE, u->current);
+                u->current = (u->current + 1) % URING_DEPTH;
+        }
+
+        if (complete_all(u) == false)
+                return false;
+        for (unsigned i = 0; i < URING_DEPTH; i++)
+                u->blocks[i].length = 0;
+        u->blocks[u->current].offset = u->position;
+
+        if (u->error) {
+                errno = u->error;
+                return false;
+        }
+
+        return true;
+}
+
+static ssize_t uring_read(void *cookie, char *buffer, size_t size)
+{
+        uring *u = (uring *)cookie;
+
+        /* Output files opened with "w+" are read back directly */
+        if (u->writer) {
+                if (drain(u) == false)
+                        return -1;
+                ssize_t n = pread(u->fd, buffer, size, u->position);
+                if (n > 0) {
+                        u->position += n;
+                        u->blocks[u->current].offset = u->position;
+                }
+                return n;
+        }
+
+        if (u->started == false && start_reads(u) == false)
+                return -1;
+
+        uring_block *block = &u->blocks[u->current];
+        if (complete(u, u->current) == false)
+                return -1;
+
+        if (block->length > 0 && u->current_pos == (size_t)block->length) {
+                /* Reused for the block after the last one queued */
+                off_t next = block->offset + block->length;
+                block->offset = u->next_read;
+                u->next_read += URING_BLOCK_SIZE;
+                queue(u, IORING_OP_READ, u->current);
+
+                u->current = (u->current + 1) % URING_DEPTH;
+                u->current_pos = 0;
+                block = &u->blocks[u->current];
+                if (complete(u, u->current) == false)
+                        return -1;
+
+                /* A short read in the middle: the next blocks are wrong */
+                if (block->offset != next) {
+                        u->position = next;
+                        if (start_reads(u) == false ||
+                            complete(u, u->current) == false)
+                                return -1;
+                        block = &u->blocks[u->current];
+                }
+        }
+
+        /* The EOF or error block stays current until the next seek */
+        if (block->length < 0) {
+                errno = -block->length;
+                return -1;
+        }
+        if (block->length == 0)
+                return 0;
+
+        size_t available = block->length - u->current_pos;
+        if (size > available)
+                size = available;
+        memcpy(buffer, block->data + u->current_pos, size);
+        u->current_pos += size;
+        u->position += size;
+
+        return size;
+}
+
+static ssize_t uring_write(void *cookie, const char *buffer, size_t size)
+{
+        uring *u = (uring *)cookie;
+
+        if (u->error) {
+                errno = u->error;
+                return -1;
+        }
+
+        size_t written = 0;
+        while (written < size) {
+                uring_block *block = &u->blocks[u->current];
+                if (block->length == 0) {
+                        if (complete(u, u->current) == false)
+                                return -1;
+                        block->offset = u->position;
+                }
+
+                size_t n = URING_BLOCK_SIZE - block->length;
+                if (n > size - written)
+                        n = size - written;
+                memcpy(block->data + block->length, buffer + written, n);
+                block->length += n;
+                u->position += n;
+                written += n;
+
+                if (block->length == URING_BLOCK_SIZE) {
+                        queue(u, IORING_OP_WRITE, u->current);
+                        u->current = (u->current + 1) % URING_DEPTH;
+                        /* Its last write is done before it is reused */
+                        if (complete(u, u->current) == false)
+                                return -1;
+                        u->blocks[u->current].length = 0;
+                }
+        }
+
+        return written;
+}
+
+static int uring_seek(void *cookie, off64_t *offset, int whence)
+{
+        uring *u = (uring *)cookie;
+        off_t target;
+
+        switch (whence) {
+        case SEEK_SET:
+                target = *offset;
+                break;
+        case SEEK_CUR:
+                target = u->position + *offset;
+                break;
+        case SEEK_END: {
+                struct stat st;
+                if ((u->writer && drain(u) == false) || fstat(u->fd, &st))
+                        return -1;
+                target = st.st_size + *offset;
+                break;
+        }
+        default:
+                errno = EINVAL;
+                return -1;
+        }
+        if (target < 0) {
+                errno = EINVAL;
+                return -1;
+        }
+
+        if (target != u->position) {
+                uring_block *block = &u->blocks[u->current];
+                if (u->writer) {
+                        if (drain(u) == false)
+                                return -1;
+                        block = &u->blocks[u->current];
+                        block->offset = target;
+                } else if (u->started && block->queued == false &&
+                           block->length > 0 && target >= block->offset &&
+                           target < block->offset + block->length) {
+                        /* Inside the block already read, no need to ask */
+                        u->current_pos = target - block->offset;
+                } else {
+                        u->started = false;
+                }
+                u->position = target;
+        }
+
+        *offset = target;
+        return 0;
+}
+
+static void unmap(uring *u)
+{
+        if (u->sqes != NULL)
+                munmap(u->sqes, u->sqes_size);
+        if (u->cq_ring != NULL && u->cq_ring != u->sq_ring)
+                munmap(u->cq_ring, u->cq_ring_size);
+        if (u->sq_ring != NULL)
+                munmap(u->sq_ring, u->sq_ring_size);
+        if (u->ring_fd >= 0)
+                close(u->ring_fd);
+        for (int i = 0; i < URING_DEPTH; i++)
+                free(u->blocks[i].data);
+        free(u);
+}
+
+static int uring_close(void *cookie)
+{
+        uring *u = (uring *)cookie;
+        int ret = 0;
+
+        if (u->writer ? drain(u) == false : complete_all(u) == false)
+                ret = -1;
+        if (close(u->fd) && ret == 0)
+                ret = -1;
+        unmap(u);
+
+        return ret;
+}
+
+/* Whether the kernel implements the read and write operations */
+static bool supports_read_write(int ring_fd)
+{
+        size_t size = sizeof(struct io_uring_probe) +
+                      256 * sizeof(struct io_uring_probe_op);
+        struct io_uring_probe *probe =
+                (struct io_uring_probe *)calloc(1, size);
+        if (probe == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        bool supported =
+                syscall(__NR_io_uring_register, ring_fd,
+                        IORING_REGISTER_PROBE, probe, 256) == 0 &&
+                probe->last_op >= IORING_OP_WRITE &&
+                (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) &&
+                (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+        free(probe);
+
+        return supported;
+}
+
+static bool setup(uring *u)
+{
+        struct io_uring_params params = { 0 };
+        u->ring_fd = syscall(__NR_io_uring_setup, URING_DEPTH, &params);
+        if (u->ring_fd < 0 || supports_read_write(u->ring_fd) == false)
+                return false;
+
+        u->sq_ring_size =
+                params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        u->cq_ring_size = params.cq_off.cqes +
+                          params.cq_entries * sizeof(struct io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                if (u->cq_ring_size > u->sq_ring_size)
+                        u->sq_ring_size = u->cq_ring_size;
+                u->cq_ring_size = u->sq_ring_size;
+        }
+
+        u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, u->ring_fd,
+                          IORING_OFF_SQ_RING);
+        if (u->sq_ring == MAP_FAILED) {
+                u->sq_ring = NULL;
+                return false;
+        }
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                u->cq_ring = u->sq_ring;
+        } else {
+                u->cq_ring = mmap(NULL, u->cq_ring_size,
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, u->ring_fd,
+                                  IORING_OFF_CQ_RING);
+                if (u->cq_ring == MAP_FAILED) {
+                        u->cq_ring = NULL;
+                        return false;
+                }
+        }
+
+        u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, u->ring_fd,
+                       IORING_OFF_SQES);
+        if (u->sqes == MAP_FAILED) {
+                u->sqes = NULL;
+                return false;
+        }
+
+        char *sq = (char *)u->sq_ring;
+        char *cq = (char *)u->cq_ring;
+        u->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+        u->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+        u->sq_array = (unsigned *)(sq + params.sq_off.array);
+        u->cq_head = (unsigned *)(cq + params.cq_off.head);
+        u->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+        u->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+        u->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+        return true;
+}
+
+/*
+ * Stream over fd (a regular file opened with mode "r", "w" or "w+") read
+ * and written through io_uring. Closing the stream closes fd. Returns NULL,
+ * leaving fd open, if io_uring is not available.
+ */
+FILE *open_uring(int fd, const char *mode)
+{
+        uring *u = (uring *)calloc(1, sizeof(uring));
+        if (u == NULL) {
+                perror("Aborting due to");
+                exit(1);
+        }
+        u->fd = fd;
+        u->writer = mode[0] == 'w';
+
+        if (setup(u) == false) {
+                unmap(u);
+                return NULL;
+        }
+
+        for (int i = 0; i < URING_DEPTH; i++) {
+                u->blocks[i].data = (char *)malloc(URING_BLOCK_SIZE);
+                if (u->blocks[i].data == NULL) {
+                        perror("Aborting due to");
+                        exit(1);
+                }
+        }
+
+        cookie_io_functions_t functions = {
+                .read = uring_read,
+                .write = uring_write,
+                .seek = uring_seek,
+                .close = uring_close,
+        };
+        FILE *fptr = fopencookie(u, mode, functions);
+        if (fptr == NULL)
+                unmap(u);
+
+        return fptr;
+}
@@ -20,10 +20,24 @@ declare -A test_files=(\
     ["r313.texler"]=1 \
     ["r314.texler"]=1 \
     ["r315.texler"]=0 \
+    ["r316.texler"]=0 \
+    ["r317.texler"]=0 \
+    ["r318.texler"]=0 \
+    ["r319.texler"]=0 \
+    ["r320.texler"]=0 \
+    ["r321.texler"]=0 \
+    ["r322.texler"]=0 \
+    ["r323.texler"]=0 \
+    ["r324.texler"]=0 \
+    ["r325.texler"]=0 \
+    ["r326.texler"]=0 \
+    ["r327.texler"]=0 \
+    ["r328.texler"]=0 \
 )
 
 declare -A test_files_execution_args=(\
     ["r36.texler"]=3 \
+    ["r320.texler"]="--batch manifest_r320.txt" \
 )
 
 
@@ -42,6 +56,19 @@ declare -A test_files_execution=(\
     ["r311.texler"]="stdout" \
     ["r312.texler"]="stdout" \
     ["r315.texler"]="stdout" \
+    ["r316.texler"]="new_r316.txt" \
+    ["r317.texler"]="new_r317.txt" \
+    ["r318.texler"]="stdout" \
+    ["r319.texler"]="stdout" \
+    ["r320.texler"]="stdout" \
+    ["r321.texler"]="new_r321.txt" \
+    ["r322.texler"]="new_r322.txt" \
+    ["r323.texler"]="new_r323.txt" \
+    ["r324.texler"]="new_r324.txt" \
+    ["r325.texler"]="new_r325.txt" \
+    ["r326.texler"]="new_r326.txt" \
+    ["r327.texler"]="new_r327.txt" \
+    ["r328.texler"]="new_r328.txt" \
 )
 
 readonly test_logs="logs"
@@ -85,24 +112,37 @@ function test_compilation()
     return $retVal
 }
 
+# Arguments:
+#   $1 : Texler source
+#   $2 : 'elf' runs the compiled executable, 'vm' runs the source with
+#        texler -r
 function test_execution()
 {
     local retVal=0
 
     local texler_source="$1"
+    local mode="$2"
     local test_name="$(basename $1)"
     test_name="${test_name%.*}"
 
+    local result_prefix=""
+    local -a command=(./$test_name.elf)
+    if [ "$mode" = "vm" ]
+    then
+        result_prefix="vm_"
+        command=($compiler_path -r "$texler_source")
+    fi
+
     if [ -f "$texler_source" ]
     then
-        if [ ${test_files_execution_args[$texler_source]} ]
+        if [ -n "${test_files_execution_args[$texler_source]}" ]
         then
-            ./$test_name.elf \
+            "${command[@]}" \
                 ${test_files_execution_args[$texler_source]} \
-                &> "$test_results/test_result_${test_name}.txt"
+                &> "$test_results/test_result_${result_prefix}${test_name}.txt"
         else
-            ./$test_name.elf \
-                &> "$test_results/test_result_${test_name}.txt"
+            "${command[@]}" \
+                &> "$test_results/test_result_${result_prefix}${test_name}.txt"
         fi
 
         if [ "${test_files_execution[$texler_source]}" = "" ] || \
@@ -110,7 +150,7 @@ function test_execution()
         then
             diff \
                 "test_expected_${test_name}.txt" \
-                "$test_results/test_result_${test_name}.txt" \
+                "$test_results/test_result_${result_prefix}${test_name}.txt" \
                 &> /dev/null
             retVal=$?
         else
@@ -120,7 +160,8 @@ function test_execution()
                 &> /dev/null
             retVal=$?
 
-            mv "${test_files_execution[$texler_source]}" "$test_results/"
+            mv "${test_files_execution[$texler_source]}" \
+                "$test_results/${result_prefix}${test_files_execution[$texler_source]}"
         fi
     else
         infoc 31 "Test file '$1' does not exist."
@@ -159,7 +200,7 @@ function run_suite()
         
         if [ ${test_files[$file]} -eq 0 ]
         then
-            test_execution "$file" 
+            test_execution "$file" elf
             retValue=$?
             
             if [ $retValue -eq 0 ]
@@ -170,6 +211,18 @@ function run_suite()
                 infoc 33 "Execution: FAIL"
             fi
 
+            # Same program, run by the VM: the output must not change
+            test_execution "$file" vm
+            retValue=$?
+
+            if [ $retValue -eq 0 ]
+            then
+                infoc 32 "Execution (VM): PASS"
+            else
+                failed+=(["$file"]=$retValue)
+                infoc 33 "Execution (VM): FAIL"
+            fi
+
             mv "$test_name.elf" "$test_results/"
         fi
 
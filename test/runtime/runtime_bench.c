@@ -0,0 +1,101 @@
+#include <time.h>
+#include <unistd.h>
+
+#include "texler_runtime.h"
+
+/*
+ * Times the runtime functions generated programs spend most of their time
+ * in. Usage: runtime_bench [number of lines]
+ */
+
+#define DEFAULT_BENCH_LINES 1000000
+
+static double elapsed_ms(const struct timespec *start)
+{
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        return (end.tv_sec - start->tv_sec) * 1e3 +
+               (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static char *write_bench_file(long n_lines)
+{
+        char *path = strdup("/tmp/texler_runtime_bench_XXXXXX");
+        int fd = mkstemp(path);
+        if (fd < 0) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        FILE *fptr = fdopen(fd, "w");
+        for (long i = 1; i <= n_lines; i++)
+                fprintf(fptr, "%ld,linea numero %ld,texler bench\n", i, i);
+        fclose(fptr);
+
+        return path;
+}
+
+int main(int argc, char **argv)
+{
+        long n_lines = argc > 1 ? atol(argv[1]) : DEFAULT_BENCH_LINES;
+        if (n_lines <= 0)
+                n_lines = DEFAULT_BENCH_LINES;
+
+        char *path = write_bench_file(n_lines);
+        TexlerObject *file = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        if (file == NULL || !open_file(path, "r", file, NULL)) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        struct timespec start;
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+        char *column = calloc(BUFFER_SIZE, sizeof(char));
+        long count = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while (lines(file, &line) > 0)
+                count++;
+        printf("lines()          %8ld lines  %10.2f ms\n", count,
+               elapsed_ms(&start));
+
+        seek_line(file, 1);
+        count = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while (lines(file, &line) > 0) {
+                char *remaining = line;
+                int separator = 0;
+                while (remaining != NULL) {
+                        columns(&remaining, file->value.file.separators,
+                                &column, &separator);
+                        count++;
+                }
+        }
+        printf("lines().columns() %7ld cells  %10.2f ms\n", count,
+               elapsed_ms(&start));
+
+        seek_line(file, 1);
+        count = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while (lines(file, &line) > 0)
+                count += is_in_string("numero 9", line);
+        printf("is_in_string()   %8ld found  %10.2f ms\n", count,
+               elapsed_ms(&start));
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < 10; i++) {
+                seek_line(file, 1);
+                seek_line(file, n_lines);
+        }
+        printf("seek_line()      %8d seeks  %10.2f ms\n", 20,
+               elapsed_ms(&start));
+
+        free(column);
+        free(line);
+        free_texlerobject(file);
+        unlink(path);
+        free(path);
+
+        return 0;
+}
@@ -0,0 +1,1599 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "texler_runtime.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+        do {                                                                 \
+                if (!(cond)) {                                               \
+                        fprintf(stderr, "%s:%d: check failed: %s\n",         \
+                                __FILE__, __LINE__, #cond);                  \
+                        failures++;                                          \
+                }                                                            \
+        } while (0)
+
+static char *write_temp_file(const char *content)
+{
+        char *path = strdup("/tmp/texler_runtime_test_XXXXXX");
+        int fd = mkstemp(path);
+        if (fd < 0) {
+                perror("Aborting due to");
+                exit(1);
+        }
+
+        FILE *fptr = fdopen(fd, "w");
+        fputs(content, fptr);
+        fclose(fptr);
+
+        return path;
+}
+
+static TexlerObject *open_temp_file(const char *content, char **path)
+{
+        TexlerObject *tex_obj =
+                (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        *path = write_temp_file(content);
+        CHECK(open_file(*path, "r", tex_obj, NULL));
+        return tex_obj;
+}
+
+static void close_temp_file(TexlerObject *tex_obj, char *path)
+{
+        free_texlerobject(tex_obj);
+        unlink(path);
+        free(path);
+}
+
+static void test_lines(void)
+{
+        char *path = NULL;
+        TexlerObject *file = open_temp_file("one\ntwo\nthree", &path);
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+
+        CHECK(lines(file, &line) == 5);
+        CHECK(strcmp(line, "one\n") == 0);
+        CHECK(lines(file, &line) == 5);
+        CHECK(strcmp(line, "two\n") == 0);
+        CHECK(lines(file, &line) > 0);
+        CHECK(strcmp(line, "three") == 0);
+        CHECK(lines(file, &line) == 0);
+        CHECK(file->value.file.n_line == 4);
+
+        free(line);
+        close_temp_file(file, path);
+}
+
+static void test_seek_line(void)
+{
+        char *path = NULL;
+        TexlerObject *file = open_temp_file("1\n2\n3\n4\n5\n", &path);
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+
+        CHECK(seek_line(file, 4));
+        CHECK(lines(file, &line) > 0 && strcmp(line, "4\n") == 0);
+
+        /* Going backwards rewinds the file */
+        CHECK(seek_line(file, 2));
+        CHECK(lines(file, &line) > 0 && strcmp(line, "2\n") == 0);
+
+        CHECK(!seek_line(file, 9));
+        CHECK(!seek_line(file, 0));
+
+        CHECK(line_by_number(file, &line, 5) > 0);
+        CHECK(strcmp(line, "5\n") == 0);
+        CHECK(line_by_number(file, &line, 6) == 0);
+
+        free(line);
+        close_temp_file(file, path);
+}
+
+static void test_lines_by_numbers(void)
+{
+        char *path = NULL;
+        TexlerObject *file = open_temp_file("a\nb\nc\nd\ne\n", &path);
+        const unsigned long rows[] = { 2, 4, 7 };
+        char *slots[3] = { NULL };
+
+        CHECK(lines_by_numbers(file, rows, 3, slots) == 2);
+        CHECK(slots[0] != NULL && strcmp(slots[0], "b\n") == 0);
+        CHECK(slots[1] != NULL && strcmp(slots[1], "d\n") == 0);
+        CHECK(slots[2] == NULL);
+
+        free(slots[0]);
+        free(slots[1]);
+        close_temp_file(file, path);
+
+        /* Consecutive rows are read in turn, a large gap is skipped */
+        char *text = NULL;
+        size_t length = 0;
+        FILE *data = open_memstream(&text, &length);
+        for (size_t i = 1; i <= 5000; i++)
+                fprintf(data, "line%05zu\n", i);
+        fclose(data);
+        file = open_temp_file(text, &path);
+        free(text);
+
+        unsigned long many[105];
+        for (size_t i = 0; i < 100; i++)
+                many[i] = i + 1;
+        many[100] = 3000;
+        many[101] = 3001;
+        many[102] = 4999;
+        many[103] = 5000;
+        many[104] = 6000;
+        char *many_slots[105] = { NULL };
+        CHECK(lines_by_numbers(file, many, 105, many_slots) == 104);
+        for (size_t i = 0; i < 104; i++) {
+                char expected[16];
+                snprintf(expected, sizeof(expected), "line%05lu\n", many[i]);
+                CHECK(many_slots[i] != NULL &&
+                      strcmp(many_slots[i], expected) == 0);
+                free(many_slots[i]);
+        }
+        CHECK(many_slots[104] == NULL);
+        close_temp_file(file, path);
+}
+
+static void test_variable_streams(void)
+{
+        char input[] = "uno\ndos\n";
+        char *path = write_temp_file("tres\n");
+        int fd = open(path, O_RDONLY);
+        texler_stream streams[] = {
+                { .name = "in", .type = TEXLER_STREAM_BUFFER,
+                  .buffer = input, .length = strlen(input) },
+                { .name = "out", .type = TEXLER_STREAM_BUFFER },
+                { .name = "fd", .type = TEXLER_STREAM_FD, .fd = fd },
+        };
+        texler_context context = { streams, 3 };
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+
+        TexlerObject *in = calloc(1, sizeof(TexlerObject));
+        CHECK(open_variable_file(&context, "in", "missing", "r", in, NULL));
+        CHECK(lines(in, &line) > 0 && strcmp(line, "uno\n") == 0);
+        CHECK(lines(in, &line) > 0 && strcmp(line, "dos\n") == 0);
+        CHECK(lines(in, &line) == 0);
+        free_texlerobject(in);
+
+        TexlerObject *out = calloc(1, sizeof(TexlerObject));
+        CHECK(open_variable_stdout(&context, "out", out));
+        fputs("hola", out->value.file.stream);
+        free_texlerobject(out);
+        CHECK(streams[1].length == 4);
+        CHECK(streams[1].buffer != NULL &&
+              strcmp(streams[1].buffer, "hola") == 0);
+        free(streams[1].buffer);
+
+        /* The host keeps its descriptor, texler reads from a copy */
+        TexlerObject *from_fd = calloc(1, sizeof(TexlerObject));
+        CHECK(open_variable_file(&context, "fd", "missing", "r", from_fd,
+                                 NULL));
+        CHECK(lines(from_fd, &line) > 0 && strcmp(line, "tres\n") == 0);
+        free_texlerobject(from_fd);
+        CHECK(fcntl(fd, F_GETFD) != -1);
+        close(fd);
+
+        /* Variables without a stream open their own file */
+        TexlerObject *unbound = calloc(1, sizeof(TexlerObject));
+        CHECK(open_variable_file(&context, "other", path, "r", unbound,
+                                 NULL));
+        CHECK(lines(unbound, &line) > 0 && strcmp(line, "tres\n") == 0);
+        close_temp_file(unbound, path);
+
+        free(line);
+}
+
+static size_t batch_runs = 0;
+
+/* Checks the bindings texler_main() passes for the manifest below */
+static int record_batch_run(texler_stream *streams, size_t n_streams,
+                            const int argc, const char **argv)
+{
+        batch_runs++;
+
+        CHECK(argc == 2 && strcmp(argv[1], "3") == 0);
+        CHECK(n_streams == 3);
+        if (n_streams != 3)
+                return 1;
+
+        if (batch_runs == 1) {
+                CHECK(strcmp(streams[0].name, "input") == 0);
+                CHECK(strcmp(streams[0].path, "a.txt") == 0);
+                CHECK(strcmp(streams[1].name, "output") == 0);
+                CHECK(strcmp(streams[1].path, "b.txt") == 0);
+        } else {
+                CHECK(strcmp(streams[0].name, "output_log") == 0);
+                CHECK(strcmp(streams[0].path, "c.txt") == 0);
+                CHECK(strcmp(streams[1].name, "input") == 0);
+                CHECK(strcmp(streams[1].path, "d.txt") == 0);
+        }
+
+        /* --file of the command line, after the ones of the line */
+        CHECK(streams[2].type == TEXLER_STREAM_PATH);
+        CHECK(strcmp(streams[2].name, "input_extra") == 0);
+        CHECK(strcmp(streams[2].path, "e.txt") == 0);
+
+        return batch_runs == 2 ? 2 : 0;
+}
+
+static void test_batch(void)
+{
+        char *manifest = write_temp_file("a.txt\tb.txt\n"
+                                         "# comment\n"
+                                         "\n"
+                                         "output_log=c.txt input=d.txt\n");
+        const char *argv[] = { "program", "--file", "input_extra=e.txt",
+                               "--batch", manifest, "3" };
+
+        /* Exit code of the worst run */
+        CHECK(texler_main(record_batch_run, 6, argv) == 2);
+        CHECK(batch_runs == 2);
+
+        const char *invalid[] = { "program", "--file", "input" };
+        CHECK(texler_main(record_batch_run, 3, invalid) == 1);
+        CHECK(batch_runs == 2);
+
+        unlink(manifest);
+        free(manifest);
+}
+
+/* Program of the worker: copies input to output, exits with argv[1] */
+static int copy_run(texler_stream *streams, size_t n_streams, const int argc,
+                    const char **argv)
+{
+        texler_context context = { streams, n_streams };
+        TexlerObject *in = calloc(1, sizeof(TexlerObject));
+        TexlerObject *out = calloc(1, sizeof(TexlerObject));
+
+        bool opened = open_variable_file(&context, "input", "missing", "r",
+                                         in, NULL) &&
+                      open_variable_file(&context, "output", "missing", "w",
+                                         out, NULL);
+        if (opened)
+                copy_file_content(in->value.file.stream,
+                                  out->value.file.stream);
+
+        free_texlerobject(in);
+        free_texlerobject(out);
+
+        if (opened == false)
+                return 1;
+
+        return argc > 1 ? atoi(argv[1]) : 0;
+}
+
+/* Sends 'request' with 'n_fds' descriptors, returns the response */
+static char *worker_request(int worker, const char *request, const int *fds,
+                            size_t n_fds)
+{
+        union {
+                char buffer[CMSG_SPACE(2 * sizeof(int))];
+                struct cmsghdr align;
+        } control;
+        struct iovec iov = { .iov_base = (void *)request,
+                             .iov_len = strlen(request) };
+        struct msghdr message = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+        if (n_fds > 0) {
+                message.msg_control = control.buffer;
+                message.msg_controllen = CMSG_SPACE(n_fds * sizeof(int));
+
+                struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(n_fds * sizeof(int));
+                memcpy(CMSG_DATA(cmsg), fds, n_fds * sizeof(int));
+        }
+
+        static char response[128];
+        memset(response, 0, sizeof(response));
+        if (sendmsg(worker, &message, 0) < 0 ||
+            recv(worker, response, sizeof(response) - 1, 0) <= 0)
+                return NULL;
+
+        return response;
+}
+
+static void test_worker(void)
+{
+        char socket_path[] = "/tmp/texler_runtime_test_socket_XXXXXX";
+        close(mkstemp(socket_path));
+        unlink(socket_path);
+
+        pid_t pid = fork();
+        if (pid == 0) {
+                const char *argv[] = { "program", "--serve", socket_path };
+                _exit(texler_main(copy_run, 3, argv));
+        }
+
+        struct sockaddr_un address = { .sun_family = AF_UNIX };
+        strcpy(address.sun_path, socket_path);
+        int worker = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+        for (int tries = 0; tries < 200; tries++) {
+                if (connect(worker, (struct sockaddr *)&address,
+                            sizeof(address)) == 0)
+                        break;
+                usleep(10000);
+        }
+
+        char *in_path = write_temp_file("uno\ndos\n");
+        char *out_path = write_temp_file("");
+        int fds[] = { open(in_path, O_RDONLY), open(out_path, O_WRONLY) };
+
+        /* Descriptors sent with the request */
+        char *response = worker_request(worker, "input=fd:0 output=fd:1",
+                                        fds, 2);
+        CHECK(response != NULL && strncmp(response, "status=0 ", 9) == 0);
+        CHECK(response != NULL && strstr(response, "requests=1\n") != NULL);
+        close(fds[0]);
+        close(fds[1]);
+
+        FILE *out = fopen(out_path, "r");
+        char copied[16] = { 0 };
+        CHECK(fread(copied, 1, sizeof(copied) - 1, out) == 8);
+        CHECK(strcmp(copied, "uno\ndos\n") == 0);
+        fclose(out);
+
+        /* Paths and arguments, on the same connection */
+        char request[256];
+        snprintf(request, sizeof(request), "%s %s -- 7", in_path, out_path);
+        response = worker_request(worker, request, NULL, 0);
+        CHECK(response != NULL && strncmp(response, "status=7 ", 9) == 0);
+        CHECK(response != NULL && strstr(response, "requests=2\n") != NULL);
+
+        /* Invalid requests are answered, but not counted */
+        response = worker_request(worker, "input=fd:3", NULL, 0);
+        CHECK(response != NULL && strncmp(response, "status=1 ", 9) == 0);
+        CHECK(response != NULL && strstr(response, "requests=2\n") != NULL);
+        response = worker_request(worker, request, NULL, 0);
+        CHECK(response != NULL && strstr(response, "requests=3\n") != NULL);
+
+        close(worker);
+        kill(pid, SIGTERM);
+        int status = 0;
+        CHECK(waitpid(pid, &status, 0) == pid);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        CHECK(access(socket_path, F_OK) != 0);
+
+        unlink(in_path);
+        unlink(out_path);
+        free(in_path);
+        free(out_path);
+}
+
+/*
+ * Reads, seeks and writes back files larger than the rings of blocks of
+ * the backends, so their threads and queues have to wait.
+ */
+static void check_io_backend(const char *backend, const char *pipeline)
+{
+        const long n_lines = 150000;
+        setenv("TEXLER_IO", backend, 1);
+        setenv("TEXLER_PIPELINE", pipeline, 1);
+
+        char *in_path = write_temp_file("");
+        char *out_path = write_temp_file("");
+        FILE *fptr = fopen(in_path, "w");
+        for (long i = 1; i <= n_lines; i++)
+                fprintf(fptr, "%07ld\n", i);
+        fclose(fptr);
+
+        TexlerObject *in = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        TexlerObject *out = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        CHECK(open_file(in_path, "r", in, NULL));
+        CHECK(open_file(out_path, "w+", out, NULL));
+
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+        char expected[16];
+        long n = 0;
+        bool in_order = true;
+        while (lines(in, &line) > 0) {
+                snprintf(expected, sizeof(expected), "%07ld\n", ++n);
+                in_order = in_order && strcmp(line, expected) == 0;
+                fputs(line, out->value.file.stream);
+        }
+        CHECK(n == n_lines && in_order);
+
+        /* Backwards, past the blocks already read */
+        CHECK(seek_line(in, 120000));
+        CHECK(lines(in, &line) > 0 && strcmp(line, "0120000\n") == 0);
+        CHECK(seek_line(in, 3));
+        CHECK(lines(in, &line) > 0 && strcmp(line, "0000003\n") == 0);
+
+        /* The output is read back once written */
+        rewind(out->value.file.stream);
+        n = 0;
+        while (lines(out, &line) > 0)
+                n++;
+        CHECK(n == n_lines);
+        CHECK(ftell(out->value.file.stream) == 8 * n_lines);
+
+        free(line);
+        free_texlerobject(in);
+        free_texlerobject(out);
+        unlink(in_path);
+        unlink(out_path);
+        free(in_path);
+        free(out_path);
+        unsetenv("TEXLER_IO");
+        unsetenv("TEXLER_PIPELINE");
+}
+
+static void test_io_backends(void)
+{
+        check_io_backend("auto", "0");
+        check_io_backend("stdio", "0");
+        check_io_backend("read", "0");
+        check_io_backend("read", "1");
+        check_io_backend("mmap", "0");
+        check_io_backend("uring", "0");
+}
+
+/*
+ * Writes a file named *suffix compressed, and reads it back decompressed,
+ * seeking within and past the blocks decompressed. Formats the runtime
+ * was built without fail to open.
+ */
+static void check_compression(const char *suffix, const char *pipeline,
+                              const unsigned char *magic)
+{
+        const long n_lines = 150000;
+        setenv("TEXLER_PIPELINE", pipeline, 1);
+
+        char *temp_path = write_temp_file("");
+        char path[64];
+        snprintf(path, sizeof(path), "%s%s", temp_path, suffix);
+        unlink(temp_path);
+        free(temp_path);
+
+        TexlerObject *out = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        if (open_file(path, "w", out, NULL) == false) {
+                CHECK(errno == ENOTSUP && strcmp(suffix, ".zst") == 0);
+                free_texlerobject(out);
+                unlink(path);
+                unsetenv("TEXLER_PIPELINE");
+                return;
+        }
+        for (long i = 1; i <= n_lines; i++)
+                fprintf(out->value.file.stream, "%07ld\n", i);
+        free_texlerobject(out);
+
+        unsigned char header[4] = { 0 };
+        FILE *fptr = fopen(path, "r");
+        CHECK(fread(header, 1, sizeof(header), fptr) == sizeof(header));
+        fclose(fptr);
+        CHECK(memcmp(header, magic, 2) == 0);
+
+        TexlerObject *in = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        CHECK(open_file(path, "r", in, NULL));
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+        char expected[16];
+        long n = 0;
+        bool in_order = true;
+        while (lines(in, &line) > 0) {
+                snprintf(expected, sizeof(expected), "%07ld\n", ++n);
+                in_order = in_order && strcmp(line, expected) == 0;
+        }
+        CHECK(n == n_lines && in_order);
+
+        /* Back past the kept blocks, forward, and back into the last ones */
+        CHECK(seek_line(in, 3));
+        CHECK(lines(in, &line) > 0 && strcmp(line, "0000003\n") == 0);
+        CHECK(seek_line(in, 120000));
+        CHECK(lines(in, &line) > 0 && strcmp(line, "0120000\n") == 0);
+        CHECK(seek_line(in, 119990));
+        CHECK(lines(in, &line) > 0 && strcmp(line, "0119990\n") == 0);
+        CHECK(seek_line(in, n_lines + 2) == false);
+        free_texlerobject(in);
+
+        /* Bound to a descriptor (--file input=fd:N), it is decompressed
+           too */
+        int fd = open(path, O_RDONLY);
+        texler_stream stream = { .name = "in", .type = TEXLER_STREAM_FD,
+                                 .fd = fd };
+        texler_context context = { &stream, 1 };
+        in = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        CHECK(open_variable_file(&context, "in", NULL, "r", in, NULL));
+        CHECK(lines(in, &line) > 0 && strcmp(line, "0000001\n") == 0);
+        free_texlerobject(in);
+        close(fd);
+
+        /* Cut in half: the lines before the cut, then an error */
+        struct stat st;
+        CHECK(stat(path, &st) == 0 && truncate(path, st.st_size / 2) == 0);
+        in = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        CHECK(open_file(path, "r", in, NULL));
+        n = 0;
+        while (lines(in, &line) > 0)
+                n++;
+        CHECK(n > 0 && n < n_lines && ferror(in->value.file.stream));
+        free_texlerobject(in);
+
+        free(line);
+        unlink(path);
+        unsetenv("TEXLER_PIPELINE");
+}
+
+static void test_compression(void)
+{
+        const unsigned char gzip_magic[] = { 0x1f, 0x8b };
+        const unsigned char zstd_magic[] = { 0x28, 0xb5 };
+
+        check_compression(".gz", "0", gzip_magic);
+        check_compression(".gz", "1", gzip_magic);
+        check_compression(".zst", "0", zstd_magic);
+        check_compression(".zst", "1", zstd_magic);
+}
+
+/* Quoted fields across blocks of 64 bytes and across lines */
+static void test_csv(void)
+{
+        char *path = NULL;
+        TexlerObject *file = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        path = write_temp_file(
+                "a,\"b, \"\"c\"\"\",d\n"
+                "\"0123456789012345678901234567890123456789012345678901234"
+                "5678901234,5\nsecond line\",z\n"
+                "plain, not \"quoted\",\n");
+        CHECK(open_file(path, "r", file, ","));
+
+        const char *fields[] = {
+                "a", "b, \"c\"", "d\n",
+                "0123456789012345678901234567890123456789012345678901234"
+                "5678901234,5\nsecond line",
+                "z\n", "plain", " not \"quoted\"", "\n",
+        };
+        size_t n_fields = sizeof(fields) / sizeof(fields[0]);
+
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+        char *column = calloc(BUFFER_SIZE, sizeof(char));
+        size_t n = 0;
+        while (records(file, &line) > 0) {
+                char *remaining = line;
+                while (remaining != NULL) {
+                        int separator = 0;
+                        file_columns(file, &remaining, &column, &separator);
+                        CHECK(n < n_fields && strcmp(column, fields[n]) == 0);
+                        CHECK(separator == (remaining != NULL ? ',' : 0));
+                        n++;
+                }
+        }
+        CHECK(n == n_fields);
+
+        /* A line not read by records() is indexed on its own */
+        char *remaining = strdup("\"x,y\",w");
+        char *owned = remaining;
+        int separator = 0;
+        CHECK(file_columns(file, &remaining, &column, &separator) == 4);
+        CHECK(strcmp(column, "x,y") == 0 && separator == ',');
+        CHECK(file_columns(file, &remaining, &column, &separator) == 2);
+        CHECK(strcmp(column, "w") == 0 && remaining == NULL);
+
+        free(owned);
+        free(column);
+        free(line);
+        close_temp_file(file, path);
+}
+
+/* Reads the projected columns of the lines of 'data', joined with '|' */
+static void check_projection(const char *data, const char *separators,
+                             const unsigned long *projected, size_t n,
+                             const char *expected)
+{
+        TexlerObject *file = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        char *path = write_temp_file(data);
+        CHECK(open_file(path, "r", file, separators));
+        project_columns(file, projected, n);
+
+        char result[BUFFER_SIZE] = "";
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+        char *column = calloc(BUFFER_SIZE, sizeof(char));
+        while (records(file, &line) > 0) {
+                char *remaining = line;
+                while (remaining != NULL) {
+                        int separator = 0;
+                        if (file_columns(file, &remaining, &column,
+                                         &separator) > 0)
+                                strcat(result, column);
+                        if (separator)
+                                strcat(result, "|");
+                }
+        }
+        CHECK(strcmp(result, expected) == 0);
+
+        free(column);
+        free(line);
+        close_temp_file(file, path);
+}
+
+/* Only the columns asked for, each line ending in its '\n' */
+static void test_projection(void)
+{
+        const unsigned long second_fourth[] = { 2, 4 };
+        const unsigned long first[] = { 1 };
+
+        check_projection("a b c d e\nf,g\nh\n", NULL, second_fourth, 2,
+                         "b|d\ng\n");
+        check_projection("a b c\nd e\n", NULL, first, 1, "a\nd\n");
+        check_projection("a,\"b,c\",d,\"e\nf\"\n", ",", second_fourth, 2,
+                         "b,c|e\nf\n");
+        check_projection("a b\n", NULL, NULL, 0, "a|b\n");
+}
+
+/* Cells of the file at 'path', with their types and the sum of the numbers */
+static void split_cells(const char *path, const char *separators,
+                        const unsigned long *projected, size_t n, char *result,
+                        char *types, double *sum)
+{
+        TexlerObject *file = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        CHECK(open_file(path, "r", file, separators));
+        project_columns(file, projected, n);
+
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+        char *column = calloc(BUFFER_SIZE, sizeof(char));
+        *result = *types = '\0';
+        *sum = 0;
+        while (records(file, &line) > 0) {
+                char *remaining = line;
+                while (remaining != NULL) {
+                        int separator = 0;
+                        if (file_columns(file, &remaining, &column,
+                                         &separator) > 0) {
+                                strcat(result, column);
+                                bool text = cell_type(file, column) ==
+                                            IS_NUMBER_RETURN_NAN;
+                                strcat(types, text ? "s" : "n");
+                                *sum += cell_real(file, column);
+                        }
+                        if (separator)
+                                strcat(result, "|");
+                }
+        }
+
+        free(column);
+        free(line);
+        free_texlerobject(file);
+}
+
+/* The same cells with and without the sidecar, rebuilt if the file changes */
+static void check_cache(const char *data, const char *changed,
+                        const char *separators, const unsigned long *projected,
+                        size_t n)
+{
+        char *path = write_temp_file(data);
+        char sidecar[64];
+        snprintf(sidecar, sizeof(sidecar), "%s.texc", path);
+
+        char expected[BUFFER_SIZE], expected_types[BUFFER_SIZE];
+        char result[BUFFER_SIZE], types[BUFFER_SIZE];
+        double expected_sum, sum;
+        unsetenv("TEXLER_SIDECAR");
+        split_cells(path, separators, projected, n, expected, expected_types,
+                    &expected_sum);
+        CHECK(access(sidecar, F_OK) != 0);
+
+        setenv("TEXLER_SIDECAR", "1", 1);
+        for (int pass = 0; pass < 2; pass++) {
+                split_cells(path, separators, projected, n, result, types,
+                            &sum);
+                CHECK(strcmp(result, expected) == 0);
+                CHECK(strcmp(types, expected_types) == 0);
+                CHECK(sum == expected_sum);
+                CHECK(access(sidecar, F_OK) == 0);
+        }
+
+        /* Same size, another modification time */
+        FILE *fptr = fopen(path, "w");
+        fputs(changed, fptr);
+        fclose(fptr);
+        struct timespec times[2] = { { 0, UTIME_OMIT }, { 1, 0 } };
+        utimensat(AT_FDCWD, path, times, 0);
+
+        unsetenv("TEXLER_SIDECAR");
+        split_cells(path, separators, projected, n, expected, expected_types,
+                    &expected_sum);
+        setenv("TEXLER_SIDECAR", "1", 1);
+        split_cells(path, separators, projected, n, result, types, &sum);
+        CHECK(strcmp(result, expected) == 0);
+        CHECK(strcmp(types, expected_types) == 0);
+        CHECK(sum == expected_sum);
+
+        unsetenv("TEXLER_SIDECAR");
+        unlink(sidecar);
+        unlink(path);
+        free(path);
+}
+
+static void test_cache(void)
+{
+        const unsigned long second_fourth[] = { 2, 4 };
+
+        check_cache("a 1 c 2.5\nx -3\n\nz\n", "b 4 c 7.5\ny -9\n\nw\n",
+                    NULL, NULL, 0);
+        check_cache("a 1 c 2.5 e\nx -3\n", "a 2 c 3.5 e\nx -4\n", NULL,
+                    second_fourth, 2);
+        check_cache("a,\"1,5\",3\n\"b\nc\",4,\"\"\"q\"\"\"\n7,,8\n",
+                    "a,\"2,5\",3\n\"b\nc\",5,\"\"\"q\"\"\"\n7,,9\n", ",",
+                    NULL, 0);
+}
+
+/* The records of the file at path, as sort_records() returns them */
+static char *sorted_text(const char *path, const char *separators,
+                         unsigned long column, bool numeric, bool descending)
+{
+        TexlerObject *file = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        CHECK(open_file(path, "r", file, separators));
+
+        char *text = NULL;
+        size_t length = 0;
+        FILE *output = open_memstream(&text, &length);
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+
+        texler_sort *sort = sort_records(file, column, numeric, descending);
+        CHECK(sort != NULL);
+        while (sorted_records(sort, &line) > 0)
+                fputs(line, output);
+        free_sort(sort);
+
+        fclose(output);
+        free(line);
+        free_texlerobject(file);
+
+        return text;
+}
+
+static void check_sort(const char *data, const char *separators,
+                       unsigned long column, bool numeric, bool descending,
+                       const char *expected)
+{
+        char *path = write_temp_file(data);
+        char *text = sorted_text(path, separators, column, numeric,
+                                 descending);
+
+        CHECK(strcmp(text, expected) == 0);
+
+        free(text);
+        unlink(path);
+        free(path);
+}
+
+/* Lines "key sequence ..." sorted by key, ties in input order */
+static void check_sorted_keys(const char *text, size_t n_lines,
+                              bool descending)
+{
+        size_t n = 0;
+        long key = 0, sequence = 0;
+        for (const char *line = text; *line != '\0'; n++) {
+                long next_key = 0, next_sequence = 0;
+                CHECK(sscanf(line, "%ld %ld", &next_key, &next_sequence) == 2);
+                CHECK(n == 0 || (descending ? key > next_key :
+                                              key < next_key) ||
+                      (key == next_key && sequence < next_sequence));
+                key = next_key;
+                sequence = next_sequence;
+                line = strchr(line, '\n') + 1;
+        }
+        CHECK(n == n_lines);
+}
+
+static char *write_keys_file(size_t n_lines, const char *padding)
+{
+        char *text = NULL;
+        size_t length = 0;
+        FILE *data = open_memstream(&text, &length);
+        for (size_t i = 0; i < n_lines; i++)
+                fprintf(data, "%ld %06zu %s\n", (long)(i * 7919) % 1000 - 500,
+                        i, padding);
+        fclose(data);
+
+        char *path = write_temp_file(text);
+        free(text);
+
+        return path;
+}
+
+/* Runs spilled to disk give the same records, ties in input order */
+static void check_sort_spill(void)
+{
+        char *path = write_keys_file(
+                40000, "................................................");
+
+        unsetenv("TEXLER_SORT_MEMORY");
+        char *expected = sorted_text(path, NULL, 1, true, false);
+        setenv("TEXLER_SORT_MEMORY", "1", 1);
+        char *spilled = sorted_text(path, NULL, 1, true, false);
+        unsetenv("TEXLER_SORT_MEMORY");
+        CHECK(strcmp(spilled, expected) == 0);
+        check_sorted_keys(spilled, 40000, false);
+
+        /* A missing column is an empty key, spilled with no key bytes */
+        char *original = NULL;
+        size_t length = 0;
+        FILE *fptr = fopen(path, "r");
+        CHECK(getdelim(&original, &length, '\0', fptr) > 0);
+        fclose(fptr);
+        setenv("TEXLER_SORT_MEMORY", "1", 1);
+        char *empty = sorted_text(path, NULL, 4, false, false);
+        unsetenv("TEXLER_SORT_MEMORY");
+        CHECK(strcmp(empty, original) == 0);
+
+        free(original);
+        free(empty);
+        free(expected);
+        free(spilled);
+        unlink(path);
+        free(path);
+}
+
+/* The radix sort gives the same records on one thread and on several */
+static void check_sort_threads(void)
+{
+        char *path = write_keys_file(140000, "");
+
+        setenv("TEXLER_SORT_THREADS", "1", 1);
+        char *expected = sorted_text(path, NULL, 1, true, true);
+        setenv("TEXLER_SORT_THREADS", "2", 1);
+        char *sorted = sorted_text(path, NULL, 1, true, true);
+        unsetenv("TEXLER_SORT_THREADS");
+        CHECK(strcmp(sorted, expected) == 0);
+        check_sorted_keys(sorted, 140000, true);
+
+        /* Short strings: radix sorted by their prefix alone */
+        char *codes = sorted_text(path, NULL, 2, false, false);
+        char *original = NULL;
+        size_t length = 0;
+        FILE *fptr = fopen(path, "r");
+        CHECK(getdelim(&original, &length, '\0', fptr) > 0);
+        fclose(fptr);
+        CHECK(strcmp(codes, original) == 0);
+
+        free(original);
+        free(codes);
+        free(expected);
+        free(sorted);
+        unlink(path);
+        free(path);
+}
+
+static void test_sort(void)
+{
+        const char *data = "b 2\na 10\nc 2\nd x\ne -1.5\nf 2";
+
+        check_sort(data, NULL, 1, false, false,
+                   "a 10\nb 2\nc 2\nd x\ne -1.5\nf 2\n");
+        check_sort(data, NULL, 2, false, false,
+                   "e -1.5\na 10\nb 2\nc 2\nf 2\nd x\n");
+        check_sort(data, NULL, 2, true, false,
+                   "e -1.5\nb 2\nc 2\nf 2\na 10\nd x\n");
+        check_sort(data, NULL, 2, true, true,
+                   "d x\na 10\nb 2\nc 2\nf 2\ne -1.5\n");
+        check_sort("ab\nabc\na\n", NULL, 1, false, true, "abc\nab\na\n");
+        /* Missing columns are empty keys, CSV records keep their lines */
+        check_sort("x,3\ny\n\"z\n1\",2\n", ",", 2, true, false,
+                   "\"z\n1\",2\nx,3\ny\n");
+        check_sort("", NULL, 1, false, false, "");
+        check_sort_spill();
+        check_sort_threads();
+}
+
+/* The groups of tex_obj, as grouped_records() returns them */
+static char *grouped_text(TexlerObject *tex_obj, unsigned long column,
+                          const texler_aggregate *aggregates,
+                          size_t n_aggregates)
+{
+        char *text = NULL;
+        size_t length = 0;
+        FILE *output = open_memstream(&text, &length);
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+
+        texler_group *group =
+                group_records(tex_obj, column, aggregates, n_aggregates);
+        CHECK(group != NULL);
+        while (grouped_records(group, &line) > 0)
+                fputs(line, output);
+        free_group(group);
+
+        fclose(output);
+        free(line);
+
+        return text;
+}
+
+static void check_group(const char *data, const char *separators,
+                        unsigned long column,
+                        const texler_aggregate *aggregates,
+                        size_t n_aggregates, const char *expected)
+{
+        char *path = write_temp_file(data);
+        TexlerObject *file = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        CHECK(open_file(path, "r", file, separators));
+
+        char *text = grouped_text(file, column, aggregates, n_aggregates);
+        CHECK(strcmp(text, expected) == 0);
+
+        free(text);
+        close_temp_file(file, path);
+}
+
+/* Spilled partitions give every group once, with all of its records */
+static void check_group_spill(void)
+{
+        char *text = NULL;
+        size_t length = 0;
+        FILE *data = open_memstream(&text, &length);
+        for (size_t i = 0; i < 60000; i++)
+                fprintf(data, "key%zu 1\n", (i * 7919) % 20000);
+        fclose(data);
+
+        TexlerObject *file = NULL;
+        char *path = NULL;
+        file = open_temp_file(text, &path);
+        free(text);
+
+        const texler_aggregate aggregates[] = {
+                { TEXLER_AGGREGATE_COUNT, 0 },
+                { TEXLER_AGGREGATE_SUM, 2 },
+        };
+        setenv("TEXLER_GROUP_MEMORY", "1", 1);
+        char *groups = grouped_text(file, 1, aggregates, 2);
+        unsetenv("TEXLER_GROUP_MEMORY");
+
+        char *seen = calloc(20000, sizeof(char));
+        size_t n = 0;
+        for (const char *line = groups; *line != '\0'; n++) {
+                size_t key = 0, count = 0, sum = 0;
+                CHECK(sscanf(line, "key%zu %zu %zu", &key, &count, &sum) ==
+                      3);
+                CHECK(key < 20000 && !seen[key] && count == 3 && sum == 3);
+                if (key < 20000)
+                        seen[key] = 1;
+                line = strchr(line, '\n') + 1;
+        }
+        CHECK(n == 20000);
+
+        free(seen);
+        free(groups);
+        close_temp_file(file, path);
+
+        /* The empty key of the lines without the column is spilled too */
+        data = open_memstream(&text, &length);
+        for (size_t i = 0; i < 60000; i++)
+                fprintf(data, i % 2 == 0 ? "a key%zu\n" : "b\n", i);
+        fclose(data);
+        file = open_temp_file(text, &path);
+        free(text);
+
+        setenv("TEXLER_GROUP_MEMORY", "1", 1);
+        groups = grouped_text(file, 2, aggregates, 1);
+        unsetenv("TEXLER_GROUP_MEMORY");
+        n = 0;
+        for (const char *line = groups; *line != '\0'; n++)
+                line = strchr(line, '\n') + 1;
+        CHECK(n == 30001);
+        CHECK(strncmp(groups, " 30000\n", 7) == 0 ||
+              strstr(groups, "\n 30000\n") != NULL);
+
+        free(groups);
+        close_temp_file(file, path);
+}
+
+/* The files of a folder give the same groups on one thread or several */
+static void check_group_folder(void)
+{
+        char dir_path[] = "/tmp/texler_runtime_test_XXXXXX";
+        CHECK(mkdtemp(dir_path) != NULL);
+        char path[64];
+        for (int i = 0; i < 8; i++) {
+                snprintf(path, sizeof(path), "%s/%d.txt", dir_path, i);
+                FILE *fptr = fopen(path, "w");
+                for (int j = 0; j < 1000; j++)
+                        fprintf(fptr, "k%d %d\n", (i + j) % 10, j);
+                fprintf(fptr, "only%d 1\n", i);
+                fclose(fptr);
+        }
+
+        TexlerObject *list = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        list->type = TYPE_T_FILE_LIST;
+        list->value.file.n_files = get_list_of_files_in_dir(
+                &list->value.file.path_list, dir_path);
+        list->value.file.separators = strdup(TEXLER_DEFAULT_SEPARATORS);
+
+        const texler_aggregate aggregates[] = {
+                { TEXLER_AGGREGATE_COUNT, 0 },
+                { TEXLER_AGGREGATE_MAX, 2 },
+        };
+        setenv("TEXLER_GROUP_THREADS", "1", 1);
+        char *expected = grouped_text(list, 1, aggregates, 2);
+        setenv("TEXLER_GROUP_THREADS", "4", 1);
+        char *groups = grouped_text(list, 1, aggregates, 2);
+        unsetenv("TEXLER_GROUP_THREADS");
+
+        CHECK(strcmp(groups, expected) == 0);
+        CHECK(strstr(groups, "k0 800 999\n") != NULL);
+        CHECK(strstr(groups, "only7 1 1\n") != NULL);
+
+        free(expected);
+        free(groups);
+        free_texlerobject(list);
+        for (int i = 0; i < 8; i++) {
+                snprintf(path, sizeof(path), "%s/%d.txt", dir_path, i);
+                unlink(path);
+        }
+        rmdir(dir_path);
+}
+
+static void test_group(void)
+{
+        const texler_aggregate all[] = {
+                { TEXLER_AGGREGATE_COUNT, 0 }, { TEXLER_AGGREGATE_SUM, 2 },
+                { TEXLER_AGGREGATE_MIN, 2 },   { TEXLER_AGGREGATE_MAX, 2 },
+                { TEXLER_AGGREGATE_AVG, 2 },
+        };
+        const texler_aggregate sum[] = { { TEXLER_AGGREGATE_SUM, 2 } };
+
+        /* Groups in the order of their first record, values not numbers
+           left out */
+        check_group("a 1\nb x\na 2.5\nc\nb 4", NULL, 1, all, 5,
+                    "a 2 3.5 1 2.5 1.75\nb 2 4 4 4 4\nc 1 0   \n");
+        check_group("b\na\nb\n", NULL, 1, NULL, 0, "b\na\n");
+        /* Long keys (in the arena) next to short ones (in the entry) */
+        check_group("a_key_longer_than_inline 1\nb 2\n"
+                    "a_key_longer_than_inline 3\n",
+                    NULL, 1, sum, 1, "a_key_longer_than_inline 4\nb 2\n");
+        /* CSV keys are quoted back if they have to */
+        check_group("k,v\n\"x,1\",2\n\"x,1\",3\n", ",", 1, sum, 1,
+                    "k,0\n\"x,1\",5\n");
+        check_group("", NULL, 1, sum, 1, "");
+        check_group_spill();
+        check_group_folder();
+}
+
+/* Lines of data that distinct_record() lets through */
+static void check_distinct(const char *data, const char *separators,
+                           unsigned long column, bool consecutive,
+                           const char *expected)
+{
+        char *path = write_temp_file(data);
+        TexlerObject *file = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        CHECK(open_file(path, "r", file, separators));
+
+        char *text = NULL;
+        size_t length = 0;
+        FILE *output = open_memstream(&text, &length);
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+
+        texler_distinct *distinct = new_distinct(file, column, consecutive);
+        CHECK(distinct != NULL);
+        while (lines(file, &line) > 0) {
+                if (distinct_record(distinct, line))
+                        fputs(line, output);
+        }
+        free_distinct(distinct);
+
+        fclose(output);
+        free(line);
+        CHECK(strcmp(text, expected) == 0);
+
+        free(text);
+        close_temp_file(file, path);
+}
+
+/* Many keys: the set grows and keeps every one of them */
+static void check_distinct_growth(void)
+{
+        texler_distinct *distinct = new_distinct(NULL, 0, false);
+        CHECK(distinct == NULL);
+
+        TexlerObject *file = NULL;
+        char *path = NULL;
+        file = open_temp_file("", &path);
+        distinct = new_distinct(file, 0, false);
+
+        char key[32];
+        size_t n = 0;
+        for (size_t i = 0; i < 200000; i++) {
+                snprintf(key, sizeof(key), "key%zu\n", (i * 7919) % 100000);
+                n += distinct_record(distinct, key);
+        }
+        CHECK(n == 100000);
+
+        free_distinct(distinct);
+        close_temp_file(file, path);
+}
+
+static void test_distinct(void)
+{
+        /* First line of each key, in its place */
+        check_distinct("b\na\nb\na\nc\n", NULL, 0, false, "b\na\nc\n");
+        /* The last line, without its '\n', is the same line */
+        check_distinct("a\nb\na", NULL, 0, false, "a\nb\n");
+        check_distinct("x 1\ny 2\nx 3\n", NULL, 1, false, "x 1\ny 2\n");
+        check_distinct("x 1\ny 2\nz 1\n", NULL, 2, false, "x 1\ny 2\n");
+        check_distinct("k,v\n\"x,1\",2\n\"x,1\",3\n", ",", 1, false,
+                       "k,v\n\"x,1\",2\n");
+        /* uniq(): only runs of the same key */
+        check_distinct("a\na\nb\na\n", NULL, 0, true, "a\nb\na\n");
+        check_distinct("x 1\nx 2\ny 3\nx 4\n", NULL, 1, true,
+                       "x 1\ny 3\nx 4\n");
+        check_distinct("", NULL, 0, false, "");
+        check_distinct_growth();
+}
+
+/* The records join_records() returns for probe and build */
+static char *joined_text(TexlerObject *probe, TexlerObject *build,
+                         unsigned long probe_column,
+                         unsigned long build_column, bool left)
+{
+        char *text = NULL;
+        size_t length = 0;
+        FILE *output = open_memstream(&text, &length);
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+
+        texler_join *join = join_records(probe, build, probe_column,
+                                         build_column, left);
+        CHECK(join != NULL);
+        while (joined_records(join, &line) > 0)
+                fputs(line, output);
+        free_join(join);
+
+        fclose(output);
+        free(line);
+
+        return text;
+}
+
+static void check_join(const char *probe_data, const char *build_data,
+                       const char *build_separators, bool left,
+                       const char *expected)
+{
+        char *probe_path = write_temp_file(probe_data);
+        TexlerObject *probe = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        CHECK(open_file(probe_path, "r", probe, NULL));
+        char *build_path = write_temp_file(build_data);
+        TexlerObject *build = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        CHECK(open_file(build_path, "r", build, build_separators));
+
+        char *text = joined_text(probe, build, 1, 1, left);
+        CHECK(strcmp(text, expected) == 0);
+
+        free(text);
+        close_temp_file(probe, probe_path);
+        close_temp_file(build, build_path);
+}
+
+static int compare_lines(const void *a, const void *b)
+{
+        return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Text with its lines sorted, to compare joins in different orders */
+static void sort_lines(char *text, size_t n_lines)
+{
+        char **lines = calloc(n_lines, sizeof(char *));
+        size_t n = 0;
+        for (char *line = strtok(text, "\n"); line != NULL && n < n_lines;
+             line = strtok(NULL, "\n"))
+                lines[n++] = strdup(line);
+        CHECK(n == n_lines);
+        qsort(lines, n, sizeof(char *), compare_lines);
+
+        char *end = text;
+        for (size_t i = 0; i < n; i++) {
+                end += sprintf(end, "%s\n", lines[i]);
+                free(lines[i]);
+        }
+        free(lines);
+}
+
+/* A build side spilled to partitions joins the same records */
+static void check_join_spill(void)
+{
+        char *text = NULL;
+        size_t length = 0;
+        FILE *data = open_memstream(&text, &length);
+        for (size_t i = 0; i < 40000; i++)
+                fprintf(data, "k%zu user%zu ................\n", i % 20000,
+                        i);
+        fclose(data);
+        TexlerObject *build = NULL;
+        char *build_path = NULL;
+        build = open_temp_file(text, &build_path);
+        free(text);
+
+        data = open_memstream(&text, &length);
+        for (size_t i = 0; i < 3000; i++)
+                fprintf(data, "k%zu %zu\n", (i * 7919) % 21000, i);
+        fclose(data);
+        TexlerObject *probe = NULL;
+        char *probe_path = NULL;
+        probe = open_temp_file(text, &probe_path);
+        free(text);
+        /* Unknown, as the one of a pipe: the other file is built */
+        probe->value.file.size = 0;
+
+        char *expected = joined_text(probe, build, 1, 1, true);
+        setenv("TEXLER_JOIN_MEMORY", "1", 1);
+        char *spilled = joined_text(probe, build, 1, 1, true);
+        unsetenv("TEXLER_JOIN_MEMORY");
+
+        /* 2 matches per key below 20000, the rest alone */
+        size_t n_lines = 0;
+        for (size_t i = 0; i < 3000; i++)
+                n_lines += (i * 7919) % 21000 < 20000 ? 2 : 1;
+        sort_lines(expected, n_lines);
+        sort_lines(spilled, n_lines);
+        CHECK(strcmp(spilled, expected) == 0);
+
+        free(expected);
+        free(spilled);
+        close_temp_file(probe, probe_path);
+        close_temp_file(build, build_path);
+}
+
+/* Lines "k<key> <i><padding>", key (i * step) % n_keys */
+static TexlerObject *open_keyed_file(size_t n_lines, size_t step,
+                                     size_t n_keys, const char *padding,
+                                     char **path)
+{
+        char *text = NULL;
+        size_t length = 0;
+        FILE *data = open_memstream(&text, &length);
+        for (size_t i = 0; i < n_lines; i++)
+                fprintf(data, "k%zu %zu%s\n", (i * step) % n_keys, i,
+                        padding);
+        fclose(data);
+
+        TexlerObject *tex_obj = open_temp_file(text, path);
+        free(text);
+
+        return tex_obj;
+}
+
+/* A smaller input is built, spilled or not, and joins the same records */
+static void check_join_swapped_spill(void)
+{
+        char padding[80] = " ";
+        memset(padding + 1, '.', 32);
+        char *probe_path = NULL;
+        TexlerObject *probe =
+                open_keyed_file(25000, 1, 15000, padding, &probe_path);
+        memset(padding + 1, '.', 64);
+        char *build_path = NULL;
+        TexlerObject *build =
+                open_keyed_file(30000, 7919, 12000, padding, &build_path);
+        CHECK(probe->value.file.size < build->value.file.size);
+
+        off_t build_size = build->value.file.size;
+        build->value.file.size = 0;
+        char *expected = joined_text(probe, build, 1, 1, true);
+        build->value.file.size = build_size;
+        char *swapped = joined_text(probe, build, 1, 1, true);
+        setenv("TEXLER_JOIN_MEMORY", "1", 1);
+        char *spilled = joined_text(probe, build, 1, 1, true);
+        unsetenv("TEXLER_JOIN_MEMORY");
+
+        /* Each input line once per match, or alone without any */
+        size_t *matches = calloc(15000, sizeof(size_t));
+        for (size_t i = 0; i < 30000; i++)
+                matches[(i * 7919) % 12000]++;
+        size_t n_lines = 0;
+        for (size_t i = 0; i < 25000; i++)
+                n_lines += matches[i % 15000] > 0 ? matches[i % 15000] : 1;
+        free(matches);
+
+        sort_lines(expected, n_lines);
+        sort_lines(swapped, n_lines);
+        sort_lines(spilled, n_lines);
+        CHECK(strcmp(swapped, expected) == 0);
+        CHECK(strcmp(spilled, expected) == 0);
+
+        free(expected);
+        free(swapped);
+        free(spilled);
+        close_temp_file(probe, probe_path);
+        close_temp_file(build, build_path);
+}
+
+static void test_join(void)
+{
+        /* Probe records in order, each one followed by its matches */
+        check_join("1 a\n2 b\n9 c\n1 d", "1,x\n2,y\n1,z\n", ",", false,
+                   "1 a 1,x\n1 a 1,z\n2 b 2,y\n1 d 1,x\n1 d 1,z\n");
+        /* left keeps the probe records without a match */
+        check_join("1 a\n9 c\n", "1 x\n", NULL, true, "1 a 1 x\n9 c\n");
+        check_join("1 a\n", "", NULL, true, "1 a\n");
+        check_join("", "1 x\n", NULL, false, "");
+        /* Empty keys match each other */
+        check_join("\n", "\n", NULL, false, " \n");
+        /*
+         * A smaller input is built: its records still come first, in the
+         * order of the other file, and a left join adds the unmatched ones
+         * at the end
+         */
+        const char *other = "1,x\n2,y\n1,zzzz\n5,w\n";
+        check_join("1 a\n9 c\n1 d\n", other, ",", false,
+                   "1 a 1,x\n1 d 1,x\n1 a 1,zzzz\n1 d 1,zzzz\n");
+        check_join("1 a\n9 c\n1 d\n", other, ",", true,
+                   "1 a 1,x\n1 d 1,x\n1 a 1,zzzz\n1 d 1,zzzz\n9 c\n");
+        check_join_spill();
+        check_join_swapped_spill();
+}
+
+static char *ranked_text(TexlerObject *tex_obj, unsigned long column,
+                         size_t k)
+{
+        char *text = NULL;
+        size_t length = 0;
+        FILE *output = open_memstream(&text, &length);
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+
+        texler_top *top = top_records(tex_obj, column, k);
+        CHECK(top != NULL);
+        while (ranked_records(top, &line) > 0)
+                fputs(line, output);
+        free_top(top);
+
+        fclose(output);
+        free(line);
+
+        return text;
+}
+
+static void check_top(const char *data, unsigned long column, size_t k,
+                      const char *expected)
+{
+        char *path = NULL;
+        TexlerObject *file = open_temp_file(data, &path);
+
+        char *text = ranked_text(file, column, k);
+        CHECK(strcmp(text, expected) == 0);
+
+        free(text);
+        close_temp_file(file, path);
+}
+
+/* Records that take the place of the root again and again */
+static void check_top_replaced(void)
+{
+        char *text = NULL;
+        size_t length = 0;
+        FILE *data = open_memstream(&text, &length);
+        for (size_t i = 0; i < 50000; i++)
+                fprintf(data, "r%zu %zu ......................\n", i, i);
+        fclose(data);
+        char *path = NULL;
+        TexlerObject *file = open_temp_file(text, &path);
+        free(text);
+
+        char *top = ranked_text(file, 2, 3);
+        CHECK(strcmp(top, "r49999 49999 ......................\n"
+                          "r49998 49998 ......................\n"
+                          "r49997 49997 ......................\n") == 0);
+        free(top);
+
+        /* k above the records: all of them */
+        top = ranked_text(file, 2, 100000);
+        CHECK(strncmp(top, "r49999 ", 7) == 0);
+        const char *last = "\nr0 0 ......................\n";
+        CHECK(strcmp(top + strlen(top) - strlen(last), last) == 0);
+        free(top);
+        close_temp_file(file, path);
+}
+
+/* The files of a folder give the same records on one thread or several */
+static void check_top_folder(void)
+{
+        char dir_path[] = "/tmp/texler_runtime_test_XXXXXX";
+        CHECK(mkdtemp(dir_path) != NULL);
+        char path[64];
+        for (int i = 0; i < 8; i++) {
+                snprintf(path, sizeof(path), "%s/%d.txt", dir_path, i);
+                FILE *fptr = fopen(path, "w");
+                for (int j = 0; j < 1000; j++)
+                        fprintf(fptr, "f%d %d\n", i, (i * 37 + j * 11) % 500);
+                fclose(fptr);
+        }
+
+        TexlerObject *list = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        list->type = TYPE_T_FILE_LIST;
+        list->value.file.n_files = get_list_of_files_in_dir(
+                &list->value.file.path_list, dir_path);
+        list->value.file.separators = strdup(TEXLER_DEFAULT_SEPARATORS);
+
+        setenv("TEXLER_TOP_THREADS", "1", 1);
+        char *expected = ranked_text(list, 2, 20);
+        setenv("TEXLER_TOP_THREADS", "4", 1);
+        char *top = ranked_text(list, 2, 20);
+        unsetenv("TEXLER_TOP_THREADS");
+
+        CHECK(strcmp(top, expected) == 0);
+        size_t n = 0;
+        /* Each value twice per file */
+        for (const char *line = top; *line != '\0'; n++) {
+                CHECK(atoi(strchr(line, ' ') + 1) == (n < 16 ? 499 : 498));
+                line = strchr(line, '\n') + 1;
+        }
+        CHECK(n == 20);
+
+        free(expected);
+        free(top);
+        free_texlerobject(list);
+        for (int i = 0; i < 8; i++) {
+                snprintf(path, sizeof(path), "%s/%d.txt", dir_path, i);
+                unlink(path);
+        }
+        rmdir(dir_path);
+}
+
+static void test_top(void)
+{
+        /* Greatest first, ties in the order they were read, values not
+           numbers left out */
+        check_top("a 3\nb x\nc 10\nd 3\ne -1\n", 2, 3, "c 10\na 3\nd 3\n");
+        check_top("a 3\nb 2.5", 2, 5, "a 3\nb 2.5");
+        /* By length, without the '\n' */
+        check_top("ab\nabcd\n\nabc\nabcd\n", 0, 2, "abcd\nabcd\n");
+        check_top("", 0, 1, "");
+        CHECK(top_records(NULL, 0, 1) == NULL);
+        check_top_replaced();
+        check_top_folder();
+}
+
+static int count_open_fds(void)
+{
+        int count = 0;
+        DIR *dir = opendir("/proc/self/fd");
+        while (dir != NULL && readdir(dir) != NULL)
+                count++;
+        if (dir != NULL)
+                closedir(dir);
+
+        return count;
+}
+
+/* Every file of a folder once, also when it is walked again */
+static void test_prefetch(void)
+{
+        char dir_path[] = "/tmp/texler_runtime_test_XXXXXX";
+        CHECK(mkdtemp(dir_path) != NULL);
+        char path[64];
+        for (int i = 0; i < 10; i++) {
+                snprintf(path, sizeof(path), "%s/%d.txt", dir_path, i);
+                FILE *fptr = fopen(path, "w");
+                fprintf(fptr, "%d\n", i);
+                fclose(fptr);
+        }
+        setenv("TEXLER_PREFETCH", "3", 1);
+        int fds = count_open_fds();
+
+        TexlerObject *list = (TexlerObject *)calloc(1, sizeof(TexlerObject));
+        list->type = TYPE_T_FILE_LIST;
+        list->value.file.n_files = get_list_of_files_in_dir(
+                &list->value.file.path_list, dir_path);
+        CHECK(list->value.file.n_files == 10);
+
+        char *line = calloc(BUFFER_SIZE, sizeof(char));
+        for (int pass = 0; pass < 2; pass++) {
+                list->value.file.next_open_file = pass == 0 ? 0 : 6;
+                int seen = 0;
+                for (size_t i = list->value.file.next_open_file;
+                     i < list->value.file.n_files; i++) {
+                        TexlerObject *file = get_next_file(list, NULL);
+                        CHECK(file != NULL && lines(file, &line) > 0);
+                        seen |= 1 << atoi(line);
+                        free_texlerobject(file);
+                }
+                CHECK(__builtin_popcount(seen) == (pass == 0 ? 10 : 4));
+        }
+
+        /* Walked halfway: the files opened ahead are closed */
+        list->value.file.next_open_file = 0;
+        free_texlerobject(get_next_file(list, NULL));
+        free_texlerobject(list);
+        CHECK(count_open_fds() == fds);
+
+        for (int i = 0; i < 10; i++) {
+                snprintf(path, sizeof(path), "%s/%d.txt", dir_path, i);
+                unlink(path);
+        }
+        rmdir(dir_path);
+        free(line);
+        unsetenv("TEXLER_PREFETCH");
+}
+
+static void test_columns(void)
+{
+        char *line = strdup("uno,dos tres");
+        char *remaining = line;
+        char *column = calloc(BUFFER_SIZE, sizeof(char));
+        int separator = 0;
+
+        CHECK(columns(&remaining, NULL, &column, &separator) == 4);
+        CHECK(strcmp(column, "uno") == 0 && separator == ',');
+        CHECK(columns(&remaining, NULL, &column, &separator) == 4);
+        CHECK(strcmp(column, "dos") == 0 && separator == ' ');
+        CHECK(columns(&remaining, NULL, &column, &separator) == 5);
+        CHECK(strcmp(column, "tres") == 0);
+        CHECK(remaining == NULL);
+
+        free(column);
+        free(line);
+}
+
+static void test_strings(void)
+{
+        char *str = string_addition(strdup("hola\n"), " mundo");
+        CHECK(strcmp(str, "hola mundo") == 0);
+
+        str = string_substract(str, " mundo");
+        CHECK(strcmp(str, "hola") == 0);
+        str = string_substract(str, "xx");
+        CHECK(strcmp(str, "hola") == 0);
+
+        CHECK(at(str, 1) == 'h');
+        CHECK(at(str, 4) == 'a');
+        free(str);
+
+        CHECK(is_in_string("dos", "uno dos tres"));
+        CHECK(!is_in_string("cuatro", "uno dos tres"));
+
+        CHECK(is_number("123", 3) == IS_NUMBER_RETURN_INTEGER);
+        CHECK(is_number("1.5", 3) == IS_NUMBER_RETURN_FLOATING);
+        CHECK(is_number("1a", 2) == IS_NUMBER_RETURN_NAN);
+}
+
+static void test_compare_equality(void)
+{
+        TexlerObject left = { .type = TYPE_T_INTEGER, .value.integer = 3 };
+        TexlerObject right = { .type = TYPE_T_INTEGER, .value.integer = 3 };
+        CHECK(compare_equality(&left, &right));
+
+        TexlerObject real = { .type = TYPE_T_REAL, .value.real = 5.0 };
+        CHECK(compare_equality_constant_number_int(5, &real));
+        CHECK(!compare_equality_constant_number_int(4, &real));
+
+        TexlerObject string = { .type = TYPE_T_STRING,
+                                .value.string = "texler" };
+        CHECK(compare_equality_constant_string("texler", &string));
+        CHECK(!compare_equality_constant_string("c", &string));
+}
+
+int main(void)
+{
+        test_lines();
+        test_seek_line();
+        test_lines_by_numbers();
+        test_variable_streams();
+        test_batch();
+        test_worker();
+        test_io_backends();
+        test_compression();
+        test_prefetch();
+        test_columns();
+        test_csv();
+        test_projection();
+        test_cache();
+        test_sort();
+        test_group();
+        test_distinct();
+        test_join();
+        test_top();
+        test_strings();
+        test_compare_equality();
+
+        if (failures > 0) {
+                fprintf(stderr, "%d checks failed\n", failures);
+                return 1;
+        }
+
+        return 0;
+}
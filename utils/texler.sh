@@ -27,6 +27,69 @@ readonly SCRIPT_DIR="$(dirname ${BASH_SOURCE[0]})"
 
 chmod +x "$SCRIPT_DIR/texler_compiler"
 
+function usage()
+{
+    echo "Usage: texler [-p debug|release|lto|pgo] [-n] [-l] [-t args]" \
+         "[-j jobs] file..."
+    echo "       texler -r file [args...]"
+    echo "  -r  Run the program right away in the texler VM, without"
+    echo "      building an executable. Its arguments follow the file"
+    echo "  -p  Build profile of the generated programs (default: release)"
+    echo "  -n  Tune the programs for this machine (-march=native)"
+    echo "  -l  Build shared objects (.so) exporting texler_run() instead"
+    echo "      of executables, to run the programs from other processes"
+    echo "  -t  Arguments of the training run of the pgo profile. The"
+    echo "      program is run once in the current directory, so it"
+    echo "      reads and writes its files there"
+    echo "  -j  Number of files compiled at the same time (default: one"
+    echo "      per core)"
+}
+
+build_profile="${TEXLER_PROFILE:-release}"
+march_native=0
+pgo_args=""
+max_jobs="${TEXLER_JOBS:-$(nproc)}"
+run_vm=0
+build_library=0
+
+while getopts "p:nlt:j:rh" opt; do
+    case $opt in
+        p) build_profile="$OPTARG" ;;
+        n) march_native=1 ;;
+        l) build_library=1 ;;
+        t) pgo_args="$OPTARG" ;;
+        j) max_jobs="$OPTARG" ;;
+        r) run_vm=1 ;;
+        h) usage; exit 0 ;;
+        *) usage; exit 1 ;;
+    esac
+done
+shift $(( OPTIND - 1 ))
+
+case "$build_profile" in
+    debug|release|lto|pgo) ;;
+    *)
+        echo -e "\e[31mError\e[0m"
+        echo "Unknown build profile: $build_profile"
+        usage
+        exit 1
+        ;;
+esac
+
+# The training run of pgo needs an executable
+if [ $build_library -eq 1 ] && [ "$build_profile" = "pgo" ]; then
+    echo -e "\e[31mError\e[0m"
+    echo "The pgo profile can not build shared objects."
+    exit 1
+fi
+
+output_extension="elf"
+compiler_mode=""
+if [ $build_library -eq 1 ]; then
+    output_extension="so"
+    compiler_mode="--library"
+fi
+
 if [ ${#@} -eq 0 ]; then
     echo -e "\e[31mError\e[0m"
     echo "Please provide an input file."
@@ -34,7 +97,13 @@ if [ ${#@} -eq 0 ]; then
     exit 1
 fi
 
-for (( opt_i=1; opt_i <= ${#}; opt_i++)); do
+# Only the program is a file in run mode, the rest are its arguments
+files_to_check=${#}
+if [ $run_vm -eq 1 ]; then
+    files_to_check=1
+fi
+
+for (( opt_i=1; opt_i <= files_to_check; opt_i++)); do
    if [ ! -f "${!opt_i}" ]; then
        echo -e "\e[31mError\e[0m"
        echo "Argument number $opt_i is not a regular file:"
@@ -43,18 +112,225 @@ for (( opt_i=1; opt_i <= ${#}; opt_i++)); do
    fi
 done
 
+if [ $run_vm -eq 1 ]; then
+    texler_source="$1"
+    shift
+    exec "$SCRIPT_DIR"/texler_compiler --run "$@" < "$texler_source"
+fi
+
+# Outputs and logs are named after the file without its folder, so two
+# files with the same name would overwrite each other's
+declare -A source_names=()
+for (( opt_i=1; opt_i <= ${#}; opt_i++)); do
+    source_name="$(basename "${!opt_i}")"
+    source_name="${source_name%.*}"
+    if [ -n "${source_names[$source_name]}" ]; then
+        echo -e "\e[31mError\e[0m"
+        echo "Both files would build $source_name.$output_extension:"
+        echo "${source_names[$source_name]}"
+        echo "${!opt_i}"
+        exit 1
+    fi
+    source_names[$source_name]="${!opt_i}"
+done
+
 readonly compilation_logs_folder="logs"
 
+# Build cache: finished executables are stored under $TEXLER_CACHE_DIR,
+# keyed by the source, the compiler, the runtime and the gcc flags.
+# TEXLER_CACHE=0 disables it, TEXLER_CACHE_SIZE is its limit in MiB.
+readonly cache_dir="${TEXLER_CACHE_DIR:-${XDG_CACHE_HOME:-$HOME/.cache}/texler}"
+readonly cache_size_limit=$(( ${TEXLER_CACHE_SIZE:-256} * 1024 * 1024 ))
+
+function cache_enabled()
+{
+    [ "${TEXLER_CACHE:-1}" != "0" ] && mkdir -p "$cache_dir" &> /dev/null
+}
+
+# Hash of everything that affects the executable
+#
+# Arguments:
+#   $1 : Texler source
+#   $* : gcc flags
+function cache_key()
+{
+    local texler_source="$1"
+    shift
+
+    {
+        sha256sum < "$texler_source"
+        sha256sum < "$SCRIPT_DIR/texler_compiler"
+        cat "$SCRIPT_DIR/libtexlerrt.a" "$SCRIPT_DIR/libtexlerrt.libs" \
+            "$SCRIPT_DIR/include/"*.h \
+            | sha256sum
+        gcc --version | head -n 1
+        echo "$*"
+        # -march=native builds for this CPU only: the options gcc picks
+        # for it tell CPUs apart in a shared cache
+        if [[ " $* " == *" -march=native "* ]]; then
+            gcc -march=native -Q --help=target 2> /dev/null
+        fi
+    } | sha256sum | cut -d ' ' -f 1
+}
+
+# Copies a cached executable to $2. Touching it keeps the LRU order.
+function cache_fetch()
+{
+    local cached="$cache_dir/$1.$output_extension"
+
+    [ -f "$cached" ] || return 1
+    touch "$cached" &> /dev/null
+    cp "$cached" "$2" && chmod +x "$2"
+}
+
+function cache_store()
+{
+    local cached="$cache_dir/$1.$output_extension"
+    local tmp_cached="$(mktemp -p "$cache_dir" .store_XXX)"
+
+    # Written under a temporary name so other texler runs never see a
+    # half copied executable
+    cp "$2" "$tmp_cached" && chmod 755 "$tmp_cached" \
+        && mv -f "$tmp_cached" "$cached"
+    rm -f "$tmp_cached"
+
+    cache_evict
+}
+
+# Removes the least recently used executables until the cache fits in
+# $cache_size_limit
+function cache_evict()
+{
+    (
+        flock -n 9 || exit 0
+
+        local total=0
+        local -a entries=()
+        mapfile -t entries < <(find "$cache_dir" -maxdepth 1 \
+            \( -name '*.elf' -o -name '*.so' \) \
+            -printf '%T@ %s %p\n' | sort -n)
+
+        for entry in "${entries[@]}"; do
+            read -r _ size _ <<< "$entry"
+            total=$(( total + size ))
+        done
+
+        for entry in "${entries[@]}"; do
+            [ $total -le $cache_size_limit ] && break
+            read -r _ size path <<< "$entry"
+            rm -f "$path"
+            total=$(( total - size ))
+        done
+    ) 9> "$cache_dir/.lock"
+}
+
+# Fills the array named $1 with the gcc flags of $build_profile
+#
+# The runtime comes precompiled in libtexlerrt.a, only the program itself
+# is compiled with these. The library objects carry LTO bytecode too, but
+# running the LTO plugin on every link costs more than it saves on short
+# scripts, so only the lto profile uses it.
+function profile_flags()
+{
+    local -n flags="$1"
+
+    case "$build_profile" in
+        debug) flags=(--std=gnu11 -O0 -g -fno-use-linker-plugin) ;;
+        release) flags=(--std=gnu11 -O2 -fno-use-linker-plugin) ;;
+        lto) flags=(--std=gnu11 -O2 -flto) ;;
+        pgo) flags=(--std=gnu11 -O2 -fno-use-linker-plugin) ;;
+    esac
+
+    if [ $march_native -eq 1 ]; then
+        flags+=(-march=native)
+    fi
+
+    # Only texler_run() is exported, the runtime stays hidden inside the
+    # shared object so several programs can be loaded in one process
+    if [ $build_library -eq 1 ]; then
+        flags+=(-shared -fPIC -fvisibility=hidden -Wl,--exclude-libs,ALL)
+    fi
+}
+
+# Arguments:
+#   $1 : C source
+#   $2 : Executable
+#   $* : gcc flags
+function gcc_build()
+{
+    local c_source="$1"
+    local executable="$2"
+    shift 2
+
+    gcc \
+        "$@" \
+        -I"$SCRIPT_DIR/include" \
+        "$c_source" \
+        -o "$executable" \
+        -L"$SCRIPT_DIR" \
+        -Wl,--gc-sections \
+        -ltexlerrt \
+        $(cat "$SCRIPT_DIR/libtexlerrt.libs" 2> /dev/null) \
+        -lm \
+        -pthread \
+        &> /dev/null
+}
+
+# Builds an instrumented executable, runs it once with $pgo_args and
+# rebuilds it with the profile it wrote
+#
+# Arguments:
+#   $1 : C source
+#   $2 : Executable
+#   $* : gcc flags
+function pgo_build()
+{
+    local c_source="$1"
+    local executable="$2"
+    shift 2
+
+    local profile_dir="$(mktemp -d)"
+    local ret_val=0
+
+    gcc_build "$c_source" "$executable" "$@" \
+        -fprofile-generate -fprofile-dir="$profile_dir"
+    ret_val=$?
+
+    if [ $ret_val -eq 0 ]; then
+        ./"$executable" $pgo_args &> /dev/null
+        gcc_build "$c_source" "$executable" "$@" \
+            -fprofile-use -fprofile-dir="$profile_dir" \
+            -fprofile-correction -Wno-missing-profile
+        ret_val=$?
+    fi
+
+    rm -rf "$profile_dir"
+    return $ret_val
+}
+
 function compile_file()
 {
     local ret_val=0
 
     local texler_source="$1"
-    local source_name="$(basename $1)"
+    local source_name="$(basename "$1")"
     source_name="${source_name%.*}"
     local c_source="$(mktemp -u -p . ${source_name}_XXX.c)"
 
+    local -a gcc_flags=()
+    profile_flags gcc_flags
+
+    # pgo executables depend on the training run, they are never cached
+    local key=""
+    if [ "$build_profile" != "pgo" ] && cache_enabled; then
+        key="$(cache_key "$texler_source" "${gcc_flags[@]}")"
+        if cache_fetch "$key" "$source_name.$output_extension"; then
+            return 0
+        fi
+    fi
+
     "$SCRIPT_DIR"/texler_compiler \
+        $compiler_mode \
         $c_source \
         < "$texler_source" \
         > "$compilation_logs_folder/$source_name.log" \
@@ -71,18 +347,23 @@ function compile_file()
         return $ret_val
     fi
 
-    gcc \
-        --std=gnu11 \
-        "$c_source" \
-        -o "$source_name.elf" \
-        &> /dev/null
+    if [ "$build_profile" = "pgo" ]; then
+        pgo_build "$c_source" "$source_name.elf" "${gcc_flags[@]}"
+    else
+        gcc_build "$c_source" "$source_name.$output_extension" \
+            "${gcc_flags[@]}"
+    fi
     ret_val=$?
-    
+
     if [ $ret_val -ne 0 ]; then
         echo "GCC error. Call support D:"
         return $ret_val
     fi
 
+    if [ -n "$key" ]; then
+        cache_store "$key" "$source_name.$output_extension"
+    fi
+
     return $ret_val
 }
 
@@ -96,12 +377,36 @@ max_return=0
 
 mkdir -p "$compilation_logs_folder" &> /dev/null
 
-for (( opt_i=1; opt_i <= ${#}; opt_i++)); do
-    ret_val=0
-    compile_file "${!opt_i}"
+if ! [[ "$max_jobs" =~ ^[0-9]+$ ]] || [ "$max_jobs" -lt 1 ]; then
+    max_jobs=1
+fi
+
+# Files are compiled by up to $max_jobs background jobs. Every file has
+# its own logs and C source, so jobs never share anything but the cache
+running_jobs=0
+
+function wait_job()
+{
+    local ret_val=0
+
+    wait -n
     ret_val=$?
+    running_jobs=$(( running_jobs - 1 ))
 
     max_return=$(( $ret_val > $max_return ? $ret_val : $max_return ))
+}
+
+for (( opt_i=1; opt_i <= ${#}; opt_i++)); do
+    if [ $running_jobs -ge $max_jobs ]; then
+        wait_job
+    fi
+
+    compile_file "${!opt_i}" &
+    running_jobs=$(( running_jobs + 1 ))
+done
+
+while [ $running_jobs -gt 0 ]; do
+    wait_job
 done
 
 exit $max_return